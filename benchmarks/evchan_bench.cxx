@@ -0,0 +1,576 @@
+// Throughput and latency benchmarks for the evchan primitives and tarp::tsq.
+//
+// Each benchmark runs P producer threads and C consumer threads passing
+// timestamped messages through one of the primitives. Reported are:
+//  - the number of messages sent and received (the latter can be smaller
+//    for lossy configurations e.g. circular channels and can be larger for
+//    the broadcaster, where every consumer gets a copy of every message).
+//  - throughput: messages received per second.
+//  - latency: p50/p99/p99.9 of the time (ns) between the push and the get
+//    of each message.
+//
+// Results are printed to stdout in CSV (default) or JSON format so they can
+// be diffed across runs or fed to other tools. Progress goes to stderr.
+//
+// Usage: evchan_bench [--format csv|json] [--msgs N] [--threads 1,2,4]
+//                     [--filter SUBSTRING] [--diagonal]
+//
+// By default every combination of producer and consumer counts from the
+// --threads list is run. With --diagonal, only runs with an equal number of
+// producers and consumers are done.
+//
+// NOTE: event_channel and event_aggregator are non-blocking; their
+// producers and consumers busy-poll (yielding the cpu between attempts).
+// Trunk, tsq and sharded_tsq consumers block.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <tarp/evchan.hxx>
+#include <tarp/histogram.hxx>
+#include <tarp/tsq.hxx>
+
+using namespace std::chrono_literals;
+namespace E = tarp::evchan::ts;
+using CLOCK = std::chrono::steady_clock;
+
+namespace {
+
+std::uint64_t now_ns() {
+    return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        CLOCK::now().time_since_epoch())
+        .count());
+}
+
+//
+
+struct small_payload {
+    std::uint64_t ts {0};
+};
+
+struct large_payload {
+    std::uint64_t ts {0};
+    std::array<std::uint8_t, 1024> data {};
+};
+
+using tuple_payload = std::tuple<std::uint64_t, std::uint32_t, double>;
+
+template<typename P>
+const char *payload_name() {
+    if constexpr (std::is_same_v<P, small_payload>) {
+        return "small";
+    } else if constexpr (std::is_same_v<P, large_payload>) {
+        return "large";
+    } else {
+        return "tuple";
+    }
+}
+
+template<typename P>
+P make_payload(std::uint64_t ts) {
+    if constexpr (std::is_same_v<P, tuple_payload>) {
+        return {ts, 1, 1.0};
+    } else {
+        P p;
+        p.ts = ts;
+        return p;
+    }
+}
+
+template<typename P>
+std::uint64_t stamp_of(const P &p) {
+    if constexpr (std::is_same_v<P, tuple_payload>) {
+        return std::get<0>(p);
+    } else {
+        return p.ts;
+    }
+}
+
+// Map a payload type to the evchan class template parameterized with it;
+// tuple payloads are spread out into multiple types, the way a multi-item
+// channel would be declared by a user.
+template<template<typename...> class C, typename P>
+struct chan_of {
+    using type = C<P>;
+};
+
+template<template<typename...> class C, typename... Ts>
+struct chan_of<C, std::tuple<Ts...>> {
+    using type = C<Ts...>;
+};
+
+// Likewise, for the event_aggregator, whose first parameter is the key.
+template<typename key_t, typename P>
+struct aggregator_of {
+    using type = E::event_aggregator<key_t, P>;
+};
+
+template<typename key_t, typename... Ts>
+struct aggregator_of<key_t, std::tuple<Ts...>> {
+    using type = E::event_aggregator<key_t, Ts...>;
+};
+
+template<typename chan_t, typename P>
+auto try_push(chan_t &chan, P &&p) {
+    if constexpr (std::is_same_v<std::decay_t<P>, tuple_payload>) {
+        return std::apply(
+          [&chan](auto &&...items) {
+              return chan.try_push(std::forward<decltype(items)>(items)...);
+          },
+          std::forward<P>(p));
+    } else {
+        return chan.try_push(std::forward<P>(p));
+    }
+}
+
+template<typename chan_t, typename P>
+auto blocking_push(chan_t &chan, P &&p) {
+    if constexpr (std::is_same_v<std::decay_t<P>, tuple_payload>) {
+        return std::apply(
+          [&chan](auto &&...items) {
+              return chan.push(std::forward<decltype(items)>(items)...);
+          },
+          std::forward<P>(p));
+    } else {
+        return chan.push(std::forward<P>(p));
+    }
+}
+
+//
+
+struct config {
+    std::uint64_t num_msgs {100 * 1000};
+    std::vector<unsigned> threads {1, 2, 4, 8, 16};
+    std::string filter;
+    bool json {false};
+    bool diagonal {false};
+};
+
+struct result {
+    std::string primitive;
+    std::string mode;
+    std::string payload;
+    unsigned producers {0};
+    unsigned consumers {0};
+    std::uint64_t sent {0};
+    std::uint64_t received {0};
+    double seconds {0};
+    tarp::histogram latency;
+
+    double ops_per_sec() const {
+        return seconds > 0 ? static_cast<double>(received) / seconds : 0;
+    }
+};
+
+class reporter {
+public:
+    explicit reporter(bool json) : m_json(json) {}
+
+    void begin() {
+        if (m_json) {
+            std::cout << "[\n";
+            return;
+        }
+        std::cout << "primitive,mode,payload,producers,consumers,sent,"
+                     "received,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns\n";
+    }
+
+    void add(const result &r) {
+        auto p50 = r.latency.percentile(50);
+        auto p99 = r.latency.percentile(99);
+        auto p999 = r.latency.percentile(99.9);
+
+        if (!m_json) {
+            std::cout << r.primitive << "," << r.mode << "," << r.payload
+                      << "," << r.producers << "," << r.consumers << ","
+                      << r.sent << "," << r.received << "," << r.seconds
+                      << "," << static_cast<std::uint64_t>(r.ops_per_sec())
+                      << "," << p50 << "," << p99 << "," << p999 << std::endl;
+            return;
+        }
+
+        std::cout << (m_first ? "" : ",\n") << "  {\"primitive\": \""
+                  << r.primitive << "\", \"mode\": \"" << r.mode
+                  << "\", \"payload\": \"" << r.payload
+                  << "\", \"producers\": " << r.producers
+                  << ", \"consumers\": " << r.consumers
+                  << ", \"sent\": " << r.sent
+                  << ", \"received\": " << r.received
+                  << ", \"seconds\": " << r.seconds << ", \"ops_per_sec\": "
+                  << static_cast<std::uint64_t>(r.ops_per_sec())
+                  << ", \"p50_ns\": " << p50 << ", \"p99_ns\": " << p99
+                  << ", \"p999_ns\": " << p999 << "}";
+        std::cout.flush();
+        m_first = false;
+    }
+
+    void end() {
+        if (m_json) {
+            std::cout << "\n]" << std::endl;
+        }
+    }
+
+private:
+    const bool m_json;
+    bool m_first {true};
+};
+
+//
+
+// Start the producer and consumer threads, time the run and merge the
+// per-consumer latency histograms into r. producer(i) must send
+// num_msgs/num_producers messages; consumer(i, hist) must return the
+// number of messages it received. on_producers_done is invoked after all
+// producers have finished.
+template<typename producer_t, typename consumer_t>
+void run(result &r,
+         producer_t &&producer,
+         consumer_t &&consumer,
+         const std::function<void()> &on_producers_done) {
+    std::vector<tarp::histogram> hists(r.consumers);
+    std::vector<std::uint64_t> received(r.consumers, 0);
+    std::vector<std::thread> producers, consumers;
+
+    auto start = CLOCK::now();
+
+    for (unsigned i = 0; i < r.consumers; ++i) {
+        consumers.emplace_back([&, i] { received[i] = consumer(i, hists[i]); });
+    }
+    for (unsigned i = 0; i < r.producers; ++i) {
+        producers.emplace_back([&, i] { producer(i); });
+    }
+
+    for (auto &t : producers) {
+        t.join();
+    }
+    on_producers_done();
+
+    for (auto &t : consumers) {
+        t.join();
+    }
+
+    r.seconds = std::chrono::duration<double>(CLOCK::now() - start).count();
+    for (unsigned i = 0; i < r.consumers; ++i) {
+        r.latency.merge(hists[i]);
+        r.received += received[i];
+    }
+}
+
+// Number of messages producer i must send such that num_msgs are sent in
+// total.
+std::uint64_t share(std::uint64_t num_msgs, unsigned n, unsigned i) {
+    return num_msgs / n + (i < num_msgs % n ? 1 : 0);
+}
+
+//
+
+template<typename P>
+void bench_event_channel(result &r, std::uint64_t num_msgs, bool circular) {
+    using chan_t = typename chan_of<E::event_channel, P>::type;
+    chan_t chan(1024, circular);
+    std::atomic<bool> done {false};
+
+    auto producer = [&](unsigned i) {
+        for (std::uint64_t n = share(num_msgs, r.producers, i); n > 0; --n) {
+            while (!try_push(chan, make_payload<P>(now_ns())).first) {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    auto consumer = [&](unsigned, tarp::histogram &hist) {
+        std::uint64_t count = 0;
+        for (;;) {
+            auto ev = chan.try_get();
+            if (ev.has_value()) {
+                hist.record(now_ns() - stamp_of(*ev));
+                ++count;
+                continue;
+            }
+            if (done.load()) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        return count;
+    };
+
+    r.sent = num_msgs;
+    run(r, producer, consumer, [&] { done = true; });
+}
+
+template<typename P>
+void bench_trunk(result &r, std::uint64_t num_msgs) {
+    using chan_t = typename chan_of<E::trunk, P>::type;
+    chan_t trunk;
+
+    auto producer = [&](unsigned i) {
+        for (std::uint64_t n = share(num_msgs, r.producers, i); n > 0; --n) {
+            blocking_push(trunk, make_payload<P>(now_ns()));
+        }
+    };
+
+    auto consumer = [&](unsigned, tarp::histogram &hist) {
+        std::uint64_t count = 0;
+        while (auto ev = trunk.get()) {
+            hist.record(now_ns() - stamp_of(*ev));
+            ++count;
+        }
+        return count;
+    };
+
+    r.sent = num_msgs;
+    run(r, producer, consumer, [&] { trunk.close(); });
+}
+
+// Every consumer gets its own channel connected to the broadcaster.
+template<typename P>
+void bench_event_broadcaster(result &r, std::uint64_t num_msgs, bool circular) {
+    using broadcaster_t = typename chan_of<E::event_broadcaster, P>::type;
+    using chan_t = typename chan_of<E::event_channel, P>::type;
+
+    broadcaster_t br(true);
+    std::vector<std::shared_ptr<chan_t>> channels;
+    for (unsigned i = 0; i < r.consumers; ++i) {
+        channels.push_back(std::make_shared<chan_t>(1024, circular));
+        br.connect(channels.back());
+    }
+
+    std::atomic<bool> done {false};
+
+    auto producer = [&](unsigned i) {
+        for (std::uint64_t n = share(num_msgs, r.producers, i); n > 0; --n) {
+            if constexpr (std::is_same_v<P, tuple_payload>) {
+                std::apply([&br](auto &&...items) { br.push(items...); },
+                           make_payload<P>(now_ns()));
+            } else {
+                br.push(make_payload<P>(now_ns()));
+            }
+        }
+    };
+
+    auto consumer = [&](unsigned i, tarp::histogram &hist) {
+        auto &chan = *channels[i];
+        std::uint64_t count = 0;
+        for (;;) {
+            auto ev = chan.try_get();
+            if (ev.has_value()) {
+                hist.record(now_ns() - stamp_of(*ev));
+                ++count;
+                continue;
+            }
+            if (done.load()) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        return count;
+    };
+
+    r.sent = num_msgs;
+    run(r, producer, consumer, [&] { done = true; });
+}
+
+// Every producer gets its own (circular) channel from the aggregator; all
+// consumers read from the aggregator.
+template<typename P>
+void bench_event_aggregator(result &r, std::uint64_t num_msgs) {
+    using aggregator_t = typename aggregator_of<unsigned, P>::type;
+    aggregator_t agg;
+    std::atomic<bool> done {false};
+
+    auto producer = [&](unsigned i) {
+        auto chan = agg.channel(i, 1024);
+        for (std::uint64_t n = share(num_msgs, r.producers, i); n > 0; --n) {
+            try_push(*chan, make_payload<P>(now_ns()));
+        }
+    };
+
+    auto consumer = [&](unsigned, tarp::histogram &hist) {
+        std::uint64_t count = 0;
+        for (;;) {
+            auto ev = agg.try_get();
+            if (ev.has_value()) {
+                hist.record(now_ns() - stamp_of(*ev));
+                ++count;
+                continue;
+            }
+            if (done.load()) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        return count;
+    };
+
+    r.sent = num_msgs;
+    run(r, producer, consumer, [&] { done = true; });
+}
+
+// q is a tsq or sharded_tsq. Consumers block in wait_pop_for.
+template<typename P, typename queue_t>
+void bench_queue(result &r, std::uint64_t num_msgs, queue_t &q) {
+    std::atomic<bool> done {false};
+
+    auto producer = [&](unsigned i) {
+        for (std::uint64_t n = share(num_msgs, r.producers, i); n > 0; --n) {
+            if constexpr (std::is_same_v<queue_t, tarp::tsq<P>>) {
+                q.push_back(make_payload<P>(now_ns()));
+            } else {
+                q.push(make_payload<P>(now_ns()));
+            }
+        }
+    };
+
+    auto consumer = [&](unsigned, tarp::histogram &hist) {
+        std::uint64_t count = 0;
+        for (;;) {
+            auto item = q.wait_pop_for(1ms);
+            if (item.has_value()) {
+                hist.record(now_ns() - stamp_of(*item));
+                ++count;
+                continue;
+            }
+            if (done.load() && q.empty()) {
+                break;
+            }
+        }
+        return count;
+    };
+
+    r.sent = num_msgs;
+    run(r, producer, consumer, [&] { done = true; });
+}
+
+//
+
+template<typename P>
+void bench_payload(const config &cfg, reporter &rep) {
+    struct bench {
+        const char *primitive;
+        const char *mode;
+        std::function<void(result &)> func;
+    };
+
+    auto n = cfg.num_msgs;
+    std::vector<bench> benches = {
+      {"event_channel", "buffered",
+       [n](result &r) { bench_event_channel<P>(r, n, false); }},
+      {"event_channel", "circular",
+       [n](result &r) { bench_event_channel<P>(r, n, true); }},
+      {"trunk", "unbuffered", [n](result &r) { bench_trunk<P>(r, n); }},
+      {"event_broadcaster", "buffered",
+       [n](result &r) { bench_event_broadcaster<P>(r, n, false); }},
+      {"event_broadcaster", "circular",
+       [n](result &r) { bench_event_broadcaster<P>(r, n, true); }},
+      {"event_aggregator", "circular",
+       [n](result &r) { bench_event_aggregator<P>(r, n); }},
+      {"tsq", "unbounded",
+       [n](result &r) {
+           tarp::tsq<P> q;
+           bench_queue<P>(r, n, q);
+       }},
+      {"sharded_tsq", "unbounded",
+       [n](result &r) {
+           tarp::sharded_tsq<P> q;
+           bench_queue<P>(r, n, q);
+       }},
+    };
+
+    for (auto &b : benches) {
+        if (std::string(b.primitive).find(cfg.filter) == std::string::npos) {
+            continue;
+        }
+
+        for (auto producers : cfg.threads) {
+            for (auto consumers : cfg.threads) {
+                if (cfg.diagonal && producers != consumers) {
+                    continue;
+                }
+
+                result r;
+                r.primitive = b.primitive;
+                r.mode = b.mode;
+                r.payload = payload_name<P>();
+                r.producers = producers;
+                r.consumers = consumers;
+
+                std::cerr << "running " << r.primitive << " (" << r.mode
+                          << ", " << r.payload << ") with " << producers
+                          << " producers and " << consumers << " consumers"
+                          << std::endl;
+
+                b.func(r);
+                rep.add(r);
+            }
+        }
+    }
+}
+
+std::vector<unsigned> parse_list(const std::string &s) {
+    std::vector<unsigned> res;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        auto n = std::stoul(item);
+        if (n == 0) {
+            throw std::invalid_argument("thread counts must be > 0");
+        }
+        res.push_back(static_cast<unsigned>(n));
+    }
+    return res;
+}
+
+void usage(const char *prog) {
+    std::cerr << "Usage: " << prog
+              << " [--format csv|json] [--msgs N] [--threads 1,2,4]"
+                 " [--filter SUBSTRING] [--diagonal]\n";
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+    config cfg;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--format" && has_value) {
+            cfg.json = std::string(argv[++i]) == "json";
+        } else if (arg == "--msgs" && has_value) {
+            cfg.num_msgs = std::stoull(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            cfg.threads = parse_list(argv[++i]);
+        } else if (arg == "--filter" && has_value) {
+            cfg.filter = argv[++i];
+        } else if (arg == "--diagonal") {
+            cfg.diagonal = true;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    reporter rep(cfg.json);
+    rep.begin();
+    bench_payload<small_payload>(cfg, rep);
+    bench_payload<large_payload>(cfg, rep);
+    bench_payload<tuple_payload>(cfg, rep);
+    rep.end();
+
+    return EXIT_SUCCESS;
+}
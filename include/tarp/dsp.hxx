@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace tarp {
+namespace dsp {
+
+//
+// Streaming filter kernels over arrays of samples. These are the building
+// blocks of the corresponding pipeline stages (see pipeline.hxx) but can be
+// used on their own.
+//
+// All functions take the input as (in, n) and write their outputs to out,
+// which must have room for as many outputs as the function produces (see
+// each function). Windowed filters are 'valid'-mode: they only produce an
+// output for each position where the window is full, so n - window + 1
+// outputs (0 if n < window); the i-th output is for the window
+// in[i, i + window).
+//
+// The FIR filter has hand-written SSE2 and AVX2 kernels for float and
+// double. The kernel is selected at runtime according to what the CPU
+// supports (see detected_isa), with a portable scalar fallback. All the
+// kernels give bit-identical outputs. The other
+// filters are either recursive (EMA, biquad: each output depends on the
+// previous one, which leaves nothing to vectorize for a single channel) or
+// data-dependent (min/max, median) and are scalar.
+//
+
+/* Instruction set extensions the kernels can use. */
+enum class isa : std::uint8_t {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+/* The best isa supported by the CPU. Detected once, on first use. */
+isa detected_isa();
+
+/*
+ * FIR (finite impulse response) filter:
+ *   out[i] = sum(taps[j] * in[i + j]) for j in [0, ntaps)
+ * NOTE: taps[0] applies to the *oldest* sample in the window. For the
+ * textbook convolution form (h[0] applied to the newest sample), pass the
+ * taps reversed.
+ * Return the number of outputs: n - ntaps + 1, or 0 if n < ntaps.
+ * Throw std::invalid_argument if ntaps is 0.
+ */
+template<typename T>
+std::size_t
+fir(const T *in, std::size_t n, const T *taps, std::size_t ntaps, T *out);
+
+std::size_t fir(const float *in,
+                std::size_t n,
+                const float *taps,
+                std::size_t ntaps,
+                float *out);
+
+std::size_t fir(const double *in,
+                std::size_t n,
+                const double *taps,
+                std::size_t ntaps,
+                double *out);
+
+/* Same as above, but use the kernel for the given isa, or the best one
+ * supported by the CPU if that is not. Mostly for testing and
+ * benchmarking. */
+std::size_t fir(const float *in,
+                std::size_t n,
+                const float *taps,
+                std::size_t ntaps,
+                float *out,
+                isa use);
+
+std::size_t fir(const double *in,
+                std::size_t n,
+                const double *taps,
+                std::size_t ntaps,
+                double *out,
+                isa use);
+
+/*
+ * Exponential moving average:
+ *   state = state + alpha * (in[i] - state); out[i] = state
+ * alpha is the smoothing factor, in (0, 1]. state is the previous output;
+ * it is typically seeded with the first sample. Produce n outputs and
+ * return the new state.
+ */
+template<typename T>
+T ema(const T *in, std::size_t n, T alpha, T state, T *out) {
+    for (std::size_t i = 0; i < n; ++i) {
+        state += alpha * (in[i] - state);
+        out[i] = state;
+    }
+    return state;
+}
+
+/* Coefficients of a biquad (second-order IIR) filter, normalized such
+ * that a0 = 1:
+ *   y[i] = b0*x[i] + b1*x[i-1] + b2*x[i-2] - a1*y[i-1] - a2*y[i-2] */
+template<typename T>
+struct biquad_coeffs {
+    T b0 {1};
+    T b1 {0};
+    T b2 {0};
+    T a1 {0};
+    T a2 {0};
+};
+
+/* The delay line of a biquad filter (transposed direct form II). */
+template<typename T>
+struct biquad_state {
+    T z1 {0};
+    T z2 {0};
+};
+
+/* Biquad filter, in transposed direct form II. Produce n outputs. */
+template<typename T>
+void biquad(const T *in,
+            std::size_t n,
+            const biquad_coeffs<T> &c,
+            biquad_state<T> &s,
+            T *out) {
+    T z1 = s.z1;
+    T z2 = s.z2;
+    for (std::size_t i = 0; i < n; ++i) {
+        const T x = in[i];
+        const T y = c.b0 * x + z1;
+        z1 = c.b1 * x - c.a1 * y + z2;
+        z2 = c.b2 * x - c.a2 * y;
+        out[i] = y;
+    }
+    s.z1 = z1;
+    s.z2 = z2;
+}
+
+/*
+ * Running extremum over a sliding window, in amortized O(1) per sample:
+ * a deque holds the candidates, i.e. the samples in the window not
+ * dominated by a later one, so the front is always the extremum.
+ * With compare=std::less this is a running min, with std::greater a
+ * running max.
+ */
+template<typename T, typename compare>
+class monotonic_window {
+public:
+    explicit monotonic_window(std::size_t window) : m_window(window) {
+        if (m_window == 0) {
+            throw std::invalid_argument("Invalid window of 0 width");
+        }
+    }
+
+    /* Add a sample; return true if the window is full, in which case the
+     * extremum of the window is stored in result. */
+    bool push(const T &value, T &result) {
+        while (!m_candidates.empty() &&
+               !m_cmp(m_candidates.back().second, value)) {
+            m_candidates.pop_back();
+        }
+        m_candidates.emplace_back(m_seq, value);
+
+        // evict the candidate that has slid out of the window.
+        if (m_candidates.front().first + m_window <= m_seq) {
+            m_candidates.pop_front();
+        }
+
+        ++m_seq;
+        if (m_seq < m_window) {
+            return false;
+        }
+
+        result = m_candidates.front().second;
+        return true;
+    }
+
+    void reset() {
+        m_candidates.clear();
+        m_seq = 0;
+    }
+
+private:
+    std::size_t m_window;
+    std::size_t m_seq {0};
+    std::deque<std::pair<std::size_t, T>> m_candidates;
+    compare m_cmp;
+};
+
+/* Running min over a sliding window. Return the number of outputs. */
+template<typename T>
+std::size_t
+running_min(const T *in, std::size_t n, std::size_t window, T *out) {
+    monotonic_window<T, std::less<T>> w(window);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        k += w.push(in[i], out[k]);
+    }
+    return k;
+}
+
+/* Running max over a sliding window. Return the number of outputs. */
+template<typename T>
+std::size_t
+running_max(const T *in, std::size_t n, std::size_t window, T *out) {
+    monotonic_window<T, std::greater<T>> w(window);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        k += w.push(in[i], out[k]);
+    }
+    return k;
+}
+
+/*
+ * Running median over a sliding window of odd width. The window is kept
+ * both in arrival order (to know which sample leaves it) and sorted (to
+ * read off the median), so each sample costs O(window); this is meant for
+ * the small windows used to reject impulse noise.
+ */
+template<typename T>
+class median_window {
+public:
+    explicit median_window(std::size_t window) : m_window(window) {
+        if (m_window == 0 || m_window % 2 == 0) {
+            throw std::invalid_argument(
+              "Invalid median window: the width must be odd");
+        }
+        m_sorted.reserve(m_window);
+    }
+
+    /* Add a sample; return true if the window is full, in which case the
+     * median of the window is stored in result. */
+    bool push(const T &value, T &result) {
+        if (m_fifo.size() == m_window) {
+            auto it = std::lower_bound(
+              m_sorted.begin(), m_sorted.end(), m_fifo.front());
+            m_sorted.erase(it);
+            m_fifo.pop_front();
+        }
+
+        m_fifo.push_back(value);
+        m_sorted.insert(
+          std::upper_bound(m_sorted.begin(), m_sorted.end(), value), value);
+
+        if (m_fifo.size() < m_window) {
+            return false;
+        }
+
+        result = m_sorted[m_window / 2];
+        return true;
+    }
+
+    void reset() {
+        m_fifo.clear();
+        m_sorted.clear();
+    }
+
+private:
+    std::size_t m_window;
+    std::deque<T> m_fifo;
+    std::vector<T> m_sorted;
+};
+
+/* Running median over a sliding window. Return the number of outputs. */
+template<typename T>
+std::size_t median(const T *in, std::size_t n, std::size_t window, T *out) {
+    median_window<T> w(window);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        k += w.push(in[i], out[k]);
+    }
+    return k;
+}
+
+//
+
+namespace impl {
+// Portable kernel. The loops are ordered such that the inner one runs
+// over the outputs (see wma), so it is vectorizable as is, and each output
+// accumulates its terms in order of the taps, like the SIMD kernels do.
+template<typename T>
+void fir_scalar(const T *in,
+                std::size_t nout,
+                const T *taps,
+                std::size_t ntaps,
+                T *out) {
+    std::fill(out, out + nout, T {});
+    for (std::size_t j = 0; j < ntaps; ++j) {
+        const T tap = taps[j];
+        const T *x = in + j;
+        for (std::size_t k = 0; k < nout; ++k) {
+            out[k] += tap * x[k];
+        }
+    }
+}
+}  // namespace impl
+
+template<typename T>
+std::size_t
+fir(const T *in, std::size_t n, const T *taps, std::size_t ntaps, T *out) {
+    if (ntaps == 0) {
+        throw std::invalid_argument("Invalid FIR filter with 0 taps");
+    }
+
+    if (n < ntaps) {
+        return 0;
+    }
+
+    const std::size_t nout = n - ntaps + 1;
+    impl::fir_scalar(in, nout, taps, ntaps, out);
+    return nout;
+}
+
+}  // namespace dsp
+}  // namespace tarp
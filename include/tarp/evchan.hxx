@@ -11,9 +11,11 @@
 #include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <tarp/cxxcommon.hxx>
+#include <tarp/evchan_stats.hxx>
 #include <tarp/semaphore.hxx>
 #include <tarp/type_traits.hxx>
 
@@ -190,7 +192,7 @@ public:
             throw std::invalid_argument(
               "unacceptable state specified for monitoring");
         }
-        return REAL->add_monitor(chanState::WRITABLE, notifier);
+        return REAL->add_monitor(notifier, chanState::WRITABLE);
     }
 
     auto closed() const { return CONST_REAL->closed(); }
@@ -246,7 +248,7 @@ public:
             throw std::invalid_argument(
               "unacceptable state specified for monitoring");
         }
-        return REAL->add_monitor(chanState::READABLE, notifier);
+        return REAL->add_monitor(notifier, chanState::READABLE);
     }
 
     auto closed() const { return CONST_REAL->closed(); }
@@ -512,6 +514,9 @@ public:
             lock_t l {m_mtx};
             m_closed = true;
             m_state_mask |= chanState::CLOSED;
+            if (m_stats) {
+                m_stats->on_drop(m_msgs.size());
+            }
             m_msgs.clear();
 
             // gather all monitors and clear the monitor queues.
@@ -552,10 +557,43 @@ public:
     // Discard all events currently enqueued.
     void clear() {
         lock_t l {m_mtx};
+        if (m_stats) {
+            m_stats->on_drop(m_msgs.size());
+        }
         m_msgs.clear();
         refresh_channel_state(l);
     }
 
+    // Start collecting statistics (see channel_stats). Stats collection is
+    // off by default, to avoid overheads when not needed. Calling this
+    // when stats are already enabled has no effect.
+    void enable_stats() {
+        lock_t l {m_mtx};
+        if (!m_stats) {
+            m_stats = std::make_unique<impl::stats_recorder>();
+            m_stats->on_depth(m_msgs.size());
+        }
+    }
+
+    // Return a snapshot of the channel statistics or std::nullopt if
+    // enable_stats() has not been called.
+    std::optional<channel_stats> stats() const {
+        lock_t l {m_mtx};
+        if (!m_stats) {
+            return std::nullopt;
+        }
+        return m_stats->snapshot(m_msgs.size());
+    }
+
+    // Zero out all the statistics (if enabled).
+    void reset_stats() {
+        lock_t l {m_mtx};
+        if (m_stats) {
+            m_stats->reset();
+            m_stats->on_depth(m_msgs.size());
+        }
+    }
+
     // Try to push a new event item. The push is only made if possible to be
     // carried through immediately; that is, either 1) the channel is not yet
     // filled to capacity, or 2) the channel has ring-buffer semantics, in which
@@ -575,12 +613,18 @@ public:
         // [[unlikely]] (c++20).
         if (m_closed) {
             // std::cerr << "Failed try_push --> closed\n";
+            if (m_stats) {
+                m_stats->on_drop();
+            }
             return {false, opt_payload(std::forward<T>(data)...)};
         }
 
         // there is room.
         if ((m_msgs.size() < m_channel_capacity)) {
             store(l, std::forward<T>(data)...);
+            if (m_stats) {
+                m_stats->on_push(m_msgs.size());
+            }
             refresh_channel_state(l);
             return {true, std::nullopt};
         }
@@ -595,6 +639,10 @@ public:
             if (m_msgs.size() > m_channel_capacity) {
                 throw std::logic_error("BUG: overfilled circular channel");
             }
+            if (m_stats) {
+                m_stats->on_overwrite();
+                m_stats->on_push(m_msgs.size());
+            }
             refresh_channel_state(l);
             return {true, std::nullopt};
         }
@@ -602,6 +650,9 @@ public:
         // full, and no ring-buffer semantics => failed push.
         // NOTE: in this case, the state does not change in any way: no need
         // to call refresh_channel_state().
+        if (m_stats) {
+            m_stats->on_drop();
+        }
         return {false, opt_payload(std::forward<T>(data)...)};
     }
 
@@ -621,6 +672,9 @@ public:
 
         auto ret = opt_payload(std::move(m_msgs.front()));
         m_msgs.pop_front();
+        if (m_stats) {
+            m_stats->on_get();
+        }
         refresh_channel_state(l);
         return ret;
     }
@@ -631,6 +685,9 @@ public:
         lock_t l {m_mtx};
         decltype(m_msgs) events;
         std::swap(events, m_msgs);
+        if (m_stats) {
+            m_stats->on_get(events.size());
+        }
         refresh_channel_state(l);
         return events;
     }
@@ -763,6 +820,9 @@ private:
     bool m_closed {false};
     std::deque<payload_t> m_msgs;
 
+    // null unless enable_stats() has been called.
+    std::unique_ptr<impl::stats_recorder> m_stats;
+
     // send and receive monitor queues.
     std::list<struct monitor_entry> m_send_monitors;
     std::list<struct monitor_entry> m_recv_monitors;
@@ -1015,6 +1075,39 @@ public:
         return m_closed;
     }
 
+    // Start collecting statistics (see channel_stats). Off by default.
+    // NOTE: since a trunk is unbuffered, the depth reported is the number of
+    // senders blocked waiting for a receiver. The producer_block and
+    // consumer_wait histograms record the time each push and get,
+    // respectively, spent waiting for a counterpart (0 if the transfer was
+    // immediate).
+    void enable_stats() {
+        lock_t l {m_mtx};
+        if (!m_stats) {
+            m_stats = std::make_unique<impl::stats_recorder>();
+            m_stats->on_depth(m_send_waitq.size());
+        }
+    }
+
+    // Return a snapshot of the channel statistics or std::nullopt if
+    // enable_stats() has not been called.
+    std::optional<channel_stats> stats() const {
+        lock_t l {m_mtx};
+        if (!m_stats) {
+            return std::nullopt;
+        }
+        return m_stats->snapshot(m_send_waitq.size());
+    }
+
+    // Zero out all the statistics (if enabled).
+    void reset_stats() {
+        lock_t l {m_mtx};
+        if (m_stats) {
+            m_stats->reset();
+            m_stats->on_depth(m_send_waitq.size());
+        }
+    }
+
     // Push a message to the channel. Wait until this can be done.
     //
     // Return {true, std::nullopt} after pushing the data to the channel or
@@ -1058,6 +1151,9 @@ public:
             // std::cerr << "Failed try_push --> closed=" << m_closed
             //           << " recv_waitq size=" << m_recv_waitq.size()
             //           << std::endl;
+            if (m_stats) {
+                m_stats->on_drop();
+            }
             return {false, opt_payload(std::forward<T>(data)...)};
         }
 
@@ -1102,8 +1198,6 @@ public:
             return get_data(l);
         }
 
-        std::cerr << "try_get(): m_send_waitq empty, impossible to get"
-                  << std::endl;
         return std::nullopt;
     }
 
@@ -1137,11 +1231,17 @@ private:
         // std::cerr << "try_push got mutex " << std::endl;
 
         if (m_closed) {
+            if (m_stats) {
+                m_stats->on_drop();
+            }
             return {false, opt_payload(std::forward<T>(data)...)};
         }
 
         // If we can do the push immediately without waiting, then do it.
         if (!m_recv_waitq.empty()) {
+            if (m_stats) {
+                m_stats->producer_block.record(0);
+            }
             pass_data(l, std::forward<T>(data)...);
             return {true, std::nullopt};
         }
@@ -1151,6 +1251,8 @@ private:
         add_sender(l, op);
         refresh_channel_state(l);
 
+        const auto start = m_stats ? CLOCK::now() : CLOCK::time_point {};
+
         // NOTE: each sender/receiver gets its own condition variable so that
         // it can be invidually woken up. This lets us avoid the thundering
         // herd problem. However, all of them still use one and the same mutex.
@@ -1180,16 +1282,25 @@ private:
             // We do not call refresh_channel_state() here because it is called
             // in get_data().
             if (op.done) {
+                record_wait(l, start, true);
                 return {true, std::nullopt};
             }
 
             if (m_closed) {
+                record_wait(l, start, true);
+                if (m_stats) {
+                    m_stats->on_drop();
+                }
                 return {false, std::move(op.data)};
             }
 
             if (use_deadline && abs_time <= CLOCK::now()) {
                 remove_sender(l, op);
                 refresh_channel_state(l);
+                record_wait(l, start, true);
+                if (m_stats) {
+                    m_stats->on_drop();
+                }
                 return {false, std::move(op.data)};
             }
         }
@@ -1207,6 +1318,9 @@ private:
 
         // If we can do the get immediately without waiting, then do it.
         if (!m_send_waitq.empty()) {
+            if (m_stats) {
+                m_stats->consumer_wait.record(0);
+            }
             return get_data(l);
         }
 
@@ -1215,6 +1329,8 @@ private:
         add_receiver(l, op);
         refresh_channel_state(l);
 
+        const auto start = m_stats ? CLOCK::now() : CLOCK::time_point {};
+
         while (true) {
             // std::cerr << "[GET] will wait on condvar" << std::endl;
             if (use_deadline) {
@@ -1227,16 +1343,19 @@ private:
             // We do not call refresh_channel_state() here because it is called
             // in pass_data().
             if (op.done) {
+                record_wait(l, start, false);
                 return std::move(op.data);
             }
 
             if (m_closed) {
+                record_wait(l, start, false);
                 return std::nullopt;
             }
 
             if (use_deadline && abs_time < CLOCK::now()) {
                 remove_receiver(l, op);
                 refresh_channel_state(l);
+                record_wait(l, start, false);
                 return std::nullopt;
             }
         }
@@ -1253,6 +1372,10 @@ private:
         receiver.done = true;
         receiver.condvar.notify_one();
         m_recv_waitq.pop_front();
+        if (m_stats) {
+            m_stats->on_push(m_send_waitq.size());
+            m_stats->on_get();
+        }
         refresh_channel_state(l);
     }
 
@@ -1266,10 +1389,32 @@ private:
         sender.done = true;
         sender.condvar.notify_one();
         m_send_waitq.pop_front();
+        if (m_stats) {
+            m_stats->on_push(m_send_waitq.size());
+            m_stats->on_get();
+        }
         refresh_channel_state(l);
         return data;
     }
 
+    // Record the time a blocked sender (sender=true) or receiver spent
+    // waiting, if stats are enabled. start is only meaningful in that case.
+    void record_wait(lock_t &,
+                     std::chrono::steady_clock::time_point start,
+                     bool sender) {
+        if (!m_stats) {
+            return;
+        }
+
+        // NOTE: stats may have been enabled while we were blocked.
+        if (start == CLOCK::time_point {}) {
+            return;
+        }
+
+        auto &h = sender ? m_stats->producer_block : m_stats->consumer_wait;
+        h.record(CLOCK::now() - start);
+    }
+
     // add receiver to wait queue
     void add_receiver(lock_t &, struct operation &op) {
         m_recv_waitq.emplace_back(op);
@@ -1278,6 +1423,9 @@ private:
     // add sender to wait queue
     void add_sender(lock_t &, struct operation &op) {
         m_send_waitq.emplace_back(op);
+        if (m_stats) {
+            m_stats->on_depth(m_send_waitq.size());
+        }
     }
 
     // Scan the sender waitq and remove the specified sender, if found.
@@ -1399,6 +1547,9 @@ private:
     // we need to track these so we can signal the true state of the channel
     // when a monitor joins.
     std::uint32_t m_state_mask = 0;
+
+    // null unless enable_stats() has been called.
+    std::unique_ptr<impl::stats_recorder> m_stats;
 };
 
 //
@@ -1760,11 +1911,51 @@ public:
 
         for (auto &event : events) {
             for (std::size_t i = 0; i < num_channels; ++i) {
-                channels[i]->try_push(event);
+                bool ok = channels[i]->try_push(event).first;
+                if (m_stats) {
+                    ok ? m_stats->on_get() : m_stats->on_drop();
+                }
             }
         }
     }
 
+    // Start collecting statistics (see channel_stats). Off by default.
+    // The depth, high_watermark, pushed and overwritten fields refer to
+    // the first-stage event buffer. got is the number of successful
+    // deliveries to connected channels (an event broadcast to n channels
+    // counts n times) and dropped additionally includes failed deliveries.
+    void enable_stats() {
+        lock_t l {m_mtx};
+        if (!m_stats) {
+            m_stats = std::make_unique<impl::stats_recorder>();
+            m_event_buffer.enable_stats();
+        }
+    }
+
+    // Return a snapshot of the broadcaster statistics or std::nullopt if
+    // enable_stats() has not been called.
+    std::optional<channel_stats> stats() const {
+        lock_t l {m_mtx};
+        if (!m_stats) {
+            return std::nullopt;
+        }
+
+        auto res = m_event_buffer.stats().value();
+        auto deliveries = m_stats->snapshot(0);
+        res.got = deliveries.got;
+        res.dropped += deliveries.dropped;
+        return res;
+    }
+
+    // Zero out all the statistics (if enabled).
+    void reset_stats() {
+        lock_t l {m_mtx};
+        if (m_stats) {
+            m_stats->reset();
+            m_event_buffer.reset_stats();
+        }
+    }
+
     // More convenient and expressive overloads for enqueuing an event.
     auto &operator<<(payload_t &&event_data) {
         push(std::move(event_data));
@@ -1795,6 +1986,9 @@ private:
     const bool m_autodispatch {false};
     event_channel_t m_event_buffer {m_BUFFSZ, true};
     std::vector<std::weak_ptr<wchan_t>> m_event_channels;
+
+    // null unless enable_stats() has been called.
+    std::unique_ptr<impl::stats_recorder> m_stats;
 };
 
 //
@@ -2062,12 +2256,21 @@ class event_aggregator final {
         std::list<std::shared_ptr<notifier>> m_notifiers;
 
         std::size_t m_idx {0};
-        std::vector<std::shared_ptr<event_channel_t>> m_channels;
+
+        // NOTE: immutable; channel() and remove() replace it wholesale, so
+        // readers (which must access the channels without the lock held;
+        // see get_all()) only need to copy the pointer.
+        using channel_list = std::vector<std::shared_ptr<event_channel_t>>;
+        std::shared_ptr<const channel_list> m_channels {
+          std::make_shared<const channel_list>()};
         std::unordered_map<key_t, std::weak_ptr<event_channel_t>> m_index;
 
         // convert the key_t keys to uint32_t keys for internal use.
         std::unordered_map<key_t, std::uint32_t> m_key_map;
         std::uint32_t m_last_key {0};
+
+        // true if stats must be enabled on all (current and future) channels.
+        bool m_stats_enabled {false};
     };
 
     std::shared_ptr<struct state> m_state;
@@ -2189,12 +2392,18 @@ public:
             }
 
             auto chan = std::make_shared<event_channel_t>(chancap, true);
+            if (S.m_stats_enabled) {
+                chan->enable_stats();
+            }
             S.m_index[k] = chan;
 
             std::uint32_t internal_key = S.m_last_key++;
             S.m_key_map[k] = internal_key;
 
-            S.m_channels.push_back(chan);
+            auto channels =
+              std::make_shared<typename state::channel_list>(*S.m_channels);
+            channels->push_back(chan);
+            S.m_channels = std::move(channels);
 
             notifier =
               std::make_shared<channel_notifier>(internal_key, m_state);
@@ -2228,13 +2437,13 @@ public:
             return;
         }
 
-        for (auto it = S.m_channels.begin(); it != S.m_channels.end();) {
-            if (*it == chan) {
-                it = S.m_channels.erase(it);
-                continue;
+        auto channels = std::make_shared<typename state::channel_list>();
+        for (const auto &c : *S.m_channels) {
+            if (c != chan) {
+                channels->push_back(c);
             }
-            ++it;
         }
+        S.m_channels = std::move(channels);
 
         auto internal_key = S.m_key_map[k];
         S.m_key_map.erase(k);
@@ -2244,7 +2453,7 @@ public:
 
         // falling edge.
         if (size_before > 0 && S.m_readable.empty()) {
-            invoke_notifiers(S.notifiers, chanState::READABLE, CLEAR);
+            invoke_notifiers(S.m_notifiers, chanState::READABLE, CLEAR);
         }
     }
 
@@ -2254,25 +2463,40 @@ public:
     // dequeuing from the same single channel all the time.
     std::optional<payload_t> try_get() {
         auto &S = *m_state;
-        auto &m_idx = S.m_idx;
+        decltype(S.m_channels) channels;
+        std::size_t idx {0};
 
-        lock_t l {S.m_mtx};
+        {
+            lock_t l {S.m_mtx};
+
+            // NOTE: the channels must be accessed without the lock held;
+            // see get_all().
+            channels = S.m_channels;
+            idx = S.m_idx;
+        }
 
-        if (S.m_channels.empty()) {
+        if (channels->empty()) {
             return std::nullopt;
         }
 
-        std::size_t n = S.m_channels.size();
-        m_idx = m_idx % n;
+        std::size_t n = channels->size();
+        idx = idx % n;
 
+        std::optional<payload_t> res;
         for (unsigned i = 0; i < n; ++i) {
-            auto res = S.m_channels[m_idx]->try_get();
-            m_idx = (m_idx + 1) % n;
+            res = (*channels)[idx]->try_get();
+            idx = (idx + 1) % n;
             if (res.has_value()) {
-                return res;
+                break;
             }
         }
-        return std::nullopt;
+
+        {
+            lock_t l {S.m_mtx};
+            S.m_idx = idx;
+        }
+
+        return res;
     }
 
     auto &operator>>(std::optional<payload_t> &event) {
@@ -2290,7 +2514,7 @@ public:
         {
             lock_t l {S.m_mtx};
 
-            // We need to copy all channel pointers so we can loop over the list
+            // We need a reference to the channel list so we can loop over it
             // without locking the mutex. Otherwise we deadlock, since
             // some_channel.get_all() may trigger a notifier call, which will
             // then try to grab this same lock.
@@ -2299,17 +2523,17 @@ public:
             idx = S.m_idx;
         }
 
-        if (channels.empty()) {
+        if (channels->empty()) {
             return {};
         }
 
-        std::size_t n = channels.size();
+        std::size_t n = channels->size();
         std::vector<std::deque<payload_t>> events;
         std::deque<payload_t> results;
 
         // get all events currently sitting in the queues
         for (std::size_t i = 0; i < n; ++i) {
-            events.emplace_back(channels[i]->get_all());
+            events.emplace_back((*channels)[i]->get_all());
         }
 
         // round-robin over all event channels, taking one event from
@@ -2373,10 +2597,12 @@ public:
             lock_t l {S.m_mtx};
             S.m_closed = true;
             std::swap(notifiers, S.m_notifiers);
-            std::swap(channels, S.m_channels);
+            channels = std::exchange(
+              S.m_channels,
+              std::make_shared<const typename state::channel_list>());
         }
 
-        for (auto &chan : channels) {
+        for (auto &chan : *channels) {
             chan->close();
         }
 
@@ -2384,7 +2610,6 @@ public:
 
         {
             lock_t l {S.m_mtx};
-            S.m_channels.clear();
             S.m_index.clear();
             S.m_readable.clear();
             S.m_subscriptions.clear();
@@ -2394,6 +2619,71 @@ public:
 
     bool closed() const { return m_state->m_closed; }
 
+    // Start collecting statistics on all current and future channels.
+    // See event_channel::enable_stats() fmi.
+    void enable_stats() {
+        auto &S = *m_state;
+        lock_t l {S.m_mtx};
+        S.m_stats_enabled = true;
+        for (auto &chan : *S.m_channels) {
+            chan->enable_stats();
+        }
+    }
+
+    // Return the aggregate statistics of all the channels or std::nullopt
+    // if enable_stats() has not been called. See channel_stats::operator+=.
+    std::optional<channel_stats> stats() const {
+        auto per_channel = stats_by_channel();
+        if (!per_channel.has_value()) {
+            return std::nullopt;
+        }
+
+        channel_stats total;
+        for (auto &[k, stats] : *per_channel) {
+            total += stats;
+        }
+        return total;
+    }
+
+    // Like stats(), but return the statistics of each channel separately,
+    // alongside its key.
+    std::optional<std::vector<std::pair<key_t, channel_stats>>>
+    stats_by_channel() const {
+        auto &S = *m_state;
+        std::vector<std::pair<key_t, std::shared_ptr<event_channel_t>>>
+          channels;
+
+        {
+            lock_t l {S.m_mtx};
+            if (!S.m_stats_enabled) {
+                return std::nullopt;
+            }
+
+            for (auto &[k, weak] : S.m_index) {
+                if (auto chan = weak.lock()) {
+                    channels.emplace_back(k, std::move(chan));
+                }
+            }
+        }
+
+        std::vector<std::pair<key_t, channel_stats>> res;
+        for (auto &[k, chan] : channels) {
+            auto stats = chan->stats();
+            if (stats.has_value()) {
+                res.emplace_back(k, std::move(*stats));
+            }
+        }
+        return res;
+    }
+
+    void reset_stats() {
+        auto &S = *m_state;
+        lock_t l {S.m_mtx};
+        for (auto &chan : *S.m_channels) {
+            chan->reset_stats();
+        }
+    }
+
 private:
     static inline unsigned int m_DEFAULT_CHANCAP {100};
 };
@@ -0,0 +1,394 @@
+#pragma once
+
+// C++20 coroutine support for event channels.
+//
+// The functions in this header return awaitables that make it possible for
+// a coroutine to wait for an event channel (or trunk, or event_aggregator
+// etc) to become readable or writable without blocking a thread. Instead of
+// parking a thread in try_get_for() or similar, the awaiting coroutine is
+// suspended and a monitor is added to the channel. When the channel changes
+// state, the coroutine is resumed via a user-specified executor (see
+// tarp/executor.hxx) e.g. on an EventPump or a ThreadPool. This way any
+// number of logical consumers can share a handful of threads.
+//
+// Example:
+//  tarp::exec::threadpool_executor exec(pool);
+//  auto consumer = [&]() -> tarp::evchan::coro::detached_task {
+//      while (auto ev = co_await tarp::evchan::coro::get(rchan, exec)) {
+//          ...
+//      }
+//  };
+//
+// NOTE: the channels waited on and the executor must outlive any pending
+// awaits on them.
+
+#if __cplusplus >= 202002L
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <tarp/evchan.hxx>
+#include <tarp/executor.hxx>
+
+namespace tarp {
+namespace evchan {
+namespace coro {
+
+using executor_t = tarp::exec::interfaces::executor;
+
+namespace impl {
+
+// Shared state between an awaitable and the notifiers it adds to the
+// channel(s) waited on.
+//
+// The notifiers are called with the channel mutex held, so they must not
+// call back into the channel. Instead, a notifier posts a job to the executor
+// and the job then retries the operation on the channel, re-adding the
+// notifiers if the operation still cannot be carried out (e.g. because
+// another consumer got there first). This repeats until the operation
+// succeeds or the channel is closed, at which point the coroutine is resumed.
+//
+// A monitor is only ever notified on state *changes* (i.e. edge-triggered).
+// Therefore when re-adding the notifiers, the pending state returned by
+// add_monitor() is checked as well, in case the change happened between the
+// failed attempt and the addition of the monitor.
+class waiter : public std::enable_shared_from_this<waiter> {
+public:
+    DISALLOW_COPY_AND_MOVE(waiter);
+    explicit waiter(executor_t &exec) : m_exec(exec) {}
+    virtual ~waiter() = default;
+
+    // Try to carry out the operation. Return true if done (successfully or
+    // otherwise e.g. the channel was closed) else false.
+    virtual bool attempt() = 0;
+
+    // Add n as a monitor to the channel(s). Return true if any of the channels
+    // is already in a state where an attempt should be made, else false.
+    virtual bool arm(const std::shared_ptr<interfaces::notifier> &n) = 0;
+
+    // Return true if the caller should suspend, in which case h will be
+    // resumed later through the executor. Else the operation has completed
+    // and the caller should not suspend.
+    // NOTE: if true is returned, h may have already been resumed on another
+    // thread, so the caller must not touch the coroutine frame.
+    bool suspend(std::coroutine_handle<> h) {
+        m_handle = h;
+        return !poll();
+    }
+
+private:
+    class wakeup_notifier final : public interfaces::notifier {
+    public:
+        wakeup_notifier(std::shared_ptr<waiter> w, std::uint32_t gen)
+            : m_waiter(std::move(w)), m_gen(gen) {}
+
+        bool notify(std::uint32_t events, std::uint32_t action) override {
+            auto &w = *m_waiter;
+
+            // stale notifier from a previous round: remove.
+            if (w.m_gen.load() != m_gen) {
+                return false;
+            }
+
+            // only rising edges (and closure) are of interest.
+            if (action == evchan::impl::CLEAR &&
+                !(events & chanState::CLOSED)) {
+                return true;
+            }
+
+            if (!w.disarm()) {
+                return false;
+            }
+
+            // NOTE: the channel lock is held here; the executor must not run
+            // the job inline.
+            w.m_exec.post([w = m_waiter] { w->on_wakeup(); });
+            return false;
+        }
+
+    private:
+        std::shared_ptr<waiter> m_waiter;
+        const std::uint32_t m_gen;
+    };
+
+    // Claim the wakeup. Only one of the notifiers in the current round
+    // (or the poll loop) succeeds.
+    bool disarm() {
+        bool expected = true;
+        return m_armed.compare_exchange_strong(expected, false);
+    }
+
+    // Return true if the operation is complete.
+    bool poll() {
+        for (;;) {
+            if (attempt()) {
+                return true;
+            }
+
+            auto gen = m_gen.fetch_add(1) + 1;
+            m_armed.store(true);
+
+            auto n = std::make_shared<wakeup_notifier>(shared_from_this(), gen);
+            if (!arm(n)) {
+                return false;
+            }
+
+            // Already in a state where another attempt should be made.
+            // Unless a notifier has beaten us to it, try again.
+            if (!disarm()) {
+                return false;
+            }
+        }
+    }
+
+    void on_wakeup() {
+        if (poll()) {
+            m_handle.resume();
+        }
+    }
+
+    executor_t &m_exec;
+    std::coroutine_handle<> m_handle;
+    std::atomic<bool> m_armed {false};
+    std::atomic<std::uint32_t> m_gen {0};
+};
+
+//
+
+template<typename source_t>
+class get_waiter final : public waiter {
+public:
+    using result_t = decltype(std::declval<source_t &>().try_get());
+
+    get_waiter(source_t &src, executor_t &exec) : waiter(exec), m_src(src) {}
+
+    bool attempt() override {
+        m_result = m_src.try_get();
+        return m_result.has_value() || m_src.closed();
+    }
+
+    bool arm(const std::shared_ptr<interfaces::notifier> &n) override {
+        auto pending = m_src.add_monitor(n, chanState::READABLE);
+        return pending & (chanState::READABLE | chanState::CLOSED);
+    }
+
+    result_t result() { return std::move(m_result); }
+
+private:
+    source_t &m_src;
+    result_t m_result;
+};
+
+//
+
+template<typename sink_t, typename payload_t>
+class push_waiter final : public waiter {
+public:
+    using result_t = decltype(std::declval<sink_t &>().try_push(
+      std::declval<payload_t &&>()));
+
+    push_waiter(sink_t &dst, executor_t &exec, payload_t data)
+        : waiter(exec), m_dst(dst), m_data(std::move(data)) {}
+
+    bool attempt() override {
+        auto res = m_dst.try_push(std::move(*m_data));
+        if (res.first) {
+            m_result = std::move(res);
+            return true;
+        }
+
+        // a failed push returns the data to the caller: hold on to it for
+        // the next attempt.
+        m_data.emplace(std::move(*res.second));
+
+        if (m_dst.closed()) {
+            m_result.emplace(false, std::move(m_data));
+            return true;
+        }
+
+        return false;
+    }
+
+    bool arm(const std::shared_ptr<interfaces::notifier> &n) override {
+        auto pending = m_dst.add_monitor(n, chanState::WRITABLE);
+        return pending & (chanState::WRITABLE | chanState::CLOSED);
+    }
+
+    result_t result() { return std::move(*m_result); }
+
+private:
+    sink_t &m_dst;
+    std::optional<payload_t> m_data;
+    std::optional<result_t> m_result;
+};
+
+//
+
+template<typename... source_t>
+class select_waiter final : public waiter {
+    using first_t = std::tuple_element_t<0, std::tuple<source_t...>>;
+    using item_t = decltype(std::declval<first_t &>().try_get());
+
+    static_assert(
+      (std::is_same_v<item_t, decltype(std::declval<source_t &>().try_get())> &&
+       ...),
+      "all sources must have the same payload type");
+
+    static constexpr std::size_t N = sizeof...(source_t);
+
+public:
+    using result_t = std::pair<std::size_t, item_t>;
+
+    select_waiter(executor_t &exec, source_t &...srcs)
+        : waiter(exec), m_srcs(&srcs...) {}
+
+    bool attempt() override {
+        auto seq = std::index_sequence_for<source_t...> {};
+
+        // round-robin to avoid starving any of the sources.
+        for (std::size_t i = 0; i < N; ++i) {
+            auto idx = (m_next + i) % N;
+            if (try_source(idx, seq)) {
+                m_next = (idx + 1) % N;
+                return true;
+            }
+        }
+
+        if (all_closed(seq)) {
+            m_result = {N, std::nullopt};
+            return true;
+        }
+
+        return false;
+    }
+
+    // NOTE: sources that have been closed are skipped. A closed source is
+    // only of interest once all the sources are closed, which attempt()
+    // checks for.
+    bool arm(const std::shared_ptr<interfaces::notifier> &n) override {
+        std::uint32_t pending = 0;
+        auto add = [&](auto *src) {
+            if (!src->closed()) {
+                pending |= src->add_monitor(n, chanState::READABLE);
+            }
+        };
+        std::apply([&](auto *...src) { (add(src), ...); }, m_srcs);
+        return pending & chanState::READABLE;
+    }
+
+    result_t result() { return std::move(m_result); }
+
+private:
+    template<std::size_t... I>
+    bool try_source(std::size_t idx, std::index_sequence<I...>) {
+        bool done = false;
+        ((done = done || (I == idx && try_get<I>())), ...);
+        return done;
+    }
+
+    template<std::size_t I>
+    bool try_get() {
+        auto res = std::get<I>(m_srcs)->try_get();
+        if (!res.has_value()) {
+            return false;
+        }
+        m_result = {I, std::move(res)};
+        return true;
+    }
+
+    template<std::size_t... I>
+    bool all_closed(std::index_sequence<I...>) {
+        return (std::get<I>(m_srcs)->closed() && ...);
+    }
+
+    std::tuple<source_t *...> m_srcs;
+    std::size_t m_next {0};
+    result_t m_result;
+};
+
+//
+
+template<typename waiter_t>
+class awaitable {
+public:
+    explicit awaitable(std::shared_ptr<waiter_t> w) : m_waiter(std::move(w)) {}
+
+    bool await_ready() { return m_waiter->attempt(); }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        return m_waiter->suspend(h);
+    }
+
+    auto await_resume() { return m_waiter->result(); }
+
+private:
+    std::shared_ptr<waiter_t> m_waiter;
+};
+
+}  // namespace impl
+
+//
+
+// Wait for an item from src, which can be anything exposing try_get(),
+// closed() and add_monitor() e.g. an rchan, rtrunk, event_aggregator or
+// event_wstream. The result of co_await is the same as that of try_get(): an
+// std::optional holding the item, or std::nullopt if src has been closed.
+//
+// NOTE: a trunk is unbuffered: a get only succeeds when a sender is blocked
+// in push(). Awaiting a trunk therefore only makes sense if the other side
+// uses the blocking API.
+template<typename source_t>
+auto get(source_t &src, executor_t &exec) {
+    using waiter_t = impl::get_waiter<source_t>;
+    return impl::awaitable<waiter_t>(std::make_shared<waiter_t>(src, exec));
+}
+
+// Push data into dst (e.g. a wchan or wtrunk), waiting for it to become
+// writable if it is full. This gives bounded backpressure without blocking a
+// thread. The result of co_await is the same as that of try_push(): if the
+// push fails because dst has been closed, the data is returned back.
+template<typename sink_t, typename payload_t>
+auto push(sink_t &dst, executor_t &exec, payload_t &&data) {
+    using waiter_t = impl::push_waiter<sink_t, std::decay_t<payload_t>>;
+    return impl::awaitable<waiter_t>(
+      std::make_shared<waiter_t>(dst, exec, std::forward<payload_t>(data)));
+}
+
+// Wait for an item from any of srcs. The result of co_await is a pair of
+// {index of the source the item was read from, item}. If all the sources
+// have been closed, the result is {sizeof...(srcs), std::nullopt}.
+template<typename... source_t>
+auto select(executor_t &exec, source_t &...srcs) {
+    static_assert(sizeof...(source_t) > 0);
+    using waiter_t = impl::select_waiter<source_t...>;
+    return impl::awaitable<waiter_t>(std::make_shared<waiter_t>(exec, srcs...));
+}
+
+//
+
+// Minimal fire-and-forget coroutine type. The coroutine starts running
+// immediately and its frame is destroyed when it completes.
+// NOTE: an exception escaping the coroutine terminates the program.
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+}  // namespace coro
+}  // namespace evchan
+}  // namespace tarp
+
+#endif
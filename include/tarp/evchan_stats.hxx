@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tarp/histogram.hxx>
+
+namespace tarp {
+namespace evchan {
+
+// Snapshot of the statistics of a channel (event_channel, trunk etc).
+// Statistics collection is opt-in: see the enable_stats() member function
+// of the respective classes.
+//
+// The meaning of some of the fields depends on the type of channel:
+// - depth: for a buffered channel, the number of buffered events; for
+//   an unbuffered channel (trunk), the number of blocked senders.
+// - high_watermark: max depth seen since stats were enabled or reset.
+// - pushed/got: number of events successfully enqueued/dequeued.
+// - dropped: number of events lost or rejected. This includes failed
+//   pushes (full/closed channel, expired deadline), events discarded by
+//   clear()/close(), and events overwritten by circular (ring buffer)
+//   channels. The latter are also counted separately in overwritten.
+// - producer_block, consumer_wait: histograms (in nanoseconds) of the time
+//   blocking senders and receivers, respectively, spent waiting. These are
+//   only populated for channels that support blocking operations.
+struct channel_stats {
+    std::size_t depth {0};
+    std::size_t high_watermark {0};
+    std::uint64_t pushed {0};
+    std::uint64_t got {0};
+    std::uint64_t dropped {0};
+    std::uint64_t overwritten {0};
+    tarp::histogram producer_block;
+    tarp::histogram consumer_wait;
+
+    // Add other to this. Used to produce aggregate statistics.
+    // NOTE: the depths are summed up; the aggregate high watermark is the
+    // max of the respective high watermarks.
+    channel_stats &operator+=(const channel_stats &other) {
+        depth += other.depth;
+        high_watermark = std::max(high_watermark, other.high_watermark);
+        pushed += other.pushed;
+        got += other.got;
+        dropped += other.dropped;
+        overwritten += other.overwritten;
+        producer_block.merge(other.producer_block);
+        consumer_wait.merge(other.consumer_wait);
+        return *this;
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const channel_stats &s) {
+    os << "depth=" << s.depth << " hwm=" << s.high_watermark
+       << " pushed=" << s.pushed << " got=" << s.got
+       << " dropped=" << s.dropped << " overwritten=" << s.overwritten;
+
+    if (s.producer_block.count() > 0) {
+        os << " producer_block_ns={" << s.producer_block.summarize() << "}";
+    }
+    if (s.consumer_wait.count() > 0) {
+        os << " consumer_wait_ns={" << s.consumer_wait.summarize() << "}";
+    }
+    return os;
+}
+
+//
+
+namespace impl {
+
+// Statistics accumulator embedded (behind a pointer that is null unless
+// stats are enabled) into the various channel classes.
+// The counters are atomics so they can be updated outside of locked
+// regions as needed.
+class stats_recorder {
+public:
+    void on_push(std::size_t depth) {
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+        on_depth(depth);
+    }
+
+    void on_get(std::uint64_t n = 1) {
+        m_got.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    void on_drop(std::uint64_t n = 1) {
+        m_dropped.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    void on_overwrite() {
+        m_overwritten.fetch_add(1, std::memory_order_relaxed);
+        on_drop();
+    }
+
+    void on_depth(std::size_t depth) {
+        auto prev = m_hwm.load(std::memory_order_relaxed);
+        while (depth > prev && !m_hwm.compare_exchange_weak(
+                                 prev, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    channel_stats snapshot(std::size_t depth) const {
+        channel_stats s;
+        s.depth = depth;
+        s.high_watermark = m_hwm.load(std::memory_order_relaxed);
+        s.pushed = m_pushed.load(std::memory_order_relaxed);
+        s.got = m_got.load(std::memory_order_relaxed);
+        s.dropped = m_dropped.load(std::memory_order_relaxed);
+        s.overwritten = m_overwritten.load(std::memory_order_relaxed);
+        s.producer_block = producer_block;
+        s.consumer_wait = consumer_wait;
+        return s;
+    }
+
+    void reset() {
+        m_hwm.store(0, std::memory_order_relaxed);
+        m_pushed.store(0, std::memory_order_relaxed);
+        m_got.store(0, std::memory_order_relaxed);
+        m_dropped.store(0, std::memory_order_relaxed);
+        m_overwritten.store(0, std::memory_order_relaxed);
+        producer_block.reset();
+        consumer_wait.reset();
+    }
+
+    tarp::histogram producer_block;
+    tarp::histogram consumer_wait;
+
+private:
+    std::atomic<std::size_t> m_hwm {0};
+    std::atomic<std::uint64_t> m_pushed {0};
+    std::atomic<std::uint64_t> m_got {0};
+    std::atomic<std::uint64_t> m_dropped {0};
+    std::atomic<std::uint64_t> m_overwritten {0};
+};
+
+}  // namespace impl
+
+//
+
+// Registry of named channels (or anything else with a
+// std::optional<channel_stats> stats() member function) for taking
+// a snapshot of the statistics of all of them at once. This is meant to
+// make it easy to tell e.g. which channel in a pipeline is the bottleneck.
+//
+// Only weak references are kept: channels that have been destroyed are
+// dropped from the registry the next time a snapshot is taken.
+// Thread-safe.
+class stats_registry {
+public:
+    template<typename T>
+    void add(const std::string &name, const std::shared_ptr<T> &source) {
+        std::weak_ptr<T> weak = source;
+        auto getter = [weak]() -> std::optional<std::optional<channel_stats>> {
+            auto p = weak.lock();
+            if (!p) {
+                return std::nullopt;
+            }
+            return p->stats();
+        };
+
+        std::unique_lock l {m_mtx};
+        m_sources.emplace_back(name, std::move(getter));
+    }
+
+    // Return the stats of each registered channel that has stats enabled.
+    std::vector<std::pair<std::string, channel_stats>> snapshot() {
+        std::vector<std::pair<std::string, channel_stats>> res;
+
+        std::unique_lock l {m_mtx};
+        for (auto it = m_sources.begin(); it != m_sources.end();) {
+            auto stats = it->second();
+
+            // channel gone.
+            if (!stats.has_value()) {
+                it = m_sources.erase(it);
+                continue;
+            }
+
+            if (stats->has_value()) {
+                res.emplace_back(it->first, std::move(**stats));
+            }
+            ++it;
+        }
+
+        return res;
+    }
+
+    // Return the aggregate of all the stats in the registry.
+    channel_stats total() {
+        channel_stats total;
+        for (auto &[name, stats] : snapshot()) {
+            total += stats;
+        }
+        return total;
+    }
+
+private:
+    using getter_t =
+      std::function<std::optional<std::optional<channel_stats>>()>;
+
+    std::mutex m_mtx;
+    std::vector<std::pair<std::string, getter_t>> m_sources;
+};
+
+}  // namespace evchan
+}  // namespace tarp
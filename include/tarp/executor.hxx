@@ -0,0 +1,143 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <tarp/cxxcommon.hxx>
+
+namespace tarp {
+
+class EventPump;
+
+namespace threading {
+class ThreadPool;
+}
+
+namespace exec {
+
+namespace interfaces {
+
+// Interface for an executor.
+//
+// An executor is something that can run arbitrary jobs (callables that take
+// no arguments and return nothing) at some point after they are posted.
+// This decouples the *what* from the *where* and *when*: for example,
+// a component that needs to run a continuation (e.g. resume a coroutine) can
+// post it to an executor without caring whether this ends up running on an
+// event loop thread, a thread pool worker etc.
+//
+// NOTE: post() must be thread-safe and must never run the job inline (i.e.
+// before post() returns). Jobs are commonly posted from contexts where locks
+// are held (e.g. evchan notifiers), where running arbitrary code could
+// deadlock.
+class executor {
+public:
+    virtual ~executor() = default;
+    virtual void post(std::function<void()> job) = 0;
+};
+
+}  // namespace interfaces
+
+//
+
+// Executor that queues posted jobs until they are explicitly run by
+// calling one of the run_* functions. Useful for driving jobs from an
+// existing loop or thread, and in tests.
+class queue_executor final : public interfaces::executor {
+public:
+    DISALLOW_COPY_AND_MOVE(queue_executor);
+    queue_executor() = default;
+
+    void post(std::function<void()> job) override;
+
+    // Run all the jobs queued at the time of the call (but not the ones
+    // posted by these jobs while they run). Return the number of jobs run.
+    std::size_t run_pending();
+
+    // Run at most one job; if none is queued, wait up to timeout for one
+    // to be posted. Return true if a job was run, else false.
+    bool run_one_for(std::chrono::microseconds timeout);
+
+    std::size_t size() const;
+
+private:
+    mutable std::mutex m_mtx;
+    std::condition_variable m_cond;
+    std::deque<std::function<void()>> m_jobs;
+};
+
+//
+
+// Executor that runs jobs on the thread running the given EventPump.
+// The jobs are delivered as user events of the specified type; the executor
+// takes over the user event callback for that type.
+// NOTE: the EventPump must outlive the executor. Jobs still queued in the
+// EventPump when the EventPump is destroyed are leaked.
+class evp_executor final : public interfaces::executor {
+public:
+    DISALLOW_COPY_AND_MOVE(evp_executor);
+    evp_executor(std::shared_ptr<tarp::EventPump> evp, unsigned event_type);
+
+    void post(std::function<void()> job) override;
+
+private:
+    std::shared_ptr<tarp::EventPump> m_evp;
+    unsigned m_event_type;
+};
+
+//
+
+// Executor that runs jobs as tasks on a ThreadPool. The ThreadPool
+// must outlive the executor.
+class threadpool_executor final : public interfaces::executor {
+public:
+    DISALLOW_COPY_AND_MOVE(threadpool_executor);
+    explicit threadpool_executor(tarp::threading::ThreadPool &pool);
+
+    void post(std::function<void()> job) override;
+
+private:
+    tarp::threading::ThreadPool &m_pool;
+};
+
+//
+
+namespace impl {
+struct batch_state;
+}
+
+// Executor that coalesces the jobs posted to it into batches on top of
+// another executor: while a batch is pending, further jobs are added to it
+// rather than posted individually, so that any number of jobs posted in
+// quick succession cost the target a single wakeup (e.g. one EventPump
+// event rather than one per job). Jobs run in the order posted.
+// If a job throws, the exception propagates to the underlying executor as
+// for any other job, but the jobs behind it in the batch are not lost: they
+// go into a new batch, ahead of any jobs posted since.
+// NOTE: the underlying executor must outlive the batching_executor. Jobs
+// still pending when the batching_executor is destroyed are still run.
+class batching_executor final : public interfaces::executor {
+public:
+    DISALLOW_COPY_AND_MOVE(batching_executor);
+    explicit batching_executor(interfaces::executor &ex);
+
+    void post(std::function<void()> job) override;
+
+    // Number of jobs posted but not yet run.
+    std::size_t size() const;
+
+    // Number of batches posted to the underlying executor.
+    std::size_t num_batches() const;
+
+private:
+    std::shared_ptr<impl::batch_state> m_state;
+};
+
+}  // namespace exec
+}  // namespace tarp
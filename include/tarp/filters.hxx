@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <utility>
 
 namespace tarp::sched::filters {
 
@@ -10,6 +12,8 @@ public:
     explicit Filter(std::uint32_t filter_id)
         : m_id(filter_id), m_inverted(false) {}
 
+    virtual ~Filter() = default;
+
     std::uint32_t get_id() const { return m_id; }
 
     void set_inverted(bool match_is_negated) { m_inverted = match_is_negated; }
@@ -25,7 +29,7 @@ public:
     }
 
 private:
-    virtual bool do_match(filterable_t &target) = 0;
+    virtual bool do_match(filterable_t &target) const = 0;
 
     uint32_t m_id;
     bool m_inverted {false};
@@ -35,8 +39,28 @@ private:
 template<typename filterable_t>
 class MatchAll : public Filter<filterable_t> {
 public:
-    virtual bool matches(filterable_t &) const override { return true; };
+    explicit MatchAll(std::uint32_t filter_id)
+        : Filter<filterable_t>(filter_id) {}
+
+private:
+    virtual bool do_match(filterable_t &) const override { return true; };
 };
 
+/* A filter that matches whatever the given predicate returns true for. */
+template<typename filterable_t>
+class MatchIf : public Filter<filterable_t> {
+public:
+    using predicate_t = std::function<bool(const filterable_t &)>;
+
+    MatchIf(std::uint32_t filter_id, predicate_t predicate)
+        : Filter<filterable_t>(filter_id), m_predicate(std::move(predicate)) {}
+
+private:
+    virtual bool do_match(filterable_t &target) const override {
+        return m_predicate(target);
+    }
+
+    predicate_t m_predicate;
+};
 
 }  // namespace tarp::sched::filters
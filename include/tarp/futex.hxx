@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace tarp {
+namespace futex {
+
+// Thin wrappers around the Linux futex(2) system call.
+//
+// A futex is a 32-bit word that threads (or processes, if the word lives in
+// shared memory) can block on until the value of the word changes. The
+// kernel only gets involved on the slow path: callers are expected to first
+// check the word with an atomic operation and only call wait() when they
+// actually need to sleep.
+//
+// If shared=true, the futex can be used to synchronize different processes
+// that have the word mapped into their address spaces (e.g. via mmap of a
+// shared memfd). Otherwise the cheaper FUTEX_PRIVATE_FLAG operations are used,
+// which only work between threads of the same process.
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+
+// Block as long as word == expected. Return false if the wait timed out,
+// else true. NOTE: a return value of true does not mean the value of
+// the word has changed: callers must be prepared to handle spurious wakeups
+// and should always recheck the value.
+bool wait(std::atomic<std::uint32_t> &word,
+          std::uint32_t expected,
+          bool shared = false);
+
+// Like wait(), but give up after rel_time has elapsed.
+bool wait_for(std::atomic<std::uint32_t> &word,
+              std::uint32_t expected,
+              std::chrono::nanoseconds rel_time,
+              bool shared = false);
+
+// Like wait(), but give up once abs_time has been reached.
+template<typename clock, typename duration>
+bool wait_until(std::atomic<std::uint32_t> &word,
+                std::uint32_t expected,
+                const std::chrono::time_point<clock, duration> &abs_time,
+                bool shared = false) {
+    auto now = clock::now();
+    if (abs_time <= now) {
+        return false;
+    }
+
+    auto rel_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(abs_time - now);
+    return wait_for(word, expected, rel_time, shared);
+}
+
+// Wake up at most n waiters blocked on word. Return the number of
+// waiters woken.
+int wake(std::atomic<std::uint32_t> &word, int n = 1, bool shared = false);
+
+// Wake up all waiters blocked on word.
+int wake_all(std::atomic<std::uint32_t> &word, bool shared = false);
+
+}  // namespace futex
+}  // namespace tarp
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+namespace tarp {
+
+// Histogram of unsigned 64-bit values, suitable for recording latencies
+// (e.g. in nanoseconds), sizes etc.
+//
+// The buckets are log-linear: values smaller than 2^SUB_BUCKET_BITS are
+// recorded exactly; every power of 2 range above that is split into
+// 2^SUB_BUCKET_BITS equal buckets. This bounds the relative error of any
+// reported percentile to 1/2^SUB_BUCKET_BITS (~6%) while keeping the
+// number of buckets small and fixed, irrespective of the range of values
+// recorded (the entire uint64 range is covered).
+//
+// Recording is lock-free and thread-safe: all counters are relaxed atomics.
+// NOTE: reading (percentile(), summarize() etc) while other threads are
+// recording gives an approximate snapshot: the count, min, max, and
+// buckets are not updated together atomically.
+class histogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr std::size_t SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+    static constexpr std::size_t NUM_BUCKETS =
+      (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    // Point-in-time statistical summary of a histogram.
+    struct summary {
+        std::uint64_t count {0};
+        std::uint64_t min {0};
+        std::uint64_t max {0};
+        double mean {0};
+        std::uint64_t p50 {0};
+        std::uint64_t p90 {0};
+        std::uint64_t p99 {0};
+        std::uint64_t p999 {0};
+    };
+
+    histogram();
+    histogram(const histogram &other);
+    histogram &operator=(const histogram &other);
+
+    // Record value v, n times.
+    void record(std::uint64_t v, std::uint64_t n = 1);
+
+    // Record a duration, in nanoseconds.
+    template<typename rep, typename period>
+    void record(const std::chrono::duration<rep, period> &d) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d);
+        record(ns.count() > 0 ? static_cast<std::uint64_t>(ns.count()) : 0);
+    }
+
+    std::uint64_t count() const;
+    std::uint64_t min() const;
+    std::uint64_t max() const;
+    double mean() const;
+
+    // Return the value below which p percent of the recorded values fall.
+    // p must be in the [0, 100] range. Return 0 if the histogram is empty.
+    std::uint64_t percentile(double p) const;
+
+    summary summarize() const;
+
+    // Add all the values recorded in other to this histogram.
+    void merge(const histogram &other);
+
+    void reset();
+
+private:
+    static std::size_t bucket_index(std::uint64_t v);
+    static std::uint64_t bucket_value(std::size_t idx);
+
+    std::array<std::atomic<std::uint64_t>, NUM_BUCKETS> m_buckets;
+    std::atomic<std::uint64_t> m_count {0};
+    std::atomic<std::uint64_t> m_sum {0};
+    std::atomic<std::uint64_t> m_min {std::numeric_limits<std::uint64_t>::max()};
+    std::atomic<std::uint64_t> m_max {0};
+};
+
+std::ostream &operator<<(std::ostream &os, const histogram::summary &s);
+
+}  // namespace tarp
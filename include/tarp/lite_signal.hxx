@@ -0,0 +1,346 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/functools.hxx>
+#include <tarp/type_traits.hxx>
+
+namespace tarp {
+
+/*
+ * Allocation-free counterpart to tarp::signal.
+ *
+ * Connecting to a tarp::signal allocates the std::function that stores the
+ * callback, the token shared between the signal and the connection, and
+ * the connection object itself. That is fine for long-lived connections,
+ * but not for observers that come and go at a high rate.
+ *
+ * With a lite_signal, the signal consumer instead provides the storage:
+ * a lite_slot, typically a member of the consumer, holds the callback
+ * inline (the callable must fit in the slot's inline buffer; this is
+ * checked at compile time) and is itself the node that gets linked into
+ * the signal's (intrusive) list of observers. Hence connect(), emit() and
+ * disconnect() never touch the heap.
+ *
+ * EXAMPLE:
+ *   struct consumer {
+ *       consumer(tarp::ts::lite_signal<void(int)> &sig) {
+ *           sig.connect(m_slot, [this](int x) { on_event(x); });
+ *       }
+ *       ~consumer() { m_slot.disconnect(); }
+ *       void on_event(int x);
+ *       tarp::lite_slot<void(int)> m_slot;
+ *   };
+ *
+ * --> max_observers
+ * If not 0, the signal accepts at most this many connected slots: connect()
+ * fails (returns false) once the limit is reached. This bounds the time
+ * taken by an emission.
+ *
+ * --> reducer
+ * As with tarp::signal, the reducer combines the values returned by the
+ * callbacks (of type R) into the value returned by emit(). The default
+ * returns the value returned by the last callback.
+ *
+ * Differences from tarp::signal:
+ * - the slot disconnects automatically when destructed. NOTE: if the
+ *   signal can be emitted from another thread, the consumer should call
+ *   disconnect() at the start of its destructor; otherwise the callback
+ *   may be invoked while the consumer is partway through destruction (see
+ *   the signal_connection comments in signal.hxx).
+ * - emission is serialized: the signal's mutex is held for the whole
+ *   emission, so that disconnect() can guarantee the callback is not
+ *   running (and will not be invoked again) once it returns.
+ *   Consequently, connecting to or disconnecting from the signal from
+ *   within a callback produces a deadlock (thread-safe variant).
+ * - the signal must not be destroyed concurrently with a call to
+ *   disconnect() on one of its slots. The slots still connected when the
+ *   signal is destroyed are disconnected.
+ */
+
+namespace impl {
+
+template<typename callback_signature,
+         std::size_t max_observers = 0,
+         template<typename output, typename input> typename reducer =
+           tarp::reduce::last,
+         typename ts_policy = tarp::type_traits::thread_safe>
+class lite_signal;
+
+template<typename signature>
+class lite_slot_base;
+
+/* Lets a slot unlink itself without knowing the exact type of the
+ * signal it is connected to. */
+template<typename signature>
+class lite_signal_link {
+public:
+    virtual void unlink(lite_slot_base<signature> &slot) = 0;
+
+protected:
+    ~lite_signal_link() = default;
+};
+
+/* The part of a slot that the signal sees: the list hooks and the
+ * type-erased callback. */
+template<typename R, typename... Args>
+class lite_slot_base<R(Args...)> {
+public:
+    DISALLOW_COPY_AND_MOVE(lite_slot_base);
+
+    /* Disconnect from the signal, if connected. Idempotent. Once this
+     * returns, the callback is not running and will not be invoked. */
+    void disconnect() {
+        if (m_signal) {
+            m_signal->unlink(*this);
+        }
+    }
+
+    /* NOTE: only meaningful if not racing against connect/disconnect. */
+    bool connected() const { return m_signal != nullptr; }
+
+protected:
+    explicit lite_slot_base(void *buf) : m_buf(buf) {}
+
+    ~lite_slot_base() { disconnect(); }
+
+    using invoke_fn = R (*)(void *, Args &...);
+    using destroy_fn = void (*)(void *);
+
+    void *const m_buf;
+    invoke_fn m_invoke {nullptr};
+    destroy_fn m_destroy {nullptr};
+
+private:
+    template<typename, std::size_t, template<typename, typename> typename, typename>
+    friend class impl::lite_signal;
+
+    // NOTE: the arguments are passed as lvalues so that every observer
+    // gets the same values (rather than the first one moving from them).
+    R invoke(Args &...args) const { return m_invoke(m_buf, args...); }
+
+    lite_signal_link<R(Args...)> *m_signal {nullptr};
+    lite_slot_base *m_prev {nullptr};
+    lite_slot_base *m_next {nullptr};
+};
+
+}  // namespace impl
+
+/*
+ * Connection handle and callback storage for a lite_signal. See above.
+ * Callables of up to inline_size bytes can be bound.
+ */
+template<typename signature, std::size_t inline_size = 32>
+class lite_slot;
+
+template<typename R, typename... Args, std::size_t inline_size>
+class lite_slot<R(Args...), inline_size> final
+    : public impl::lite_slot_base<R(Args...)> {
+public:
+    lite_slot() : impl::lite_slot_base<R(Args...)>(m_storage) {}
+
+    ~lite_slot() {
+        this->disconnect();
+        reset();
+    }
+
+    /* True if the callable can be stored in a lite_slot of this size. */
+    template<typename F>
+    static constexpr bool fits() {
+        return sizeof(F) <= inline_size &&
+               alignof(F) <= alignof(std::max_align_t);
+    }
+
+private:
+    template<typename, std::size_t, template<typename, typename> typename, typename>
+    friend class impl::lite_signal;
+
+    // NOTE: must only be called when not connected.
+    template<typename F>
+    void bind(F &&f) {
+        using fn_t = std::decay_t<F>;
+        static_assert(fits<fn_t>(),
+                      "callable too large for the lite_slot inline storage; "
+                      "capture less or increase inline_size");
+        static_assert(std::is_invocable_r_v<R, fn_t &, Args &...>);
+
+        reset();
+        new (m_storage) fn_t(std::forward<F>(f));
+        this->m_invoke = [](void *buf, Args &...args) -> R {
+            return std::invoke(*static_cast<fn_t *>(buf), args...);
+        };
+        this->m_destroy = [](void *buf) {
+            static_cast<fn_t *>(buf)->~fn_t();
+        };
+    }
+
+    void reset() {
+        if (this->m_destroy) {
+            this->m_destroy(m_storage);
+        }
+        this->m_invoke = nullptr;
+        this->m_destroy = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char m_storage[inline_size];
+};
+
+namespace impl {
+
+template<typename R,
+         typename... Args,
+         std::size_t max_observers,
+         template<typename output, typename input>
+         typename reducer,
+         typename ts_policy>
+class lite_signal<R(Args...), max_observers, reducer, ts_policy> final
+    : public lite_signal_link<R(Args...)> {
+    // see signal: every observer gets the same arguments.
+    static_assert((!std::is_rvalue_reference_v<Args> && ...));
+    static_assert(((std::is_reference_v<Args> or
+                    std::is_copy_constructible_v<std::remove_cv_t<Args>>) &&
+                   ...));
+
+public:
+    DISALLOW_COPY_AND_MOVE(lite_signal);
+
+    lite_signal() = default;
+
+    /* Disconnect all the slots still connected. */
+    ~lite_signal() {
+        lock_t l {m_mtx};
+        while (m_head) {
+            remove(*m_head);
+        }
+    }
+
+    /* same as .emit(...) */
+    R operator()(Args... args) { return emit(std::forward<Args>(args)...); }
+
+    /* Invoke all connected callbacks in the order of their connection. */
+    R emit(Args... args) {
+        using reducer_type =
+          typename std::conditional<std::is_void_v<R>,
+                                    tarp::reduce::void_reducer<R, R>,
+                                    reducer<R, R>>::type;
+        reducer_type r;
+
+        lock_t l {m_mtx};
+        for (auto *slot = m_head; slot; slot = slot->m_next) {
+            if constexpr (std::is_void_v<R>) {
+                slot->invoke(args...);
+            } else {
+                r.process(slot->invoke(args...));
+            }
+        }
+
+        return r.get();
+    }
+
+    /* Bind f to the slot and connect the slot to the signal. If the slot
+     * is already connected (to this or another signal), it is first
+     * disconnected. Return false if the signal already has max_observers
+     * slots connected, in which case the slot is left disconnected. */
+    template<typename F, std::size_t inline_size>
+    bool connect(lite_slot<R(Args...), inline_size> &slot, F &&f) {
+        slot.disconnect();
+
+        lock_t l {m_mtx};
+        if constexpr (max_observers > 0) {
+            if (m_count >= max_observers) {
+                return false;
+            }
+        }
+
+        slot.bind(std::forward<F>(f));
+        slot.m_signal = this;
+        slot.m_prev = m_tail;
+        slot.m_next = nullptr;
+        if (m_tail) {
+            m_tail->m_next = &slot;
+        } else {
+            m_head = &slot;
+        }
+        m_tail = &slot;
+        ++m_count;
+        return true;
+    }
+
+    /* Return the number of slots connected to the signal. */
+    std::size_t count() {
+        lock_t l {m_mtx};
+        return m_count;
+    }
+
+    /* True if no slots are connected to the signal. */
+    bool empty() { return count() == 0; }
+
+private:
+    using slot_t = lite_slot_base<R(Args...)>;
+    using mutex_t = typename tarp::type_traits::ts_types<ts_policy>::mutex_t;
+    using lock_t = typename tarp::type_traits::ts_types<ts_policy>::lock_t;
+
+    void unlink(slot_t &slot) override {
+        lock_t l {m_mtx};
+
+        // may have been disconnected by the signal destructor meanwhile.
+        if (slot.m_signal == this) {
+            remove(slot);
+        }
+    }
+
+    // NOTE: m_mtx must be held.
+    void remove(slot_t &slot) {
+        if (slot.m_prev) {
+            slot.m_prev->m_next = slot.m_next;
+        } else {
+            m_head = slot.m_next;
+        }
+
+        if (slot.m_next) {
+            slot.m_next->m_prev = slot.m_prev;
+        } else {
+            m_tail = slot.m_prev;
+        }
+
+        slot.m_prev = slot.m_next = nullptr;
+        slot.m_signal = nullptr;
+        --m_count;
+    }
+
+    mutex_t m_mtx;
+    slot_t *m_head {nullptr};
+    slot_t *m_tail {nullptr};
+    std::size_t m_count {0};
+};
+
+}  // namespace impl
+
+namespace ts {
+template<typename callback_signature,
+         std::size_t max_observers = 0,
+         template<typename output, typename input> typename reducer =
+           tarp::reduce::last>
+using lite_signal = impl::lite_signal<callback_signature,
+                                      max_observers,
+                                      reducer,
+                                      tarp::type_traits::thread_safe>;
+}
+
+namespace tu {
+template<typename callback_signature,
+         std::size_t max_observers = 0,
+         template<typename output, typename input> typename reducer =
+           tarp::reduce::last>
+using lite_signal = impl::lite_signal<callback_signature,
+                                      max_observers,
+                                      reducer,
+                                      tarp::type_traits::thread_unsafe>;
+}
+
+}  // namespace tarp
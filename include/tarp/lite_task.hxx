@@ -0,0 +1,674 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/futex.hxx>
+#include <tarp/sched.hxx>
+
+/*
+ * Lightweight alternatives to sched::task and std::promise/std::future.
+ *
+ * A sched::task (see make_task_as) allocates the task object, the callable
+ * (possibly), and the shared state of a std::promise/std::future pair.
+ * For short tasks such as bumping a counter, the allocations dominate.
+ *
+ * - inline_task stores small callables inline (small-buffer optimization)
+ *   and the task objects themselves are recycled through a freelist, so
+ *   creating and destroying one normally does not allocate, even when it
+ *   is created on one thread and destroyed on another.
+ * - lite_promise/lite_future is a promise/future pair with a single,
+ *   likewise recycled, shared state. Unlike std::future it supports
+ *   continuations via then().
+ * - For fire-and-forget submission, which needs no shared state at all,
+ *   wrap the callable with make_inline_task (see also ThreadPool::post).
+ */
+namespace tarp::sched {
+
+namespace impl {
+
+/*
+ * Allocator of fixed-size memory blocks. Each thread allocates from its own
+ * cache of free blocks, falling back to the global heap when the cache is
+ * empty. Each block has a small header that points back to the cache it
+ * was allocated from, and a freed block is returned to that cache:
+ * - if freed on the thread that owns the cache, onto its local list (no
+ *   atomics), up to MAX_CACHED blocks; beyond that, to the heap.
+ * - if freed on any other thread (e.g. a task created by a producer and
+ *   destroyed by a thread pool worker), onto the cache's lock-free MPSC
+ *   list: one CAS. The owner takes over the whole list in one go (one
+ *   atomic exchange) when its local list runs empty.
+ * So a producer that hands blocks off to other threads gets them back, and
+ * in the steady state does not touch the heap.
+ *
+ * When a thread exits, its cache frees the blocks it holds and is then
+ * handed over to the next thread that needs one. Caches are never freed,
+ * so blocks freed on other threads later on can always be returned to
+ * theirs; the number of caches is the highest number of threads that
+ * were ever using the allocator at the same time.
+ */
+template<std::size_t block_size>
+class block_freelist {
+public:
+    static constexpr std::size_t MAX_CACHED = 1024;
+
+    static void *allocate() {
+        cache *owner = cache::current();
+        header *h = owner ? owner->pop() : nullptr;
+        if (!h) {
+            h = static_cast<header *>(::operator new(sizeof(header) + block_size));
+            h->owner = owner;
+        }
+        return h + 1;
+    }
+
+    static void deallocate(void *p) {
+        header *h = static_cast<header *>(p) - 1;
+        cache *owner = h->owner;
+
+        // allocated while the thread had no cache (see cache::current).
+        if (!owner) {
+            ::operator delete(h);
+        } else if (owner == cache::current()) {
+            owner->push_local(h);
+        } else {
+            owner->push_remote(h);
+        }
+    }
+
+private:
+    class cache;
+
+    // NOTE: sized such that the block that follows is suitably aligned for
+    // any type, like memory returned by ::operator new.
+    struct alignas(std::max_align_t) header {
+        cache *owner;
+        header *next;
+    };
+
+    static_assert(sizeof(header) % alignof(std::max_align_t) == 0);
+
+    class cache {
+    public:
+        /* The cache of the calling thread. nullptr when called while the
+         * thread is exiting, after its cache has been given up. */
+        static cache *current() {
+            static thread_local binding b;
+            return t_current;
+        }
+
+        header *pop() {
+            if (!m_local) {
+                take_remote();
+            }
+
+            header *h = m_local;
+            if (h) {
+                m_local = h->next;
+                --m_num_local;
+            }
+            return h;
+        }
+
+        void push_local(header *h) {
+            if (m_num_local >= MAX_CACHED) {
+                ::operator delete(h);
+                return;
+            }
+
+            h->next = m_local;
+            m_local = h;
+            ++m_num_local;
+        }
+
+        void push_remote(header *h) {
+            h->next = m_remote.load(std::memory_order_relaxed);
+            while (!m_remote.compare_exchange_weak(h->next,
+                                                   h,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+            }
+        }
+
+    private:
+        // Ties a cache to a thread for the lifetime of the thread.
+        struct binding {
+            binding() : c(adopt()) { t_current = c; }
+
+            ~binding() {
+                t_current = nullptr;
+                c->release();
+                abandon(c);
+            }
+
+            cache *const c;
+        };
+
+        // Caches not currently tied to a thread.
+        struct registry {
+            std::mutex mtx;
+            cache *unowned {nullptr};
+        };
+
+        // NOTE: leaked, since threads may still exit during static
+        // destruction.
+        static registry &caches() {
+            static auto *r = new registry;
+            return *r;
+        }
+
+        static cache *adopt() {
+            auto &r = caches();
+            std::unique_lock l {r.mtx};
+            if (cache *c = r.unowned) {
+                r.unowned = c->m_next_unowned;
+                return c;
+            }
+            return new cache;
+        }
+
+        static void abandon(cache *c) {
+            auto &r = caches();
+            std::unique_lock l {r.mtx};
+            c->m_next_unowned = r.unowned;
+            r.unowned = c;
+        }
+
+        void take_remote() {
+            header *h = m_remote.exchange(nullptr, std::memory_order_acquire);
+            while (h) {
+                header *next = h->next;
+                push_local(h);
+                h = next;
+            }
+        }
+
+        // Free all the blocks held. NOTE: blocks may still be returned to
+        // m_remote afterwards; they are reused by the next owner.
+        void release() {
+            take_remote();
+            while (m_local) {
+                header *next = m_local->next;
+                ::operator delete(m_local);
+                m_local = next;
+            }
+            m_num_local = 0;
+        }
+
+        // trivially destructible, so it can still be read while the
+        // thread's other thread_local objects are being destroyed.
+        static inline thread_local cache *t_current = nullptr;
+
+        // owner thread only.
+        header *m_local {nullptr};
+        std::size_t m_num_local {0};
+        cache *m_next_unowned {nullptr};
+
+        // NOTE: on a cache line of its own, since other threads write it.
+        alignas(64) std::atomic<header *> m_remote {nullptr};
+    };
+};
+
+// Mixin giving T class-specific operator new/delete backed by a freelist.
+template<typename T>
+struct freelist_allocated {
+    static void *operator new(std::size_t n) {
+        if (n != sizeof(T)) {
+            return ::operator new(n);
+        }
+        return block_freelist<sizeof(T)>::allocate();
+    }
+
+    static void operator delete(void *p, std::size_t n) {
+        if (n != sizeof(T)) {
+            ::operator delete(p);
+            return;
+        }
+        block_freelist<sizeof(T)>::deallocate(p);
+    }
+};
+
+}  // namespace impl
+
+//
+
+/*
+ * Task that stores its callable inline if it fits into INLINE_SIZE
+ * bytes (and is nothrow-movable), else on the heap. The task objects are
+ * recycled through a freelist (see impl::block_freelist).
+ *
+ * Since it is an interfaces::task, it can be enqueued anywhere a
+ * sched::task can (ThreadPool, ActiveObject, WorkStealingPool etc).
+ *
+ * NOTE: exceptions thrown by the callable do not escape execute(): an
+ * inline_task is fire-and-forget, so there is no one to deliver them to,
+ * and letting them unwind a worker thread would terminate the process.
+ * They are reported on stderr instead.
+ */
+class inline_task final : public interfaces::task,
+                          public impl::freelist_allocated<inline_task> {
+public:
+    static constexpr std::size_t INLINE_SIZE = 48;
+
+    DISALLOW_COPY_AND_MOVE(inline_task);
+
+    template<typename F,
+             typename = std::enable_if_t<
+               !std::is_same_v<std::decay_t<F>, inline_task>>>
+    explicit inline_task(F &&f) {
+        using fn_t = std::decay_t<F>;
+        static_assert(std::is_invocable_v<fn_t &>);
+
+        if constexpr (fits_inline<fn_t>()) {
+            new (m_buf) fn_t(std::forward<F>(f));
+            m_ops = &inline_ops<fn_t>;
+        } else {
+            auto *p = new fn_t(std::forward<F>(f));
+            new (m_buf) fn_t *(p);
+            m_ops = &heap_ops<fn_t>;
+        }
+    }
+
+    ~inline_task() override { m_ops->destroy(m_buf); }
+
+    void execute() override {
+        try {
+            m_ops->invoke(m_buf);
+        } catch (const std::exception &e) {
+            std::cerr << "exception caught in inline_task: " << e.what()
+                      << "\n";
+        } catch (...) {
+            std::cerr << "unknown exception caught in inline_task\n";
+        }
+    }
+
+    std::string get_name() const override { return {}; }
+
+    using impl::freelist_allocated<inline_task>::operator new;
+    using impl::freelist_allocated<inline_task>::operator delete;
+
+private:
+    struct ops {
+        void (*invoke)(void *);
+        void (*destroy)(void *);
+    };
+
+    template<typename fn_t>
+    static constexpr bool fits_inline() {
+        return sizeof(fn_t) <= INLINE_SIZE &&
+               alignof(std::max_align_t) % alignof(fn_t) == 0 &&
+               std::is_nothrow_move_constructible_v<fn_t>;
+    }
+
+    template<typename fn_t>
+    static constexpr ops inline_ops {
+      [](void *p) { (*static_cast<fn_t *>(p))(); },
+      [](void *p) { static_cast<fn_t *>(p)->~fn_t(); }};
+
+    template<typename fn_t>
+    static constexpr ops heap_ops {
+      [](void *p) { (**static_cast<fn_t **>(p))(); },
+      [](void *p) { delete *static_cast<fn_t **>(p); }};
+
+    alignas(std::max_align_t) unsigned char m_buf[INLINE_SIZE];
+    const ops *m_ops;
+};
+
+/* Wrap f in an inline_task; this is fire-and-forget: no result is
+ * communicated back and there is no shared state. */
+template<typename F>
+std::unique_ptr<interfaces::task> make_inline_task(F &&f) {
+    return std::make_unique<inline_task>(std::forward<F>(f));
+}
+
+//
+
+template<typename T>
+class lite_future;
+
+template<typename T>
+class lite_promise;
+
+namespace impl {
+
+struct unit {};
+
+// Shared state of a lite_promise/lite_future pair. Reference-counted:
+// freed when both the promise and the future are gone.
+template<typename T>
+class lite_state final : public freelist_allocated<lite_state<T>> {
+public:
+    using value_type = std::conditional_t<std::is_void_v<T>, unit, T>;
+
+    void ref() { m_refs.fetch_add(1, std::memory_order_relaxed); }
+
+    void unref() {
+        if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    bool ready() const { return m_ready.load(std::memory_order_acquire); }
+
+    template<typename... args_t>
+    void set_value(args_t &&...args) {
+        m_value.emplace(std::forward<args_t>(args)...);
+        make_ready();
+    }
+
+    void set_exception(std::exception_ptr e) {
+        m_error = std::move(e);
+        make_ready();
+    }
+
+    void wait() {
+        if (ready()) {
+            return;
+        }
+
+        m_waiters.fetch_add(1);
+        while (m_ready.load() == 0) {
+            tarp::futex::wait(m_ready, 0);
+        }
+        m_waiters.fetch_sub(1);
+    }
+
+    value_type take() {
+        wait();
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+        return std::move(*m_value);
+    }
+
+    std::exception_ptr get_exception() const { return m_error; }
+
+    // Run cont when the state becomes ready: immediately, on the calling
+    // thread, if already ready, else on the thread that makes it ready.
+    void on_ready(std::unique_ptr<interfaces::task> cont) {
+        {
+            std::unique_lock l {m_mtx};
+            if (!ready()) {
+                m_cont = std::move(cont);
+                return;
+            }
+        }
+        cont->execute();
+    }
+
+private:
+    void make_ready() {
+        std::unique_ptr<interfaces::task> cont;
+        {
+            std::unique_lock l {m_mtx};
+            m_ready.store(1);
+            cont = std::move(m_cont);
+        }
+
+        if (m_waiters.load() > 0) {
+            tarp::futex::wake_all(m_ready);
+        }
+
+        if (cont) {
+            cont->execute();
+        }
+    }
+
+    std::atomic<std::uint32_t> m_refs {2};
+    std::atomic<std::uint32_t> m_ready {0};
+    std::atomic<std::uint32_t> m_waiters {0};
+    std::mutex m_mtx;
+    std::unique_ptr<interfaces::task> m_cont;
+    std::optional<value_type> m_value;
+    std::exception_ptr m_error;
+};
+
+}  // namespace impl
+
+/*
+ * The read end of a lite_promise/lite_future pair. Move-only.
+ * get() can only be called once.
+ */
+template<typename T>
+class lite_future {
+public:
+    lite_future() = default;
+
+    lite_future(lite_future &&other) noexcept
+        : m_state(std::exchange(other.m_state, nullptr)) {}
+
+    lite_future &operator=(lite_future &&other) noexcept {
+        if (this != &other) {
+            release();
+            m_state = std::exchange(other.m_state, nullptr);
+        }
+        return *this;
+    }
+
+    lite_future(const lite_future &) = delete;
+    lite_future &operator=(const lite_future &) = delete;
+
+    ~lite_future() { release(); }
+
+    bool valid() const { return m_state != nullptr; }
+
+    bool is_ready() const { return check()->ready(); }
+
+    void wait() const { check()->wait(); }
+
+    /* Block until the result is available and return it, or rethrow the
+     * exception stored in the promise. Invalidates the future. */
+    T get() {
+        lite_future self = std::move(*this);
+        if constexpr (std::is_void_v<T>) {
+            self.check()->take();
+        } else {
+            return self.check()->take();
+        }
+    }
+
+    /*
+     * Chain a continuation: f is called with the result of this future
+     * (or without arguments if T is void) once it is available, and the
+     * returned future is fulfilled with the result of f. If this future
+     * holds an exception, f is not called and the exception is propagated
+     * to the returned future. Invalidates this future.
+     *
+     * NOTE: the continuation runs inline: on the thread that fulfills the
+     * promise or, if the result is already available, on the calling
+     * thread, before then() returns. Keep it short or have it post the
+     * actual work to an executor.
+     */
+    template<typename F>
+    auto then(F &&f) {
+        using R = std::conditional_t<std::is_void_v<T>,
+                                     std::invoke_result<std::decay_t<F>>,
+                                     std::invoke_result<std::decay_t<F>, T>>;
+        using result_t = typename R::type;
+
+        auto *state = check();
+        lite_promise<result_t> promise;
+        auto future = promise.get_future();
+
+        auto cont = [src = std::move(*this),
+                     p = std::move(promise),
+                     fn = std::forward<F>(f)]() mutable {
+            auto *s = src.m_state;
+            if (auto e = s->get_exception()) {
+                p.set_exception(e);
+                return;
+            }
+
+            try {
+                if constexpr (std::is_void_v<T> && std::is_void_v<result_t>) {
+                    fn();
+                    p.set_value();
+                } else if constexpr (std::is_void_v<T>) {
+                    p.set_value(fn());
+                } else if constexpr (std::is_void_v<result_t>) {
+                    fn(s->take());
+                    p.set_value();
+                } else {
+                    p.set_value(fn(s->take()));
+                }
+            } catch (...) {
+                p.set_exception(std::current_exception());
+            }
+        };
+
+        state->on_ready(make_inline_task(std::move(cont)));
+        return future;
+    }
+
+private:
+    friend class lite_promise<T>;
+
+    explicit lite_future(impl::lite_state<T> *state) : m_state(state) {}
+
+    impl::lite_state<T> *check() const {
+        if (!m_state) {
+            throw std::future_error(std::future_errc::no_state);
+        }
+        return m_state;
+    }
+
+    void release() {
+        if (m_state) {
+            std::exchange(m_state, nullptr)->unref();
+        }
+    }
+
+    impl::lite_state<T> *m_state = nullptr;
+};
+
+/*
+ * The write end of a lite_promise/lite_future pair. Move-only.
+ * If destroyed without having been fulfilled, the future gets a
+ * std::future_error (broken_promise).
+ */
+template<typename T>
+class lite_promise {
+public:
+    lite_promise() : m_state(new impl::lite_state<T>) {}
+
+    lite_promise(lite_promise &&other) noexcept
+        : m_state(std::exchange(other.m_state, nullptr))
+        , m_future_retrieved(other.m_future_retrieved)
+        , m_fulfilled(other.m_fulfilled) {}
+
+    lite_promise &operator=(lite_promise &&other) noexcept {
+        if (this != &other) {
+            release();
+            m_state = std::exchange(other.m_state, nullptr);
+            m_future_retrieved = other.m_future_retrieved;
+            m_fulfilled = other.m_fulfilled;
+        }
+        return *this;
+    }
+
+    lite_promise(const lite_promise &) = delete;
+    lite_promise &operator=(const lite_promise &) = delete;
+
+    ~lite_promise() { release(); }
+
+    lite_future<T> get_future() {
+        if (m_future_retrieved) {
+            throw std::future_error(std::future_errc::future_already_retrieved);
+        }
+        m_future_retrieved = true;
+        return lite_future<T>(check());
+    }
+
+    template<typename... args_t>
+    void set_value(args_t &&...args) {
+        fulfill()->set_value(std::forward<args_t>(args)...);
+    }
+
+    void set_exception(std::exception_ptr e) {
+        fulfill()->set_exception(std::move(e));
+    }
+
+private:
+    impl::lite_state<T> *check() const {
+        if (!m_state) {
+            throw std::future_error(std::future_errc::no_state);
+        }
+        return m_state;
+    }
+
+    impl::lite_state<T> *fulfill() {
+        auto *s = check();
+        if (m_fulfilled) {
+            throw std::future_error(
+              std::future_errc::promise_already_satisfied);
+        }
+        m_fulfilled = true;
+        return s;
+    }
+
+    void release() {
+        if (!m_state) {
+            return;
+        }
+
+        if (!m_fulfilled) {
+            m_state->set_exception(std::make_exception_ptr(
+              std::future_error(std::future_errc::broken_promise)));
+        }
+
+        // The future holds the other reference; if it was never retrieved,
+        // drop that reference here too.
+        if (!m_future_retrieved) {
+            m_state->unref();
+        }
+        std::exchange(m_state, nullptr)->unref();
+    }
+
+    impl::lite_state<T> *m_state = nullptr;
+    bool m_future_retrieved = false;
+    bool m_fulfilled = false;
+};
+
+/*
+ * Like make_task_as, but return an inline_task and a lite_future:
+ * after warm-up, neither the task nor the shared state allocate unless
+ * the callable is too big to be stored inline.
+ */
+template<typename F>
+std::pair<std::unique_ptr<interfaces::task>,
+          lite_future<std::invoke_result_t<std::decay_t<F>>>>
+make_lite_task(F &&f) {
+    using result_t = std::invoke_result_t<std::decay_t<F>>;
+
+    lite_promise<result_t> promise;
+    auto future = promise.get_future();
+
+    auto job = [p = std::move(promise), fn = std::forward<F>(f)]() mutable {
+        try {
+            if constexpr (std::is_void_v<result_t>) {
+                fn();
+                p.set_value();
+            } else {
+                p.set_value(fn());
+            }
+        } catch (...) {
+            p.set_exception(std::current_exception());
+        }
+    };
+
+    return {make_inline_task(std::move(job)), std::move(future)};
+}
+
+}  // namespace tarp::sched
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/sched.hxx>
+#include <tarp/seqtools.hxx>
+
+/*
+ * Parallel algorithms that run on one of our thread pools.
+ *
+ * Using e.g. std::execution::par alongside our own thread pools
+ * oversubscribes the cores since the standard library maintains its own
+ * threads. The functions here instead split the input into chunks and run
+ * them as tasks on a pool supplied by the caller, so that bulk data
+ * processing shares the same set of threads as everything else.
+ *
+ * --> Pool
+ * Any type with the same enqueue_task()/get_num_threads() API as
+ * tarp::threading::ThreadPool (e.g. ThreadPool or WorkStealingPool).
+ * The pool must have been started.
+ *
+ * --> grain
+ * The max number of elements per chunk, i.e. per task. If 0, a grain is
+ * chosen automatically such that there are a few chunks per pool thread.
+ *
+ * The calling thread processes one of the chunks itself and then blocks
+ * until all the others are done. If the pool has a try_run_one() member
+ * function (WorkStealingPool), the caller runs pending tasks while waiting
+ * instead; that makes it safe to call these functions from inside a task
+ * running on the same pool. With a ThreadPool, calling them from a task
+ * running on that pool may deadlock if all the workers end up waiting.
+ *
+ * If the callable throws, the first exception thrown is rethrown to the
+ * caller after all the chunks have completed.
+ */
+namespace tarp {
+namespace parallel {
+
+namespace impl {
+
+template<typename Pool, typename = void>
+struct has_try_run_one : std::false_type {};
+
+template<typename Pool>
+struct has_try_run_one<Pool,
+                       std::void_t<decltype(std::declval<Pool &>().try_run_one())>>
+    : std::true_type {};
+
+// Number of chunks to aim for per pool thread. More than one so that
+// chunks that take longer than others do not leave threads idle.
+constexpr std::size_t CHUNKS_PER_THREAD = 4;
+
+template<typename Pool>
+std::size_t pick_grain(const Pool &pool, std::size_t n, std::size_t grain) {
+    if (grain > 0) {
+        return grain;
+    }
+
+    // +1 for the calling thread.
+    auto nthreads = pool.get_num_threads() + 1;
+    auto g = n / (nthreads * CHUNKS_PER_THREAD);
+    return g > 0 ? g : 1;
+}
+
+// Count of outstanding chunks plus the first exception thrown, if any.
+class join_state {
+public:
+    DISALLOW_COPY_AND_MOVE(join_state);
+
+    explicit join_state(std::size_t n) : m_pending(n) {}
+
+    template<typename F>
+    void run(F &f) {
+        try {
+            f();
+        } catch (...) {
+            LOCK(m_mtx);
+            if (!m_error) {
+                m_error = std::current_exception();
+            }
+        }
+
+        LOCK(m_mtx);
+        if (--m_pending == 0) {
+            m_cv.notify_all();
+        }
+    }
+
+    bool done() const {
+        LOCK(m_mtx);
+        return m_pending == 0;
+    }
+
+    void wait() {
+        LOCK(m_mtx);
+        m_cv.wait(lock, [this] { return m_pending == 0; });
+    }
+
+    void rethrow() {
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+private:
+    mutable std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::size_t m_pending;
+    std::exception_ptr m_error;
+};
+
+// Call f(i) for each i in [0, n): all but the first on the pool, the first
+// on the calling thread. Block until all the calls have returned.
+template<typename Pool, typename F>
+void fork_join(Pool &pool, std::size_t n, const F &f) {
+    if (n == 0) {
+        return;
+    }
+
+    // NOTE: must outlive the tasks, which is guaranteed since we block
+    // until they have all completed.
+    join_state state(n);
+
+    for (std::size_t i = 1; i < n; ++i) {
+        auto job = [&state, &f, i] {
+            auto call = [&] { f(i); };
+            state.run(call);
+        };
+        auto [task, future] =
+          tarp::sched::make_task_as<tarp::sched::interfaces::task>(
+            std::move(job));
+        pool.enqueue_task(std::move(task));
+    }
+
+    auto first = [&] { f(0); };
+    state.run(first);
+
+    if constexpr (has_try_run_one<Pool>::value) {
+        while (!state.done()) {
+            if (!pool.try_run_one()) {
+                std::this_thread::yield();
+            }
+        }
+    } else {
+        state.wait();
+    }
+
+    state.rethrow();
+}
+
+// Split [first, last) into chunks and return their bounds.
+template<typename I>
+std::vector<std::pair<I, I>> split(I first, I last, std::size_t grain) {
+    std::vector<std::pair<I, I>> chunks;
+    tarp::chunk_range(
+      first, last, grain, [&chunks](I lo, I hi) { chunks.emplace_back(lo, hi); });
+    return chunks;
+}
+
+}  // namespace impl
+
+/*
+ * Call body(lo, hi) for each chunk [lo, hi) of the index range
+ * [first, last), in parallel.
+ */
+template<typename Pool, typename F>
+void parallel_for(Pool &pool,
+                  std::size_t first,
+                  std::size_t last,
+                  F body,
+                  std::size_t grain = 0) {
+    if (first >= last) {
+        return;
+    }
+
+    grain = impl::pick_grain(pool, last - first, grain);
+    auto chunks = impl::split(first, last, grain);
+    impl::fork_join(pool, chunks.size(), [&](std::size_t i) {
+        body(chunks[i].first, chunks[i].second);
+    });
+}
+
+/*
+ * Call f(elem) for each element in the random-access range [first, last),
+ * in parallel.
+ */
+template<typename Pool, typename It, typename F>
+void for_each(Pool &pool, It first, It last, F f, std::size_t grain = 0) {
+    auto n = static_cast<std::size_t>(std::distance(first, last));
+    parallel_for(
+      pool,
+      0,
+      n,
+      [&](std::size_t lo, std::size_t hi) {
+          std::for_each(first + lo, first + hi, f);
+      },
+      grain);
+}
+
+/*
+ * Apply transform to each element in [first, last) and combine the
+ * results with init using reduce. Each chunk is reduced separately
+ * (starting from its first transformed element) and the partial results
+ * are then combined in order on the calling thread. Therefore reduce must
+ * be associative, but need not be commutative.
+ */
+template<typename Pool, typename It, typename T, typename R, typename U>
+T transform_reduce(Pool &pool,
+                   It first,
+                   It last,
+                   T init,
+                   R reduce,
+                   U transform,
+                   std::size_t grain = 0) {
+    auto n = static_cast<std::size_t>(std::distance(first, last));
+    if (n == 0) {
+        return init;
+    }
+
+    grain = impl::pick_grain(pool, n, grain);
+    auto chunks = impl::split(std::size_t {0}, n, grain);
+
+    std::vector<std::optional<T>> partials(chunks.size());
+    impl::fork_join(pool, chunks.size(), [&](std::size_t i) {
+        auto it = first + chunks[i].first;
+        auto end = first + chunks[i].second;
+        T acc = transform(*it);
+        for (++it; it != end; ++it) {
+            acc = reduce(std::move(acc), transform(*it));
+        }
+        partials[i].emplace(std::move(acc));
+    });
+
+    for (auto &p : partials) {
+        init = reduce(std::move(init), std::move(*p));
+    }
+    return init;
+}
+
+/*
+ * Sort the random-access range [first, last) in parallel.
+ * The chunks are sorted in parallel with std::sort and then merged
+ * pairwise, also in parallel. NOTE: like std::sort, this is not stable.
+ */
+template<typename Pool, typename It, typename Cmp = std::less<>>
+void sort(Pool &pool, It first, It last, Cmp cmp = {}, std::size_t grain = 0) {
+    auto n = static_cast<std::size_t>(std::distance(first, last));
+    if (n < 2) {
+        return;
+    }
+
+    grain = impl::pick_grain(pool, n, grain);
+    auto chunks = impl::split(first, last, grain);
+    impl::fork_join(pool, chunks.size(), [&](std::size_t i) {
+        std::sort(chunks[i].first, chunks[i].second, cmp);
+    });
+
+    // Merge adjacent pairs of sorted runs until there is only one left.
+    while (chunks.size() > 1) {
+        std::vector<std::pair<It, It>> merged;
+        for (std::size_t i = 0; i + 1 < chunks.size(); i += 2) {
+            merged.emplace_back(chunks[i].first, chunks[i + 1].second);
+        }
+
+        impl::fork_join(pool, chunks.size() / 2, [&](std::size_t i) {
+            std::inplace_merge(chunks[2 * i].first,
+                               chunks[2 * i].second,
+                               chunks[2 * i + 1].second,
+                               cmp);
+        });
+
+        if (chunks.size() % 2) {
+            merged.push_back(chunks.back());
+        }
+        chunks = std::move(merged);
+    }
+}
+
+/*
+ * Inclusive scan: write op(*first, ..., *(first+i)) to out[i] for each i in
+ * [0, last-first). out may be equal to first (in-place scan). op must be
+ * associative. Return the end of the output range.
+ *
+ * This is done in two parallel passes: the first reduces each chunk; the
+ * chunk totals are then scanned serially; the second pass scans each
+ * chunk, seeded with the total of the chunks before it.
+ */
+template<typename Pool, typename It, typename Out, typename Op = std::plus<>>
+Out scan(Pool &pool,
+         It first,
+         It last,
+         Out out,
+         Op op = {},
+         std::size_t grain = 0) {
+    using T = typename std::iterator_traits<It>::value_type;
+
+    auto n = static_cast<std::size_t>(std::distance(first, last));
+    if (n == 0) {
+        return out;
+    }
+
+    grain = impl::pick_grain(pool, n, grain);
+    auto chunks = impl::split(std::size_t {0}, n, grain);
+
+    // Pass 1: chunk totals. The last chunk's total is never needed.
+    std::vector<std::optional<T>> totals(chunks.size());
+    impl::fork_join(pool, chunks.size() - 1, [&](std::size_t i) {
+        auto it = first + chunks[i].first;
+        auto end = first + chunks[i].second;
+        T acc = *it;
+        for (++it; it != end; ++it) {
+            acc = op(std::move(acc), *it);
+        }
+        totals[i].emplace(std::move(acc));
+    });
+
+    // Exclusive prefix of the totals: the seed for chunk i+1 is in
+    // totals[i] after this.
+    for (std::size_t i = 1; i + 1 < chunks.size(); ++i) {
+        *totals[i] = op(*totals[i - 1], std::move(*totals[i]));
+    }
+
+    // Pass 2.
+    impl::fork_join(pool, chunks.size(), [&](std::size_t i) {
+        auto it = first + chunks[i].first;
+        auto end = first + chunks[i].second;
+        auto o = out + chunks[i].first;
+        T acc = i > 0 ? op(*totals[i - 1], *it) : T(*it);
+        *o = acc;
+        for (++it, ++o; it != end; ++it, ++o) {
+            acc = op(std::move(acc), *it);
+            *o = acc;
+        }
+    });
+
+    return out + n;
+}
+
+}  // namespace parallel
+}  // namespace tarp
@@ -2,16 +2,30 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <functional>
 #include <initializer_list>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <optional>
 #include <queue>
 #include <stdexcept>
+#include <thread>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
+#include <tarp/cxxcommon.hxx>
+#include <tarp/dsp.hxx>
 #include <tarp/floats.h>
+#include <tarp/histogram.hxx>
+#include <tarp/pipeline_metrics.hxx>
 #include <tarp/signal.hxx>
+#include <tarp/sketches.hxx>
 
 #include <iostream>
 
@@ -66,47 +80,150 @@ namespace tarp {
 // to say, stage 2 must take as input the output of stage 1. So arbitrary stages
 // cannot be linked at random.
 //
+// --> batch mode
+// Besides one value at a time (process()), a stage can be given a whole
+// array of values at once (process_batch()). The outputs produced for the
+// batch are then emitted together, as a single array, on the output_batch
+// signal. Stages joined with join_batch() thus pay for one signal dispatch
+// per batch rather than one per value, and stages that override
+// process_input_batch can process the batch in a tight loop the compiler
+// can vectorize. The two modes can be mixed freely: each stage emits on
+// whichever of output and output_batch have observers.
+//
+// --> asynchronous boundaries
+// Normally all the stages run on the thread that feeds the first stage, so
+// one slow stage holds up the whole chain. Inserting an async_boundary
+// between two stages makes the stages downstream of it run on a thread of
+// their own, decoupled from the upstream stages by a bounded buffer. Each
+// of the parallel paths shown above can be given its own boundary and they
+// then run concurrently.
+//
+// --> profiling
+// Stages added to a pipeline_profiler record their input and output
+// counts and processing times; see pipeline_metrics.hxx. Stages not
+// profiled pay only for a null check per input (or batch).
+//
 
 template<typename output_t>
 class PipelineStageOutputInterface {
 public:
     // hook for subsequent stages (or any arbitrary sink) to connect to
     tarp::tu::signal<void(output_t)> output;
+
+    // same as output, but for the outputs of a batch (array, length).
+    tarp::tu::signal<void(const output_t *, std::size_t)> output_batch;
 };
 
 template<typename input_t, typename output_t = input_t>
 class PipelineStage : public PipelineStageOutputInterface<output_t> {
 public:
+    using input_type = input_t;
+    using output_type = output_t;
+
     PipelineStage() : m_is_terminal(false) {}
 
-    // virtual ~PipelineStage() { m_prev_stage->disconnect(); }
+    virtual ~PipelineStage() { disconnect(); }
 
     /* connect current stage to the output of a previous one */
     void join(PipelineStageOutputInterface<input_t> &prev) {
+        disconnect();
+        set_upstream(&prev);
         m_prev_stage = prev.output.connect([this](input_t value) {
             this->process(value);
         });
     }
 
+    /* Same as join, but connect to the batch output of the previous stage */
+    void join_batch(PipelineStageOutputInterface<input_t> &prev) {
+        disconnect();
+        set_upstream(&prev);
+        m_prev_stage = prev.output_batch.connect(
+          [this](const input_t *values, std::size_t n) {
+              this->process_batch(values, n);
+          });
+    }
+
     /* Stop emitting signals for new outputs; terminate the pipeline
      * at the current stage. */
     void make_terminal(void) { m_is_terminal = true; }
 
+    /* Record metrics into recorder from now on (or stop recording, if
+     * nullptr). Normally called by pipeline_profiler::add. Must not be
+     * called while the stage is processing inputs. */
+    void set_recorder(std::shared_ptr<impl::stage_recorder> recorder) {
+        m_recorder = std::move(recorder);
+        if (m_recorder) {
+            m_recorder->set_stage(
+              static_cast<PipelineStageOutputInterface<output_t> *>(this));
+            m_recorder->set_upstream(m_upstream);
+        }
+    }
+
     void process(input_t value) {
         std::optional<output_t> result;
-        process_input(value, result);
+
+        if (m_recorder) {
+            const auto start = std::chrono::steady_clock::now();
+            process_input(value, result);
+            record_inputs(1, start);
+        } else {
+            process_input(value, result);
+        }
 
         /* no output this time */
         if (!result.has_value()) return;
 
+        if (m_recorder) m_recorder->record_outputs(1);
+
         if (m_is_terminal) return;
 
         this->output.emit(result.value());
+
+        if (!this->output_batch.empty()) {
+            this->output_batch.emit(&result.value(), 1);
+        }
     }
 
     void operator()(input_t value) { process(value); };
 
+    /* Process n values in one go; see the batch mode comments above. */
+    void process_batch(const input_t *inputs, std::size_t n) {
+        m_batch_outputs.clear();
+
+        if (m_recorder) {
+            const auto start = std::chrono::steady_clock::now();
+            process_input_batch(inputs, n, m_batch_outputs);
+            record_inputs(n, start);
+        } else {
+            process_input_batch(inputs, n, m_batch_outputs);
+        }
+
+        emit_outputs(m_batch_outputs.data(), m_batch_outputs.size());
+    }
+
+    void process_batch(const std::vector<input_t> &inputs) {
+        process_batch(inputs.data(), inputs.size());
+    }
+
 protected:
+    /* Emit the n values as outputs of the stage, as a batch on output_batch
+     * and one at a time on output. Does nothing if the stage is terminal. */
+    void emit_outputs(const output_t *values, std::size_t n) {
+        if (n == 0) return;
+
+        if (m_recorder) m_recorder->record_outputs(n);
+
+        if (m_is_terminal) return;
+
+        this->output_batch.emit(values, n);
+
+        if (!this->output.empty()) {
+            for (std::size_t i = 0; i < n; ++i) {
+                this->output.emit(values[i]);
+            }
+        }
+    }
+
     /*
      * --> input
      * Value to be processed.
@@ -130,9 +247,59 @@ protected:
     virtual void process_input(input_t input,
                                std::optional<output_t> &output) = 0;
 
+    /*
+     * Batch counterpart to process_input: process the n values in inputs
+     * and *append* the outputs obtained to outputs. The default
+     * implementation calls process_input on each value in turn. Stages
+     * override this with an implementation that processes the whole
+     * batch at once, which must produce the same outputs as the default.
+     */
+    virtual void process_input_batch(const input_t *inputs,
+                                     std::size_t n,
+                                     std::vector<output_t> &outputs) {
+        std::optional<output_t> result;
+        for (std::size_t i = 0; i < n; ++i) {
+            result.reset();
+            process_input(inputs[i], result);
+            if (result.has_value()) {
+                outputs.push_back(std::move(result.value()));
+            }
+        }
+    }
+
 private:
+    void set_upstream(const void *upstream) {
+        m_upstream = upstream;
+        if (m_recorder) {
+            m_recorder->set_upstream(upstream);
+        }
+    }
+
+    void record_inputs(std::size_t n,
+                       std::chrono::steady_clock::time_point start) {
+        m_recorder->record_inputs(
+          n,
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start));
+    }
+
+    /* disconnect from the previous stage, if joined */
+    void disconnect() {
+        if (m_prev_stage) {
+            m_prev_stage->disconnect();
+            m_prev_stage.reset();
+        }
+    }
+
     std::unique_ptr<tarp::signal_connection> m_prev_stage;
     bool m_is_terminal;
+
+    // the output interface of the stage joined to, if any.
+    const void *m_upstream {nullptr};
+    std::shared_ptr<impl::stage_recorder> m_recorder;
+
+    // reused across batches to avoid allocations.
+    std::vector<output_t> m_batch_outputs;
 };
 
 // TODO:
@@ -185,14 +352,35 @@ public:
               " (low_cutoff > high_cutoff)");
     }
 
-private:
-    virtual void process_input(T input, std::optional<T> &output) {
+    virtual void process_input(T input, std::optional<T> &result) override {
         if (input >= m_low_cutoff and input <= m_high_cutoff) {
-            output = input;
+            result = input;
             return;
         }
     }
 
+    // Branchless: every input is written out, but the write position only
+    // advances past those within the band.
+    virtual void process_input_batch(const T *inputs,
+                                     std::size_t n,
+                                     std::vector<T> &outputs) override {
+        auto start = outputs.size();
+        outputs.resize(start + n);
+
+        T *out = outputs.data() + start;
+        const T low = m_low_cutoff;
+        const T high = m_high_cutoff;
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const T value = inputs[i];
+            out[k] = value;
+            k += static_cast<std::size_t>((value >= low) & (value <= high));
+        }
+
+        outputs.resize(start + k);
+    }
+
+private:
     T m_low_cutoff;
     T m_high_cutoff;
 };
@@ -261,9 +449,48 @@ public:
         }
     }
 
+    // The batch is appended to the tail of the current window so that
+    // the k-th output is the weighted sum of m_window[k, k+width).
+    // NOTE: the loops are ordered such that the innermost one runs over
+    // the outputs, which is vectorizable without reordering the
+    // (floating point) additions: each output accumulates its terms in the
+    // same order as process_input does.
+    virtual void process_input_batch(const input_t *inputs,
+                                     std::size_t n,
+                                     std::vector<output_t> &outputs) override {
+        const std::size_t width = m_weights.size();
+
+        // m_buffer holds the last min(width, #inputs so far) inputs; the
+        // last width-1 of those are the start of the next window.
+        auto keep = std::min(m_buffer.size(), width - 1);
+        m_window.assign(m_buffer.end() - keep, m_buffer.end());
+        m_window.insert(m_window.end(), inputs, inputs + n);
+
+        if (m_window.size() >= width) {
+            const std::size_t num_outputs = m_window.size() - width + 1;
+            const auto start = outputs.size();
+            outputs.resize(start + num_outputs, output_t {});
+
+            output_t *out = outputs.data() + start;
+            const input_t *window = m_window.data();
+            for (std::size_t j = 0; j < width; ++j) {
+                const float weight = m_weights[j];
+                for (std::size_t k = 0; k < num_outputs; ++k) {
+                    out[k] += window[k + j] * weight;
+                }
+            }
+        }
+
+        keep = std::min(m_window.size(), width);
+        m_buffer.assign(m_window.end() - keep, m_window.end());
+    }
+
 private:
     std::deque<input_t> m_buffer;
     std::vector<float> m_weights;
+
+    // scratch space for process_input_batch; reused across batches.
+    std::vector<input_t> m_window;
 };
 
 /*
@@ -312,17 +539,311 @@ public:
         result = m_sma;
     }
 
+    // Once on the fast path, output i is the contribution of inputs[i],
+    // plus the previous output, minus the contribution of the value leaving
+    // the window, which for i >= width is inputs[i - width]. The
+    // contributions are computed first, in loops that the compiler can
+    // vectorize, and then accumulated in order, associated exactly as in
+    // process_input so that both give bit-identical outputs.
+    virtual void process_input_batch(const input_t *inputs,
+                                     std::size_t n,
+                                     std::vector<output_t> &outputs) override {
+        // warm-up, until the first window is full.
+        std::optional<output_t> result;
+        while (!m_fastpath && n > 0) {
+            result.reset();
+            process_input(*inputs++, result);
+            --n;
+            if (result.has_value()) {
+                outputs.push_back(result.value());
+            }
+        }
+
+        if (n == 0) return;
+
+        m_entering.resize(n);
+        m_leaving.resize(n);
+
+        const float weight = m_weight;
+        const std::size_t head = std::min(n, m_window_width);
+        for (std::size_t i = 0; i < n; ++i) {
+            m_entering[i] = weight * inputs[i];
+        }
+        for (std::size_t i = 0; i < head; ++i) {
+            m_leaving[i] = weight * m_buffer[i];
+        }
+        for (std::size_t i = head; i < n; ++i) {
+            m_leaving[i] = weight * inputs[i - m_window_width];
+        }
+
+        const auto start = outputs.size();
+        outputs.resize(start + n);
+        output_t *out = outputs.data() + start;
+
+        output_t running = m_sma;
+        for (std::size_t i = 0; i < n; ++i) {
+            running = m_entering[i] + running - m_leaving[i];
+            out[i] = running;
+        }
+        m_sma = running;
+
+        // keep the last width inputs.
+        if (n >= m_window_width) {
+            m_buffer.assign(inputs + n - m_window_width, inputs + n);
+        } else {
+            m_buffer.erase(m_buffer.begin(), m_buffer.begin() + n);
+            m_buffer.insert(m_buffer.end(), inputs, inputs + n);
+        }
+    }
+
 private:
     bool m_fastpath;
     size_t m_window_width;
     float m_weight;
     std::deque<input_t> m_buffer;
     output_t m_sma;
+
+    // scratch space for process_input_batch; reused across batches.
+    using product_t = decltype(std::declval<float>() * std::declval<input_t>());
+    std::vector<product_t> m_entering;
+    std::vector<product_t> m_leaving;
 };
 
 template<typename T>
 using tolerance_filter = memoryless_bandpass_filter<T>;
 
+//
+// The stages below wrap the filter kernels in dsp.hxx; see there fmi.
+//
+
+/*
+ * Exponential moving average. The first input is output as is and seeds
+ * the average. */
+template<typename T>
+class ema : public PipelineStage<T, T> {
+public:
+    explicit ema(T alpha) : m_alpha(alpha) {
+        if (!(alpha > 0 && alpha <= 1)) {
+            throw std::invalid_argument("Invalid EMA smoothing factor: "
+                                        "must be in (0, 1]");
+        }
+    }
+
+    virtual void process_input(T input, std::optional<T> &result) override {
+        if (!m_seeded) {
+            m_state = input;
+            m_seeded = true;
+        } else {
+            T out;
+            m_state = dsp::ema(&input, 1, m_alpha, m_state, &out);
+        }
+        result = m_state;
+    }
+
+    virtual void process_input_batch(const T *inputs,
+                                     std::size_t n,
+                                     std::vector<T> &outputs) override {
+        if (n == 0) return;
+
+        const auto start = outputs.size();
+        outputs.resize(start + n);
+        T *out = outputs.data() + start;
+
+        if (!m_seeded) {
+            m_state = *out++ = *inputs++;
+            m_seeded = true;
+            --n;
+        }
+
+        m_state = dsp::ema(inputs, n, m_alpha, m_state, out);
+    }
+
+private:
+    T m_alpha;
+    T m_state {};
+    bool m_seeded {false};
+};
+
+/*
+ * FIR filter; see dsp::fir. Outputs start once len(taps) inputs have been
+ * seen. */
+template<typename T>
+class fir_filter : public PipelineStage<T, T> {
+public:
+    explicit fir_filter(std::vector<T> taps) : m_taps(std::move(taps)) {
+        if (m_taps.empty()) {
+            throw std::invalid_argument("Invalid FIR filter with 0 taps");
+        }
+        m_window.reserve(m_taps.size());
+    }
+
+    virtual void process_input(T input, std::optional<T> &result) override {
+        m_single.clear();
+        process_input_batch(&input, 1, m_single);
+        if (!m_single.empty()) {
+            result = m_single.front();
+        }
+    }
+
+    // The batch is appended to the last len(taps)-1 inputs, which are kept
+    // from one call to the next.
+    virtual void process_input_batch(const T *inputs,
+                                     std::size_t n,
+                                     std::vector<T> &outputs) override {
+        const std::size_t ntaps = m_taps.size();
+        m_window.insert(m_window.end(), inputs, inputs + n);
+
+        if (m_window.size() >= ntaps) {
+            const auto start = outputs.size();
+            outputs.resize(start + m_window.size() - ntaps + 1);
+            dsp::fir(m_window.data(),
+                     m_window.size(),
+                     m_taps.data(),
+                     ntaps,
+                     outputs.data() + start);
+        }
+
+        const auto keep = std::min(m_window.size(), ntaps - 1);
+        m_window.erase(m_window.begin(), m_window.end() - keep);
+    }
+
+private:
+    std::vector<T> m_taps;
+    std::vector<T> m_window;
+
+    // scratch space for process_input.
+    std::vector<T> m_single;
+};
+
+/*
+ * Biquad (second-order IIR) filter; see dsp::biquad. */
+template<typename T>
+class biquad_filter : public PipelineStage<T, T> {
+public:
+    explicit biquad_filter(const dsp::biquad_coeffs<T> &coeffs)
+        : m_coeffs(coeffs) {}
+
+    virtual void process_input(T input, std::optional<T> &result) override {
+        T out;
+        dsp::biquad(&input, 1, m_coeffs, m_state, &out);
+        result = out;
+    }
+
+    virtual void process_input_batch(const T *inputs,
+                                     std::size_t n,
+                                     std::vector<T> &outputs) override {
+        const auto start = outputs.size();
+        outputs.resize(start + n);
+        dsp::biquad(inputs, n, m_coeffs, m_state, outputs.data() + start);
+    }
+
+private:
+    dsp::biquad_coeffs<T> m_coeffs;
+    dsp::biquad_state<T> m_state;
+};
+
+/*
+ * Running min/max/median over a sliding window. Outputs start once the
+ * window is full. */
+template<typename T, typename window_t>
+class sliding_window_stage : public PipelineStage<T, T> {
+public:
+    explicit sliding_window_stage(std::size_t window) : m_window(window) {}
+
+    virtual void process_input(T input, std::optional<T> &result) override {
+        T out;
+        if (m_window.push(input, out)) {
+            result = out;
+        }
+    }
+
+    virtual void process_input_batch(const T *inputs,
+                                     std::size_t n,
+                                     std::vector<T> &outputs) override {
+        const auto start = outputs.size();
+        outputs.resize(start + n);
+
+        T *out = outputs.data() + start;
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            k += m_window.push(inputs[i], out[k]);
+        }
+
+        outputs.resize(start + k);
+    }
+
+private:
+    window_t m_window;
+};
+
+template<typename T>
+using running_min =
+  sliding_window_stage<T, dsp::monotonic_window<T, std::less<T>>>;
+
+template<typename T>
+using running_max =
+  sliding_window_stage<T, dsp::monotonic_window<T, std::greater<T>>>;
+
+template<typename T>
+using median_filter = sliding_window_stage<T, dsp::median_window<T>>;
+
+/*
+ * Pass-through stage that feeds every input into a statistics accumulator
+ * (see sketches.hxx and histogram.hxx) and outputs it unchanged. The
+ * accumulator can be read (or reset) at any time through accumulator();
+ * for e.g. per-thread pipelines, merge their accumulators when reading.
+ *
+ * NOTE: tarp::histogram records unsigned integers: negative inputs are
+ * recorded as 0 and fractional ones are truncated.
+ */
+template<typename T, typename accumulator_t>
+class accumulator_stage : public PipelineStage<T, T> {
+public:
+    template<typename... args_t>
+    explicit accumulator_stage(args_t &&...args)
+        : m_acc(std::forward<args_t>(args)...) {}
+
+    virtual void process_input(T input, std::optional<T> &result) override {
+        record(input);
+        result = input;
+    }
+
+    virtual void process_input_batch(const T *inputs,
+                                     std::size_t n,
+                                     std::vector<T> &outputs) override {
+        for (std::size_t i = 0; i < n; ++i) {
+            record(inputs[i]);
+        }
+        outputs.insert(outputs.end(), inputs, inputs + n);
+    }
+
+    accumulator_t &accumulator() { return m_acc; }
+    const accumulator_t &accumulator() const { return m_acc; }
+
+private:
+    void record(const T &value) {
+        if constexpr (std::is_same_v<accumulator_t, histogram>) {
+            m_acc.record(value > 0 ? static_cast<std::uint64_t>(value) : 0);
+        } else {
+            m_acc.add(value);
+        }
+    }
+
+    accumulator_t m_acc;
+};
+
+/* Running count, mean, variance, min and max. */
+template<typename T, typename float_t = double>
+using welford_stage = accumulator_stage<T, welford<float_t>>;
+
+/* Running quantile estimates; constructed with the digest compression. */
+template<typename T>
+using tdigest_stage = accumulator_stage<T, tdigest>;
+
+/* Log-bucketed (HDR-style) histogram, e.g. of latencies. */
+template<typename T>
+using histogram_stage = accumulator_stage<T, histogram>;
+
 /*
  * Counter; this is based on the idea of an electronic flip-flop counter
  * circuit, often used to divide an input clock to a lower frequency
@@ -361,15 +882,300 @@ public:
 
     virtual void process_input(std::size_t,
                                std::optional<std::size_t> &result) override {
-        m_current_value = (m_current_value + 1 % m_modulus);
+        m_current_value = (m_current_value + 1) % m_modulus;
         if (m_current_value != 0) return;
         result = m_monotonic_output;
     }
 
+    // The inputs are ignored, so the number of wraparounds is computed
+    // directly.
+    virtual void process_input_batch(const std::size_t *,
+                                     std::size_t n,
+                                     std::vector<std::size_t> &outputs) override {
+        const std::size_t total = m_current_value + n;
+        outputs.insert(outputs.end(), total / m_modulus, m_monotonic_output);
+        m_current_value = total % m_modulus;
+    }
+
 private:
-    size_t m_monotonic_output;
     std::size_t m_modulus;
     std::size_t m_current_value;
+    size_t m_monotonic_output;
+};
+
+//
+// A fused pipeline chains stages statically, for pipelines whose topology
+// is fixed at compile time: each value is handed straight from the
+// process_input of one stage to the process_input of the next, and the
+// output of the last stage is passed to a sink (any callable). There are
+// no signals or std::functions in between, and process_input is called
+// non-virtually, so the whole call chain can be inlined.
+//
+// EXAMPLE:
+//   tarp::sma<float, float> ma(8);
+//   tarp::memoryless_bandpass_filter<float> bp(lo, hi, false);
+//   auto p = tarp::make_pipeline(ma, bp, [](float v) { ... });
+//   p.process(1.0);
+//
+// NOTE: the stages are not copied or moved into the pipeline (they are not
+// movable) but referenced, and so they must outlive it. The sink is stored
+// by value. The stages keep their state between calls as usual and their
+// output signals are bypassed (not emitted).
+// NOTE: the process_input method of each stage must be public.
+//
+template<typename sink_t, typename... stages>
+class fused_pipeline {
+    static_assert(sizeof...(stages) > 0, "A pipeline needs at least one stage");
+
+    using stage_list = std::tuple<stages...>;
+
+    template<std::size_t i>
+    using stage_at = std::tuple_element_t<i, stage_list>;
+
+public:
+    using input_type = typename stage_at<0>::input_type;
+    using output_type =
+      typename stage_at<sizeof...(stages) - 1>::output_type;
+
+    template<typename sink_type>
+    fused_pipeline(stages &...s, sink_type &&sink)
+        : m_stages(s...), m_sink(std::forward<sink_type>(sink)) {}
+
+    void process(input_type value) { feed<0>(std::move(value)); }
+
+    void operator()(input_type value) { process(std::move(value)); }
+
+    void process_batch(const input_type *inputs, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            feed<0>(inputs[i]);
+        }
+    }
+
+private:
+    template<std::size_t i, typename T>
+    void feed(T &&value) {
+        if constexpr (i == sizeof...(stages)) {
+            std::invoke(m_sink, std::forward<T>(value));
+        } else {
+            using stage_t = stage_at<i>;
+            static_assert(
+              std::is_convertible_v<T, typename stage_t::input_type>,
+              "The output of a stage must be convertible to the input of "
+              "the next stage");
+
+            std::optional<typename stage_t::output_type> result;
+
+            // qualified, hence non-virtual, call.
+            std::get<i>(m_stages).stage_t::process_input(
+              std::forward<T>(value), result);
+
+            if (result.has_value()) {
+                feed<i + 1>(std::move(result.value()));
+            }
+        }
+    }
+
+    std::tuple<stages &...> m_stages;
+    sink_t m_sink;
+};
+
+namespace impl {
+template<typename args_tuple, std::size_t... stage_indices>
+auto make_fused_pipeline(args_tuple &&args,
+                         std::index_sequence<stage_indices...>) {
+    constexpr std::size_t sink_index = sizeof...(stage_indices);
+    using sink_arg_t = std::tuple_element_t<sink_index, args_tuple>;
+
+    static_assert(
+      (std::is_lvalue_reference_v<
+         std::tuple_element_t<stage_indices, args_tuple>> &&
+       ...),
+      "Pipeline stages must be passed as lvalues (they are referenced)");
+
+    return fused_pipeline<
+      std::decay_t<sink_arg_t>,
+      std::remove_reference_t<
+        std::tuple_element_t<stage_indices, args_tuple>>...>(
+      std::get<stage_indices>(args)...,
+      std::forward<sink_arg_t>(std::get<sink_index>(args)));
+}
+}  // namespace impl
+
+/* Build a fused_pipeline from the given stages, in order, followed by the
+ * sink (the last argument). */
+template<typename... args_t>
+auto make_pipeline(args_t &&...args) {
+    static_assert(sizeof...(args_t) >= 2,
+                  "make_pipeline takes one or more stages and a sink");
+    return impl::make_fused_pipeline(
+      std::forward_as_tuple(std::forward<args_t>(args)...),
+      std::make_index_sequence<sizeof...(args_t) - 1> {});
+}
+
+//
+// Asynchronous pipeline boundary. A pass-through stage that hands the
+// values it is given over to a thread of its own, which then emits them as
+// outputs of the stage. The stages joined to its output therefore run on
+// that thread rather than on the thread feeding the boundary.
+//
+// EXAMPLE:
+//   tarp::async_boundary<float> b(4096);
+//   b.join(fast_stage);
+//   slow_stage.join_batch(b);
+//
+// --> capacity
+// The max number of values buffered. When the buffer is full, the thread
+// feeding the boundary blocks until there is room (backpressure); nothing
+// is dropped.
+//
+// --> batching
+// The values buffered while the boundary thread is busy are handed over
+// all at once and emitted as a single batch (see output_batch), so the
+// handoff costs one lock and one wakeup per batch rather than per value;
+// the faster the upstream stages relative to the downstream ones, the
+// larger the batches.
+//
+// NOTE: the output signals are emitted on the boundary thread, so the
+// stages downstream must be joined before any values are fed in and must
+// not be disconnected while values are flowing (the signals are not
+// thread-safe).
+// NOTE: the boundary thread delivers the values still buffered before
+// exiting when the boundary is destructed; values fed in after that point
+// are discarded. See flush() for waiting for delivery instead.
+//
+template<typename T>
+class async_boundary final : public PipelineStage<T, T> {
+public:
+    DISALLOW_COPY_AND_MOVE(async_boundary);
+
+    explicit async_boundary(std::size_t capacity) : m_capacity(capacity) {
+        if (m_capacity == 0) {
+            throw std::logic_error("Invalid async_boundary capacity (0)");
+        }
+
+        m_buffer.reserve(m_capacity);
+        m_thread = std::thread([this] { run(); });
+    }
+
+    ~async_boundary() override {
+        {
+            std::unique_lock l {m_mtx};
+            m_stop = true;
+        }
+        m_consumer_cond.notify_one();
+        m_producer_cond.notify_all();
+
+        m_thread.join();
+    }
+
+    /* Block until all the values fed in so far have been emitted. */
+    void flush() {
+        std::unique_lock l {m_mtx};
+        m_producer_cond.wait(l, [this] {
+            return (m_buffer.empty() && !m_busy) || m_stop;
+        });
+    }
+
+    /* Number of values buffered waiting to be emitted. */
+    std::size_t size() const {
+        std::unique_lock l {m_mtx};
+        return m_buffer.size();
+    }
+
+    std::size_t capacity() const { return m_capacity; }
+
+    /* Number of batches emitted so far. */
+    std::size_t num_batches() const {
+        std::unique_lock l {m_mtx};
+        return m_num_batches;
+    }
+
+protected:
+    // NOTE: the outputs are emitted from the boundary thread, so no output
+    // is ever returned here.
+    void process_input(T input, std::optional<T> &) override {
+        enqueue(&input, 1);
+    }
+
+    void process_input_batch(const T *inputs,
+                             std::size_t n,
+                             std::vector<T> &) override {
+        enqueue(inputs, n);
+    }
+
+private:
+    void enqueue(const T *values, std::size_t n) {
+        while (n > 0) {
+            {
+                std::unique_lock l {m_mtx};
+                m_producer_cond.wait(l, [this] {
+                    return m_buffer.size() < m_capacity || m_stop;
+                });
+
+                if (m_stop) {
+                    return;
+                }
+
+                auto room = m_capacity - m_buffer.size();
+                auto count = std::min(room, n);
+                m_buffer.insert(m_buffer.end(), values, values + count);
+                values += count;
+                n -= count;
+            }
+
+            m_consumer_cond.notify_one();
+        }
+    }
+
+    void run() {
+        // swapped with m_buffer, so that, in the steady state, the two
+        // buffers are reused without allocations.
+        std::vector<T> batch;
+        batch.reserve(m_capacity);
+
+        for (;;) {
+            {
+                std::unique_lock l {m_mtx};
+                m_busy = false;
+                m_producer_cond.notify_all();
+
+                m_consumer_cond.wait(l, [this] {
+                    return !m_buffer.empty() || m_stop;
+                });
+
+                if (m_buffer.empty()) {
+                    return;
+                }
+
+                std::swap(batch, m_buffer);
+                m_busy = true;
+                m_num_batches++;
+            }
+
+            m_producer_cond.notify_all();
+
+            this->emit_outputs(batch.data(), batch.size());
+            batch.clear();
+        }
+    }
+
+    const std::size_t m_capacity;
+
+    mutable std::mutex m_mtx;
+
+    // signaled when there is room in the buffer or the boundary goes idle.
+    std::condition_variable m_producer_cond;
+
+    // signaled when values are buffered or on stop.
+    std::condition_variable m_consumer_cond;
+
+    std::vector<T> m_buffer;
+    bool m_busy {false};
+    bool m_stop {false};
+    std::size_t m_num_batches {0};
+
+    // NOTE: last, so that it is started after everything else is set up.
+    std::thread m_thread;
 };
 
 } /* namespace tarp */
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/histogram.hxx>
+
+/*
+ * Opt-in profiling of pipeline stages (see pipeline.hxx).
+ *
+ * For each profiled stage, the following is recorded:
+ *  - the number of inputs processed and outputs produced. Inputs that
+ *    produce no output (e.g. filtered out, or absorbed into a moving
+ *    average) show up in the drop ratio.
+ *  - the processing time per input, in nanoseconds. This is the time spent
+ *    in the stage itself, *not* including the stages downstream of it:
+ *    the outputs are emitted (and so the downstream stages run) after the
+ *    clock is stopped. For a batch, each of its inputs is recorded as
+ *    taking an equal share of the batch time.
+ *
+ * NOTE: for an async_boundary, the time recorded is that spent waiting for
+ * room in its buffer, i.e. the backpressure from the stages downstream.
+ * NOTE: stages run as part of a fused_pipeline are called directly,
+ * bypassing the instrumentation, and are not profiled.
+ */
+namespace tarp {
+
+/* Point-in-time snapshot of the metrics of a pipeline stage. */
+struct stage_metrics {
+    std::string name;
+
+    /* Index (in the profiler snapshot) of the profiled stage this stage is
+     * joined to, if any. */
+    std::optional<std::size_t> upstream;
+
+    std::uint64_t num_inputs {0};
+    std::uint64_t num_outputs {0};
+
+    /* Total time spent processing inputs. */
+    std::chrono::nanoseconds busy_time {0};
+
+    histogram process_time;
+
+    /* Fraction of the inputs that produced no output, in [0, 1]. 0 for
+     * stages that produce more outputs than inputs. */
+    double drop_ratio() const {
+        if (num_inputs == 0 || num_outputs >= num_inputs) {
+            return 0;
+        }
+        return static_cast<double>(num_inputs - num_outputs) /
+               static_cast<double>(num_inputs);
+    }
+};
+
+namespace impl {
+
+/*
+ * Metrics recorded by a stage as it processes its inputs. Only the thread
+ * running the stage records, but snapshots can be taken concurrently from
+ * any thread.
+ */
+class stage_recorder {
+public:
+    DISALLOW_COPY_AND_MOVE(stage_recorder);
+
+    explicit stage_recorder(std::string name);
+
+    void record_inputs(std::uint64_t n, std::chrono::nanoseconds elapsed);
+
+    void record_outputs(std::uint64_t n) {
+        m_num_outputs.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /* The identities of the stage and of the stage it is joined to; only
+     * ever compared, to reconstruct the topology of the pipeline. */
+    void set_stage(const void *stage) { m_stage = stage; }
+    void set_upstream(const void *upstream) { m_upstream = upstream; }
+    const void *stage() const { return m_stage; }
+    const void *upstream() const { return m_upstream; }
+
+    stage_metrics snapshot() const;
+
+    void reset();
+
+private:
+    const std::string m_name;
+    std::atomic<const void *> m_stage {nullptr};
+    std::atomic<const void *> m_upstream {nullptr};
+    std::atomic<std::uint64_t> m_num_inputs {0};
+    std::atomic<std::uint64_t> m_num_outputs {0};
+    std::atomic<std::uint64_t> m_busy_ns {0};
+    histogram m_process_time;
+};
+
+}  // namespace impl
+
+/*
+ * Collects the metrics of a set of pipeline stages and dumps them as a
+ * tree that follows the topology of the pipeline, such that it is easy to
+ * see where the time goes across its branches.
+ *
+ * Profiling is enabled for a stage by adding it to a profiler, before
+ * the stage starts processing inputs. The stages can be added and joined
+ * in any order. The profiler may outlive the stages it profiles.
+ *
+ * Example:
+ *   pipeline_profiler prof;
+ *   prof.add(source, "source");
+ *   prof.add(smoothing, "smoothing");
+ *   ...
+ *   prof.dump(std::cerr);
+ */
+class pipeline_profiler {
+public:
+    DISALLOW_COPY_AND_MOVE(pipeline_profiler);
+
+    pipeline_profiler() = default;
+
+    /* Start profiling stage, under the given name. */
+    template<typename stage_t>
+    void add(stage_t &stage, std::string name) {
+        auto recorder = std::make_shared<impl::stage_recorder>(std::move(name));
+        stage.set_recorder(recorder);
+
+        std::unique_lock l {m_mtx};
+        m_recorders.push_back(std::move(recorder));
+    }
+
+    /* The metrics of all the stages, in the order they were added in. */
+    std::vector<stage_metrics> snapshot() const;
+
+    /*
+     * Write a table of the metrics of each stage, with the stages indented
+     * under the stage they are joined to. Besides the time spent in each
+     * stage itself (self), the time spent in each stage together with all
+     * the stages downstream of it (branch) is shown, each as a percentage
+     * of the total time spent in all the stages. */
+    void dump(std::ostream &os) const;
+
+    /* Reset the metrics of all the stages. */
+    void reset();
+
+private:
+    mutable std::mutex m_mtx;
+    std::vector<std::shared_ptr<impl::stage_recorder>> m_recorders;
+};
+
+}  // namespace tarp
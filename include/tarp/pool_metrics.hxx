@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/histogram.hxx>
+#include <tarp/sched.hxx>
+
+/*
+ * Execution metrics for thread pools and active objects.
+ *
+ * All durations are recorded in nanoseconds:
+ *  - queue wait: from the time a task is enqueued to the time it starts
+ *    running. A long tail here with short execution times points to
+ *    head-of-line blocking or to an undersized pool.
+ *  - execution time: how long the task ran for.
+ *
+ * The metrics are recorded per worker (so that workers do not contend on
+ * shared counters) and combined when a snapshot is taken.
+ */
+namespace tarp::threading {
+
+/* Point-in-time snapshot of the metrics of a single worker thread. */
+struct worker_metrics {
+    std::uint32_t worker_id {0};
+    std::uint64_t num_tasks {0};
+
+    /* Number of tasks taken from other workers (WorkStealingPool only). */
+    std::uint64_t num_steals {0};
+
+    /* Time spent running tasks vs time since the worker was created. */
+    std::chrono::nanoseconds busy_time {0};
+    std::chrono::nanoseconds uptime {0};
+
+    histogram queue_wait;
+    histogram exec_time;
+
+    /* Fraction of its uptime the worker spent running tasks, in [0, 1]. */
+    double busy_ratio() const {
+        if (uptime.count() <= 0) {
+            return 0;
+        }
+        return std::min(1.0,
+                        static_cast<double>(busy_time.count()) /
+                          static_cast<double>(uptime.count()));
+    }
+};
+
+/* Point-in-time snapshot of the metrics of a pool (or active object). */
+struct pool_metrics {
+    /* Totals across all workers, including workers that have since been
+     * removed from the pool. */
+    histogram queue_wait;
+    histogram exec_time;
+    std::uint64_t num_tasks_handled {0};
+
+    std::size_t queue_length {0};
+
+    /* Highest queue length seen since the pool was created. */
+    std::size_t queue_length_hwm {0};
+
+    /* Current workers only. */
+    std::vector<worker_metrics> workers;
+};
+
+namespace impl {
+
+/*
+ * Metrics recorded by a worker as it runs tasks. Only the worker itself
+ * records (single writer), but snapshots can be taken concurrently from
+ * any thread.
+ */
+class worker_recorder {
+public:
+    DISALLOW_COPY_AND_MOVE(worker_recorder);
+
+    explicit worker_recorder(std::uint32_t worker_id);
+
+    /* Execute task, recording how long it waited in the queue (if its
+     * enqueue time was set) and how long it ran for. */
+    void run(tarp::sched::interfaces::task &task);
+
+    /* The two halves of run(), for when the task is executed by someone
+     * else: begin() records how long the task waited in the queue and
+     * returns the start time to pass to end() once the task has run. */
+    std::chrono::steady_clock::time_point
+    begin(const tarp::sched::interfaces::task &task);
+    void end(std::chrono::steady_clock::time_point start);
+
+    void record_steal();
+
+    worker_metrics snapshot() const;
+
+    /* Merge the queue wait times recorded since the previous call into
+     * into. This is used to evaluate the recent latency (e.g. for
+     * autoscaling) as opposed to the latency since the worker was created.
+     * NOTE: approximate; a task completing concurrently may be missed. */
+    void drain_queue_wait_window(histogram &into);
+
+private:
+    const std::uint32_t m_worker_id;
+    const std::chrono::steady_clock::time_point m_start;
+    std::atomic<std::uint64_t> m_num_tasks {0};
+    std::atomic<std::uint64_t> m_num_steals {0};
+    std::atomic<std::uint64_t> m_busy_ns {0};
+    histogram m_queue_wait;
+    histogram m_exec_time;
+    histogram m_window_queue_wait;
+};
+
+/* Queue length high-watermark. */
+class watermark {
+public:
+    void update(std::size_t v) {
+        auto prev = m_max.load(std::memory_order_relaxed);
+        while (v > prev && !m_max.compare_exchange_weak(
+                             prev, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::size_t get() const { return m_max.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::size_t> m_max {0};
+};
+
+/* Merge the histograms of w into the pool-wide totals in m. */
+void accumulate(pool_metrics &m, const worker_metrics &w);
+
+}  // namespace impl
+
+}  // namespace tarp::threading
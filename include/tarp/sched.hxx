@@ -1,14 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <deque>
 #include <future>
-#include <list>
 #include <map>
 #include <memory>
 #include <optional>
+#include <stdexcept>
 #include <type_traits>
+#include <vector>
 
 #include <tarp/cancellation_token.hxx>
 #include <tarp/common.h>
@@ -53,13 +55,24 @@ public:
      * hierarchy and must be unique within that hierarchy.  */
     explicit Scheduler(uint32_t id) : m_id(id) {}
 
-    virtual ~Scheduler() = default;
+    /* Detach from the parent and children, if any. */
+    virtual ~Scheduler();
 
+    /* Enqueue item. If filters are attached, item is passed on to the child
+     * indicated by the first filter that matches it, if any. */
     void enqueue(std::unique_ptr<queue_item_t> item) {
         if (!item) {
             throw std::invalid_argument(
               "Illegal attempt to enqueue unacceptable NULL value");
         }
+
+        for (auto &[filter_id, filter] : m_filters) {
+            if (filter.first->matches(*item)) {
+                m_children.at(filter.second)->enqueue(std::move(item));
+                return;
+            }
+        }
+
         do_enqueue(std::move(item));
     }
 
@@ -76,13 +89,48 @@ public:
     /* Discard all enqueued items. */
     virtual void clear() = 0;
 
+    /* Return the time at which the next item becomes dequeueable, for
+     * schedulers that hold items back until some point in time (see
+     * SchedulerDeadline). Clients can use this to sleep exactly until then
+     * rather than polling dequeue(). std::nullopt if the queue is empty or
+     * if the scheduler never holds items back. */
+    virtual std::optional<std::chrono::steady_clock::time_point>
+    get_first_deadline() const {
+        return std::nullopt;
+    }
+
     bool empty() const { return get_queue_length() == 0; }
 
     uint32_t get_id() const { return m_id; }
 
+    /*
+     * Make this scheduler a child of parent, which must be a classful
+     * scheduler (see ClassfulScheduler). The parent does not take
+     * ownership: a scheduler detaches itself from its parent and children
+     * when destroyed, but must otherwise outlive its use by the parent.
+     *
+     * Return false if parent_id does not match the id of parent, if this
+     * scheduler already has a parent, if the parent is not classful or
+     * already has a child with the same id, or if the attachment would
+     * create a cycle.
+     *
+     * NOTE: once attached, a child should only be accessed through the
+     * root of the hierarchy: schedulers are not thread-safe and users such
+     * as the ThreadPool only synchronize access to the root. */
     bool attach_parent(uint32_t parent_id, Scheduler<queue_item_t> &parent);
+
+    /* Return false if parent_id is not the id of the current parent. */
     bool detach_parent(uint32_t parent_id);
 
+    /*
+     * Attach a filter: items enqueued into this scheduler that match the
+     * filter are passed on to the child with the given id. Filters are
+     * tried in order of their ids (lowest first) and the first match wins.
+     * Items that match no filter are enqueued into this scheduler itself.
+     * Filters pointing to a child are removed when the child is detached.
+     *
+     * Throw std::invalid_argument if filter is NULL, if filter_id is already
+     * in use, or if there is no child with the given id. */
     using filter_type = sched::filters::Filter<queue_item_t>;
     void attach_filter(uint32_t filter_id,
                        std::shared_ptr<filter_type> filter,
@@ -90,13 +138,29 @@ public:
 
     void detach_filter(uint32_t filter_id);
 
+protected:
+    /* True if this scheduler distributes items to children (classes)
+     * rather than queueing them itself. Only classful schedulers can be
+     * parents. */
+    virtual bool classful() const { return false; }
+
+    /* Called after a child has been attached or before it is detached. */
+    virtual void on_child_attached(Scheduler<queue_item_t> &) {}
+
+    virtual void on_child_detached(Scheduler<queue_item_t> &) {}
+
+    const std::map<std::uint32_t, Scheduler<queue_item_t> *> &
+    get_children() const {
+        return m_children;
+    }
+
 private:
     uint32_t m_id;
 
     void attach_child(uint32_t child_id, Scheduler<queue_item_t> &child);
     void detach_child(uint32_t child_id);
 
-    std::shared_ptr<Scheduler> m_parent;
+    Scheduler<queue_item_t> *m_parent {nullptr};
     std::map<std::uint32_t, Scheduler<queue_item_t> *> m_children;
 
     // filter_id, <filter, destination_child_id
@@ -104,6 +168,101 @@ private:
       m_filters;
 };
 
+template<typename queue_item_t>
+Scheduler<queue_item_t>::~Scheduler() {
+    if (m_parent) {
+        m_parent->detach_child(m_id);
+    }
+
+    for (auto &[child_id, child] : m_children) {
+        child->m_parent = nullptr;
+    }
+}
+
+template<typename queue_item_t>
+bool Scheduler<queue_item_t>::attach_parent(uint32_t parent_id,
+                                            Scheduler<queue_item_t> &parent) {
+    if (m_parent || parent_id != parent.get_id() || !parent.classful()) {
+        return false;
+    }
+
+    if (parent.m_children.count(m_id) > 0) {
+        return false;
+    }
+
+    for (auto *p = &parent; p != nullptr; p = p->m_parent) {
+        if (p == this) {
+            return false;
+        }
+    }
+
+    parent.attach_child(m_id, *this);
+    m_parent = &parent;
+    return true;
+}
+
+template<typename queue_item_t>
+bool Scheduler<queue_item_t>::detach_parent(uint32_t parent_id) {
+    if (!m_parent || m_parent->get_id() != parent_id) {
+        return false;
+    }
+
+    m_parent->detach_child(m_id);
+    m_parent = nullptr;
+    return true;
+}
+
+template<typename queue_item_t>
+void Scheduler<queue_item_t>::attach_child(uint32_t child_id,
+                                           Scheduler<queue_item_t> &child) {
+    m_children[child_id] = &child;
+    on_child_attached(child);
+}
+
+template<typename queue_item_t>
+void Scheduler<queue_item_t>::detach_child(uint32_t child_id) {
+    auto found = m_children.find(child_id);
+    if (found == m_children.end()) {
+        return;
+    }
+
+    for (auto it = m_filters.begin(); it != m_filters.end();) {
+        if (it->second.second == child_id) {
+            it = m_filters.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    on_child_detached(*found->second);
+    m_children.erase(found);
+}
+
+template<typename queue_item_t>
+void Scheduler<queue_item_t>::attach_filter(uint32_t filter_id,
+                                            std::shared_ptr<filter_type> filter,
+                                            uint32_t destination_child_id) {
+    if (!filter) {
+        throw std::invalid_argument("Cannot attach NULL filter");
+    }
+
+    if (m_filters.count(filter_id) > 0) {
+        throw std::invalid_argument("Filter id already in use");
+    }
+
+    if (m_children.count(destination_child_id) == 0) {
+        throw std::invalid_argument("No child with the given id");
+    }
+
+    m_filters.emplace(filter_id,
+                      std::make_pair(std::move(filter), destination_child_id));
+}
+
+template<typename queue_item_t>
+void Scheduler<queue_item_t>::detach_filter(uint32_t filter_id) {
+    m_filters.erase(filter_id);
+}
+
 //
 
 #if __cplusplus >= 202002L
@@ -119,7 +278,7 @@ concept deadline_qitif = requires(const T &t) {
 
     {
         t.get_expiration_time()
-    } -> std::same_as<std::chrono::system_clock::time_point>;
+    } -> std::same_as<std::chrono::steady_clock::time_point>;
 };
 
 #else
@@ -136,7 +295,7 @@ struct deadline_qitif {
     // clang-format off
     template <typename C,
         VALIDATE(&C::expired, bool (C::*)() const),
-        VALIDATE(&C::get_expiration_time, std::chrono::system_clock::time_point (C::*)() const)
+        VALIDATE(&C::get_expiration_time, std::chrono::steady_clock::time_point (C::*)() const)
              >
     struct constraints;
     // clang-format on
@@ -151,7 +310,7 @@ class SchedulerFifo final : public Scheduler<queue_item_t> {
 #else
 template<typename queue_item_t>
 class SchedulerFifo final : public Scheduler<queue_item_t> {
-    REQUIRE(queue_item_t, fifo_qitif);
+    TARP_REQUIRE(queue_item_t, fifo_qitif);
 #endif
 public:
     explicit SchedulerFifo(uint32_t id = 0) : Scheduler<queue_item_t>(id) {}
@@ -179,13 +338,21 @@ private:
 };
 
 /*
- * A deadline scheduler. It sorts its queued items in order of expiration time
- * and imposes a FIFO ordering on them: that is, the item expiring first gets
- * dequed first. The sort is stable: items with an equal expiration time
- * maintain their relative order.
+ * A deadline scheduler. Items are dequeued in order of expiration time:
+ * the item expiring first gets dequeued first. Items with an equal
+ * expiration time are dequeued in the order they were enqueued in (FIFO).
+ *
+ * The items are kept in a 4-ary min-heap, so enqueue and dequeue are both
+ * O(log n). (A 4-ary heap is shallower than a binary heap and the children
+ * of a node are adjacent in memory, which makes it faster in practice).
+ * The expiration time of each item is read once, on enqueue, and cached
+ * in the heap.
+ * NOTE: therefore an item's expiration time must not be changed (e.g. via
+ * delay()) while it is enqueued; dequeue it and enqueue it again instead.
  *
  * NOTE: an item may only be dequed when its expiration time arrives; up until
- * that point it is buffered in the queue.
+ * that point it is buffered in the queue and dequeue() returns nullptr.
+ * Use get_first_deadline() to find out how long to wait for.
  */
 #if __cplusplus >= 202002L
 template<deadline_qitif queue_item_t>
@@ -193,31 +360,44 @@ class SchedulerDeadline final : public Scheduler<queue_item_t> {
 #else
 template<typename queue_item_t>
 class SchedulerDeadline final : public Scheduler<queue_item_t> {
-    REQUIRE(queue_item_t, deadline_qitif);
+    TARP_REQUIRE(queue_item_t, deadline_qitif);
 #endif
 public:
+    using time_point = std::chrono::steady_clock::time_point;
+
     SchedulerDeadline(uint32_t id = 0) : Scheduler<queue_item_t>(id) {};
 
     virtual std::size_t get_queue_length() const override { return m_q.size(); }
 
     virtual void clear() override { m_q.clear(); }
 
-    std::optional<std::chrono::system_clock::time_point>
-    get_first_deadline() const {
+    virtual std::optional<time_point> get_first_deadline() const override {
         if (m_q.empty()) {
             return std::nullopt;
         }
-        return m_q.front()->get_expiration_time();
+        return m_q.front().deadline;
     }
 
 private:
-    virtual void do_enqueue(std::unique_ptr<queue_item_t> item) override {
-        m_q.emplace_back(std::move(item));
+    struct entry {
+        time_point deadline;
+        std::uint64_t seq;
+        std::unique_ptr<queue_item_t> item;
+
+        bool operator<(const entry &other) const {
+            if (deadline != other.deadline) {
+                return deadline < other.deadline;
+            }
+            return seq < other.seq;
+        }
+    };
 
-        using param_type = const std::unique_ptr<queue_item_t> &;
-        m_q.sort([](param_type a, param_type b) {
-            return a->get_expiration_time() < b->get_expiration_time();
-        });
+    static constexpr std::size_t ARITY = 4;
+
+    virtual void do_enqueue(std::unique_ptr<queue_item_t> item) override {
+        auto deadline = item->get_expiration_time();
+        m_q.push_back(entry {deadline, m_next_seq++, std::move(item)});
+        sift_up(m_q.size() - 1);
     }
 
     virtual std::unique_ptr<queue_item_t> do_dequeue() override {
@@ -226,18 +406,314 @@ private:
         }
 
         /* Buffer items until they are actually expired. */
-        if (!m_q.front()->expired()) {
+        if (m_q.front().deadline > time_now()) {
             return nullptr;
         }
 
-        auto front = std::move(m_q.front());
-        m_q.pop_front();
-        return std::move(front);
+        auto front = std::move(m_q.front().item);
+        m_q.front() = std::move(m_q.back());
+        m_q.pop_back();
+        if (!m_q.empty()) {
+            sift_down(0);
+        }
+        return front;
     }
 
-    inline auto time_now() const { return std::chrono::system_clock::now(); }
+    void sift_up(std::size_t i) {
+        entry e = std::move(m_q[i]);
+        while (i > 0) {
+            auto parent = (i - 1) / ARITY;
+            if (!(e < m_q[parent])) {
+                break;
+            }
+            m_q[i] = std::move(m_q[parent]);
+            i = parent;
+        }
+        m_q[i] = std::move(e);
+    }
 
-    std::list<std::unique_ptr<queue_item_t>> m_q {};
+    void sift_down(std::size_t i) {
+        auto n = m_q.size();
+        entry e = std::move(m_q[i]);
+
+        for (;;) {
+            auto first = i * ARITY + 1;
+            if (first >= n) {
+                break;
+            }
+
+            // smallest child.
+            auto last = std::min(first + ARITY, n);
+            auto min = first;
+            for (auto c = first + 1; c < last; ++c) {
+                if (m_q[c] < m_q[min]) {
+                    min = c;
+                }
+            }
+
+            if (!(m_q[min] < e)) {
+                break;
+            }
+            m_q[i] = std::move(m_q[min]);
+            i = min;
+        }
+
+        m_q[i] = std::move(e);
+    }
+
+    inline auto time_now() const { return std::chrono::steady_clock::now(); }
+
+    std::vector<entry> m_q;
+    std::uint64_t m_next_seq {0};
+};
+
+//
+
+/*
+ * Base class for classful schedulers. A classful scheduler does not queue
+ * items itself. Instead, items are classified via filters (see
+ * Scheduler::attach_filter) and passed on to child schedulers (classes).
+ * The classful scheduler then decides which child to dequeue from next.
+ * Since the children can themselves be of any type, including classful,
+ * arbitrary hierarchies can be built, e.g. a priority scheduler at the root
+ * giving latency-sensitive tasks precedence over a weighted fair queueing
+ * scheduler that shares the remaining capacity among bulk work.
+ *
+ * Items that match no filter go to the default child, if set; else
+ * enqueue() throws std::logic_error.
+ */
+template<typename queue_item_t>
+class ClassfulScheduler : public Scheduler<queue_item_t> {
+public:
+    explicit ClassfulScheduler(uint32_t id) : Scheduler<queue_item_t>(id) {}
+
+    virtual std::size_t get_queue_length() const override {
+        std::size_t n = 0;
+        for (const auto &[id, child] : this->get_children()) {
+            n += child->get_queue_length();
+        }
+        return n;
+    }
+
+    virtual void clear() override {
+        for (auto &[id, child] : this->get_children()) {
+            child->clear();
+        }
+    }
+
+    virtual std::optional<std::chrono::steady_clock::time_point>
+    get_first_deadline() const override {
+        std::optional<std::chrono::steady_clock::time_point> first;
+        for (const auto &[id, child] : this->get_children()) {
+            auto deadline = child->get_first_deadline();
+            if (deadline && (!first || *deadline < *first)) {
+                first = deadline;
+            }
+        }
+        return first;
+    }
+
+    /* Set the child that gets the items that match no filter.
+     * Throw std::invalid_argument if there is no child with this id. */
+    void set_default_child(uint32_t child_id) {
+        if (this->get_children().count(child_id) == 0) {
+            throw std::invalid_argument("No child with the given id");
+        }
+        m_default_child = child_id;
+    }
+
+protected:
+    virtual bool classful() const override { return true; }
+
+private:
+    virtual void do_enqueue(std::unique_ptr<queue_item_t> item) override {
+        const auto &children = this->get_children();
+        auto found = m_default_child ? children.find(*m_default_child)
+                                     : children.end();
+        if (found == children.end()) {
+            throw std::logic_error(
+              "Item matches no filter and there is no default child");
+        }
+        found->second->enqueue(std::move(item));
+    }
+
+    std::optional<uint32_t> m_default_child;
+};
+
+/*
+ * Strict priority scheduler. Dequeues from the highest-priority child that
+ * has an item available; lower-priority children are only dequeued from
+ * when all higher-priority ones are empty (or holding their items back).
+ * NOTE: therefore a steady stream of high-priority items starves
+ * lower-priority ones; use SchedulerDrr to share capacity instead.
+ *
+ * Children have priority 0 when attached; higher values mean higher
+ * priority (max-heap semantics, as with qdisc::PRIO). Children with equal
+ * priority are tried in the order they were attached in.
+ */
+template<typename queue_item_t>
+class SchedulerPrio final : public ClassfulScheduler<queue_item_t> {
+public:
+    explicit SchedulerPrio(uint32_t id = 0)
+        : ClassfulScheduler<queue_item_t>(id) {}
+
+    /* Throw std::invalid_argument if there is no child with this id. */
+    void set_priority(uint32_t child_id, int priority) {
+        auto it = std::find_if(m_bands.begin(), m_bands.end(), [&](auto &b) {
+            return b.child->get_id() == child_id;
+        });
+        if (it == m_bands.end()) {
+            throw std::invalid_argument("No child with the given id");
+        }
+
+        it->priority = priority;
+        std::stable_sort(m_bands.begin(),
+                         m_bands.end(),
+                         [](const auto &a, const auto &b) {
+                             return a.priority > b.priority;
+                         });
+    }
+
+private:
+    struct band {
+        Scheduler<queue_item_t> *child;
+        int priority;
+    };
+
+    virtual std::unique_ptr<queue_item_t> do_dequeue() override {
+        for (auto &b : m_bands) {
+            if (auto item = b.child->dequeue()) {
+                return item;
+            }
+        }
+        return nullptr;
+    }
+
+    virtual void on_child_attached(Scheduler<queue_item_t> &child) override {
+        // after any other children with priority 0.
+        auto it = std::find_if(m_bands.begin(), m_bands.end(), [](auto &b) {
+            return b.priority < 0;
+        });
+        m_bands.insert(it, band {&child, 0});
+    }
+
+    virtual void on_child_detached(Scheduler<queue_item_t> &child) override {
+        m_bands.erase(std::remove_if(m_bands.begin(),
+                                     m_bands.end(),
+                                     [&](auto &b) { return b.child == &child; }),
+                      m_bands.end());
+    }
+
+    // sorted by priority, highest first.
+    std::vector<band> m_bands;
+};
+
+/*
+ * Weighted fair queueing scheduler implemented using Deficit Round Robin
+ * (see "Efficient Fair Queueing using Deficit Round Robin", Shreedhar,
+ * Varghese). The children are visited in round-robin order and in each
+ * round a child may dequeue up to its weight (quantum) in items before the
+ * next child gets a turn. Therefore, when all children are backlogged, each
+ * gets a share of the dequeues proportional to its weight; children with
+ * nothing to dequeue are skipped and their share goes to the others.
+ *
+ * NOTE: every item costs 1 (there is no notion of item size, since tasks
+ * do not declare their cost upfront), in which case DRR amounts to
+ * weighted round robin. An idle child does not accumulate credit.
+ *
+ * Children have weight 1 when attached.
+ */
+template<typename queue_item_t>
+class SchedulerDrr final : public ClassfulScheduler<queue_item_t> {
+public:
+    explicit SchedulerDrr(uint32_t id = 0)
+        : ClassfulScheduler<queue_item_t>(id) {}
+
+    /* Throw std::invalid_argument if weight is 0 or if there is no child
+     * with this id. */
+    void set_weight(uint32_t child_id, uint32_t weight) {
+        if (weight == 0) {
+            throw std::invalid_argument("Weight must be > 0");
+        }
+
+        for (auto &c : m_classes) {
+            if (c.child->get_id() == child_id) {
+                c.weight = weight;
+                return;
+            }
+        }
+        throw std::invalid_argument("No child with the given id");
+    }
+
+private:
+    struct cls {
+        Scheduler<queue_item_t> *child;
+        uint32_t weight;
+        uint32_t deficit;
+    };
+
+    virtual std::unique_ptr<queue_item_t> do_dequeue() override {
+        if (m_classes.empty()) {
+            return nullptr;
+        }
+
+        // Visiting the current child twice (at the start and the end of the
+        // loop) ensures a child whose quantum ran out is tried again if all
+        // the others have nothing to dequeue.
+        for (std::size_t i = 0; i <= m_classes.size(); ++i) {
+            auto &c = m_classes[m_current];
+            if (!m_turn_started) {
+                c.deficit += c.weight;
+                m_turn_started = true;
+            }
+
+            if (c.deficit > 0) {
+                if (auto item = c.child->dequeue()) {
+                    --c.deficit;
+                    return item;
+                }
+            }
+
+            c.deficit = 0;
+            next();
+        }
+        return nullptr;
+    }
+
+    void next() {
+        m_current = (m_current + 1) % m_classes.size();
+        m_turn_started = false;
+    }
+
+    virtual void on_child_attached(Scheduler<queue_item_t> &child) override {
+        m_classes.push_back(cls {&child, 1, 0});
+    }
+
+    virtual void on_child_detached(Scheduler<queue_item_t> &child) override {
+        auto it = std::find_if(m_classes.begin(),
+                               m_classes.end(),
+                               [&](auto &c) { return c.child == &child; });
+        if (it == m_classes.end()) {
+            return;
+        }
+
+        auto idx = static_cast<std::size_t>(it - m_classes.begin());
+        m_classes.erase(it);
+
+        if (idx < m_current) {
+            --m_current;
+        } else if (idx == m_current) {
+            m_turn_started = false;
+        }
+
+        if (m_current >= m_classes.size()) {
+            m_current = 0;
+        }
+    }
+
+    std::vector<cls> m_classes;
+    std::size_t m_current {0};
+    bool m_turn_started {false};
 };
 
 //
@@ -254,6 +730,19 @@ public:
     virtual ~task() = default;
     virtual void execute(void) = 0;
     virtual std::string get_name() const = 0;
+
+    /* Set by executors (e.g. ThreadPool) when the task is enqueued, in
+     * order to measure how long it waits in the queue. */
+    void set_enqueue_time(std::chrono::steady_clock::time_point tp) {
+        m_enqueue_time = tp;
+    }
+
+    std::chrono::steady_clock::time_point get_enqueue_time() const {
+        return m_enqueue_time;
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_enqueue_time {};
 };
 
 /*
@@ -286,7 +775,7 @@ public:
     /* True if we are at or past the deadline, else False */
     virtual bool expired() const = 0;
 
-    virtual std::chrono::system_clock::time_point
+    virtual std::chrono::steady_clock::time_point
     get_expiration_time() const = 0;
 
     /* Postpone the expiration time by the specified delay value */
@@ -362,7 +851,7 @@ template<typename result_type, typename callable_type>
 task<result_type, callable_type>::task(callable_type func,
                                        const std::string &name,
                                        std::optional<cancellation_token> token)
-    : m_f(std::move(func)), m_name(name) {
+    : m_name(name), m_f(std::move(func)) {
     if (token.has_value()) {
         m_cancellation_token =
           std::make_unique<cancellation_token>(std::move(*token));
@@ -416,14 +905,14 @@ public:
                                  std::optional<cancellation_token> token = {});
 
     bool expired() const override;
-    std::chrono::system_clock::time_point get_expiration_time() const override;
+    std::chrono::steady_clock::time_point get_expiration_time() const override;
     void delay(std::chrono::microseconds delay) override;
     bool renewable() const override;
     void renew() override;
 
 protected:
-    void set_expiration(std::chrono::system_clock::time_point deadline);
-    std::chrono::system_clock::time_point time_now() const;
+    void set_expiration(std::chrono::steady_clock::time_point deadline);
+    std::chrono::steady_clock::time_point time_now() const;
     std::chrono::milliseconds get_interval() const;
     bool starts_expired() const;
 
@@ -438,7 +927,7 @@ protected:
 
 private:
     std::unique_ptr<cancellation_token> m_cancellation_token;
-    std::chrono::system_clock::time_point m_next_deadline;
+    std::chrono::steady_clock::time_point m_next_deadline;
     std::chrono::milliseconds m_interval;
     std::optional<std::size_t> m_max_num_renewals;
     std::size_t m_num_renewals {0};
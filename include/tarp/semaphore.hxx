@@ -1,9 +1,12 @@
 #pragma once
 
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 
 #include <tarp/cxxcommon.hxx>
+#include <tarp/futex.hxx>
 
 namespace tarp {
 
@@ -11,6 +14,12 @@ namespace tarp {
  * introduced in the c++ stdlib.
  * NOTE: set max_count=1 if you need binary semaphore semantics (or better, use
  * the binary_semaphore alias).
+ *
+ * The counter is a futex word. When uncontended -- i.e. acquire() finds the
+ * counter non-zero and release() finds no waiters -- each operation is a
+ * single atomic read-modify-write, with no system call. Only a thread that
+ * finds the counter at 0 blocks in the kernel, and release() only calls
+ * into the kernel to wake it if there are such blocked threads.
  */
 class semaphore {
 public:
@@ -25,60 +34,67 @@ public:
         , m_max_count(max_count) {}
 
 public:
-    // reset semaphore to 0
+    // reset semaphore to its initial counter value
     void reset() {
-        std::unique_lock l {m_mtx};
-        m_counter = m_initial_counter;
+        m_counter.store(m_initial_counter);
+        if (m_initial_counter > 0 && m_num_waiters.load() > 0) {
+            tarp::futex::wake_all(m_counter);
+        }
     }
 
     // Signal the semaphore and increment the internal counter.
     // NOP if the max value has been reached for the counter.
     void release() {
-        std::unique_lock l {m_mtx};
-
-        /* this has binary semaphore semantics when m_max_count=2 */
-        if (m_counter < m_max_count) {
-            m_counter++;
-            m_condvar.notify_all();
+        auto counter = m_counter.load(std::memory_order_relaxed);
+        do {
+            if (counter >= m_max_count) {
+                return;
+            }
+        } while (!m_counter.compare_exchange_weak(counter, counter + 1));
+
+        // NOTE: seq_cst, paired with the increment of m_num_waiters in
+        // wait(): either the waiter sees the incremented counter (and does
+        // not block) or it is seen here (and woken).
+        if (m_num_waiters.load() > 0) {
+            tarp::futex::wake(m_counter, 1);
         }
     }
 
     // Block until the semaphore is signaled AND the internal counter is
     // non-zero.
     void acquire() {
-        std::unique_lock l(m_mtx);
-
-        while (m_counter == 0) {
-            m_condvar.wait(l);
+        while (!try_acquire()) {
+            wait([](auto &word) { return tarp::futex::wait(word, 0); });
         }
-        --m_counter;
     }
 
     // Try to decrement the internal counter; return immediately.
     // True if successful, False if failed (==> counter is 0)
     bool try_acquire() {
-        std::unique_lock l {m_mtx};
-
-        if (m_counter > 0) {
-            --m_counter;
-            return true;
+        auto counter = m_counter.load(std::memory_order_relaxed);
+        while (counter > 0) {
+            if (m_counter.compare_exchange_weak(counter,
+                                                counter - 1,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed)) {
+                return true;
+            }
         }
         return false;
     }
 
     template<typename timepoint>
     bool try_acquire_until(const timepoint &abs_time) {
-        std::unique_lock l(m_mtx);
-
-        m_condvar.wait_until(l, abs_time, [this] {
-            return m_counter > 0;
-        });
-
-        if (m_counter > 0) {
-            --m_counter;
-            return true;
+        while (!try_acquire()) {
+            if (timepoint::clock::now() >= abs_time) {
+                return false;
+            }
+
+            wait([&abs_time](auto &word) {
+                return tarp::futex::wait_until(word, 0, abs_time);
+            });
         }
-        return false;
+        return true;
     }
 
     template<class Rep, class Period>
@@ -87,9 +103,17 @@ public:
     }
 
 private:
-    std::mutex m_mtx;
-    std::condition_variable m_condvar;
-    std::uint32_t m_counter;
+    // Block (via the given futex wait function) while the counter is 0.
+    // Spurious wakeups are possible.
+    template<typename wait_function>
+    void wait(const wait_function &futex_wait) {
+        m_num_waiters.fetch_add(1);
+        futex_wait(m_counter);
+        m_num_waiters.fetch_sub(1);
+    }
+
+    std::atomic<std::uint32_t> m_counter;
+    std::atomic<std::uint32_t> m_num_waiters {0};
     const std::uint32_t m_initial_counter;
     const std::uint32_t m_max_count;
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdlib>
+#include <type_traits>
 #include <vector>
 
 namespace tarp {
@@ -42,7 +43,7 @@ void chunk_sequence(const sequence<T> &inputs,
 
         size_t num_to_pad = chunksz - num_to_write;
         if (pad_rest && num_to_pad > 0) {
-            for (size_t i = 0; i < num_to_pad; ++i) {
+            for (size_t j = 0; j < num_to_pad; ++j) {
                 arr.push_back(pad_elem);
             }
         }
@@ -69,4 +70,29 @@ std::vector<sequence<T>> chunk_sequence(const sequence<T> &inputs,
     return outputs;
 }
 
+/*
+ * Split the range [first, last) into consecutive subranges of (at most)
+ * chunksz elements and call CB with the bounds [lo, hi) of each one in turn.
+ * Unlike chunk_sequence, nothing is copied: first and last can be
+ * integer indices or random-access iterators.
+ * Return the number of chunks.
+ */
+template<typename I, typename CB>
+size_t chunk_range(I first, I last, size_t chunksz, CB callback) {
+    if (chunksz == 0) {
+        chunksz = 1;
+    }
+
+    size_t num_chunks = 0;
+    while (first < last) {
+        size_t n = static_cast<size_t>(last - first);
+        I hi = n > chunksz ? first + chunksz : last;
+        callback(first, hi);
+        first = hi;
+        ++num_chunks;
+    }
+
+    return num_chunks;
+}
+
 }  // namespace tarp
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/evchan.hxx>
+
+namespace tarp {
+namespace evchan {
+
+namespace impl {
+
+// Layout of the control block at the start of a shared memory segment
+// backing a shm_channel. Everything in here must be position-independent
+// (no pointers) since the segment is generally mapped at different addresses
+// in different processes.
+struct shm_header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t elem_size;
+    std::uint64_t capacity;
+    std::uint32_t circular;
+
+    // Futex-based mutex: 0=unlocked, 1=locked, 2=locked with waiters.
+    std::atomic<std::uint32_t> lock;
+    std::atomic<std::uint32_t> closed;
+
+    // Sequence words that readers and writers block on (futex-wait) when
+    // the ring is empty and full, respectively. These are bumped on every
+    // push and pop, respectively.
+    std::atomic<std::uint32_t> readable_seq;
+    std::atomic<std::uint32_t> writable_seq;
+    std::atomic<std::uint32_t> num_waiting_readers;
+    std::atomic<std::uint32_t> num_waiting_writers;
+
+    // Protected by lock.
+    std::uint64_t head;
+    std::uint64_t count;
+};
+
+// Type-erased ring buffer of fixed-size elements stored in a memfd-backed
+// shared memory segment. Used to implement shm_channel<T>; elements are
+// copied in and out byte-wise, which is why shm_channel requires trivially
+// copyable types.
+//
+// Synchronization is done via process-shared futexes so the ring can be
+// used by any number of readers and writers in any number of processes.
+// NOTE: the lock is not robust. If a process dies while holding it (i.e. in
+// the middle of a push or pop) other users of the segment will deadlock.
+class shm_ring {
+public:
+    DISALLOW_COPY_AND_MOVE(shm_ring);
+    ~shm_ring();
+
+    // Create a new memfd segment large enough to hold capacity elements of
+    // elem_size bytes each. Throw std::runtime_error on failure.
+    static std::unique_ptr<shm_ring>
+    create(std::size_t elem_size, std::size_t capacity, bool circular);
+
+    // Map the segment referred to by fd. Ownership of fd is taken in all
+    // cases (i.e. fd is closed on failure too). Throw std::runtime_error
+    // if fd cannot be mapped or does not refer to a valid segment storing
+    // elements of elem_size bytes.
+    static std::unique_ptr<shm_ring> attach(int fd, std::size_t elem_size);
+
+    int fd() const { return m_fd; }
+    std::size_t capacity() const;
+    bool circular() const;
+
+    // Push the element of elem_size bytes at src. If the ring is full and
+    // circular, the oldest element is copied to evicted (if non-null) before
+    // being overwritten. Return -1 if the push failed (the ring is closed, or
+    // full and not circular), 1 if an element was evicted, and 0 otherwise.
+    int try_push(const void *src, void *evicted);
+
+    // Like try_push, but if the ring is full (and not circular), block until
+    // space is made or the ring is closed. If deadline is non-null, give up
+    // once it has been reached.
+    bool push(const void *src,
+              const std::chrono::steady_clock::time_point *deadline);
+
+    bool try_pop(void *dst);
+
+    // Like try_pop, but if the ring is empty block until an element is
+    // available or the ring is closed. If deadline is non-null, give up once
+    // it has been reached.
+    bool pop(void *dst, const std::chrono::steady_clock::time_point *deadline);
+
+    // Pop all elements, calling cb for each of them in FIFO order. Return the
+    // number of elements popped. NOTE: cb is called with the lock held.
+    template<typename F>
+    std::size_t pop_all(F &&cb);
+
+    void close();
+    bool closed() const;
+    bool empty() const;
+    std::size_t size() const;
+    void clear();
+
+    // Send the file descriptor of the segment over the unix domain socket
+    // uds_fd (via SCM_RIGHTS) so that a peer process can attach to it.
+    // Throw std::runtime_error on failure.
+    void send_fd(int uds_fd) const;
+
+    // Receive a file descriptor sent via send_fd() from a peer.
+    // Throw std::runtime_error on failure.
+    static int receive_fd(int uds_fd);
+
+private:
+    shm_ring(int fd, void *base, std::size_t mapsz);
+
+    void lock();
+    void unlock();
+    std::uint8_t *slot(std::uint64_t idx);
+    void pop_locked(void *dst);
+    void wake_readers(bool all);
+    void wake_writers(bool all);
+
+    int m_fd = -1;
+    void *m_base = nullptr;
+    std::size_t m_mapsz = 0;
+    shm_header *m_hdr = nullptr;
+    std::uint8_t *m_slots = nullptr;
+};
+
+template<typename F>
+std::size_t shm_ring::pop_all(F &&cb) {
+    std::size_t n = 0;
+    lock();
+    while (m_hdr->count > 0) {
+        cb(slot(m_hdr->head));
+        m_hdr->head = (m_hdr->head + 1) % m_hdr->capacity;
+        m_hdr->count--;
+        ++n;
+    }
+    if (n > 0) {
+        m_hdr->writable_seq.fetch_add(1, std::memory_order_release);
+    }
+    unlock();
+
+    if (n > 0) {
+        wake_writers(true);
+    }
+    return n;
+}
+
+}  // namespace impl
+
+//
+
+// Event channel backed by shared memory, for communication between
+// processes.
+//
+// The buffer is stored in an anonymous memory file (see memfd_create(2))
+// that is mmapped by every process using the channel. The creator gets
+// a channel via create(); the file descriptor of the channel can then be
+// inherited by a child process (e.g. via fork) or sent to an unrelated
+// process over a unix domain socket via send() and picked up with receive().
+// The peer attaches to the same buffer via attach() (receive() does this
+// implicitly).
+//
+// The semantics otherwise match those of the (in-process) event_channel:
+// the channel has a fixed capacity and optionally ring-buffer semantics
+// (circular=true), where writes always succeed and overwrite the oldest
+// element when the channel is full. Unlike event_channel, blocking (and
+// timed) push/get are also provided, since monitors cannot be used across
+// processes: a notifier is an object in the address space of one process.
+// For the same reason add_monitor() is not supported.
+//
+// Both reads and writes are safe to do from any number of threads in any
+// number of processes. The payload type must be trivially copyable as it is
+// copied byte-wise into and out of shared memory; it should also not contain
+// pointers, since the processes involved do not share an address space.
+template<typename T>
+class shm_channel final
+    : public interfaces::wchan<shm_channel<T>, T>
+    , public interfaces::rchan<shm_channel<T>, T> {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "shm_channel payload must be trivially copyable");
+    static_assert(std::is_default_constructible_v<T>,
+                  "shm_channel payload must be default constructible");
+
+public:
+    using payload_t = T;
+
+    // Create a new channel with room for capacity elements.
+    static std::shared_ptr<shm_channel>
+    create(std::size_t capacity, bool circular = false) {
+        if (capacity == 0) {
+            throw std::invalid_argument("nonsensical capacity of 0");
+        }
+        return std::shared_ptr<shm_channel>(new shm_channel(
+          impl::shm_ring::create(sizeof(T), capacity, circular)));
+    }
+
+    // Attach to an existing channel given its memfd file descriptor.
+    // Ownership of fd is taken.
+    static std::shared_ptr<shm_channel> attach(int fd) {
+        return std::shared_ptr<shm_channel>(
+          new shm_channel(impl::shm_ring::attach(fd, sizeof(T))));
+    }
+
+    // Receive a channel file descriptor sent by a peer via send() over the
+    // unix domain socket uds_fd, and attach to the channel.
+    static std::shared_ptr<shm_channel> receive(int uds_fd) {
+        return attach(impl::shm_ring::receive_fd(uds_fd));
+    }
+
+    // Send the file descriptor of the channel to a peer over the unix
+    // domain socket uds_fd; see receive().
+    void send(int uds_fd) const { m_ring->send_fd(uds_fd); }
+
+    // File descriptor of the underlying memfd. It remains owned by the
+    // channel.
+    int fd() const { return m_ring->fd(); }
+
+    std::size_t capacity() const { return m_ring->capacity(); }
+    bool closed() const { return m_ring->closed(); }
+    bool empty() const { return m_ring->empty(); }
+    std::size_t size() const { return m_ring->size(); }
+    void clear() { m_ring->clear(); }
+
+    // Close the channel for all processes. Pending elements can still be
+    // read, but pushes fail. Any blocked readers and writers are woken up.
+    void close() { m_ring->close(); }
+
+    // Same semantics as event_channel::try_push: if the push fails, the
+    // first element of the pair is false and the second element is the value
+    // that could not be pushed. If the push succeeds but an element was
+    // evicted (circular channel), the second element is the evicted value.
+    std::pair<bool, std::optional<T>> try_push(const T &data) {
+        T evicted;
+        switch (m_ring->try_push(&data, &evicted)) {
+        case -1: return {false, data};
+        case 1: return {true, evicted};
+        default: return {true, std::nullopt};
+        }
+    }
+
+    // Block until data is pushed or the channel is closed. Return true if
+    // the element was pushed, else false.
+    bool push(const T &data) { return m_ring->push(&data, nullptr); }
+
+    template<typename clock, typename duration>
+    bool
+    try_push_until(const T &data,
+                   const std::chrono::time_point<clock, duration> &deadline) {
+        auto tp = to_steady(deadline);
+        return m_ring->push(&data, &tp);
+    }
+
+    template<typename rep, typename period>
+    bool try_push_for(const T &data,
+                      const std::chrono::duration<rep, period> &timeout) {
+        return try_push_until(data, std::chrono::steady_clock::now() + timeout);
+    }
+
+    std::optional<T> try_get() {
+        T data;
+        if (!m_ring->try_pop(&data)) {
+            return std::nullopt;
+        }
+        return data;
+    }
+
+    // Block until an element is available or the channel is closed (and
+    // empty).
+    std::optional<T> get() {
+        T data;
+        if (!m_ring->pop(&data, nullptr)) {
+            return std::nullopt;
+        }
+        return data;
+    }
+
+    template<typename clock, typename duration>
+    std::optional<T>
+    try_get_until(const std::chrono::time_point<clock, duration> &deadline) {
+        T data;
+        auto tp = to_steady(deadline);
+        if (!m_ring->pop(&data, &tp)) {
+            return std::nullopt;
+        }
+        return data;
+    }
+
+    template<typename rep, typename period>
+    std::optional<T>
+    try_get_for(const std::chrono::duration<rep, period> &timeout) {
+        return try_get_until(std::chrono::steady_clock::now() + timeout);
+    }
+
+    std::deque<T> get_all() {
+        std::deque<T> elements;
+        m_ring->pop_all([&elements](const void *src) {
+            T data;
+            std::memcpy(&data, src, sizeof(T));
+            elements.push_back(data);
+        });
+        return elements;
+    }
+
+    auto operator<<(const T &event) { return try_push(event); }
+
+    auto &operator>>(std::optional<T> &event) {
+        event = try_get();
+        return *this;
+    }
+
+    // Not supported: see class description.
+    std::uint32_t add_monitor(std::shared_ptr<interfaces::notifier>,
+                              std::uint32_t) = delete;
+
+private:
+    explicit shm_channel(std::unique_ptr<impl::shm_ring> ring)
+        : m_ring(std::move(ring)) {}
+
+    template<typename clock, typename duration>
+    static std::chrono::steady_clock::time_point
+    to_steady(const std::chrono::time_point<clock, duration> &tp) {
+        if constexpr (std::is_same_v<clock, std::chrono::steady_clock>) {
+            return std::chrono::time_point_cast<
+              std::chrono::steady_clock::duration>(tp);
+        } else {
+            auto rel = tp - clock::now();
+            return std::chrono::steady_clock::now() +
+                   std::chrono::duration_cast<
+                     std::chrono::steady_clock::duration>(rel);
+        }
+    }
+
+    std::unique_ptr<impl::shm_ring> m_ring;
+};
+
+}  // namespace evchan
+}  // namespace tarp
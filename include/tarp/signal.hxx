@@ -4,11 +4,14 @@
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <shared_mutex>
 #include <stdexcept>
+#include <tuple>
 #include <type_traits>
 #include <vector>
 
 #include <tarp/cxxcommon.hxx>
+#include <tarp/executor.hxx>
 #include <tarp/functools.hxx>
 #include <tarp/type_traits.hxx>
 
@@ -50,8 +53,63 @@ template<typename ts_policy>
 struct signal_token {
     bool valid {true};
 
-    using mutex_t = typename tarp::type_traits::ts_types<ts_policy>::mutex_t;
+    /* Held shared by the signal provider while invoking the callback (see
+     * emission_lock) and exclusively by the signal consumer when
+     * invalidating the token, so that concurrent emissions do not
+     * serialize on it. */
+    using mutex_t =
+      typename tarp::type_traits::ts_types<ts_policy,
+                                           std::shared_mutex>::mutex_t;
+    using unique_lock_t = typename tarp::type_traits::
+      ts_types<ts_policy, std::shared_mutex, std::unique_lock>::lock_t;
     mutex_t mtx;
+
+    /* Holds mtx shared for the lifetime of the object -- unless the
+     * calling thread already holds it further up the stack, e.g. when a
+     * handler emits the signal that invoked it. Taking a shared_mutex
+     * shared twice in the same thread is undefined behavior, and in
+     * practice deadlocks if a disconnect() is waiting for the mutex in
+     * between. Not re-taking it is safe: the token cannot be invalidated
+     * while the outer lock is held. */
+    class emission_lock {
+    public:
+        DISALLOW_COPY_AND_MOVE(emission_lock);
+
+        explicit emission_lock(signal_token &token) : m_token(token) {
+            if constexpr (thread_safe) {
+                for (auto *l = t_held; l; l = l->m_prev) {
+                    if (&l->m_token == &token) {
+                        return;
+                    }
+                }
+
+                m_token.mtx.lock_shared();
+                m_owned = true;
+                m_prev = t_held;
+                t_held = this;
+            }
+        }
+
+        ~emission_lock() {
+            if constexpr (thread_safe) {
+                if (m_owned) {
+                    t_held = m_prev;
+                    m_token.mtx.unlock_shared();
+                }
+            }
+        }
+
+    private:
+        static constexpr bool thread_safe =
+          std::is_same_v<ts_policy, tarp::type_traits::thread_safe>;
+
+        /* the token locks held by this thread, innermost first. */
+        static inline thread_local emission_lock *t_held = nullptr;
+
+        signal_token &m_token;
+        emission_lock *m_prev {nullptr};
+        bool m_owned {false};
+    };
 };
 
 /*
@@ -233,6 +291,26 @@ public:
      * consumer does in fact outlive the signal provider. */
     void connect_detached(std::function<R(vargs...)> callback);
 
+    /*
+     * Connect the given callback such that it is invoked on the target
+     * executor (e.g. an evp_executor or a strand) rather than in the
+     * thread that emits the signal. On each emission the arguments are
+     * copied (decayed: references are not preserved) and a job delivering
+     * them is posted to the target, so the emitter never waits on the
+     * callback. To have several emissions cost the target a single wakeup,
+     * use a batching_executor as the target.
+     *
+     * Disconnection works as for connect(). Deliveries still queued when
+     * the connection is disconnected are dropped, and once disconnect()
+     * returns the callback is not running and will not be invoked.
+     * Consequently the callback must not disconnect itself (deadlock).
+     *
+     * NOTE: only signals returning void support queued connections.
+     * NOTE: the target executor must outlive the connection. */
+    std::unique_ptr<signal_connection>
+    connect_queued(tarp::exec::interfaces::executor &target,
+                   std::function<void(vargs...)> callback);
+
     /* True if the count of callbacks connected to the signal is 0 */
     bool empty(void);
 
@@ -260,20 +338,49 @@ private:
         std::shared_ptr<signal_token_t> check(void) const;
 
         std::function<R(vargs...)> notify;
-        bool m_detached;
+        std::shared_ptr<signal_token_t> m_detached;
         std::weak_ptr<signal_token_t> m_link;
     };
 
+    /*
+     * The observers are kept in an immutable array that is replaced
+     * wholesale (copy-on-write) whenever an observer is added or removed.
+     * emit() only takes a reference to the current array, so it holds no
+     * signal-wide lock while invoking the callbacks: connections do not
+     * block emissions, and emissions only contend with each other for as
+     * long as it takes to copy the shared_ptr (under m_snapshot_mtx).
+     * NOTE: emission is therefore not lock-free. std::atomic_load on a
+     * shared_ptr would not be either: libstdc++ implements it with a
+     * process-wide pool of mutexes, which unrelated signals would share.
+     * m_mtx serializes the writers.
+     */
+    using observer_list = std::vector<std::shared_ptr<const observer>>;
+
+    std::shared_ptr<const observer_list> load_observers() const;
+    void store_observers(std::shared_ptr<const observer_list> observers);
+
+    /* Publish a copy of the array without the observers that have
+     * disconnected. */
+    void collect_garbage();
+
     std::unique_ptr<signal_connection>
-    register_observer(std::function<R(vargs...)> callback, bool detached);
+    register_observer(std::shared_ptr<signal_token_t> token,
+                      std::function<R(vargs...)> callback,
+                      bool detached);
 
-    std::vector<observer> m_observers;
+    std::shared_ptr<const observer_list> m_observers;
+    mutable mutex_t m_snapshot_mtx;
     mutex_t m_mtx;
 };
 
 /*
- * WARNING: connection to/disconnection from a signal is not allowed
- * from within a signal handler. Doing so will produce a deadlock.
+ * NOTE: a signal handler may connect new handlers to the signal (these are
+ * first invoked on the next emission) and disconnect *other* handlers. It
+ * may also emit the signal again: a thread does not take a token lock it
+ * already holds (see signal_token::emission_lock).
+ * WARNING: a signal handler must not disconnect *itself*, nor any handler
+ * that is running further up the same thread's stack: doing so will
+ * produce a deadlock.
  */
 template<SIGNAL_TEMPLATE_SPEC>
 signal_output signal<SIGNAL_TEMPLATE_INSTANCE>::emit(vargs... params) {
@@ -291,42 +398,99 @@ signal_output signal<SIGNAL_TEMPLATE_INSTANCE>::emit(vargs... params) {
                                 reducer<signal_output, R>>::type;
     reducer_type r;
 
-    lock_t lock{m_mtx};
+    auto observers = load_observers();
+    if (!observers) {
+        return r.get();
+    }
+
+    bool have_garbage = false;
 
-    for (auto it = m_observers.begin(); it != m_observers.end();) {
-        auto token = it->check();
+    for (const auto &obs : *observers) {
+        auto token = obs->check();
 
-        /* on every signal emission, weed out broken links
-         * to observers that are no longer alive */
+        /* broken link to an observer that is no longer alive */
         if (!token) {
-            it = m_observers.erase(it);
+            have_garbage = true;
             continue;
         }
 
         /* NOTE: CRITICAL SECTION.
          * The validity check and callback invocation must be mutex-protected.
          * see signal_connection comments. */
-        lock_t l(token->mtx);
-        if (!token->valid) continue;
+        typename signal_token_t::emission_lock l(*token);
+        if (!token->valid) {
+            have_garbage = true;
+            continue;
+        }
 
         // we use std::forward here to _cast_ the arguments passed to emit()
         // to the parameter types specified in the signal signature.
         if constexpr((std::is_void_v<R>)){
-            std::invoke(it->notify, std::forward<vargs>(params)...);
+            std::invoke(obs->notify, std::forward<vargs>(params)...);
         }
         else {
-            r.process(std::invoke(it->notify, std::forward<vargs>(params)...));
+            r.process(std::invoke(obs->notify, std::forward<vargs>(params)...));
         }
-        ++it;
+    }
+
+    /* weed out the observers found to be dead. NOTE: this is only done
+     * after all the token locks have been released. */
+    if (have_garbage) {
+        collect_garbage();
     }
 
     return r.get();
 }
 
 template<SIGNAL_TEMPLATE_SPEC>
-std::size_t signal<SIGNAL_TEMPLATE_INSTANCE>::count() {
+std::shared_ptr<const typename signal<SIGNAL_TEMPLATE_INSTANCE>::observer_list>
+signal<SIGNAL_TEMPLATE_INSTANCE>::load_observers() const {
+    lock_t l{m_snapshot_mtx};
+    return m_observers;
+}
+
+template<SIGNAL_TEMPLATE_SPEC>
+void signal<SIGNAL_TEMPLATE_INSTANCE>::store_observers(
+  std::shared_ptr<const observer_list> observers) {
+    {
+        lock_t l{m_snapshot_mtx};
+        std::swap(m_observers, observers);
+    }
+
+    // NOTE: the old array (if no emission still holds it) is freed here,
+    // outside the lock.
+}
+
+template<SIGNAL_TEMPLATE_SPEC>
+void signal<SIGNAL_TEMPLATE_INSTANCE>::collect_garbage() {
     lock_t l{m_mtx};
-    return m_observers.size();
+
+    auto current = load_observers();
+    if (!current) {
+        return;
+    }
+
+    auto observers = std::make_shared<observer_list>();
+    observers->reserve(current->size());
+    for (const auto &obs : *current) {
+        auto token = obs->check();
+        if (!token) {
+            continue;
+        }
+
+        typename signal_token_t::emission_lock tl(*token);
+        if (token->valid) {
+            observers->push_back(obs);
+        }
+    }
+
+    store_observers(std::move(observers));
+}
+
+template<SIGNAL_TEMPLATE_SPEC>
+std::size_t signal<SIGNAL_TEMPLATE_INSTANCE>::count() {
+    auto observers = load_observers();
+    return observers ? observers->size() : 0;
 }
 
 template<SIGNAL_TEMPLATE_SPEC>
@@ -338,13 +502,15 @@ template<SIGNAL_TEMPLATE_SPEC>
 std::unique_ptr<signal_connection>
 signal<SIGNAL_TEMPLATE_INSTANCE>::connect(
   std::function<R(vargs...)> callback) {
-    return register_observer(callback, false);
+    return register_observer(
+      std::make_shared<signal_token_t>(), std::move(callback), false);
 }
 
 template<SIGNAL_TEMPLATE_SPEC>
 void signal<SIGNAL_TEMPLATE_INSTANCE>::connect_detached(
   std::function<R(vargs...)> callback) {
-    auto conn = register_observer(callback, true);
+    auto conn = register_observer(
+      std::make_shared<signal_token_t>(), std::move(callback), true);
 
     // when connecting in detached mode, 'disconnect()' does nothing.
     // However, the connection object requires us to invoke this method
@@ -355,13 +521,65 @@ void signal<SIGNAL_TEMPLATE_INSTANCE>::connect_detached(
 
 template<SIGNAL_TEMPLATE_SPEC>
 std::unique_ptr<signal_connection>
-signal<SIGNAL_TEMPLATE_INSTANCE>::register_observer(observer_callback_t f,
-                                                          bool detached) {
+signal<SIGNAL_TEMPLATE_INSTANCE>::connect_queued(
+  tarp::exec::interfaces::executor &target,
+  std::function<void(vargs...)> callback) {
+    static_assert(std::is_void_v<R>,
+                  "queued connections are only supported for signals "
+                  "returning void");
+    static_assert(
+      (std::is_copy_constructible_v<std::decay_t<vargs>> && ...),
+      "queued connections need copy-constructible signal parameters");
+
+    if (!callback) {
+        throw std::invalid_argument("Illegal attempt to connect empty callback");
+    }
+
     auto token = std::make_shared<signal_token_t>();
+    std::weak_ptr<signal_token_t> link = token;
+    auto cb = std::make_shared<std::function<void(vargs...)>>(
+      std::move(callback));
+
+    // NOTE: runs in the emitter's thread, with the token lock held.
+    auto post_delivery = [&target, link, cb](vargs... params) {
+        target.post([link,
+                     cb,
+                     args = std::tuple<std::decay_t<vargs>...>(params...)]() {
+            auto tkn = link.lock();
+            if (!tkn) {
+                return;
+            }
+
+            // see signal_connection comments.
+            typename signal_token_t::emission_lock l(*tkn);
+            if (!tkn->valid) {
+                return;
+            }
+
+            std::apply([&cb](auto &...a) { (*cb)(a...); }, args);
+        });
+    };
+
+    return register_observer(std::move(token), std::move(post_delivery), false);
+}
+
+template<SIGNAL_TEMPLATE_SPEC>
+std::unique_ptr<signal_connection>
+signal<SIGNAL_TEMPLATE_INSTANCE>::register_observer(
+  std::shared_ptr<signal_token_t> token, observer_callback_t f, bool detached) {
+    auto obs = std::make_shared<const observer>(detached, token, std::move(f));
 
     lock_t l{m_mtx};
 
-    m_observers.emplace_back(observer({detached, token, f}));
+    auto current = load_observers();
+    auto observers = std::make_shared<observer_list>();
+    if (current) {
+        observers->reserve(current->size() + 1);
+        *observers = *current;
+    }
+    observers->push_back(std::move(obs));
+    store_observers(std::move(observers));
+
     return std::make_unique<signal<SIGNAL_TEMPLATE_INSTANCE>::connection>(
       token);
 }
@@ -436,7 +654,7 @@ void signal<SIGNAL_TEMPLATE_INSTANCE>::connection::disconnect(void) {
     }
 
     {
-        lock_t l{token->mtx};
+        typename signal_token_t::unique_lock_t l{token->mtx};
         token->valid = false;
     }
 
@@ -449,7 +667,7 @@ signal<SIGNAL_TEMPLATE_INSTANCE>::connection::~connection(void){
     auto token = m_token;
     if (!token) return;
 
-    lock_t l{token->mtx};
+    typename signal_token_t::emission_lock l{*token};
     if (token->valid) {
         throw std::logic_error(
           "signal_connection destructed without being disconnected");
@@ -461,7 +679,9 @@ signal<SIGNAL_TEMPLATE_INSTANCE>::observer::observer(
   bool detached,
   std::shared_ptr<signal_token_t> &ref,
   std::function<R(vargs...)> f)
-    : notify(f), m_detached(detached), m_link(ref) {
+    : notify(std::move(f))
+    , m_detached(detached ? std::make_shared<signal_token_t>() : nullptr)
+    , m_link(ref) {
 }
 
 template<SIGNAL_TEMPLATE_SPEC>
@@ -469,8 +689,9 @@ std::shared_ptr<typename signal<SIGNAL_TEMPLATE_INSTANCE>::signal_token_t>
 signal<SIGNAL_TEMPLATE_INSTANCE>::observer::check(void) const {
     // a detached observer is deemed perpetually alive. User
     // must ensure that is the case (i.e. that the signal consumer
-    // outlives the signal provider)
-    if (m_detached) return std::make_shared<signal_token_t>();
+    // outlives the signal provider). NOTE: it gets a token of its own,
+    // which is never invalidated.
+    if (m_detached) return m_detached;
 
     return m_link.lock();
 }
@@ -602,7 +823,7 @@ signal_output monosignal<SIGNAL_TEMPLATE_INSTANCE>::emit(vargs... params) {
     /* NOTE: CRITICAL SECTION.
     * The validity check and callback invocation must be mutex-protected.
     * see signal_connection comments. */
-    lock_t l(token->mtx);
+    typename signal_token_t::emission_lock l(*token);
     if (!token->valid){
         m_observer.reset();
         return r.get();
@@ -636,7 +857,7 @@ bool monosignal<SIGNAL_TEMPLATE_INSTANCE>::connected() {
     /* NOTE: CRITICAL SECTION.
      * The validity check and callback invocation must be mutex-protected.
      * see signal_connection comments. */
-    lock_t lock(tkn->mtx);
+    typename signal_token_t::emission_lock lock(*tkn);
     if (!tkn->valid){
         m_observer.reset();
         return false;
@@ -683,7 +904,7 @@ monosignal<SIGNAL_TEMPLATE_INSTANCE>::register_observer(observer_callback_t f,
             /* NOTE: CRITICAL SECTION.
             * The validity check and callback invocation must be mutex-protected.
             * see signal_connection comments. */
-            lock_t lock(token->mtx);
+            typename signal_token_t::emission_lock lock(*token_tmp);
             if (!token_tmp->valid){
                 m_observer.reset();
             }
@@ -770,7 +991,7 @@ void monosignal<SIGNAL_TEMPLATE_INSTANCE>::connection::disconnect(void) {
     }
 
     {
-        lock_t l{token->mtx};
+        typename signal_token_t::unique_lock_t l{token->mtx};
         token->valid = false;
     }
 
@@ -783,7 +1004,7 @@ monosignal<SIGNAL_TEMPLATE_INSTANCE>::connection::~connection(void){
     auto token = m_token;
     if (!token) return;
 
-    lock_t l{token->mtx};
+    typename signal_token_t::emission_lock l{*token};
     if (token->valid) {
         throw std::logic_error(
           "signal_connection destructed without being disconnected");
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace tarp {
+
+//
+// Streaming statistics accumulators. Each summarizes any number of values
+// in constant (or bounded) space and can be merged with another of the
+// same kind, such that e.g. each thread can accumulate values into its own
+// instance, with the instances merged only when the statistics are read.
+//
+// NOTE: unlike tarp::histogram (which serves as the log-bucketed HDR-style
+// sketch for integer values), these are not thread-safe.
+//
+
+// Count, mean, variance, min and max of a stream of values, computed with
+// Welford's numerically stable online algorithm. Merging uses the pairwise
+// update by Chan et al.
+template<typename T = double>
+class welford {
+    static_assert(std::is_floating_point_v<T>);
+
+public:
+    void add(T x) {
+        ++m_count;
+        const T delta = x - m_mean;
+        m_mean += delta / static_cast<T>(m_count);
+        m_m2 += delta * (x - m_mean);
+        m_min = std::min(m_min, x);
+        m_max = std::max(m_max, x);
+    }
+
+    void merge(const welford &other) {
+        if (other.m_count == 0) {
+            return;
+        }
+
+        if (m_count == 0) {
+            *this = other;
+            return;
+        }
+
+        const auto na = static_cast<T>(m_count);
+        const auto nb = static_cast<T>(other.m_count);
+        const T n = na + nb;
+        const T delta = other.m_mean - m_mean;
+
+        m_mean += delta * nb / n;
+        m_m2 += other.m_m2 + delta * delta * na * nb / n;
+        m_count += other.m_count;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    std::uint64_t count() const { return m_count; }
+
+    /* 0 if empty */
+    T mean() const { return m_mean; }
+
+    /* Population variance; 0 if empty. */
+    T variance() const {
+        return m_count > 0 ? m_m2 / static_cast<T>(m_count) : 0;
+    }
+
+    /* Sample variance (Bessel-corrected); 0 if fewer than 2 values. */
+    T sample_variance() const {
+        return m_count > 1 ? m_m2 / static_cast<T>(m_count - 1) : 0;
+    }
+
+    T stddev() const { return std::sqrt(variance()); }
+
+    /* +inf and -inf, respectively, if empty. */
+    T min() const { return m_min; }
+    T max() const { return m_max; }
+
+    void reset() { *this = welford {}; }
+
+private:
+    std::uint64_t m_count {0};
+    T m_mean {0};
+    T m_m2 {0};
+    T m_min {std::numeric_limits<T>::infinity()};
+    T m_max {-std::numeric_limits<T>::infinity()};
+};
+
+// t-digest (merging variant, Dunning & Ertl): an approximation of the
+// distribution of a stream of values as a list of centroids (mean,
+// weight), from which quantiles can be estimated. The centroids are
+// smaller near the tails, so the estimates of extreme quantiles (e.g.
+// p99.9) are the most accurate ones, which is what is wanted for latency
+// percentiles. For the default compression, the rank error of a quantile
+// estimate (i.e. the difference between q and the fraction of values
+// actually below the estimate) is typically under 0.1%.
+//
+// --> compression
+// Bounds the number of centroids (to about compression/2 after each
+// compaction), trading memory and time for accuracy.
+//
+// NOTE: values are first buffered and then merged into the centroids in
+// batches, so add() is amortized O(log compression). The read functions
+// flush the buffer first, so they are const but not free.
+class tdigest {
+public:
+    explicit tdigest(double compression = 100);
+
+    /* Add a value with the given weight (the number of occurrences). */
+    void add(double x, double weight = 1);
+
+    /* Add all the values summarized by other to this digest. */
+    void merge(const tdigest &other);
+
+    /* Return the estimated value below which a fraction q of the values
+     * fall; q must be in [0, 1]. Return 0 if the digest is empty. */
+    double quantile(double q) const;
+
+    /* Same as quantile(p / 100). */
+    double percentile(double p) const { return quantile(p / 100); }
+
+    /* Return the estimated fraction of values <= x. */
+    double cdf(double x) const;
+
+    /* The total weight of the values added. */
+    double count() const;
+
+    /* Exact; 0 if empty. */
+    double min() const;
+    double max() const;
+
+    double compression() const { return m_compression; }
+
+    /* Number of centroids (after flushing the buffer). */
+    std::size_t size() const;
+
+    void reset();
+
+private:
+    struct centroid {
+        double mean;
+        double weight;
+    };
+
+    void flush() const;
+
+    double m_compression;
+    std::size_t m_buffer_limit;
+
+    mutable std::vector<centroid> m_centroids;
+    mutable std::vector<centroid> m_buffer;
+    double m_total_weight {0};
+    double m_min {std::numeric_limits<double>::infinity()};
+    double m_max {-std::numeric_limits<double>::infinity()};
+};
+
+}  // namespace tarp
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/executor.hxx>
+#include <tarp/lite_task.hxx>
+#include <tarp/sched.hxx>
+
+namespace tarp {
+namespace exec {
+
+namespace impl {
+struct strand_state;
+}
+
+/*
+ * Executor that serializes the jobs posted to it on top of another
+ * executor (e.g. a threadpool_executor).
+ *
+ * Jobs posted to a strand run one at a time, in the order given by the
+ * scheduler (FIFO by default), but not necessarily on the same thread.
+ * A strand does not own a thread: while it has pending jobs, it has a
+ * single drain job posted to the underlying executor, which runs a batch
+ * of jobs and then, if there are more, posts itself again (so that a busy
+ * strand does not starve the other strands sharing the same threads).
+ * Therefore any number of strands can be multiplexed on a few threads.
+ *
+ * NOTE: schedulers that hold tasks back until some deadline (see
+ * Scheduler::get_first_deadline) are not fully supported: the strand
+ * does not wait for the deadline, so a task held back is only run once
+ * another task is enqueued after its deadline.
+ *
+ * NOTE: the underlying executor must outlive the strand.
+ */
+class strand final : public interfaces::executor {
+public:
+    DISALLOW_COPY_AND_MOVE(strand);
+
+    explicit strand(
+      interfaces::executor &ex,
+      std::unique_ptr<tarp::sched::Scheduler<tarp::sched::interfaces::task>>
+        scheduler = std::make_unique<
+          tarp::sched::SchedulerFifo<tarp::sched::interfaces::task>>());
+
+    /* See close(). */
+    ~strand() override;
+
+    /* Discard the pending jobs and, if a job is running on some other
+     * thread, block until it returns. Any jobs posted afterwards are
+     * discarded. */
+    void close();
+
+    void post(std::function<void()> job) override;
+
+    /* Schedule a task; same as post but without the std::function. */
+    void enqueue(std::unique_ptr<tarp::sched::interfaces::task> task);
+
+    /* Number of jobs queued waiting to be run. */
+    std::size_t size() const;
+
+    /* True if called from a job running on this strand. */
+    bool running_in_this_thread() const;
+
+private:
+    std::shared_ptr<impl::strand_state> m_state;
+};
+
+}  // namespace exec
+
+namespace threading {
+
+/*
+ * Lightweight counterpart to the ActiveObject.
+ *
+ * Like an ActiveObject, a LiteActiveObject runs the tasks scheduled on it
+ * one at a time, in the order given by its scheduler, so the state it
+ * protects needs no locking. But instead of owning a thread, it runs its
+ * tasks on a strand (see exec::strand) over an executor shared with any
+ * number of other LiteActiveObjects, e.g. a threadpool_executor over a
+ * ThreadPool sized to the number of cores.
+ *
+ * The schedule_task/post API is the same as that of the ActiveObject, so
+ * ActiveObject subclasses that only schedule tasks (i.e. that do not
+ * override do_work) can be ported by changing the base class and passing
+ * the executor to the constructor.
+ *
+ * NOTE: the tasks must not block for long, since that ties up a thread
+ * shared with other objects.
+ * NOTE: the executor must outlive the object.
+ */
+class LiteActiveObject {
+public:
+    DISALLOW_COPY_AND_MOVE(LiteActiveObject);
+
+    explicit LiteActiveObject(
+      tarp::exec::interfaces::executor &ex,
+      std::unique_ptr<tarp::sched::Scheduler<tarp::sched::interfaces::task>>
+        sched = std::make_unique<
+          tarp::sched::SchedulerFifo<tarp::sched::interfaces::task>>())
+        : m_strand(ex, std::move(sched)) {}
+
+    /* See stop(). */
+    virtual ~LiteActiveObject() = default;
+
+protected:
+    /* Discard pending tasks and wait for the running task, if any.
+     * Tasks scheduled afterwards are discarded (their futures report a
+     * broken promise).
+     * NOTE: a derived class whose tasks access its members should call
+     * this in its own destructor, since by the time the base destructor
+     * runs those members have been destroyed. */
+    void stop() { m_strand.close(); }
+
+    /* See ActiveObject::schedule_task. */
+    // clang-format off
+    template<typename callable_type>
+    auto schedule_task(callable_type &&func)
+      -> std::future<std::invoke_result_t<callable_type>>
+    {
+        auto task_item = std::make_unique<
+            tarp::sched::task<
+               std::invoke_result_t<callable_type>, callable_type>>(
+                  std::forward<decltype(func)>(func)
+               );
+
+        auto future = task_item->get_future();
+        m_strand.enqueue(std::move(task_item));
+        return future;
+        // clang-format on
+    }
+
+    /* See ActiveObject::post. */
+    template<typename callable_type>
+    void post(callable_type &&func) {
+        m_strand.enqueue(
+          tarp::sched::make_inline_task(std::forward<callable_type>(func)));
+    }
+
+    /* True if called from a task of this object. */
+    bool in_task_context() const { return m_strand.running_in_this_thread(); }
+
+    /* Number of tasks waiting to run. */
+    std::size_t get_queue_length() const { return m_strand.size(); }
+
+private:
+    tarp::exec::strand m_strand;
+};
+
+}  // namespace threading
+}  // namespace tarp
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tarp {
+namespace threading {
+
+/*
+ * OS-level attributes of a thread: CPU affinity, scheduling policy and
+ * priority, name, and stack prefaulting. See ThreadEntity::set_thread_options
+ * and ThreadPool::set_worker_options.
+ *
+ * NOTE: these are Linux-specific. The real-time policies (FIFO, RR) usually
+ * need CAP_SYS_NICE or an RLIMIT_RTPRIO allowance.
+ */
+enum class sched_policy : std::uint8_t {
+    OTHER, /* the default time-sharing policy (SCHED_OTHER) */
+    FIFO,  /* real-time, first-in first-out (SCHED_FIFO) */
+    RR     /* real-time, round-robin (SCHED_RR) */
+};
+
+struct thread_options {
+    /* Thread name, as shown by e.g. top -H. Truncated to 15 characters
+     * (the kernel limit). */
+    std::optional<std::string> name;
+
+    /* CPUs the thread may run on. If empty, the affinity is left
+     * unchanged (i.e. inherited from the creating thread). */
+    std::vector<unsigned> cpus;
+
+    /* Scheduling policy. The priority must be in [1, 99] for the
+     * real-time policies and 0 for OTHER. If policy is OTHER, the policy
+     * of the thread is left unchanged. */
+    sched_policy policy {sched_policy::OTHER};
+    int priority {0};
+
+    /* Number of bytes of stack to touch when the thread starts so that
+     * the stack pages are faulted in before any latency-sensitive work
+     * is done (and, with lock_process_memory, locked in memory). */
+    std::size_t prefault_stack {0};
+};
+
+/* Apply the affinity, scheduling and name in opts to the given thread.
+ * NOTE: opts.prefault_stack is not applied; see prefault_stack().
+ * Throw std::invalid_argument if the options are invalid and
+ * std::runtime_error if the system refuses to apply them. */
+void apply_thread_options(std::thread::native_handle_type thread,
+                          const thread_options &opts);
+
+/* Apply all of opts to the calling thread (see above). */
+void apply_thread_options(const thread_options &opts);
+
+/* Touch nbytes of the stack of the calling thread, or as much of it as is
+ * left, minus a safety margin, if nbytes is larger than that.
+ * Throw std::runtime_error if the stack bounds cannot be determined. */
+void prefault_stack(std::size_t nbytes);
+
+/* Lock all the memory of the process in RAM (mlockall), so that it can
+ * never be paged out. If future=true, memory mapped later on (e.g. the
+ * stacks of threads created later) is locked as well.
+ * Throw std::runtime_error on failure (typically for lack of privileges or
+ * because RLIMIT_MEMLOCK would be exceeded). */
+void lock_process_memory(bool future = true);
+
+/* Undo lock_process_memory. */
+void unlock_process_memory();
+
+/* The CPUs the calling process is allowed to run on (sched_getaffinity). */
+std::vector<unsigned> get_allowed_cpus();
+
+/* Location of a logical CPU in the processor topology. */
+struct cpu_info {
+    unsigned cpu;     /* logical CPU number */
+    unsigned core;    /* physical core id (unique per package only) */
+    unsigned package; /* physical package (socket) id */
+};
+
+/* Read the topology of the online CPUs from sysfs. CPUs whose topology
+ * cannot be read are reported as a core of their own in package 0. If the
+ * list of online CPUs cannot be read, the allowed CPUs (see
+ * get_allowed_cpus) are reported instead. The result is sorted by cpu. */
+std::vector<cpu_info>
+read_cpu_topology(const std::string &sysfs_root = "/sys/devices/system/cpu");
+
+/*
+ * Placement policy for the workers of a pool.
+ *
+ * --> COMPACT
+ * Consecutive workers go on SMT siblings of the same core, then on the
+ * other cores of the same package. Good for workers that share data.
+ *
+ * --> SCATTER
+ * Consecutive workers go on different physical cores, alternating between
+ * packages; SMT siblings are only used once every core has a worker.
+ * Good for independent compute-bound workers.
+ */
+enum class placement : std::uint8_t {
+    NONE, /* no pinning */
+    COMPACT,
+    SCATTER
+};
+
+/* Return the order in which CPUs are to be assigned to workers under the
+ * given policy: worker i is meant to be pinned to result[i % size].
+ * Empty if policy is NONE. */
+std::vector<unsigned> plan_placement(std::vector<cpu_info> topology,
+                                     placement policy);
+
+}  // namespace threading
+}  // namespace tarp
@@ -1,19 +1,24 @@
 #pragma once
 
 // C++ stdlib
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
 #include <future>
 #include <list>
 #include <map>
+#include <optional>
 #include <shared_mutex>
 #include <thread>
 #include <type_traits>
 
 #include <tarp/cxxcommon.hxx>
+#include <tarp/lite_task.hxx>
+#include <tarp/pool_metrics.hxx>
 #include <tarp/sched.hxx>
 #include <tarp/signal.hxx>
+#include <tarp/thread_options.hxx>
 #include <tarp/timeguard.hxx>
 
 namespace tarp {
@@ -55,6 +60,17 @@ public:
     bool is_stopped(void) const;
     bool is_running(void) const;
 
+    /* Set the CPU affinity, scheduling policy, name etc of the thread (see
+     * thread_options). If the thread has not been spawned yet, the options
+     * are applied when it is (i.e. on the first run()), in which case
+     * run() throws if they cannot be applied -- the thread is nevertheless
+     * left running, with default attributes. Otherwise they are applied
+     * immediately, except for prefault_stack, which only takes effect on
+     * thread startup.
+     * Throw std::invalid_argument if the options are invalid and
+     * std::runtime_error if the system refuses to apply them. */
+    void set_thread_options(thread_options opts);
+
 protected:
     enum class threadState : std::uint8_t {
         INITIALIZED,
@@ -95,11 +111,14 @@ protected:
      * Called on stopping the thread, before the main loop returns.
      * This is when stop() is called explicitly or in the dtor
      * of the thread entity.
+     *
+     * (5) called after every call to do_work().
      */
     virtual void initialize(void);     /* (1) */
     virtual void prepare_resume(void); /* (2) */
     virtual void do_work(void) = 0;    /* (3) */
     virtual void cleanup(void);        /* (4) */
+    virtual void finish_work(void);    /* (5) */
 
     /*
      * Derived classes that need to wait for certain periods in do_work
@@ -127,6 +146,7 @@ private:
     enum threadState m_state = threadState::STOPPED;
     std::condition_variable m_wait_cond;
     bool m_signaled;
+    std::optional<thread_options> m_options;
 };
 
 /* A timer expiring at intervals dictated by the given TimeGuard.
@@ -281,10 +301,32 @@ public:
         sched = std::make_unique<
           tarp::sched::SchedulerFifo<tarp::sched::interfaces::task>>());
 
+    /* Snapshot of the execution metrics. The active object thread is
+     * reported as the single worker (with id 0). */
+    pool_metrics get_metrics() const;
+
 protected:
     bool has_pending_tasks() const;
+
+    /* Dequeue the next task. NOTE: this returns nullptr if there are
+     * pending tasks but the scheduler is holding them back until some
+     * deadline (see Scheduler::get_first_deadline).
+     * The task is meant to be executed in the same call to do_work, and is
+     * recorded in the metrics (see get_metrics) as running from now until
+     * do_work returns (or get_next_task is called again). */
     std::unique_ptr<tarp::sched::interfaces::task> get_next_task();
 
+    /* Meant to be called from do_work when there is no task to run: sleep
+     * until the first deadline of the scheduler, if any, or until max_wait
+     * elapses, whichever comes first. As with wait_until, the sleep is cut
+     * short when a new task is scheduled. */
+    void wait_for_next_task(
+      std::chrono::microseconds max_wait = std::chrono::seconds(1));
+
+    /* Dequeue the next task and execute it, recording its metrics (see
+     * get_metrics). Return false if there was no task to run. */
+    bool run_next_task();
+
     /* Create a task based on the future-promise mechanism.
      * This will be scheduled for execution according to
      * the scheduler's queue discipline.
@@ -312,23 +354,38 @@ protected:
                );
 
         auto future = task_item->get_future();
-
-        {
-            std::unique_lock l(m_scheduler_mtx);
-            m_scheduler->enqueue(std::move(task_item));
-        }
-
-        /* wake up the active object if idling */
-        signal();
-
+        enqueue(std::move(task_item));
         return future;
         // clang-format on
     }
 
+    /* Like schedule_task, but fire-and-forget: no result is communicated
+     * back, so there is no promise/future shared state to allocate, and
+     * small callables are stored inline in the (recycled) task object.
+     * See tarp/lite_task.hxx. */
+    template<typename callable_type>
+    void post(callable_type &&func) {
+        enqueue(
+          tarp::sched::make_inline_task(std::forward<callable_type>(func)));
+    }
+
 private:
+    /* Record the run time of the task last returned by get_next_task. */
+    void finish_work(void) override final;
+
+    /* Enqueue the task and wake up the active object if idling. */
+    void enqueue(std::unique_ptr<tarp::sched::interfaces::task> task);
+
     std::unique_ptr<tarp::sched::Scheduler<tarp::sched::interfaces::task>>
       m_scheduler;
     mutable std::mutex m_scheduler_mtx;
+
+    impl::worker_recorder m_recorder {0};
+    impl::watermark m_queue_hwm;
+
+    /* Start time of the task last returned by get_next_task, if it has
+     * not been recorded yet. Only used by the active object thread. */
+    std::optional<std::chrono::steady_clock::time_point> m_task_start;
 };
 
 /*
@@ -365,6 +422,12 @@ public:
      */
     void set_task(std::unique_ptr<tarp::sched::interfaces::task> task);
 
+    /* Snapshot of the metrics of the tasks run by this worker. */
+    worker_metrics get_metrics() const;
+
+    /* See impl::worker_recorder::drain_queue_wait_window. */
+    void drain_queue_wait_window(histogram &into);
+
 private:
     virtual void do_work(void) override final;
     virtual void initialize(void) override final;
@@ -380,6 +443,59 @@ private:
     mutable std::mutex m_mtx;
     const std::uint32_t m_worker_id;
     tarp::ts::signal<void(std::uint32_t id)> m_sig_work_done;
+    impl::worker_recorder m_recorder;
+};
+
+/*
+ * Policy for automatically resizing a ThreadPool according to the load.
+ * See ThreadPool::set_autoscale_policy.
+ *
+ * Every interval, the pool looks at the queue wait times (the time from
+ * enqueueing a task to a worker starting it) recorded since the previous
+ * evaluation.
+ * - The pool grows by grow_step workers (up to max_workers) if the given
+ *   percentile of the queue wait exceeds target_queue_wait or if tasks
+ *   have been waiting with no idle worker to take them for longer than
+ *   target_queue_wait (since queue wait is only recorded when a task
+ *   starts, this catches the case where all workers are tied up by
+ *   long-running tasks).
+ * - The pool shrinks by one worker (down to min_workers) if a worker has
+ *   been idle for idle_timeout and the queue wait percentile is at most
+ *   shrink_threshold * target_queue_wait.
+ *
+ * The gap between the two thresholds and the cooldown (the minimum time
+ * between two resizing decisions) provide hysteresis: they prevent the
+ * pool from oscillating in size.
+ */
+struct autoscale_policy {
+    std::size_t min_workers {1};
+    std::size_t max_workers {
+      std::max(1u, std::thread::hardware_concurrency())};
+
+    double percentile {95};
+    std::chrono::microseconds target_queue_wait {std::chrono::milliseconds(1)};
+    double shrink_threshold {0.5};
+    std::chrono::milliseconds idle_timeout {std::chrono::seconds(5)};
+
+    std::size_t grow_step {1};
+    std::chrono::milliseconds interval {std::chrono::milliseconds(100)};
+    std::chrono::milliseconds cooldown {std::chrono::milliseconds(500)};
+};
+
+/* Resizing decision made by the autoscaler of a ThreadPool. */
+struct autoscale_decision {
+    enum class reason : std::uint8_t {
+        LATENCY,    /* queue wait percentile above target */
+        SATURATION, /* tasks waiting with no idle worker for too long */
+        IDLE        /* a worker has been idle for idle_timeout */
+    };
+
+    reason why;
+    std::size_t old_num_workers;
+    std::size_t new_num_workers;
+
+    /* The queue wait percentile observed over the last interval. */
+    std::chrono::nanoseconds queue_wait;
 };
 
 /*
@@ -406,15 +522,32 @@ public:
         scheduler = std::make_unique<
           tarp::sched::SchedulerFifo<tarp::sched::interfaces::task>>());
 
+    /* Stop the pool (see cleanup) before any members are destroyed. */
+    ~ThreadPool() override;
+
     /* Get number of tasks queued waiting for execution */
     std::size_t get_queue_length() const;
 
     /* total number of tasks handled across all workers combined */
     std::size_t get_num_tasks_handled() const;
 
+    /* Snapshot of the execution metrics: queue wait and execution time
+     * histograms, queue length high-watermark, and per-worker
+     * busy/idle time. */
+    pool_metrics get_metrics() const;
+
     /* Schedule a task for execution */
     void enqueue_task(std::unique_ptr<tarp::sched::interfaces::task> task);
 
+    /* Schedule f for execution, fire-and-forget. This is cheaper than
+     * enqueueing a sched::task since there is no promise/future shared
+     * state and small callables are stored inline in the (recycled) task
+     * object. Use sched::make_lite_task if a result is needed. */
+    template<typename F>
+    void post(F &&f) {
+        enqueue_task(tarp::sched::make_inline_task(std::forward<F>(f)));
+    }
+
     /* Get the number of worker threads i.e. the size of the worker pool. */
     std::size_t get_num_threads() const;
 
@@ -428,6 +561,33 @@ public:
      * scheduled. */
     void start();
 
+    /* Enable autoscaling according to the given policy, or disable it if
+     * std::nullopt. The current number of threads is clamped to the
+     * [min_workers, max_workers] range. While autoscaling is enabled, the
+     * autoscaler overrides the size set via set_num_threads.
+     * NOTE: when autoscaling, the dispatcher thread wakes up every
+     * policy.interval even when the pool is idle.
+     * Throw std::invalid_argument if the policy is invalid. */
+    void set_autoscale_policy(std::optional<autoscale_policy> policy);
+
+    /* Apply opts to all the worker threads (existing and future ones).
+     * If policy is not placement::NONE, opts.cpus is overridden: each
+     * worker is pinned to a single CPU chosen according to the policy
+     * from the topology read from sysfs (see plan_placement), out of the
+     * CPUs the process is allowed to run on. If opts.name is set, each
+     * worker is named "<name>/<worker id>".
+     * Throw as ThreadEntity::set_thread_options if the options cannot be
+     * applied to an existing worker. NOTE: failures to apply the options
+     * to workers spawned later on (e.g. when the pool is resized) are
+     * logged but otherwise ignored, as the pool must keep working. */
+    void set_worker_options(thread_options opts,
+                            placement policy = placement::NONE);
+
+    /* Signal emitted (on the pool's dispatcher thread) whenever the
+     * autoscaler decides to resize the pool. NOTE: handlers must be quick
+     * and must not call back into the pool. */
+    auto &get_autoscale_signal() { return m_autoscale_signal; }
+
 private:
     virtual void initialize(void) override final;
     virtual void prepare_resume(void) override final;
@@ -445,8 +605,10 @@ private:
     virtual void cleanup(void) override final;
 
     void resize_pool_if_needed(void);
+    void autoscale_if_needed(void);
     void add_follower(uint32_t worker_id);
     void hook_up_task_completion_signal(tarp::threading::WorkerThread &worker);
+    std::optional<thread_options> get_worker_options(std::uint32_t worker_id);
 
     mutable std::shared_mutex m_mtx;
     std::size_t m_num_workers {0};    /* number of user-requested workers */
@@ -466,6 +628,23 @@ private:
     const std::unique_ptr<tarp::sched::Scheduler<tarp::sched::interfaces::task>>
       m_taskq;
     std::uint64_t m_num_tasks_handled {0};
+
+    /* metrics of the workers that have been removed from the pool. */
+    pool_metrics m_retired_metrics;
+    impl::watermark m_queue_hwm;
+
+    /* autoscaling state */
+    std::optional<autoscale_policy> m_autoscale;
+    std::chrono::steady_clock::time_point m_next_evaluation;
+    std::chrono::steady_clock::time_point m_last_resize;
+    std::optional<std::chrono::steady_clock::time_point> m_saturated_since;
+    std::map<std::uint32_t, std::chrono::steady_clock::time_point>
+      m_idle_since;
+    tarp::ts::signal<void(const autoscale_decision &)> m_autoscale_signal;
+
+    /* see set_worker_options */
+    std::optional<thread_options> m_worker_options;
+    std::vector<unsigned> m_placement;
 };
 
 }  // namespace threading
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/signal.hxx>
+#include <tarp/threading.hxx>
+#include <tarp/timeguard.hxx>
+
+namespace tarp {
+namespace threading {
+
+/*
+ * A single thread that multiplexes any number of timers.
+ *
+ * Timer, Oscillator and Watchdog are each a ThreadEntity, i.e. one OS
+ * thread per timer, which is wasteful when there are many of them, since
+ * the threads are asleep most of the time. The TimerService instead keeps
+ * all the expiration times in a min-heap and sleeps until the earliest one.
+ * HostedTimer, HostedOscillator and HostedWatchdog (see tarp/watchdog.hxx)
+ * offer the same signal-based API as their thread-based counterparts but
+ * run on a TimerService.
+ *
+ * The callbacks run on the service thread, one at a time. They should
+ * therefore be quick: a slow callback delays every other timer.
+ *
+ * The service thread is spawned when the first timer is scheduled and
+ * sleeps (paused) while there are no timers.
+ */
+class TimerService final : public ThreadEntity {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+    using timer_id = std::uint64_t;
+
+    /* Called on expiry. Return the time the timer should next expire at
+     * (i.e. the timer is re-armed), or std::nullopt to retire it.
+     * A callback that throws is retired too; the exception is reported on
+     * stderr and does not reach the service thread. */
+    using callback_type = std::function<std::optional<time_point>()>;
+
+    TimerService() = default;
+
+    /* Stop the service thread; pending timers never fire. */
+    ~TimerService() override;
+
+    /* Arm a new timer to expire at the given time. Return its id, which
+     * stays valid until the timer is retired or canceled. */
+    timer_id schedule(time_point expiry, callback_type cb);
+
+    /* Change the expiration time of a timer.
+     * Return false if there is no such timer. NOTE: if the callback of the
+     * timer is running, its return value takes precedence. */
+    bool reschedule(timer_id id, time_point expiry);
+
+    /* Cancel a timer. If the callback of the timer is running, block until
+     * it returns, unless called from the callback itself: once cancel()
+     * returns, the callback is guaranteed not to be running and never to
+     * run again (so it is safe to destroy what it refers to).
+     * Return false if there is no such timer. */
+    bool cancel(timer_id id);
+
+    /* Number of timers armed. */
+    std::size_t size() const;
+
+private:
+    void do_work() override;
+
+    struct entry {
+        time_point expiry;
+        std::uint64_t seq;
+        timer_id id;
+
+        bool operator>(const entry &other) const {
+            if (expiry != other.expiry) {
+                return expiry > other.expiry;
+            }
+            return seq > other.seq;
+        }
+    };
+
+    struct timer {
+        callback_type cb;
+
+        // seq of the (only) valid heap entry for this timer; entries with
+        // a different seq are stale (rescheduled) and skipped.
+        std::uint64_t seq;
+    };
+
+    void push(timer_id id, timer &t, time_point expiry);
+
+    mutable std::mutex m_mtx;
+    std::condition_variable m_callback_done;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry>> m_heap;
+    std::unordered_map<timer_id, timer> m_timers;
+    timer_id m_next_id {1};
+    std::uint64_t m_next_seq {0};
+
+    // timer whose callback is running, if any, and whether it has been
+    // canceled from inside its own callback.
+    std::optional<timer_id> m_running;
+    bool m_running_canceled {false};
+    std::thread::id m_service_thread;
+};
+
+/*
+ * Like Timer, but hosted on a TimerService rather than running in its own
+ * thread. The timeout signal is emitted on the service thread.
+ */
+template<typename T>
+class HostedTimer {
+public:
+    DISALLOW_COPY_AND_MOVE(HostedTimer);
+
+    HostedTimer(TimerService &service,
+                std::unique_ptr<tarp::TimeGuard<T>> interval)
+        : m_service(service), m_guard(std::move(interval)) {}
+
+    ~HostedTimer() { stop(); }
+
+    auto &get_timeout_signal(void) { return m_timeout_signal; }
+
+    /* Arm the timer. NOP if already armed. */
+    void start() {
+        std::unique_lock l {m_mtx};
+        if (m_id) {
+            return;
+        }
+
+        m_id = m_service.schedule(m_guard->get_next_timepoint(),
+                                  [this] { return on_expiry(); });
+    }
+
+    /* Disarm the timer. Once this returns, the timeout signal is not
+     * emitted again until start() is called. */
+    void stop() {
+        std::optional<TimerService::timer_id> id;
+        {
+            std::unique_lock l {m_mtx};
+            std::swap(id, m_id);
+        }
+
+        if (id) {
+            m_service.cancel(*id);
+        }
+    }
+
+private:
+    std::optional<TimerService::time_point> on_expiry() {
+        if (m_guard->disabled()) {
+            return std::nullopt;
+        }
+
+        if (m_guard->down()) {
+            /* NOTE: Any signal handlers should run quickly, in order
+             * not to block the timer service! */
+            m_timeout_signal.emit();
+            m_guard->shift(1);
+        }
+
+        if (m_guard->disabled()) {
+            return std::nullopt;
+        }
+        return m_guard->get_next_timepoint();
+    }
+
+    TimerService &m_service;
+    std::unique_ptr<tarp::TimeGuard<T>> m_guard;
+    tarp::ts::signal<void(void)> m_timeout_signal;
+
+    std::mutex m_mtx;
+    std::optional<TimerService::timer_id> m_id;
+};
+
+/*
+ * Like Oscillator, but hosted on a TimerService rather than running in its
+ * own thread. The tick signal is emitted (and on_tick called) on the
+ * service thread. See Oscillator for the semantics of set_period().
+ */
+class HostedOscillator {
+public:
+    DISALLOW_COPY_AND_MOVE(HostedOscillator);
+
+    explicit HostedOscillator(TimerService &service) : m_service(service) {}
+
+    virtual ~HostedOscillator();
+
+    auto &get_tick_signal(void) { return m_tick_signal; }
+
+    /* Start ticking; the first tick is one period from now. NOP if already
+     * started. */
+    void start();
+
+    /* Stop ticking. Once this returns, no more ticks are emitted until
+     * start() is called. NOTE: derived classes that override on_tick must
+     * call stop() in their destructor. */
+    void stop();
+
+    void set_period(const std::chrono::microseconds &period);
+    std::chrono::microseconds get_period() const;
+
+protected:
+    virtual void on_tick(void) {}
+
+private:
+    std::optional<TimerService::time_point> on_expiry();
+
+    static inline constexpr std::chrono::microseconds c_default_period {1s};
+
+    TimerService &m_service;
+    tarp::ts::signal<void(void)> m_tick_signal;
+
+    mutable std::mutex m_mtx;
+    std::chrono::microseconds m_period {c_default_period};
+    std::chrono::steady_clock::time_point m_prev_tick_tp;
+    std::optional<TimerService::timer_id> m_id;
+};
+
+}  // namespace threading
+}  // namespace tarp
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
 
 #include <tarp/cxxcommon.hxx>
 
@@ -13,6 +21,13 @@ namespace tarp {
  * This is a simple wrapper around an STL queue type that wraps
  * its methods so that they are protected by mutex guards to ensure
  * thread safety.
+ *
+ * Move-only types are supported: the queue never copies an element
+ * unless the caller passes it by const reference. The *_many functions
+ * copy from (push) or move into (pop) the caller's sequence.
+ *
+ * Consumers can block waiting for an element to be enqueued (see
+ * wait_pop()) rather than spinning on empty().
  */
 template<typename T>
 class tsq final {
@@ -31,21 +46,39 @@ public:
     };
 
     void push_back(const T &i) {
-        LOCK(m_mtx);
-        m_queue.push_back(i);
+        {
+            LOCK(m_mtx);
+            m_queue.push_back(i);
+        }
+        m_cv.notify_one();
     }
 
     void push_back(T &&i) {
-        LOCK(m_mtx);
-        m_queue.emplace_back(i);
+        {
+            LOCK(m_mtx);
+            m_queue.push_back(std::move(i));
+        }
+        m_cv.notify_one();
+    }
+
+    template<typename... args_t>
+    void emplace_back(args_t &&...args) {
+        {
+            LOCK(m_mtx);
+            m_queue.emplace_back(std::forward<args_t>(args)...);
+        }
+        m_cv.notify_one();
     }
 
     template<template<typename> class SEQ>
     void push_back_many(const SEQ<T> &seq) {
-        LOCK(m_mtx);
-        for (const auto &i : seq) {
-            m_queue.push_back(i);
+        {
+            LOCK(m_mtx);
+            for (const auto &i : seq) {
+                m_queue.push_back(i);
+            }
         }
+        m_cv.notify_all();
     }
 
     /*
@@ -62,42 +95,51 @@ public:
 
     T pop_back(void) {
         LOCK(m_mtx);
-        T t = m_queue.back();
+        T t = std::move(m_queue.back());
         m_queue.pop_back();
         return t;
     }
 
     /*
-     * Pop n elements (all if n == 1) from the back of the queue
+     * Pop n elements (all if n == -1) from the back of the queue
      * as if with pop_back and insert them one by one into seq
      * using push_back.
      */
     template<template<typename> class SEQ>
     void pop_back_many(SEQ<T> &seq, int n = -1) {
         LOCK(m_mtx);
-        std::size_t num = (n == -1 || n > m_queue.size()) ? m_queue.size() : n;
+        std::size_t num = count(n);
         for (size_t i = 0; i < num; ++i) {
-            seq.emplace_back(m_queue.back());
+            seq.emplace_back(std::move(m_queue.back()));
             m_queue.pop_back();
         }
     }
 
     void push_front(const T &i) {
-        LOCK(m_mtx);
-        m_queue.push_front(i);
+        {
+            LOCK(m_mtx);
+            m_queue.push_front(i);
+        }
+        m_cv.notify_one();
     }
 
     void push_front(T &&i) {
-        LOCK(m_mtx);
-        m_queue.emplace_front(i);
+        {
+            LOCK(m_mtx);
+            m_queue.push_front(std::move(i));
+        }
+        m_cv.notify_one();
     }
 
     template<template<typename> class SEQ>
     void push_front_many(const SEQ<T> &seq) {
-        LOCK(m_mtx);
-        for (const auto &i : seq) {
-            m_queue.push_front(i);
+        {
+            LOCK(m_mtx);
+            for (const auto &i : seq) {
+                m_queue.push_front(i);
+            }
         }
+        m_cv.notify_all();
     }
 
     const T &front(void) const {
@@ -107,29 +149,254 @@ public:
 
     T pop_front(void) {
         LOCK(m_mtx);
-        T t = m_queue.front();
+        T t = std::move(m_queue.front());
         m_queue.pop_front();
         return t;
     }
 
     /*
-     * Pop n elements (all if n == 1) from the front of the queue
+     * Pop n elements (all if n == -1) from the front of the queue
      * as if with pop_front and insert them one by one into seq
      * using push_back.
      */
     template<template<typename> class SEQ>
     void pop_front_many(SEQ<T> &seq, int n = -1) {
         LOCK(m_mtx);
-        std::size_t num = (n == -1 || n > m_queue.size()) ? m_queue.size() : n;
+        std::size_t num = count(n);
         for (size_t i = 0; i < num; ++i) {
-            seq.emplace_back(m_queue.front());
+            seq.emplace_back(std::move(m_queue.front()));
             m_queue.pop_front();
         }
     }
 
+    /*
+     * Pop the front element if the queue is not empty, else return
+     * std::nullopt. Unlike pop_front, this is safe to call on an empty
+     * queue, so it can be used when there are multiple consumers.
+     */
+    std::optional<T> try_pop(void) {
+        LOCK(m_mtx);
+        return do_pop(lock);
+    }
+
+    /*
+     * Pop the front element, blocking until there is one.
+     *
+     * NOTE: there is no way to unblock a waiting consumer other than by
+     * pushing an element, so consumers that must be stopped should either
+     * use wait_pop_for or be sent a sentinel value.
+     */
+    T wait_pop(void) {
+        LOCK(m_mtx);
+        m_cv.wait(lock, [this] { return !m_queue.empty(); });
+        return *do_pop(lock);
+    }
+
+    /*
+     * Like wait_pop, but give up after rel_time and return std::nullopt.
+     */
+    template<class Rep, class Period>
+    std::optional<T>
+    wait_pop_for(const std::chrono::duration<Rep, Period> &rel_time) {
+        LOCK(m_mtx);
+        m_cv.wait_for(lock, rel_time, [this] { return !m_queue.empty(); });
+        return do_pop(lock);
+    }
+
+    /*
+     * Take all the elements currently enqueued, in O(1) time: the queue is
+     * swapped with items, which must be empty, or else its contents are
+     * discarded. This lets a consumer process whole batches while only
+     * holding the lock for the duration of the swap.
+     */
+    void swap_drain(std::deque<T> &items) {
+        items.clear();
+        LOCK(m_mtx);
+        std::swap(items, m_queue);
+    }
+
 private:
+    std::size_t count(int n) const {
+        if (n < 0 || static_cast<std::size_t>(n) > m_queue.size()) {
+            return m_queue.size();
+        }
+        return static_cast<std::size_t>(n);
+    }
+
+    std::optional<T> do_pop(std::unique_lock<std::mutex> &) {
+        if (m_queue.empty()) {
+            return std::nullopt;
+        }
+        std::optional<T> t {std::move(m_queue.front())};
+        m_queue.pop_front();
+        return t;
+    }
+
     std::deque<T> m_queue;
     mutable std::mutex m_mtx;
+    std::condition_variable m_cv;
+};
+
+/*
+ * Thread-safe queue split into a number of independently locked shards in
+ * order to reduce lock contention when there are many producers.
+ *
+ * Each producer thread always pushes to the same shard (chosen by hashing
+ * its thread id); consumers pop from the shards in round-robin order.
+ * Consequently elements pushed by the same thread are popped in FIFO order,
+ * but there is no ordering guarantee across producer threads.
+ */
+template<typename T>
+class sharded_tsq final {
+public:
+    DISALLOW_COPY_AND_MOVE(sharded_tsq);
+
+    explicit sharded_tsq(
+      std::size_t num_shards = std::thread::hardware_concurrency())
+        : m_shards(num_shards > 0 ? num_shards : 1) {}
+
+    std::size_t num_shards(void) const { return m_shards.size(); }
+
+    /*
+     * NOTE: since the shards are locked one by one, the result is only
+     * approximate if there are concurrent producers or consumers.
+     */
+    std::size_t size(void) const {
+        std::size_t n = 0;
+        for (const auto &s : m_shards) {
+            LOCK(s.mtx);
+            n += s.queue.size();
+        }
+        return n;
+    }
+
+    bool empty(void) const { return size() == 0; }
+
+    void push(const T &i) { emplace(i); }
+
+    void push(T &&i) { emplace(std::move(i)); }
+
+    template<typename... args_t>
+    void emplace(args_t &&...args) {
+        auto &s = local_shard();
+        {
+            LOCK(s.mtx);
+            s.queue.emplace_back(std::forward<args_t>(args)...);
+        }
+
+        // pairs with the increment of m_waiters in wait_pop_until: either
+        // the waiter sees the new element or we see the waiter.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiters.load() > 0) {
+            LOCK(m_wait_mtx);
+            m_cv.notify_one();
+        }
+    }
+
+    /*
+     * Pop an element from one of the shards, or return std::nullopt if all
+     * of them are empty.
+     */
+    std::optional<T> try_pop(void) {
+        std::size_t n = m_shards.size();
+        std::size_t start = m_next.fetch_add(1, std::memory_order_relaxed);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            auto &s = m_shards[(start + i) % n];
+            LOCK(s.mtx);
+            if (!s.queue.empty()) {
+                std::optional<T> t {std::move(s.queue.front())};
+                s.queue.pop_front();
+                return t;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /* See tsq::wait_pop. */
+    T wait_pop(void) {
+        return *wait_pop_until(std::nullopt);
+    }
+
+    template<class Rep, class Period>
+    std::optional<T>
+    wait_pop_for(const std::chrono::duration<Rep, Period> &rel_time) {
+        auto deadline = std::chrono::steady_clock::now() + rel_time;
+        return wait_pop_until(
+          std::chrono::time_point_cast<std::chrono::steady_clock::duration>(
+            deadline));
+    }
+
+    /*
+     * Move all the elements from all the shards to the back of items.
+     * NOTE: unlike tsq::swap_drain, this is not O(1), since the contents
+     * of the shards must be concatenated.
+     */
+    void drain(std::deque<T> &items) {
+        std::deque<T> tmp;
+        for (auto &s : m_shards) {
+            {
+                LOCK(s.mtx);
+                std::swap(tmp, s.queue);
+            }
+            for (auto &i : tmp) {
+                items.push_back(std::move(i));
+            }
+            tmp.clear();
+        }
+    }
+
+private:
+    // Aligned to avoid false sharing between the shards.
+    struct alignas(64) shard {
+        mutable std::mutex mtx;
+        std::deque<T> queue;
+    };
+
+    shard &local_shard() {
+        static thread_local const std::size_t hash =
+          std::hash<std::thread::id> {}(std::this_thread::get_id());
+        return m_shards[hash % m_shards.size()];
+    }
+
+    // Wait until an element can be popped or the deadline (if any) expires.
+    std::optional<T> wait_pop_until(
+      const std::optional<std::chrono::steady_clock::time_point> &deadline) {
+        for (;;) {
+            if (auto t = try_pop()) {
+                return t;
+            }
+
+            std::unique_lock l {m_wait_mtx};
+            m_waiters.fetch_add(1);
+            auto t = try_pop();
+            bool timed_out = false;
+            if (!t && deadline) {
+                timed_out = m_cv.wait_until(l, *deadline) ==
+                            std::cv_status::timeout;
+            } else if (!t) {
+                m_cv.wait(l);
+            }
+            m_waiters.fetch_sub(1);
+
+            if (t) {
+                return t;
+            }
+            if (timed_out) {
+                l.unlock();
+                return try_pop();
+            }
+        }
+    }
+
+    std::vector<shard> m_shards;
+    std::atomic<std::size_t> m_next {0};
+
+    // Consumers block on m_cv when all the shards are empty. Producers
+    // only take m_wait_mtx to notify if there are any waiters.
+    std::mutex m_wait_mtx;
+    std::condition_variable m_cv;
+    std::atomic<std::size_t> m_waiters {0};
 };
 
 }  // namespace tarp
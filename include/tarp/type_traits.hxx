@@ -162,7 +162,9 @@ inline constexpr bool implements_interface_v =
     ":" tkn2str(__LINE__) "): type specified for " tkn2str( \
       TYPE) " does not implement required interface (" tkn2str(INTERFACE) ")"
 
-#define REQUIRE(type_argument, required_interface)                     \
+// NOTE: prefixed, since e.g. unit test frameworks commonly define a
+// REQUIRE macro.
+#define TARP_REQUIRE(type_argument, required_interface)                \
     static_assert(                                                     \
       (tarp::type_traits::implements_interface_v<type_argument,        \
                                                  required_interface>), \
@@ -235,6 +237,16 @@ struct thread_unsafe : public std::false_type {};
 // i.e. calls to lock mutexes, needs to:
 // 1) take a policy template parameter, to be forwarded to ts_types.
 // 2) use the lock_t and mutex_t types defined by ts_types.
+namespace impl {
+// NOTE: shared by all ts_types instantiations so that e.g. a lock_t for a
+// std::shared_mutex can be constructed from a mutex_t of the same policy.
+struct dummy_mutex {};
+
+struct dummy_lock {
+    dummy_lock(dummy_mutex &) {}
+};
+}  // namespace impl
+
 template<typename policy,
          typename mutex_type = std::mutex,
          template<typename> typename lock_type = std::lock_guard>
@@ -242,18 +254,15 @@ struct ts_types {
     static_assert(std::is_same_v<policy, thread_safe> ||
                   std::is_same_v<policy, thread_unsafe>);
 
-    struct dummy_mutex {};
-
-    struct dummy_lock {
-        dummy_lock(dummy_mutex &) {}
-    };
+    using dummy_mutex = impl::dummy_mutex;
+    using dummy_lock = impl::dummy_lock;
 
     using mutex_t = std::conditional_t<std::is_same_v<policy, thread_safe>,
                                        mutex_type,
                                        dummy_mutex>;
 
     using lock_t = std::conditional_t<std::is_same_v<policy, thread_safe>,
-                                      lock_type<std::mutex>,
+                                      lock_type<mutex_type>,
                                       dummy_lock>;
 };
 
@@ -1,18 +1,44 @@
 #ifndef TARP_WATCHDOG_HXX_
 #define TARP_WATCHDOG_HXX_
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <mutex>
+#include <optional>
 #include <stdexcept>
 
 #include <tarp/threading.hxx>
+#include <tarp/timer_service.hxx>
 
 namespace tarp {
 
 using wd_guard_cb_t = std::function<bool(void)>;
 using wd_action_cb_t = std::function<void(void)>;
 
+namespace impl {
+
+// A steady_clock time point that can be stored atomically, so that
+// Watchdog::reset() -- the hot path -- is a single lock-free store.
+class atomic_deadline {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    void store(time_point tp) {
+        m_ticks.store(tp.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    time_point load() const {
+        return time_point(time_point::duration(
+          m_ticks.load(std::memory_order_relaxed)));
+    }
+
+private:
+    std::atomic<time_point::rep> m_ticks {0};
+};
+
+}  // namespace impl
+
 /*
  * Simple watchdog class running in its own thread.
  *
@@ -56,6 +82,8 @@ public:
 
     /* Reset the watchdog so that it waits another full interval
      * before it 'bites'. I.e. keep the watchdog at bay.
+     * This is a lock-free store of the new deadline, so it is cheap enough
+     * to be called on every pass of a hot loop.
      * NOTE: a watchdog that has already 'bitten' must be 'kicked'; .reset()
      * is only for a running watchdog.
      * NOTE: a watchdog that has been stopped can never used again. Reset
@@ -83,30 +111,24 @@ private:
 
     bool m_guard_mode;
     T m_interval;
-    std::chrono::steady_clock::time_point m_deadline;
+    impl::atomic_deadline m_deadline;
     wd_action_cb_t m_action_cb;
     wd_guard_cb_t m_guard;
     mutable std::mutex m_mtx;
 };
 
+/* NOTE: no need to signal the watchdog thread: the deadline can only
+ * move later, so the thread wakes up at the old deadline, finds it has
+ * moved, and goes back to sleep. On a paused watchdog, this is harmless
+ * since kick() reinitializes the deadline anyway. */
 template<typename T>
 void Watchdog<T>::reset() {
-    // printf("****** WATCHDOG RESET\n");
-
-    {
-        LOCK(m_mtx);
-        if (!is_running()) {
-            return;
-        }
-        initialize();
-    }
-
-    signal();
+    initialize();
 }
 
 template<typename T>
 void Watchdog<T>::initialize() {
-    m_deadline = std::chrono::steady_clock::now() + m_interval;
+    m_deadline.store(std::chrono::steady_clock::now() + m_interval);
 }
 
 template<typename T>
@@ -123,14 +145,10 @@ void Watchdog<T>::bite() {
 
 template<typename T>
 void Watchdog<T>::do_work(void) {
-    decltype(m_deadline) deadline;
-    {
-        LOCK(m_mtx);
-        deadline = m_deadline;
-    }
+    auto deadline = m_deadline.load();
 
     if (std::chrono::steady_clock::now() < deadline) {
-        wait_for(m_interval);
+        wait_until(deadline);
         return;
     }
 
@@ -138,6 +156,7 @@ void Watchdog<T>::do_work(void) {
         LOCK(m_mtx);
         if (m_guard_mode) {
             if (m_guard()) {
+                initialize();
                 return;
             }
         }
@@ -160,6 +179,124 @@ void Watchdog<T>::kick() {
     run();
 }
 
+/*
+ * Like Watchdog, but hosted on a TimerService rather than running in its
+ * own thread, so any number of them can share a single thread. The guard
+ * and action callbacks run on the service thread.
+ *
+ * Unlike the Watchdog, a HostedWatchdog is created disarmed: kick() arms it
+ * (and re-arms it after it has bitten). reset() is a lock-free store, as
+ * with the Watchdog; the service only looks at the deadline when the
+ * previously scheduled one comes up.
+ */
+template<typename T = std::chrono::seconds>
+class HostedWatchdog {
+public:
+    DISALLOW_COPY_AND_MOVE(HostedWatchdog);
+
+    /* guarded-mode watchdog constructor */
+    HostedWatchdog(threading::TimerService &service,
+                   T interval,
+                   wd_action_cb_t action,
+                   wd_guard_cb_t guard)
+        : m_service(service)
+        , m_guard_mode(true)
+        , m_interval(interval)
+        , m_action_cb(std::move(action))
+        , m_guard(std::move(guard)) {}
+
+    /* unguarded-mode watchdog constructor */
+    HostedWatchdog(threading::TimerService &service,
+                   T interval,
+                   wd_action_cb_t action)
+        : m_service(service)
+        , m_guard_mode(false)
+        , m_interval(interval)
+        , m_action_cb(std::move(action)) {}
+
+    ~HostedWatchdog() { stop(); }
+
+    /* See Watchdog::reset. */
+    void reset() {
+        m_deadline.store(std::chrono::steady_clock::now() + m_interval);
+    }
+
+    /* Disarm the watchdog and invoke the action callback. */
+    void bite() {
+        stop();
+        invoke_action();
+    }
+
+    /* Arm the watchdog if disarmed (i.e. not yet armed, bitten, or
+     * stopped), with a full interval until it bites. NOP if armed. */
+    void kick() {
+        std::unique_lock l {m_mtx};
+        if (m_id) {
+            return;
+        }
+
+        reset();
+        m_id = m_service.schedule(m_deadline.load(),
+                                  [this] { return on_expiry(); });
+    }
+
+    /* Disarm the watchdog. Once this returns, the callbacks are not
+     * invoked again until the watchdog is kicked. */
+    void stop() {
+        std::optional<threading::TimerService::timer_id> id;
+        {
+            std::unique_lock l {m_mtx};
+            std::swap(id, m_id);
+        }
+
+        if (id) {
+            m_service.cancel(*id);
+        }
+    }
+
+    bool armed() const {
+        std::unique_lock l {m_mtx};
+        return m_id.has_value();
+    }
+
+private:
+    std::optional<threading::TimerService::time_point> on_expiry() {
+        auto deadline = m_deadline.load();
+        if (std::chrono::steady_clock::now() < deadline) {
+            return deadline;
+        }
+
+        if (m_guard_mode && m_guard()) {
+            reset();
+            return m_deadline.load();
+        }
+
+        {
+            std::unique_lock l {m_mtx};
+            m_id.reset();
+        }
+
+        invoke_action();
+        return std::nullopt;
+    }
+
+    void invoke_action() {
+        if (!m_action_cb) {
+            throw std::logic_error("Illegal null action callback");
+        }
+        m_action_cb();
+    }
+
+    threading::TimerService &m_service;
+    bool m_guard_mode;
+    T m_interval;
+    impl::atomic_deadline m_deadline;
+    wd_action_cb_t m_action_cb;
+    wd_guard_cb_t m_guard;
+
+    mutable std::mutex m_mtx;
+    std::optional<threading::TimerService::timer_id> m_id;
+};
 
 }  // namespace tarp
 
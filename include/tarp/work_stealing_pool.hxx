@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tarp/cxxcommon.hxx>
+#include <tarp/lite_task.hxx>
+#include <tarp/pool_metrics.hxx>
+#include <tarp/sched.hxx>
+
+namespace tarp {
+namespace threading {
+
+namespace impl {
+
+// Chase-Lev work-stealing deque.
+//
+// The owner thread pushes and pops at the bottom (LIFO); any number of
+// other threads can concurrently steal from the top (FIFO). All operations
+// are lock-free. The buffer grows as needed; retired buffers are kept around
+// until the deque is destroyed since thieves may still be reading them.
+//
+// See "Dynamic Circular Work-Stealing Deque" (Chase, Lev) and "Correct and
+// Efficient Work-Stealing for Weak Memory Models" (Le et al) for the memory
+// orderings used.
+//
+// NOTE: only pointers are stored; the deque does not take ownership.
+template<typename T>
+class ws_deque {
+public:
+    DISALLOW_COPY_AND_MOVE(ws_deque);
+
+    explicit ws_deque(std::size_t capacity = 256) {
+        std::size_t cap = 1;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        m_arrays.push_back(std::make_unique<array>(cap));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    // Owner only.
+    void push(T *item) {
+        auto b = m_bottom.load(std::memory_order_relaxed);
+        auto t = m_top.load(std::memory_order_acquire);
+        auto *a = m_array.load(std::memory_order_relaxed);
+
+        if (b - t > a->capacity() - 1) {
+            a = grow(a, b, t);
+        }
+
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only. Return nullptr if empty.
+    T *pop() {
+        auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+        auto *a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // empty.
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T *item = a->get(b);
+        if (t == b) {
+            // last item: race against thieves for it.
+            if (!m_top.compare_exchange_strong(t,
+                                               t + 1,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread. Return nullptr if empty or if the steal lost a race
+    // (in which case the caller may retry).
+    T *steal() {
+        auto t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        auto *a = m_array.load(std::memory_order_acquire);
+        T *item = a->get(t);
+        if (!m_top.compare_exchange_strong(t,
+                                           t + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate if there are concurrent operations.
+    std::size_t size() const {
+        auto b = m_bottom.load(std::memory_order_relaxed);
+        auto t = m_top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<std::size_t>(b - t) : 0;
+    }
+
+private:
+    class array {
+    public:
+        explicit array(std::size_t capacity)
+            : m_mask(static_cast<std::int64_t>(capacity) - 1)
+            , m_items(new std::atomic<T *>[capacity]) {}
+
+        std::int64_t capacity() const { return m_mask + 1; }
+
+        T *get(std::int64_t i) const {
+            return m_items[i & m_mask].load(std::memory_order_relaxed);
+        }
+
+        void put(std::int64_t i, T *item) {
+            m_items[i & m_mask].store(item, std::memory_order_relaxed);
+        }
+
+    private:
+        const std::int64_t m_mask;
+        std::unique_ptr<std::atomic<T *>[]> m_items;
+    };
+
+    array *grow(array *old, std::int64_t b, std::int64_t t) {
+        auto cap = static_cast<std::size_t>(old->capacity()) * 2;
+        m_arrays.push_back(std::make_unique<array>(cap));
+        auto *a = m_arrays.back().get();
+        for (auto i = t; i < b; ++i) {
+            a->put(i, old->get(i));
+        }
+        m_array.store(a, std::memory_order_release);
+        return a;
+    }
+
+    alignas(64) std::atomic<std::int64_t> m_top {0};
+    alignas(64) std::atomic<std::int64_t> m_bottom {0};
+    std::atomic<array *> m_array {nullptr};
+
+    // owner only; current and retired arrays.
+    std::vector<std::unique_ptr<array>> m_arrays;
+};
+
+}  // namespace impl
+
+/*
+ * Thread pool where each worker has its own task deque.
+ *
+ * Unlike the ThreadPool, there is no dispatcher thread: tasks are picked
+ * up by the workers directly. A task enqueued from inside a task running
+ * on a worker goes to the back of that worker's own deque and is popped in
+ * LIFO order (good for locality, and for divide-and-conquer style
+ * parallelism). Tasks enqueued from outside the pool go to a shared
+ * injection queue. Workers that run out of work take from the injection
+ * queue or steal from the front of the deque of another, randomly
+ * chosen, worker. Workers that find nothing to do park on a futex until
+ * more work is enqueued.
+ *
+ * The enqueue_task() API is the same as that of ThreadPool.
+ * NOTE: no ordering guarantee is given for the execution of the tasks.
+ */
+class WorkStealingPool final {
+public:
+    DISALLOW_COPY_AND_MOVE(WorkStealingPool);
+
+    /* Create a pool of num_workers worker threads. The workers are only
+     * spawned when start() is called. */
+    explicit WorkStealingPool(
+      std::uint16_t num_workers = static_cast<std::uint16_t>(
+        std::min<unsigned>(std::max(1u, std::thread::hardware_concurrency()),
+                           std::numeric_limits<std::uint16_t>::max())));
+
+    /* Stop the pool; tasks not yet started are discarded. */
+    ~WorkStealingPool();
+
+    /* Spawn the worker threads. Tasks enqueued before this is called
+     * are buffered. */
+    void start();
+
+    /* Stop and join all the workers. Blocks until each worker has completed
+     * its current task, if any. Pending tasks are left unexecuted.
+     * The pool cannot be restarted. */
+    void stop();
+
+    /* Schedule a task for execution. */
+    void enqueue_task(std::unique_ptr<tarp::sched::interfaces::task> task);
+
+    /* Schedule f for execution, fire-and-forget. See ThreadPool::post. */
+    template<typename F>
+    void post(F &&f) {
+        enqueue_task(tarp::sched::make_inline_task(std::forward<F>(f)));
+    }
+
+    /* Run one pending task, if any, on the calling thread. Return true if a
+     * task was run, else false. This is useful for a task that must wait
+     * on the result of other tasks: rather than blocking the worker (which
+     * with enough such tasks could deadlock the pool), it can help out
+     * until the result is available. */
+    bool try_run_one();
+
+    /* Get the (approximate) number of tasks queued waiting for execution. */
+    std::size_t get_queue_length() const;
+
+    /* total number of tasks executed across all workers combined */
+    std::size_t get_num_tasks_handled() const;
+
+    std::size_t get_num_threads() const;
+
+    /* Snapshot of the execution metrics (see ThreadPool::get_metrics).
+     * NOTE: to avoid a shared counter on the hot path, queue_length_hwm is
+     * the highest length seen of any *single* queue (the deque of a worker
+     * or the injection queue) rather than of all queues combined. Tasks run
+     * via try_run_one() from outside the pool are not accounted for in the
+     * per-worker metrics. */
+    pool_metrics get_metrics() const;
+
+private:
+    using task_t = tarp::sched::interfaces::task;
+
+    struct worker {
+        explicit worker(std::uint32_t id) : recorder(id) {}
+
+        impl::ws_deque<task_t> deque;
+        std::thread thread;
+        threading::impl::worker_recorder recorder;
+    };
+
+    void loop(std::size_t idx);
+    task_t *find_task(worker *self);
+    task_t *steal(worker *self);
+    void run_task(worker *self, task_t *task);
+    void notify();
+    worker *current_worker() const;
+
+    std::vector<std::unique_ptr<worker>> m_workers;
+
+    mutable std::mutex m_mtx;
+    std::deque<task_t *> m_injectq;
+    bool m_started {false};
+
+    std::atomic<bool> m_stopping {false};
+    std::atomic<std::size_t> m_num_tasks_handled {0};
+    impl::watermark m_queue_hwm;
+
+    // Parking: workers wait on m_epoch, which is bumped whenever there may
+    // be new work and there are parked workers.
+    std::atomic<std::uint32_t> m_epoch {0};
+    std::atomic<std::uint32_t> m_num_sleepers {0};
+};
+
+}  // namespace threading
+}  // namespace tarp
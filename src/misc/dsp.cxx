@@ -0,0 +1,217 @@
+#include <tarp/dsp.hxx>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TARP_DSP_X86
+#endif
+
+#include <stdexcept>
+
+namespace tarp {
+namespace dsp {
+
+namespace {
+
+#ifdef TARP_DSP_X86
+
+// The SIMD kernels compute several consecutive outputs at once: for each
+// tap, the tap is broadcast to all lanes and multiplied with the inputs
+// that tap applies to for those outputs. The outputs left over at the end
+// (fewer than a vector's worth) are computed by the scalar kernel.
+// NOTE: every kernel computes each output with the same operations in the
+// same order as the scalar kernel (a multiply, then an add, for each tap
+// in turn), so they all give bit-identical outputs, no matter how many
+// outputs are computed at once. This is why the AVX2 kernels do not use
+// FMA: the fused multiply-add rounds once rather than twice.
+
+__attribute__((target("sse2"))) void fir_sse2(const float *in,
+                                              std::size_t nout,
+                                              const float *taps,
+                                              std::size_t ntaps,
+                                              float *out) {
+    std::size_t k = 0;
+    for (; k + 4 <= nout; k += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (std::size_t j = 0; j < ntaps; ++j) {
+            __m128 x = _mm_loadu_ps(in + k + j);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(taps[j]), x));
+        }
+        _mm_storeu_ps(out + k, acc);
+    }
+
+    impl::fir_scalar(in + k, nout - k, taps, ntaps, out + k);
+}
+
+__attribute__((target("sse2"))) void fir_sse2(const double *in,
+                                              std::size_t nout,
+                                              const double *taps,
+                                              std::size_t ntaps,
+                                              double *out) {
+    std::size_t k = 0;
+    for (; k + 2 <= nout; k += 2) {
+        __m128d acc = _mm_setzero_pd();
+        for (std::size_t j = 0; j < ntaps; ++j) {
+            __m128d x = _mm_loadu_pd(in + k + j);
+            acc = _mm_add_pd(acc, _mm_mul_pd(_mm_set1_pd(taps[j]), x));
+        }
+        _mm_storeu_pd(out + k, acc);
+    }
+
+    impl::fir_scalar(in + k, nout - k, taps, ntaps, out + k);
+}
+
+// NOTE: two accumulators (i.e. 2 vectors' worth of outputs) per iteration,
+// to hide the latency of the add.
+__attribute__((target("avx2"))) void fir_avx2(const float *in,
+                                              std::size_t nout,
+                                              const float *taps,
+                                              std::size_t ntaps,
+                                              float *out) {
+    std::size_t k = 0;
+    for (; k + 16 <= nout; k += 16) {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (std::size_t j = 0; j < ntaps; ++j) {
+            __m256 tap = _mm256_set1_ps(taps[j]);
+            acc0 = _mm256_add_ps(
+              acc0, _mm256_mul_ps(tap, _mm256_loadu_ps(in + k + j)));
+            acc1 = _mm256_add_ps(
+              acc1, _mm256_mul_ps(tap, _mm256_loadu_ps(in + k + j + 8)));
+        }
+        _mm256_storeu_ps(out + k, acc0);
+        _mm256_storeu_ps(out + k + 8, acc1);
+    }
+
+    for (; k + 8 <= nout; k += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (std::size_t j = 0; j < ntaps; ++j) {
+            __m256 tap = _mm256_set1_ps(taps[j]);
+            acc = _mm256_add_ps(
+              acc, _mm256_mul_ps(tap, _mm256_loadu_ps(in + k + j)));
+        }
+        _mm256_storeu_ps(out + k, acc);
+    }
+
+    impl::fir_scalar(in + k, nout - k, taps, ntaps, out + k);
+}
+
+__attribute__((target("avx2"))) void fir_avx2(const double *in,
+                                              std::size_t nout,
+                                              const double *taps,
+                                              std::size_t ntaps,
+                                              double *out) {
+    std::size_t k = 0;
+    for (; k + 8 <= nout; k += 8) {
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        for (std::size_t j = 0; j < ntaps; ++j) {
+            __m256d tap = _mm256_set1_pd(taps[j]);
+            acc0 = _mm256_add_pd(
+              acc0, _mm256_mul_pd(tap, _mm256_loadu_pd(in + k + j)));
+            acc1 = _mm256_add_pd(
+              acc1, _mm256_mul_pd(tap, _mm256_loadu_pd(in + k + j + 4)));
+        }
+        _mm256_storeu_pd(out + k, acc0);
+        _mm256_storeu_pd(out + k + 4, acc1);
+    }
+
+    for (; k + 4 <= nout; k += 4) {
+        __m256d acc = _mm256_setzero_pd();
+        for (std::size_t j = 0; j < ntaps; ++j) {
+            __m256d tap = _mm256_set1_pd(taps[j]);
+            acc = _mm256_add_pd(
+              acc, _mm256_mul_pd(tap, _mm256_loadu_pd(in + k + j)));
+        }
+        _mm256_storeu_pd(out + k, acc);
+    }
+
+    impl::fir_scalar(in + k, nout - k, taps, ntaps, out + k);
+}
+
+#endif /* TARP_DSP_X86 */
+
+isa detect_isa() {
+#ifdef TARP_DSP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return isa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return isa::SSE2;
+    }
+#endif
+    return isa::SCALAR;
+}
+
+template<typename T>
+std::size_t fir_dispatch(const T *in,
+                         std::size_t n,
+                         const T *taps,
+                         std::size_t ntaps,
+                         T *out,
+                         isa use) {
+    if (ntaps == 0) {
+        throw std::invalid_argument("Invalid FIR filter with 0 taps");
+    }
+
+    if (n < ntaps) {
+        return 0;
+    }
+
+    const std::size_t nout = n - ntaps + 1;
+    use = std::min(use, detected_isa());
+
+    switch (use) {
+#ifdef TARP_DSP_X86
+    case isa::AVX2: fir_avx2(in, nout, taps, ntaps, out); break;
+    case isa::SSE2: fir_sse2(in, nout, taps, ntaps, out); break;
+#endif
+    default: impl::fir_scalar(in, nout, taps, ntaps, out); break;
+    }
+
+    return nout;
+}
+
+}  // namespace
+
+isa detected_isa() {
+    static const isa detected = detect_isa();
+    return detected;
+}
+
+std::size_t fir(const float *in,
+                std::size_t n,
+                const float *taps,
+                std::size_t ntaps,
+                float *out) {
+    return fir_dispatch(in, n, taps, ntaps, out, detected_isa());
+}
+
+std::size_t fir(const double *in,
+                std::size_t n,
+                const double *taps,
+                std::size_t ntaps,
+                double *out) {
+    return fir_dispatch(in, n, taps, ntaps, out, detected_isa());
+}
+
+std::size_t fir(const float *in,
+                std::size_t n,
+                const float *taps,
+                std::size_t ntaps,
+                float *out,
+                isa use) {
+    return fir_dispatch(in, n, taps, ntaps, out, use);
+}
+
+std::size_t fir(const double *in,
+                std::size_t n,
+                const double *taps,
+                std::size_t ntaps,
+                double *out,
+                isa use) {
+    return fir_dispatch(in, n, taps, ntaps, out, use);
+}
+
+}  // namespace dsp
+}  // namespace tarp
@@ -0,0 +1,220 @@
+#include <tarp/event.hxx>
+#include <tarp/executor.hxx>
+#include <tarp/sched.hxx>
+#include <tarp/threading.hxx>
+
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace tarp {
+namespace exec {
+
+void queue_executor::post(std::function<void()> job) {
+    if (!job) {
+        throw std::invalid_argument("Illegal attempt to post empty job");
+    }
+
+    {
+        std::unique_lock l {m_mtx};
+        m_jobs.push_back(std::move(job));
+    }
+    m_cond.notify_one();
+}
+
+std::size_t queue_executor::run_pending() {
+    decltype(m_jobs) jobs;
+
+    {
+        std::unique_lock l {m_mtx};
+        std::swap(jobs, m_jobs);
+    }
+
+    for (auto &job : jobs) {
+        job();
+    }
+
+    return jobs.size();
+}
+
+bool queue_executor::run_one_for(std::chrono::microseconds timeout) {
+    std::function<void()> job;
+
+    {
+        std::unique_lock l {m_mtx};
+        if (!m_cond.wait_for(l, timeout, [this] { return !m_jobs.empty(); })) {
+            return false;
+        }
+
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+    }
+
+    job();
+    return true;
+}
+
+std::size_t queue_executor::size() const {
+    std::unique_lock l {m_mtx};
+    return m_jobs.size();
+}
+
+//
+
+evp_executor::evp_executor(std::shared_ptr<tarp::EventPump> evp,
+                           unsigned event_type)
+    : m_evp(std::move(evp)), m_event_type(event_type) {
+    if (!m_evp) {
+        throw std::invalid_argument("null EventPump");
+    }
+
+    int rc = m_evp->set_user_event_callback(
+      m_event_type, [](unsigned, void *data) {
+          std::unique_ptr<std::function<void()>> job(
+            static_cast<std::function<void()> *>(data));
+          if (job) {
+              (*job)();
+          }
+          return true;
+      });
+
+    if (rc != 0) {
+        throw std::runtime_error("failed to register user event callback");
+    }
+}
+
+void evp_executor::post(std::function<void()> job) {
+    if (!job) {
+        throw std::invalid_argument("Illegal attempt to post empty job");
+    }
+
+    // NOTE: ownership passes to the user event callback. This is the case
+    // even if push_event fails, since the event may already have been
+    // enqueued by then (e.g. if only the wakeup of the event pump failed).
+    auto *data = new std::function<void()>(std::move(job));
+    if (m_evp->push_event(m_event_type, data) != 0) {
+        throw std::runtime_error("failed to push user event");
+    }
+}
+
+//
+
+threadpool_executor::threadpool_executor(tarp::threading::ThreadPool &pool)
+    : m_pool(pool) {
+}
+
+void threadpool_executor::post(std::function<void()> job) {
+    if (!job) {
+        throw std::invalid_argument("Illegal attempt to post empty job");
+    }
+
+    m_pool.post(std::move(job));
+}
+
+//
+
+namespace impl {
+struct batch_state {
+    explicit batch_state(interfaces::executor &ex) : target(ex) {}
+
+    interfaces::executor &target;
+
+    mutable std::mutex mtx;
+    std::vector<std::function<void()>> jobs;
+    bool scheduled {false};
+    std::size_t num_batches {0};
+};
+
+namespace {
+void run_batch(const std::shared_ptr<batch_state> &state) {
+    std::vector<std::function<void()>> jobs;
+
+    {
+        std::unique_lock l {state->mtx};
+        std::swap(jobs, state->jobs);
+
+        // jobs posted from now on go in a new batch.
+        state->scheduled = false;
+    }
+
+    for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+        try {
+            (*it)();
+        } catch (...) {
+            // do not lose the rest of the batch: put it back at the front
+            // of the queue and make sure another batch will run it.
+            bool schedule = false;
+            {
+                std::unique_lock l {state->mtx};
+                state->jobs.insert(state->jobs.begin(),
+                                   std::make_move_iterator(std::next(it)),
+                                   std::make_move_iterator(jobs.end()));
+                if (!state->jobs.empty() && !state->scheduled) {
+                    state->scheduled = true;
+                    state->num_batches++;
+                    schedule = true;
+                }
+            }
+
+            if (schedule) {
+                try {
+                    state->target.post([state] { run_batch(state); });
+                } catch (...) {
+                    // the jobs go with the next batch (see post).
+                    std::unique_lock l {state->mtx};
+                    state->scheduled = false;
+                    state->num_batches--;
+                }
+            }
+            throw;
+        }
+    }
+}
+}  // namespace
+
+}  // namespace impl
+
+batching_executor::batching_executor(interfaces::executor &ex)
+    : m_state(std::make_shared<impl::batch_state>(ex)) {
+}
+
+void batching_executor::post(std::function<void()> job) {
+    if (!job) {
+        throw std::invalid_argument("Illegal attempt to post empty job");
+    }
+
+    {
+        std::unique_lock l {m_state->mtx};
+        m_state->jobs.push_back(std::move(job));
+        if (m_state->scheduled) {
+            return;
+        }
+        m_state->scheduled = true;
+        m_state->num_batches++;
+    }
+
+    // NOTE: the state is kept alive by the batch until it runs.
+    try {
+        m_state->target.post(
+          [state = m_state] { impl::run_batch(state); });
+    } catch (...) {
+        // the queued jobs go with the next batch.
+        std::unique_lock l {m_state->mtx};
+        m_state->scheduled = false;
+        m_state->num_batches--;
+        throw;
+    }
+}
+
+std::size_t batching_executor::size() const {
+    std::unique_lock l {m_state->mtx};
+    return m_state->jobs.size();
+}
+
+std::size_t batching_executor::num_batches() const {
+    std::unique_lock l {m_state->mtx};
+    return m_state->num_batches;
+}
+
+}  // namespace exec
+}  // namespace tarp
@@ -0,0 +1,77 @@
+#include <tarp/futex.hxx>
+
+#include <cerrno>
+#include <climits>
+
+extern "C" {
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+}
+
+namespace tarp {
+namespace futex {
+
+namespace {
+
+long sys_futex(std::atomic<std::uint32_t> &word,
+               int op,
+               std::uint32_t val,
+               const struct timespec *timeout,
+               bool shared) {
+    if (!shared) {
+        op |= FUTEX_PRIVATE_FLAG;
+    }
+
+    // NOTE: std::atomic<uint32_t> is guaranteed (see the static_asserts in
+    // the header) to have the same size and representation as uint32_t.
+    auto *addr = reinterpret_cast<std::uint32_t *>(&word);
+    return syscall(SYS_futex, addr, op, val, timeout, nullptr, 0);
+}
+
+}  // namespace
+
+bool wait(std::atomic<std::uint32_t> &word,
+          std::uint32_t expected,
+          bool shared) {
+    sys_futex(word, FUTEX_WAIT, expected, nullptr, shared);
+    return true;
+}
+
+bool wait_for(std::atomic<std::uint32_t> &word,
+              std::uint32_t expected,
+              std::chrono::nanoseconds rel_time,
+              bool shared) {
+    if (rel_time.count() <= 0) {
+        return false;
+    }
+
+    using namespace std::chrono;
+    auto secs = duration_cast<seconds>(rel_time);
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(secs.count());
+    ts.tv_nsec = static_cast<long>((rel_time - secs).count());
+
+    // EAGAIN => the value of the word was not the expected one when
+    // the call was made; EINTR => interrupted by a signal. Both count as
+    // (possibly spurious) wakeups.
+    if (sys_futex(word, FUTEX_WAIT, expected, &ts, shared) < 0) {
+        return errno != ETIMEDOUT;
+    }
+
+    return true;
+}
+
+int wake(std::atomic<std::uint32_t> &word, int n, bool shared) {
+    auto rc = sys_futex(word, FUTEX_WAKE, static_cast<std::uint32_t>(n),
+                        nullptr, shared);
+    return rc < 0 ? 0 : static_cast<int>(rc);
+}
+
+int wake_all(std::atomic<std::uint32_t> &word, bool shared) {
+    return wake(word, INT_MAX, shared);
+}
+
+}  // namespace futex
+}  // namespace tarp
@@ -0,0 +1,190 @@
+#include <tarp/histogram.hxx>
+
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+namespace tarp {
+
+namespace {
+
+// Atomically update cur to v if v is smaller (cmp=less) or greater.
+template<typename cmp>
+void update_extremum(std::atomic<std::uint64_t> &cur, std::uint64_t v) {
+    auto prev = cur.load(std::memory_order_relaxed);
+    while (cmp {}(v, prev) &&
+           !cur.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace
+
+histogram::histogram() {
+    for (auto &b : m_buckets) {
+        b.store(0, std::memory_order_relaxed);
+    }
+}
+
+histogram::histogram(const histogram &other) : histogram() {
+    merge(other);
+}
+
+histogram &histogram::operator=(const histogram &other) {
+    if (this != &other) {
+        reset();
+        merge(other);
+    }
+    return *this;
+}
+
+std::size_t histogram::bucket_index(std::uint64_t v) {
+    if (v < SUB_BUCKET_COUNT) {
+        return static_cast<std::size_t>(v);
+    }
+
+    // position of the most significant bit; >= SUB_BUCKET_BITS here.
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(v));
+    unsigned shift = msb - SUB_BUCKET_BITS;
+    auto sub = static_cast<std::size_t>(v >> shift) - SUB_BUCKET_COUNT;
+    return ((shift + 1) << SUB_BUCKET_BITS) + sub;
+}
+
+// Return the midpoint of the range of values that map to bucket idx.
+std::uint64_t histogram::bucket_value(std::size_t idx) {
+    std::size_t group = idx >> SUB_BUCKET_BITS;
+    if (group == 0) {
+        return idx;
+    }
+
+    unsigned shift = static_cast<unsigned>(group - 1);
+    std::uint64_t sub = SUB_BUCKET_COUNT + (idx & (SUB_BUCKET_COUNT - 1));
+    std::uint64_t lo = sub << shift;
+    std::uint64_t width = std::uint64_t {1} << shift;
+    return lo + width / 2;
+}
+
+void histogram::record(std::uint64_t v, std::uint64_t n) {
+    if (n == 0) {
+        return;
+    }
+
+    m_buckets[bucket_index(v)].fetch_add(n, std::memory_order_relaxed);
+    m_count.fetch_add(n, std::memory_order_relaxed);
+    m_sum.fetch_add(v * n, std::memory_order_relaxed);
+    update_extremum<std::less<std::uint64_t>>(m_min, v);
+    update_extremum<std::greater<std::uint64_t>>(m_max, v);
+}
+
+std::uint64_t histogram::count() const {
+    return m_count.load(std::memory_order_relaxed);
+}
+
+std::uint64_t histogram::min() const {
+    return count() > 0 ? m_min.load(std::memory_order_relaxed) : 0;
+}
+
+std::uint64_t histogram::max() const {
+    return m_max.load(std::memory_order_relaxed);
+}
+
+double histogram::mean() const {
+    auto n = count();
+    if (n == 0) {
+        return 0;
+    }
+    return static_cast<double>(m_sum.load(std::memory_order_relaxed)) /
+           static_cast<double>(n);
+}
+
+std::uint64_t histogram::percentile(double p) const {
+    if (p < 0 || p > 100) {
+        throw std::invalid_argument("percentile must be in [0, 100]");
+    }
+
+    // NOTE: the bucket counts are summed up rather than using m_count so
+    // that concurrent recording can never cause the target to be missed.
+    std::uint64_t total = 0;
+    for (const auto &b : m_buckets) {
+        total += b.load(std::memory_order_relaxed);
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    auto target = static_cast<std::uint64_t>(
+      std::ceil(p / 100.0 * static_cast<double>(total)));
+    if (target == 0) {
+        target = 1;
+    }
+
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i < NUM_BUCKETS; ++i) {
+        cumulative += m_buckets[i].load(std::memory_order_relaxed);
+        if (cumulative >= target) {
+            // the bucket midpoint may lie outside the range of the values
+            // actually recorded.
+            auto v = bucket_value(i);
+            auto lo = min();
+            auto hi = max();
+            return v < lo ? lo : (v > hi ? hi : v);
+        }
+    }
+
+    return max();
+}
+
+histogram::summary histogram::summarize() const {
+    summary s;
+    s.count = count();
+    s.min = min();
+    s.max = max();
+    s.mean = mean();
+    s.p50 = percentile(50);
+    s.p90 = percentile(90);
+    s.p99 = percentile(99);
+    s.p999 = percentile(99.9);
+    return s;
+}
+
+void histogram::merge(const histogram &other) {
+    auto n = other.count();
+    if (n == 0) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < NUM_BUCKETS; ++i) {
+        auto c = other.m_buckets[i].load(std::memory_order_relaxed);
+        if (c > 0) {
+            m_buckets[i].fetch_add(c, std::memory_order_relaxed);
+        }
+    }
+
+    m_count.fetch_add(n, std::memory_order_relaxed);
+    m_sum.fetch_add(other.m_sum.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+    update_extremum<std::less<std::uint64_t>>(
+      m_min, other.m_min.load(std::memory_order_relaxed));
+    update_extremum<std::greater<std::uint64_t>>(
+      m_max, other.m_max.load(std::memory_order_relaxed));
+}
+
+void histogram::reset() {
+    for (auto &b : m_buckets) {
+        b.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(std::numeric_limits<std::uint64_t>::max(),
+                std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+std::ostream &operator<<(std::ostream &os, const histogram::summary &s) {
+    os << "count=" << s.count << " min=" << s.min << " max=" << s.max
+       << " mean=" << s.mean << " p50=" << s.p50 << " p90=" << s.p90
+       << " p99=" << s.p99 << " p99.9=" << s.p999;
+    return os;
+}
+
+}  // namespace tarp
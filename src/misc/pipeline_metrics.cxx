@@ -0,0 +1,161 @@
+#include <tarp/pipeline_metrics.hxx>
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+namespace tarp {
+
+namespace impl {
+
+stage_recorder::stage_recorder(std::string name) : m_name(std::move(name)) {
+}
+
+void stage_recorder::record_inputs(std::uint64_t n,
+                                   std::chrono::nanoseconds elapsed) {
+    if (n == 0) {
+        return;
+    }
+
+    auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(
+      0, static_cast<std::int64_t>(elapsed.count())));
+
+    m_process_time.record(ns / n, n);
+    m_busy_ns.fetch_add(ns, std::memory_order_relaxed);
+    m_num_inputs.fetch_add(n, std::memory_order_relaxed);
+}
+
+stage_metrics stage_recorder::snapshot() const {
+    stage_metrics m;
+    m.name = m_name;
+    m.num_inputs = m_num_inputs.load(std::memory_order_relaxed);
+    m.num_outputs = m_num_outputs.load(std::memory_order_relaxed);
+    m.busy_time = std::chrono::nanoseconds(
+      static_cast<std::int64_t>(m_busy_ns.load(std::memory_order_relaxed)));
+    m.process_time = m_process_time;
+    return m;
+}
+
+void stage_recorder::reset() {
+    m_num_inputs.store(0, std::memory_order_relaxed);
+    m_num_outputs.store(0, std::memory_order_relaxed);
+    m_busy_ns.store(0, std::memory_order_relaxed);
+    m_process_time.reset();
+}
+
+}  // namespace impl
+
+std::vector<stage_metrics> pipeline_profiler::snapshot() const {
+    std::unique_lock l {m_mtx};
+
+    std::vector<stage_metrics> metrics;
+    metrics.reserve(m_recorders.size());
+
+    for (const auto &r : m_recorders) {
+        metrics.push_back(r->snapshot());
+
+        const void *upstream = r->upstream();
+        if (upstream == nullptr) {
+            continue;
+        }
+
+        for (std::size_t i = 0; i < m_recorders.size(); ++i) {
+            if (m_recorders[i]->stage() == upstream) {
+                metrics.back().upstream = i;
+                break;
+            }
+        }
+    }
+
+    return metrics;
+}
+
+void pipeline_profiler::dump(std::ostream &os) const {
+    const auto metrics = snapshot();
+
+    std::vector<std::vector<std::size_t>> downstream(metrics.size());
+    std::vector<std::size_t> roots;
+    std::uint64_t total_ns = 0;
+
+    for (std::size_t i = 0; i < metrics.size(); ++i) {
+        total_ns += static_cast<std::uint64_t>(metrics[i].busy_time.count());
+        if (metrics[i].upstream.has_value()) {
+            downstream[*metrics[i].upstream].push_back(i);
+        } else {
+            roots.push_back(i);
+        }
+    }
+
+    // NOTE: every stage is joined to at most one upstream stage, so this
+    // is a forest (no stage is reachable from more than one root).
+    std::vector<std::uint64_t> branch_ns(metrics.size(), 0);
+    std::function<std::uint64_t(std::size_t)> sum_branch =
+      [&](std::size_t i) {
+          auto ns = static_cast<std::uint64_t>(metrics[i].busy_time.count());
+          for (auto j : downstream[i]) {
+              ns += sum_branch(j);
+          }
+          branch_ns[i] = ns;
+          return ns;
+      };
+
+    for (auto i : roots) {
+        sum_branch(i);
+    }
+
+    auto percent = [total_ns](std::uint64_t ns) {
+        return total_ns > 0 ? 100.0 * static_cast<double>(ns) /
+                                static_cast<double>(total_ns)
+                            : 0.0;
+    };
+
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+
+    os << std::left << std::setw(28) << "stage" << std::right
+       << std::setw(12) << "inputs" << std::setw(12) << "outputs"
+       << std::setw(8) << "drop%" << std::setw(12) << "busy(ms)"
+       << std::setw(8) << "self%" << std::setw(9) << "branch%"
+       << std::setw(10) << "p50(ns)" << std::setw(10) << "p99(ns)" << "\n";
+
+    std::function<void(std::size_t, unsigned)> print = [&](std::size_t i,
+                                                           unsigned depth) {
+        const auto &m = metrics[i];
+        auto self_ns = static_cast<std::uint64_t>(m.busy_time.count());
+
+        std::ostringstream name;
+        name << std::string(depth * 2, ' ') << (depth > 0 ? "`-" : "")
+             << m.name;
+
+        os << std::left << std::setw(28) << name.str() << std::right
+           << std::setw(12) << m.num_inputs << std::setw(12) << m.num_outputs
+           << std::fixed << std::setprecision(1) << std::setw(8)
+           << 100 * m.drop_ratio() << std::setprecision(3) << std::setw(12)
+           << static_cast<double>(self_ns) / 1e6 << std::setprecision(1)
+           << std::setw(8) << percent(self_ns) << std::setw(9)
+           << percent(branch_ns[i]) << std::setw(10)
+           << m.process_time.percentile(50) << std::setw(10)
+           << m.process_time.percentile(99) << "\n";
+
+        for (auto j : downstream[i]) {
+            print(j, depth + 1);
+        }
+    };
+
+    for (auto i : roots) {
+        print(i, 0);
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void pipeline_profiler::reset() {
+    std::unique_lock l {m_mtx};
+    for (auto &r : m_recorders) {
+        r->reset();
+    }
+}
+
+}  // namespace tarp
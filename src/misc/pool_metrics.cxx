@@ -0,0 +1,72 @@
+#include <tarp/pool_metrics.hxx>
+
+namespace tarp::threading {
+
+namespace impl {
+
+using std::chrono::steady_clock;
+
+worker_recorder::worker_recorder(std::uint32_t worker_id)
+    : m_worker_id(worker_id), m_start(steady_clock::now()) {
+}
+
+void worker_recorder::run(tarp::sched::interfaces::task &task) {
+    auto start = begin(task);
+    task.execute();
+    end(start);
+}
+
+steady_clock::time_point
+worker_recorder::begin(const tarp::sched::interfaces::task &task) {
+    auto start = steady_clock::now();
+
+    auto enqueued = task.get_enqueue_time();
+    if (enqueued != steady_clock::time_point {}) {
+        m_queue_wait.record(start - enqueued);
+        m_window_queue_wait.record(start - enqueued);
+    }
+
+    return start;
+}
+
+void worker_recorder::end(steady_clock::time_point start) {
+    auto elapsed = steady_clock::now() - start;
+    m_exec_time.record(elapsed);
+    m_busy_ns.fetch_add(
+      static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+      std::memory_order_relaxed);
+    m_num_tasks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void worker_recorder::record_steal() {
+    m_num_steals.fetch_add(1, std::memory_order_relaxed);
+}
+
+worker_metrics worker_recorder::snapshot() const {
+    worker_metrics m;
+    m.worker_id = m_worker_id;
+    m.num_tasks = m_num_tasks.load(std::memory_order_relaxed);
+    m.num_steals = m_num_steals.load(std::memory_order_relaxed);
+    m.busy_time = std::chrono::nanoseconds(
+      static_cast<std::int64_t>(m_busy_ns.load(std::memory_order_relaxed)));
+    m.uptime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      steady_clock::now() - m_start);
+    m.queue_wait = m_queue_wait;
+    m.exec_time = m_exec_time;
+    return m;
+}
+
+void worker_recorder::drain_queue_wait_window(histogram &into) {
+    into.merge(m_window_queue_wait);
+    m_window_queue_wait.reset();
+}
+
+void accumulate(pool_metrics &m, const worker_metrics &w) {
+    m.queue_wait.merge(w.queue_wait);
+    m.exec_time.merge(w.exec_time);
+}
+
+}  // namespace impl
+
+}  // namespace tarp::threading
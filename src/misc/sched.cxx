@@ -32,7 +32,7 @@ bool T::expired() const {
     return time_now() >= m_next_deadline;
 }
 
-std::chrono::system_clock::time_point T::get_expiration_time() const {
+std::chrono::steady_clock::time_point T::get_expiration_time() const {
     return m_next_deadline;
 }
 
@@ -87,12 +87,12 @@ void T::renew() {
     m_num_renewals++;
 }
 
-void T::set_expiration(std::chrono::system_clock::time_point deadline) {
+void T::set_expiration(std::chrono::steady_clock::time_point deadline) {
     m_next_deadline = deadline;
 }
 
-std::chrono::system_clock::time_point T::time_now() const {
-    return std::chrono::system_clock::now();
+std::chrono::steady_clock::time_point T::time_now() const {
+    return std::chrono::steady_clock::now();
 }
 
 std::chrono::milliseconds T::get_interval() const {
@@ -0,0 +1,418 @@
+// NOTE: common.h must be included before ioutils.h: the latter includes it
+// from within an extern "C" block, which breaks the C++-only parts.
+#include <tarp/common.h>
+#include <tarp/futex.hxx>
+#include <tarp/ioutils.h>
+#include <tarp/shmchan.hxx>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+namespace tarp {
+namespace evchan {
+namespace impl {
+
+using namespace std::string_literals;
+
+namespace {
+
+constexpr std::uint32_t SHM_MAGIC = 0x74617270;  // 'tarp'
+constexpr std::uint32_t SHM_VERSION = 1;
+
+// Message sent alongside the memfd descriptor over a unix domain socket;
+// lets the receiver tell a channel descriptor from a stray message.
+constexpr std::uint8_t SHM_FD_MSG[] = {'s', 'h', 'm', 'c'};
+
+// The slots start on a cache line boundary after the header so the
+// (frequently written) header does not share a line with the first slots.
+constexpr std::size_t SLOTS_OFFSET =
+  ((sizeof(shm_header) + 63) / 64) * 64;
+
+std::runtime_error syserr(const std::string &what) {
+    return std::runtime_error(what + ": "s + strerror(errno));
+}
+
+}  // namespace
+
+shm_ring::shm_ring(int fd, void *base, std::size_t mapsz)
+    : m_fd(fd)
+    , m_base(base)
+    , m_mapsz(mapsz)
+    , m_hdr(static_cast<shm_header *>(base))
+    , m_slots(static_cast<std::uint8_t *>(base) + SLOTS_OFFSET) {
+}
+
+shm_ring::~shm_ring() {
+    munmap(m_base, m_mapsz);
+    ::close(m_fd);
+}
+
+std::unique_ptr<shm_ring>
+shm_ring::create(std::size_t elem_size, std::size_t capacity, bool circular) {
+    if (elem_size == 0 || capacity == 0) {
+        throw std::invalid_argument("invalid shm_ring dimensions");
+    }
+
+    std::size_t mapsz = SLOTS_OFFSET + elem_size * capacity;
+
+    int fd = memfd_create("tarp.shmchan", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        throw syserr("memfd_create");
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(mapsz)) < 0) {
+        auto e = syserr("ftruncate");
+        ::close(fd);
+        throw e;
+    }
+
+    // Prevent anyone with access to the descriptor from resizing the
+    // segment, which would cause SIGBUS in the other processes.
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        auto e = syserr("fcntl(F_ADD_SEALS)");
+        ::close(fd);
+        throw e;
+    }
+
+    void *base = mmap(nullptr, mapsz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        auto e = syserr("mmap");
+        ::close(fd);
+        throw e;
+    }
+
+    // the memfd is zero-filled; construct the header in place.
+    auto *hdr = new (base) shm_header {};
+    hdr->version = SHM_VERSION;
+    hdr->elem_size = elem_size;
+    hdr->capacity = capacity;
+    hdr->circular = circular;
+
+    // publish the segment as initialized last.
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr->magic = SHM_MAGIC;
+
+    return std::unique_ptr<shm_ring>(new shm_ring(fd, base, mapsz));
+}
+
+std::unique_ptr<shm_ring> shm_ring::attach(int fd, std::size_t elem_size) {
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+        auto e = syserr("fstat");
+        ::close(fd);
+        throw e;
+    }
+
+    auto mapsz = static_cast<std::size_t>(sb.st_size);
+    if (mapsz < SLOTS_OFFSET) {
+        ::close(fd);
+        throw std::runtime_error("invalid shm_ring segment: too small");
+    }
+
+    void *base = mmap(nullptr, mapsz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        auto e = syserr("mmap");
+        ::close(fd);
+        throw e;
+    }
+
+    std::unique_ptr<shm_ring> ring(new shm_ring(fd, base, mapsz));
+    const auto *hdr = ring->m_hdr;
+
+    if (hdr->magic != SHM_MAGIC || hdr->version != SHM_VERSION) {
+        throw std::runtime_error("invalid shm_ring segment: bad magic");
+    }
+
+    if (hdr->elem_size != elem_size) {
+        throw std::runtime_error("shm_ring element size mismatch: "s +
+                                 std::to_string(hdr->elem_size) +
+                                 " != " + std::to_string(elem_size));
+    }
+
+    // NOTE: the header comes from the peer; nothing in it can be trusted.
+    // Written this way so a huge capacity cannot wrap the product around.
+    if (hdr->elem_size == 0 || hdr->capacity == 0 ||
+        hdr->capacity > (mapsz - SLOTS_OFFSET) / hdr->elem_size) {
+        throw std::runtime_error("invalid shm_ring segment: bad capacity");
+    }
+
+    ring->lock();
+    bool bad_indices = hdr->head >= hdr->capacity || hdr->count > hdr->capacity;
+    ring->unlock();
+    if (bad_indices) {
+        throw std::runtime_error("invalid shm_ring segment: bad head or count");
+    }
+
+    return ring;
+}
+
+std::size_t shm_ring::capacity() const {
+    return m_hdr->capacity;
+}
+
+bool shm_ring::circular() const {
+    return m_hdr->circular;
+}
+
+// See Drepper, 'Futexes Are Tricky', mutex #2.
+void shm_ring::lock() {
+    auto &word = m_hdr->lock;
+    std::uint32_t c = 0;
+    if (word.compare_exchange_strong(c, 1, std::memory_order_acquire)) {
+        return;
+    }
+
+    if (c != 2) {
+        c = word.exchange(2, std::memory_order_acquire);
+    }
+
+    while (c != 0) {
+        futex::wait(word, 2, true);
+        c = word.exchange(2, std::memory_order_acquire);
+    }
+}
+
+void shm_ring::unlock() {
+    auto &word = m_hdr->lock;
+    if (word.fetch_sub(1, std::memory_order_release) != 1) {
+        word.store(0, std::memory_order_release);
+        futex::wake(word, 1, true);
+    }
+}
+
+std::uint8_t *shm_ring::slot(std::uint64_t idx) {
+    return m_slots + idx * m_hdr->elem_size;
+}
+
+void shm_ring::pop_locked(void *dst) {
+    std::memcpy(dst, slot(m_hdr->head), m_hdr->elem_size);
+    m_hdr->head = (m_hdr->head + 1) % m_hdr->capacity;
+    m_hdr->count--;
+}
+
+void shm_ring::wake_readers(bool all) {
+    if (m_hdr->num_waiting_readers.load() > 0) {
+        futex::wake(m_hdr->readable_seq, all ? INT32_MAX : 1, true);
+    }
+}
+
+void shm_ring::wake_writers(bool all) {
+    if (m_hdr->num_waiting_writers.load() > 0) {
+        futex::wake(m_hdr->writable_seq, all ? INT32_MAX : 1, true);
+    }
+}
+
+int shm_ring::try_push(const void *src, void *evicted) {
+    int rc = 0;
+
+    lock();
+    if (m_hdr->closed.load(std::memory_order_relaxed)) {
+        unlock();
+        return -1;
+    }
+
+    if (m_hdr->count == m_hdr->capacity) {
+        if (!m_hdr->circular) {
+            unlock();
+            return -1;
+        }
+
+        if (evicted) {
+            pop_locked(evicted);
+        } else {
+            m_hdr->head = (m_hdr->head + 1) % m_hdr->capacity;
+            m_hdr->count--;
+        }
+        rc = 1;
+    }
+
+    auto tail = (m_hdr->head + m_hdr->count) % m_hdr->capacity;
+    std::memcpy(slot(tail), src, m_hdr->elem_size);
+    m_hdr->count++;
+    m_hdr->readable_seq.fetch_add(1, std::memory_order_release);
+    unlock();
+
+    wake_readers(false);
+    return rc;
+}
+
+bool shm_ring::push(const void *src,
+                    const std::chrono::steady_clock::time_point *deadline) {
+    for (;;) {
+        lock();
+        if (m_hdr->closed.load(std::memory_order_relaxed)) {
+            unlock();
+            return false;
+        }
+
+        if (m_hdr->count < m_hdr->capacity || m_hdr->circular) {
+            unlock();
+            if (try_push(src, nullptr) >= 0) {
+                return true;
+            }
+            continue;
+        }
+
+        // NOTE: the sequence word must be sampled and the waiter registered
+        // while the lock is held, otherwise a wakeup could be missed.
+        auto seq = m_hdr->writable_seq.load(std::memory_order_acquire);
+        m_hdr->num_waiting_writers.fetch_add(1);
+        unlock();
+
+        bool ok = true;
+        if (deadline) {
+            ok = futex::wait_until(m_hdr->writable_seq, seq, *deadline, true);
+        } else {
+            futex::wait(m_hdr->writable_seq, seq, true);
+        }
+
+        m_hdr->num_waiting_writers.fetch_sub(1);
+
+        if (!ok) {
+            return try_push(src, nullptr) >= 0;
+        }
+    }
+}
+
+bool shm_ring::try_pop(void *dst) {
+    lock();
+    if (m_hdr->count == 0) {
+        unlock();
+        return false;
+    }
+
+    pop_locked(dst);
+    m_hdr->writable_seq.fetch_add(1, std::memory_order_release);
+    unlock();
+
+    wake_writers(false);
+    return true;
+}
+
+bool shm_ring::pop(void *dst,
+                   const std::chrono::steady_clock::time_point *deadline) {
+    for (;;) {
+        lock();
+        if (m_hdr->count > 0) {
+            pop_locked(dst);
+            m_hdr->writable_seq.fetch_add(1, std::memory_order_release);
+            unlock();
+            wake_writers(false);
+            return true;
+        }
+
+        if (m_hdr->closed.load(std::memory_order_relaxed)) {
+            unlock();
+            return false;
+        }
+
+        auto seq = m_hdr->readable_seq.load(std::memory_order_acquire);
+        m_hdr->num_waiting_readers.fetch_add(1);
+        unlock();
+
+        bool ok = true;
+        if (deadline) {
+            ok = futex::wait_until(m_hdr->readable_seq, seq, *deadline, true);
+        } else {
+            futex::wait(m_hdr->readable_seq, seq, true);
+        }
+
+        m_hdr->num_waiting_readers.fetch_sub(1);
+
+        if (!ok) {
+            return try_pop(dst);
+        }
+    }
+}
+
+void shm_ring::close() {
+    lock();
+    m_hdr->closed.store(1, std::memory_order_relaxed);
+    m_hdr->readable_seq.fetch_add(1, std::memory_order_release);
+    m_hdr->writable_seq.fetch_add(1, std::memory_order_release);
+    unlock();
+
+    wake_readers(true);
+    wake_writers(true);
+}
+
+bool shm_ring::closed() const {
+    return m_hdr->closed.load(std::memory_order_acquire);
+}
+
+bool shm_ring::empty() const {
+    return size() == 0;
+}
+
+std::size_t shm_ring::size() const {
+    auto *self = const_cast<shm_ring *>(this);
+    self->lock();
+    auto n = m_hdr->count;
+    self->unlock();
+    return n;
+}
+
+void shm_ring::clear() {
+    lock();
+    m_hdr->head = 0;
+    m_hdr->count = 0;
+    m_hdr->writable_seq.fetch_add(1, std::memory_order_release);
+    unlock();
+
+    wake_writers(true);
+}
+
+void shm_ring::send_fd(int uds_fd) const {
+    std::uint8_t msg[sizeof(SHM_FD_MSG)];
+    std::memcpy(msg, SHM_FD_MSG, sizeof(msg));
+
+    size_t nwritten = 0;
+    auto res = send_msg_with_fd(
+      uds_fd, m_fd, msg, sizeof(msg), true, &nwritten, nullptr);
+    if (!res.ok) {
+        throw std::runtime_error("failed to send shm_ring fd: " + geterr(res));
+    }
+}
+
+int shm_ring::receive_fd(int uds_fd) {
+    std::uint8_t msg[sizeof(SHM_FD_MSG)];
+    size_t nread = 0;
+    int fd = -1;
+    struct sockaddr_un *src = nullptr;
+
+    auto res = receive_msg_with_fd(
+      uds_fd, &fd, msg, sizeof(msg), sizeof(msg), true, &nread, &src);
+    free(src);
+
+    if (!res.ok) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("failed to receive shm_ring fd: " +
+                                 geterr(res));
+    }
+
+    if (fd < 0 || nread != sizeof(msg) ||
+        std::memcmp(msg, SHM_FD_MSG, sizeof(msg)) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("unexpected message on shm_ring socket");
+    }
+
+    return fd;
+}
+
+}  // namespace impl
+}  // namespace evchan
+}  // namespace tarp
@@ -0,0 +1,233 @@
+#include <tarp/sketches.hxx>
+
+#include <cmath>
+#include <stdexcept>
+
+namespace tarp {
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+// The k1 scale function, mapping a quantile to the 'index' of the
+// centroid at that quantile. A centroid may span at most one unit of k,
+// which keeps the centroids small at the tails, where k is steep.
+double k_of_q(double q, double compression) {
+    return compression / (2 * PI) * std::asin(2 * q - 1);
+}
+
+double q_of_k(double k, double compression) {
+    if (k >= compression / 4) {
+        return 1;
+    }
+    return (std::sin(k * 2 * PI / compression) + 1) / 2;
+}
+
+}  // namespace
+
+tdigest::tdigest(double compression)
+    : m_compression(compression)
+    , m_buffer_limit(static_cast<std::size_t>(compression) * 5) {
+    if (!(compression >= 10)) {
+        throw std::invalid_argument("Invalid t-digest compression (< 10)");
+    }
+
+    m_buffer.reserve(m_buffer_limit);
+}
+
+void tdigest::add(double x, double weight) {
+    if (std::isnan(x) || !(weight > 0)) {
+        throw std::invalid_argument("Invalid t-digest value or weight");
+    }
+
+    m_buffer.push_back({x, weight});
+    m_total_weight += weight;
+    m_min = std::min(m_min, x);
+    m_max = std::max(m_max, x);
+
+    if (m_buffer.size() >= m_buffer_limit) {
+        flush();
+    }
+}
+
+void tdigest::merge(const tdigest &other) {
+    if (&other == this) {
+        throw std::invalid_argument(
+          "Illegal attempt to merge t-digest into itself");
+    }
+
+    // NOTE: merging into the buffer, rather than the centroids, means the
+    // centroids of both are recompacted together as a whole.
+    for (const auto *src : {&other.m_centroids, &other.m_buffer}) {
+        m_buffer.insert(m_buffer.end(), src->begin(), src->end());
+    }
+
+    m_total_weight += other.m_total_weight;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+
+    flush();
+}
+
+// Merge the buffered values into the centroids: sort everything and sweep
+// left to right, merging each centroid into the current one for as long as
+// the current one stays within one unit of k.
+void tdigest::flush() const {
+    if (m_buffer.empty()) {
+        return;
+    }
+
+    m_buffer.insert(m_buffer.end(), m_centroids.begin(), m_centroids.end());
+    std::sort(m_buffer.begin(), m_buffer.end(), [](auto &a, auto &b) {
+        return a.mean < b.mean;
+    });
+
+    m_centroids.clear();
+
+    double weight_so_far = 0;
+    double q_limit = q_of_k(k_of_q(0, m_compression) + 1, m_compression);
+    centroid cur = m_buffer.front();
+
+    for (std::size_t i = 1; i < m_buffer.size(); ++i) {
+        const auto &next = m_buffer[i];
+        double q = (weight_so_far + cur.weight + next.weight) / m_total_weight;
+
+        if (q <= q_limit) {
+            cur.weight += next.weight;
+            cur.mean += (next.mean - cur.mean) * next.weight / cur.weight;
+            continue;
+        }
+
+        weight_so_far += cur.weight;
+        m_centroids.push_back(cur);
+        q_limit = q_of_k(k_of_q(weight_so_far / m_total_weight, m_compression) +
+                           1,
+                         m_compression);
+        cur = next;
+    }
+
+    m_centroids.push_back(cur);
+    m_buffer.clear();
+}
+
+// Each centroid is taken to be centered on its mean, with half of its
+// weight on either side; values between the centers of two neighboring
+// centroids are interpolated linearly. The outer halves of the first and
+// last centroids are interpolated against the exact min and max.
+double tdigest::quantile(double q) const {
+    if (q < 0 || q > 1) {
+        throw std::invalid_argument("Invalid quantile: must be in [0, 1]");
+    }
+
+    flush();
+    if (m_centroids.empty()) {
+        return 0;
+    }
+
+    const auto &cs = m_centroids;
+    const double index = q * m_total_weight;
+
+    if (cs.size() == 1) {
+        return m_min + (m_max - m_min) * q;
+    }
+
+    // in the outer half of the first centroid.
+    if (index <= cs.front().weight / 2) {
+        if (cs.front().weight <= 1) {
+            return m_min;
+        }
+        double frac = index / (cs.front().weight / 2);
+        return m_min + (cs.front().mean - m_min) * frac;
+    }
+
+    double cum = cs.front().weight / 2;
+    for (std::size_t i = 0; i + 1 < cs.size(); ++i) {
+        double gap = (cs[i].weight + cs[i + 1].weight) / 2;
+        if (index <= cum + gap) {
+            // singleton centroids represent exact values: no interpolation.
+            if (cs[i].weight == 1 && index - cum < 0.5) {
+                return cs[i].mean;
+            }
+            if (cs[i + 1].weight == 1 && cum + gap - index <= 0.5) {
+                return cs[i + 1].mean;
+            }
+            return cs[i].mean +
+                   (cs[i + 1].mean - cs[i].mean) * (index - cum) / gap;
+        }
+        cum += gap;
+    }
+
+    // in the outer half of the last centroid.
+    const auto &last = cs.back();
+    if (last.weight <= 1) {
+        return m_max;
+    }
+    double frac = (index - cum) / (last.weight / 2);
+    return last.mean + (m_max - last.mean) * std::min(frac, 1.0);
+}
+
+double tdigest::cdf(double x) const {
+    flush();
+    if (m_centroids.empty()) {
+        return 0;
+    }
+
+    if (x < m_min) {
+        return 0;
+    }
+
+    if (x >= m_max) {
+        return 1;
+    }
+
+    const auto &cs = m_centroids;
+
+    // the mirror image of quantile().
+    if (x <= cs.front().mean) {
+        double span = cs.front().mean - m_min;
+        double w = cs.front().weight / 2;
+        return span > 0 ? (x - m_min) / span * w / m_total_weight : 0;
+    }
+
+    double cum = cs.front().weight / 2;
+    for (std::size_t i = 0; i + 1 < cs.size(); ++i) {
+        double gap = (cs[i].weight + cs[i + 1].weight) / 2;
+        if (x < cs[i + 1].mean) {
+            double span = cs[i + 1].mean - cs[i].mean;
+            double frac = span > 0 ? (x - cs[i].mean) / span : 0;
+            return (cum + frac * gap) / m_total_weight;
+        }
+        cum += gap;
+    }
+
+    double span = m_max - cs.back().mean;
+    double frac = span > 0 ? (x - cs.back().mean) / span : 1;
+    return (cum + frac * cs.back().weight / 2) / m_total_weight;
+}
+
+double tdigest::count() const {
+    return m_total_weight;
+}
+
+double tdigest::min() const {
+    return m_total_weight > 0 ? m_min : 0;
+}
+
+double tdigest::max() const {
+    return m_total_weight > 0 ? m_max : 0;
+}
+
+std::size_t tdigest::size() const {
+    flush();
+    return m_centroids.size();
+}
+
+void tdigest::reset() {
+    m_centroids.clear();
+    m_buffer.clear();
+    m_total_weight = 0;
+    m_min = std::numeric_limits<double>::infinity();
+    m_max = -std::numeric_limits<double>::infinity();
+}
+
+}  // namespace tarp
@@ -0,0 +1,180 @@
+#include <tarp/strand.hxx>
+
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace tarp {
+namespace exec {
+
+namespace impl {
+
+// Max number of jobs a drain job runs before yielding the thread to the
+// other users of the underlying executor.
+constexpr std::size_t STRAND_BATCH_SIZE = 32;
+
+// Shared with the drain job, which may outlive the strand.
+struct strand_state {
+    strand_state(
+      interfaces::executor &ex,
+      std::unique_ptr<tarp::sched::Scheduler<tarp::sched::interfaces::task>>
+        sched)
+        : executor(ex), scheduler(std::move(sched)) {}
+
+    interfaces::executor &executor;
+
+    mutable std::mutex mtx;
+    std::condition_variable cond;
+    const std::unique_ptr<
+      tarp::sched::Scheduler<tarp::sched::interfaces::task>>
+      scheduler;
+
+    bool scheduled {false}; /* a drain job has been posted */
+    bool closed {false};
+    std::thread::id runner; /* thread running a job, if any */
+};
+
+namespace {
+
+void drain(const std::shared_ptr<strand_state> &s);
+
+void schedule_drain(const std::shared_ptr<strand_state> &s) {
+    s->executor.post([s] { drain(s); });
+}
+
+// Called with the lock held, when the drain job is done running tasks.
+// held: the scheduler is holding back the tasks still queued.
+void finish_drain(const std::shared_ptr<strand_state> &s,
+                  std::unique_lock<std::mutex> &l,
+                  bool held) {
+    s->runner = {};
+
+    // NOTE: do not post the drain job again for held back tasks: it
+    // would only find them held back again, over and over (busy-looping
+    // on the executor) until the deadline. The next enqueue posts it.
+    if (s->closed || held || s->scheduler->get_queue_length() == 0) {
+        s->scheduled = false;
+        l.unlock();
+        s->cond.notify_all();
+        return;
+    }
+
+    // more to do; go to the back of the executor's queue.
+    l.unlock();
+    s->cond.notify_all();
+    schedule_drain(s);
+}
+
+void drain(const std::shared_ptr<strand_state> &s) {
+    std::unique_lock l {s->mtx};
+    s->runner = std::this_thread::get_id();
+
+    bool held = false;
+    for (std::size_t i = 0; i < STRAND_BATCH_SIZE && !s->closed; ++i) {
+        auto task = s->scheduler->dequeue();
+        if (!task) {
+            held = s->scheduler->get_queue_length() > 0;
+            break;
+        }
+
+        l.unlock();
+        try {
+            task->execute();
+        } catch (...) {
+            // NOTE: tasks from post() never throw (see inline_task); this
+            // is a task given to enqueue(). Leave the strand in a usable
+            // state (e.g. such that close() does not wait forever for the
+            // runner) and let the underlying executor deal with it.
+            task.reset();
+            l.lock();
+            finish_drain(s, l, false);
+            throw;
+        }
+        task.reset();
+        l.lock();
+    }
+
+    finish_drain(s, l, held);
+}
+
+}  // namespace
+
+}  // namespace impl
+
+strand::strand(
+  interfaces::executor &ex,
+  std::unique_ptr<tarp::sched::Scheduler<tarp::sched::interfaces::task>>
+    scheduler)
+    : m_state(std::make_shared<impl::strand_state>(ex, std::move(scheduler))) {
+    if (!m_state->scheduler) {
+        throw std::invalid_argument("Illegal null scheduler");
+    }
+}
+
+strand::~strand() {
+    close();
+}
+
+void strand::close() {
+    auto &s = *m_state;
+    std::unique_lock l {s.mtx};
+    s.closed = true;
+    s.scheduler->clear();
+
+    if (s.runner == std::this_thread::get_id()) {
+        return;
+    }
+
+    s.cond.wait(l, [&s] { return s.runner == std::thread::id {}; });
+}
+
+void strand::post(std::function<void()> job) {
+    if (!job) {
+        throw std::invalid_argument("Illegal attempt to post empty job");
+    }
+
+    enqueue(tarp::sched::make_inline_task(std::move(job)));
+}
+
+void strand::enqueue(std::unique_ptr<tarp::sched::interfaces::task> task) {
+    if (!task) {
+        throw std::invalid_argument("Illegal attempt to enqueue null task");
+    }
+
+    {
+        std::unique_lock l {m_state->mtx};
+        if (m_state->closed) {
+            return;
+        }
+
+        task->set_enqueue_time(std::chrono::steady_clock::now());
+        m_state->scheduler->enqueue(std::move(task));
+        if (m_state->scheduled) {
+            return;
+        }
+        m_state->scheduled = true;
+    }
+
+    try {
+        impl::schedule_drain(m_state);
+    } catch (...) {
+        // leave the task queued; the next enqueue will try again.
+        std::unique_lock l {m_state->mtx};
+        m_state->scheduled = false;
+        throw;
+    }
+}
+
+std::size_t strand::size() const {
+    std::unique_lock l {m_state->mtx};
+    return m_state->scheduler->get_queue_length();
+}
+
+bool strand::running_in_this_thread() const {
+    std::unique_lock l {m_state->mtx};
+    return m_state->runner == std::this_thread::get_id();
+}
+
+}  // namespace exec
+}  // namespace tarp
@@ -0,0 +1,321 @@
+#include <tarp/thread_options.hxx>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <alloca.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace tarp {
+namespace threading {
+
+using namespace std::string_literals;
+
+namespace {
+
+// pthread functions return the error number rather than setting errno.
+std::runtime_error syserr(const std::string &what, int err) {
+    return std::runtime_error(what + ": "s + strerror(err));
+}
+
+// The max length of a thread name, excluding the terminator.
+constexpr std::size_t MAX_THREAD_NAME_LEN = 15;
+
+// Stack prefault_stack() leaves untouched, for the frames of its callers
+// and callees (and signal handlers) to come.
+constexpr std::size_t STACK_SAFETY_MARGIN = 64 * 1024;
+
+// Number of bytes of stack left below the caller's frame.
+std::size_t get_stack_left() {
+    pthread_attr_t attr;
+    if (int rc = pthread_getattr_np(pthread_self(), &attr)) {
+        throw syserr("pthread_getattr_np", rc);
+    }
+
+    void *addr = nullptr;
+    std::size_t size = 0;
+    int rc = pthread_attr_getstack(&attr, &addr, &size);
+    pthread_attr_destroy(&attr);
+    if (rc) {
+        throw syserr("pthread_attr_getstack", rc);
+    }
+
+    // NOTE: the stack grows down, from addr + size toward addr.
+    volatile unsigned char here = 0;
+    auto top = reinterpret_cast<std::uintptr_t>(&here);
+    auto bottom = reinterpret_cast<std::uintptr_t>(addr);
+    return top > bottom ? top - bottom : 0;
+}
+
+int to_native(sched_policy policy) {
+    switch (policy) {
+    case sched_policy::OTHER: return SCHED_OTHER;
+    case sched_policy::FIFO: return SCHED_FIFO;
+    case sched_policy::RR: return SCHED_RR;
+    }
+
+    throw std::invalid_argument("Invalid scheduling policy");
+}
+
+void validate(const thread_options &opts) {
+    for (auto cpu : opts.cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            throw std::invalid_argument("Invalid cpu number: " +
+                                        std::to_string(cpu));
+        }
+    }
+
+    auto policy = to_native(opts.policy);
+    if (opts.policy == sched_policy::OTHER) {
+        if (opts.priority != 0) {
+            throw std::invalid_argument(
+              "Invalid priority: must be 0 for sched_policy::OTHER");
+        }
+        return;
+    }
+
+    if (opts.priority < sched_get_priority_min(policy) ||
+        opts.priority > sched_get_priority_max(policy)) {
+        throw std::invalid_argument("Invalid real-time priority: " +
+                                    std::to_string(opts.priority));
+    }
+}
+
+// Read a single unsigned value from a sysfs file.
+std::optional<unsigned> read_id(const std::string &path) {
+    std::ifstream f(path);
+    long v = 0;
+    if (!(f >> v)) {
+        return std::nullopt;
+    }
+
+    // e.g. physical_package_id is -1 on some systems.
+    return v < 0 ? 0 : static_cast<unsigned>(v);
+}
+
+// Parse a cpu list in the sysfs format e.g. "0-3,6,8-9".
+std::optional<std::vector<unsigned>> read_cpu_list(const std::string &path) {
+    std::ifstream f(path);
+    std::string s;
+    if (!std::getline(f, s) || s.empty()) {
+        return std::nullopt;
+    }
+
+    std::vector<unsigned> cpus;
+    std::size_t pos = 0;
+    while (pos < s.size()) {
+        auto end = s.find(',', pos);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+
+        auto range = s.substr(pos, end - pos);
+        auto dash = range.find('-');
+        try {
+            auto lo = std::stoul(range.substr(0, dash));
+            auto hi = dash == std::string::npos
+                        ? lo
+                        : std::stoul(range.substr(dash + 1));
+            for (auto cpu = lo; cpu <= hi; ++cpu) {
+                cpus.push_back(static_cast<unsigned>(cpu));
+            }
+        } catch (const std::exception &) {
+            return std::nullopt;
+        }
+
+        pos = end + 1;
+    }
+
+    return cpus;
+}
+
+}  // namespace
+
+void apply_thread_options(std::thread::native_handle_type thread,
+                          const thread_options &opts) {
+    validate(opts);
+
+    if (!opts.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu : opts.cpus) {
+            CPU_SET(cpu, &set);
+        }
+
+        if (int rc = pthread_setaffinity_np(thread, sizeof(set), &set)) {
+            throw syserr("pthread_setaffinity_np", rc);
+        }
+    }
+
+    if (opts.policy != sched_policy::OTHER) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = opts.priority;
+        if (int rc =
+              pthread_setschedparam(thread, to_native(opts.policy), &param)) {
+            throw syserr("pthread_setschedparam", rc);
+        }
+    }
+
+    if (opts.name) {
+        auto name = opts.name->substr(0, MAX_THREAD_NAME_LEN);
+        if (int rc = pthread_setname_np(thread, name.c_str())) {
+            throw syserr("pthread_setname_np", rc);
+        }
+    }
+}
+
+void apply_thread_options(const thread_options &opts) {
+    apply_thread_options(pthread_self(), opts);
+    prefault_stack(opts.prefault_stack);
+}
+
+// NOTE: must not be inlined, otherwise the alloca'd memory would only be
+// released when the caller returns.
+__attribute__((noinline)) void prefault_stack(std::size_t nbytes) {
+    if (nbytes == 0) {
+        return;
+    }
+
+    static const auto page_size =
+      static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+    // clamp to what the stack can take: alloca does not fail gracefully.
+    auto left = get_stack_left();
+    if (left <= STACK_SAFETY_MARGIN) {
+        return;
+    }
+    nbytes = std::min(nbytes, left - STACK_SAFETY_MARGIN);
+
+    auto *stack = static_cast<volatile unsigned char *>(alloca(nbytes));
+    for (std::size_t i = 0; i < nbytes; i += page_size) {
+        stack[i] = 0;
+    }
+    stack[nbytes - 1] = 0;
+}
+
+void lock_process_memory(bool future) {
+    int flags = MCL_CURRENT | (future ? MCL_FUTURE : 0);
+    if (mlockall(flags) != 0) {
+        throw syserr("mlockall", errno);
+    }
+}
+
+void unlock_process_memory() {
+    if (munlockall() != 0) {
+        throw syserr("munlockall", errno);
+    }
+}
+
+std::vector<unsigned> get_allowed_cpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        throw syserr("sched_getaffinity", errno);
+    }
+
+    std::vector<unsigned> cpus;
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<cpu_info> read_cpu_topology(const std::string &sysfs_root) {
+    auto cpus = read_cpu_list(sysfs_root + "/online");
+    if (!cpus) {
+        cpus = get_allowed_cpus();
+    }
+
+    std::vector<cpu_info> topology;
+    for (auto cpu : *cpus) {
+        auto dir = sysfs_root + "/cpu" + std::to_string(cpu) + "/topology/";
+        auto core = read_id(dir + "core_id");
+        auto package = read_id(dir + "physical_package_id");
+
+        if (core && package) {
+            topology.push_back({cpu, *core, *package});
+        } else {
+            // unknown: make it a core of its own, with an id that cannot
+            // clash with that of a real core.
+            topology.push_back({cpu, 0x10000 + cpu, 0});
+        }
+    }
+
+    std::sort(topology.begin(), topology.end(), [](auto &a, auto &b) {
+        return a.cpu < b.cpu;
+    });
+    return topology;
+}
+
+std::vector<unsigned> plan_placement(std::vector<cpu_info> topology,
+                                     placement policy) {
+    std::vector<unsigned> plan;
+    if (policy == placement::NONE) {
+        return plan;
+    }
+
+    std::sort(topology.begin(), topology.end(), [](auto &a, auto &b) {
+        return std::tie(a.package, a.core, a.cpu) <
+               std::tie(b.package, b.core, b.cpu);
+    });
+
+    if (policy == placement::COMPACT) {
+        for (const auto &c : topology) {
+            plan.push_back(c.cpu);
+        }
+        return plan;
+    }
+
+    // SCATTER. packages -> cores -> SMT siblings, all in ascending order.
+    std::map<unsigned, std::vector<std::vector<unsigned>>> packages;
+    for (std::size_t i = 0; i < topology.size(); ++i) {
+        const auto &c = topology[i];
+        auto &cores = packages[c.package];
+        if (i == 0 || topology[i - 1].package != c.package ||
+            topology[i - 1].core != c.core) {
+            cores.emplace_back();
+        }
+        cores.back().push_back(c.cpu);
+    }
+
+    std::size_t max_cores = 0;
+    std::size_t max_siblings = 0;
+    for (const auto &[_, cores] : packages) {
+        max_cores = std::max(max_cores, cores.size());
+        for (const auto &siblings : cores) {
+            max_siblings = std::max(max_siblings, siblings.size());
+        }
+    }
+
+    // one round per SMT sibling; within each round, take the k-th core
+    // of each package in turn.
+    for (std::size_t s = 0; s < max_siblings; ++s) {
+        for (std::size_t k = 0; k < max_cores; ++k) {
+            for (const auto &[_, cores] : packages) {
+                if (k < cores.size() && s < cores[k].size()) {
+                    plan.push_back(cores[k][s]);
+                }
+            }
+        }
+    }
+
+    return plan;
+}
+
+}  // namespace threading
+}  // namespace tarp
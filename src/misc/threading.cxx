@@ -1,7 +1,9 @@
 #include "tarp/log.h"
 #include "tarp/signal.hxx"
+#include <algorithm>
 #include <chrono>
 #include <memory>
+#include <optional>
 #include <shared_mutex>
 #include <stdexcept>
 #include <tarp/threading.hxx>
@@ -29,6 +31,9 @@ void ThreadEntity::prepare_resume() {
 void ThreadEntity::cleanup() {
 }
 
+void ThreadEntity::finish_work() {
+}
+
 void ThreadEntity::do_work(void) {
     using namespace std::chrono_literals;
     wait_for(1s);
@@ -95,6 +100,16 @@ enum ThreadEntity::threadState ThreadEntity::get_state() const {
     return m_state;
 }
 
+void ThreadEntity::set_thread_options(thread_options opts) {
+    LOCK(m_mtx);
+
+    if (m_thread.joinable()) {
+        apply_thread_options(m_thread.native_handle(), opts);
+    }
+
+    m_options = std::move(opts);
+}
+
 void ThreadEntity::spawn(void) {
     set_state(threadState::RUNNING);
     std::thread t {[this] {
@@ -102,6 +117,12 @@ void ThreadEntity::spawn(void) {
     }};
 
     std::swap(t, m_thread);
+
+    // NOTE: done from here rather than from the new thread so that any
+    // errors can be reported to the caller of run().
+    if (m_options) {
+        apply_thread_options(m_thread.native_handle(), *m_options);
+    }
 }
 
 /*
@@ -197,6 +218,11 @@ void ThreadEntity::loop(void) {
         return m_state != threadState::PAUSED;
     };
 
+    l.lock();
+    auto prefault = m_options ? m_options->prefault_stack : 0;
+    l.unlock();
+    prefault_stack(prefault);
+
     initialize();
 
     while (true) {
@@ -206,6 +232,7 @@ void ThreadEntity::loop(void) {
         case threadState::RUNNING:
             l.unlock();
             do_work(); /* (2) */
+            finish_work();
             break;
         case threadState::PAUSED: /* (3) */
             m_wait_cond.wait(l, pause_checker);
@@ -298,18 +325,95 @@ bool ActiveObject::has_pending_tasks() const {
 }
 
 std::unique_ptr<interfaces::task> ActiveObject::get_next_task() {
-    std::unique_lock l {m_scheduler_mtx};
+    std::unique_ptr<interfaces::task> task;
 
-    auto task = m_scheduler->dequeue();
+    {
+        std::unique_lock l {m_scheduler_mtx};
+
+        task = m_scheduler->dequeue();
+
+        // not a bug if the scheduler is holding back tasks until a deadline.
+        if (!task && !m_scheduler->get_first_deadline()) {
+            throw std::logic_error(
+              "BUG: cannot get task from QueueItem in ActiveObject");
+        }
+    }
 
     if (!task) {
-        throw std::logic_error(
-          "BUG: cannot get task from QueueItem in ActiveObject");
+        return nullptr;
     }
+
+    // the previous task, if any, is done by now.
+    finish_work();
+    m_task_start = m_recorder.begin(*task);
     return task;
 }
 
-WorkerThread::WorkerThread(std::uint32_t worker_id) : m_worker_id(worker_id) {
+void ActiveObject::finish_work() {
+    if (m_task_start) {
+        m_recorder.end(*m_task_start);
+        m_task_start.reset();
+    }
+}
+
+void ActiveObject::enqueue(std::unique_ptr<interfaces::task> task) {
+    task->set_enqueue_time(std::chrono::steady_clock::now());
+
+    {
+        std::unique_lock l {m_scheduler_mtx};
+        m_scheduler->enqueue(std::move(task));
+        m_queue_hwm.update(m_scheduler->get_queue_length());
+    }
+
+    /* wake up the active object if idling */
+    signal();
+}
+
+bool ActiveObject::run_next_task() {
+    std::unique_ptr<interfaces::task> task;
+    {
+        std::unique_lock l {m_scheduler_mtx};
+        task = m_scheduler->dequeue();
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    m_recorder.run(*task);
+    return true;
+}
+
+pool_metrics ActiveObject::get_metrics() const {
+    pool_metrics m;
+
+    {
+        std::unique_lock l {m_scheduler_mtx};
+        m.queue_length = m_scheduler->get_queue_length();
+    }
+
+    auto w = m_recorder.snapshot();
+    m.num_tasks_handled = w.num_tasks;
+    m.queue_length_hwm = m_queue_hwm.get();
+    impl::accumulate(m, w);
+    m.workers.push_back(std::move(w));
+    return m;
+}
+
+void ActiveObject::wait_for_next_task(std::chrono::microseconds max_wait) {
+    auto limit = std::chrono::steady_clock::now() + max_wait;
+
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    {
+        std::unique_lock l {m_scheduler_mtx};
+        deadline = m_scheduler->get_first_deadline();
+    }
+
+    wait_until(deadline ? std::min(*deadline, limit) : limit);
+}
+
+WorkerThread::WorkerThread(std::uint32_t worker_id)
+    : m_worker_id(worker_id), m_recorder(worker_id) {
 }
 
 void WorkerThread::set_task(std::unique_ptr<interfaces::task> task) {
@@ -340,12 +444,20 @@ void WorkerThread::do_work(void) {
         m_next_task.reset();
     }
 
-    m_current_task->execute();
+    m_recorder.run(*m_current_task);
 
     /* ready for new work, become a follower again. */
     m_sig_work_done.emit(m_worker_id);
 }
 
+worker_metrics WorkerThread::get_metrics() const {
+    return m_recorder.snapshot();
+}
+
+void WorkerThread::drain_queue_wait_window(histogram &into) {
+    m_recorder.drain_queue_wait_window(into);
+}
+
 // NOTE: this id is a read-only field, hence no mutex-protection is needed.
 std::size_t WorkerThread::get_worker_id() const {
     return m_worker_id;
@@ -357,6 +469,10 @@ ThreadPool::ThreadPool(
     : m_num_workers(num_workers), m_taskq(std::move(scheduler)) {
 }
 
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
 std::size_t ThreadPool::get_queue_length() const {
     std::shared_lock l {m_mtx};
     return m_taskq->get_queue_length();
@@ -367,9 +483,12 @@ void ThreadPool::enqueue_task(std::unique_ptr<interfaces::task> task) {
         throw std::invalid_argument("Illegal attempt to enqueue null task");
     }
 
+    task->set_enqueue_time(std::chrono::steady_clock::now());
+
     {
         std::unique_lock l {m_mtx};
         m_taskq->enqueue(std::move(task));
+        m_queue_hwm.update(m_taskq->get_queue_length());
     }
 
     // if thread pool idling, wake it up.
@@ -436,35 +555,64 @@ void ThreadPool::cleanup(void) {
 }
 
 void ThreadPool::do_work(void) {
+    autoscale_if_needed();
     resize_pool_if_needed();
 
     std::shared_ptr<tarp::threading::WorkerThread> worker;
     std::unique_ptr<interfaces::task> task;
+    std::optional<std::chrono::steady_clock::time_point> next_deadline;
 
     {
         std::unique_lock l {m_mtx};
 
-        // nothing to do. Wait for some arbitrary time until further notice.
+        if (m_idle_threads.empty() && !m_taskq->empty()) {
+            if (!m_saturated_since) {
+                m_saturated_since = std::chrono::steady_clock::now();
+            }
+        } else {
+            m_saturated_since.reset();
+        }
+
+        // nothing to do. Wait until further notice -- or until the next
+        // autoscaling evaluation, if autoscaling.
         if (m_idle_threads.empty() || m_taskq->empty()) {
-            set_state(threadState::PAUSED);
-            return;
+            if (!m_autoscale) {
+                set_state(threadState::PAUSED);
+                return;
+            }
+            next_deadline = m_next_evaluation;
+        } else {
+            task = m_taskq->dequeue();
         }
 
-        // use LIFO semantics for the idle threads; i.e. the thread that has
-        // most recently become idle is the one that gets picked first for
-        // new work. See POSA, vol2 p464.
-        // => Leaders get dequeued from the front, followers get enqueued to
-        // the front as well.
-        worker = m_idle_threads.front();
-        m_idle_threads.pop_front();
-
-        task = m_taskq->dequeue();
-        if (!task) {
-            throw std::logic_error("BUG: failed conversion from QueueItem "
-                                   "to tarp::threading::task");
+        // The scheduler is holding back its tasks until some deadline.
+        if (!task && !next_deadline) {
+            next_deadline = m_taskq->get_first_deadline();
+            if (!next_deadline) {
+                throw std::logic_error("BUG: failed conversion from QueueItem "
+                                       "to tarp::threading::task");
+            }
+            if (m_autoscale) {
+                next_deadline = std::min(*next_deadline, m_next_evaluation);
+            }
+        } else if (task) {
+            // use LIFO semantics for the idle threads; i.e. the thread that
+            // has most recently become idle is the one that gets picked first
+            // for new work. See POSA, vol2 p464.
+            // => Leaders get dequeued from the front, followers get enqueued
+            // to the front as well.
+            worker = m_idle_threads.front();
+            m_idle_threads.pop_front();
         }
     }
 
+    // Sleep until the deadline. This is interrupted early if signaled
+    // e.g. by enqueue_task, since the new task may have an earlier deadline.
+    if (next_deadline) {
+        wait_until(*next_deadline);
+        return;
+    }
+
     if (!worker || !task) {
         throw std::logic_error("BUG, null worker/task");
     }
@@ -479,8 +627,9 @@ void ThreadPool::resize_pool_if_needed() {
      * without locking any mutexes on the ThreadPool side, otherwise if we get a
      * circular call we will end up with a deadlock. */
     std::vector<std::shared_ptr<tarp::threading::WorkerThread>> to_initialize;
+    std::vector<std::optional<thread_options>> options;
     std::vector<std::shared_ptr<tarp::threading::WorkerThread>> to_stop;
-    std::unique_ptr<tarp::signal_connection> signal_connection;
+    std::vector<std::unique_ptr<tarp::signal_connection>> signal_connections;
 
     {
         std::unique_lock l {m_mtx};
@@ -507,8 +656,10 @@ void ThreadPool::resize_pool_if_needed() {
                 }
 
                 m_idle_threads.push_back(worker);
+                m_idle_since[id] = std::chrono::steady_clock::now();
                 hook_up_task_completion_signal(*worker);
                 to_initialize.push_back(worker);
+                options.push_back(get_worker_options(id));
             }
         }
 
@@ -524,12 +675,18 @@ void ThreadPool::resize_pool_if_needed() {
                 auto worker_id = worker->get_worker_id();
                 m_idle_threads.pop_back();
                 m_threads.erase(worker_id);
+                m_idle_since.erase(worker_id);
                 to_stop.push_back(worker);
 
+                // NOTE: the worker is idle, so its metrics are final; this
+                // only reads atomics and cannot call back into the pool.
+                impl::accumulate(m_retired_metrics, worker->get_metrics());
+
                 // disconnect task-completion signal connection
                 auto signal_connection_it = m_worker_signals.find(worker_id);
                 if (signal_connection_it != m_worker_signals.end()) {
-                    signal_connection = std::move(signal_connection_it->second);
+                    signal_connections.push_back(
+                      std::move(signal_connection_it->second));
                     m_worker_signals.erase(signal_connection_it);
                 }
             }
@@ -538,8 +695,20 @@ void ThreadPool::resize_pool_if_needed() {
 
     // =============== run UNLOCKED ===========
     //
-    for (auto &worker : to_initialize) {
-        worker->run();   /* initialize */
+    for (std::size_t i = 0; i < to_initialize.size(); ++i) {
+        auto &worker = to_initialize[i];
+
+        try {
+            if (options[i]) {
+                worker->set_thread_options(std::move(*options[i]));
+            }
+            worker->run(); /* initialize */
+        } catch (const std::exception &e) {
+            warn("Failed to apply thread options to worker %zu: %s",
+                 worker->get_worker_id(),
+                 e.what());
+        }
+
         worker->pause(); /* idle until further notice */
     }
 
@@ -547,7 +716,7 @@ void ThreadPool::resize_pool_if_needed() {
         worker->stop();
     }
 
-    if (signal_connection) {
+    for (auto &signal_connection : signal_connections) {
         signal_connection->disconnect();
     }
 }
@@ -580,14 +749,19 @@ void ThreadPool::add_follower(uint32_t worker_id) {
 
         worker = found->second;
         m_idle_threads.push_front(worker);
+        m_idle_since[worker_id] = std::chrono::steady_clock::now();
+        m_num_tasks_handled++;
     }
 
     if (!worker) {
         return;
     }
 
-    worker->pause();
-    m_num_tasks_handled++;
+    /* NOTE: the worker must not be paused here: as soon as it is in
+     * m_idle_threads, it may get picked and handed a new task (and run())
+     * before we get here, in which case pausing it would lose the wakeup
+     * and leave the task stranded. The worker pauses itself in do_work
+     * instead, if it finds it has no next task. */
     signal(); /* wake up thread pool if idling */
 }
 
@@ -611,16 +785,218 @@ void ThreadPool::hook_up_task_completion_signal(
       std::make_pair(worker_id, std::move(signal_connection)));
 }
 
+// NOTE: m_mtx must be held.
+std::optional<thread_options>
+ThreadPool::get_worker_options(std::uint32_t worker_id) {
+    if (!m_worker_options) {
+        return std::nullopt;
+    }
+
+    auto opts = *m_worker_options;
+    if (!m_placement.empty()) {
+        opts.cpus = {m_placement[worker_id % m_placement.size()]};
+    }
+
+    if (opts.name) {
+        *opts.name += "/" + std::to_string(worker_id);
+    }
+
+    return opts;
+}
+
+void ThreadPool::set_worker_options(thread_options opts, placement policy) {
+    std::vector<unsigned> plan;
+    if (policy != placement::NONE) {
+        auto allowed = get_allowed_cpus();
+        auto topology = read_cpu_topology();
+        topology.erase(std::remove_if(topology.begin(),
+                                      topology.end(),
+                                      [&allowed](const auto &c) {
+                                          return std::find(allowed.begin(),
+                                                           allowed.end(),
+                                                           c.cpu) ==
+                                                 allowed.end();
+                                      }),
+                       topology.end());
+        plan = plan_placement(std::move(topology), policy);
+    }
+
+    std::vector<std::shared_ptr<WorkerThread>> workers;
+    std::vector<thread_options> options;
+    {
+        std::unique_lock l {m_mtx};
+        m_worker_options = std::move(opts);
+        m_placement = std::move(plan);
+
+        for (auto &[id, worker] : m_threads) {
+            workers.push_back(worker);
+            options.push_back(*get_worker_options(id));
+        }
+    }
+
+    // NOTE: unlocked, see resize_pool_if_needed.
+    for (std::size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->set_thread_options(std::move(options[i]));
+    }
+}
+
 void ThreadPool::initialize(void) {
 }
 
 void ThreadPool::prepare_resume(void) {
 }
 
+void ThreadPool::set_autoscale_policy(std::optional<autoscale_policy> policy) {
+    if (policy) {
+        const auto &p = *policy;
+        if (p.min_workers == 0 || p.max_workers < p.min_workers) {
+            throw std::invalid_argument(
+              "Invalid autoscale policy: need 1 <= min_workers <= max_workers");
+        }
+
+        if (p.grow_step == 0 || p.interval.count() <= 0 ||
+            p.percentile <= 0 || p.percentile > 100) {
+            throw std::invalid_argument(
+              "Invalid autoscale policy: need grow_step > 0, interval > 0 "
+              "and percentile in (0, 100]");
+        }
+    }
+
+    {
+        std::unique_lock l {m_mtx};
+        m_autoscale = std::move(policy);
+
+        if (m_autoscale) {
+            m_num_workers = std::clamp(
+              m_num_workers, m_autoscale->min_workers, m_autoscale->max_workers);
+            m_next_evaluation =
+              std::chrono::steady_clock::now() + m_autoscale->interval;
+        }
+    }
+
+    signal(); /* wake thread pool if idling */
+}
+
+/*
+ * Evaluate the autoscale policy, if any, and update the requested number of
+ * workers accordingly. The actual resizing is done by resize_pool_if_needed.
+ */
+void ThreadPool::autoscale_if_needed() {
+    using std::chrono::nanoseconds;
+    using std::chrono::steady_clock;
+
+    auto now = steady_clock::now();
+    std::vector<std::shared_ptr<WorkerThread>> workers;
+    autoscale_policy policy;
+
+    {
+        std::shared_lock l {m_mtx};
+        if (!m_autoscale || now < m_next_evaluation) {
+            return;
+        }
+
+        policy = *m_autoscale;
+        for (auto &[worker_id, worker] : m_threads) {
+            workers.push_back(worker);
+        }
+    }
+
+    // NOTE: do not call into the workers with the mutex locked.
+    histogram window;
+    for (auto &worker : workers) {
+        worker->drain_queue_wait_window(window);
+    }
+    auto queue_wait = nanoseconds(window.percentile(policy.percentile));
+    auto target = std::chrono::duration_cast<nanoseconds>(
+      policy.target_queue_wait);
+
+    std::optional<autoscale_decision> decision;
+
+    {
+        std::unique_lock l {m_mtx};
+
+        // disabled in the meantime.
+        if (!m_autoscale) {
+            return;
+        }
+
+        m_next_evaluation = now + policy.interval;
+        if (now < m_last_resize + policy.cooldown) {
+            return;
+        }
+
+        using reason = autoscale_decision::reason;
+        auto n = m_num_workers;
+
+        if (n < policy.max_workers) {
+            std::optional<reason> why;
+            if (queue_wait > target) {
+                why = reason::LATENCY;
+            } else if (m_saturated_since && now - *m_saturated_since > target) {
+                why = reason::SATURATION;
+            }
+
+            if (why) {
+                auto new_n = std::min(policy.max_workers, n + policy.grow_step);
+                decision = autoscale_decision {*why, n, new_n, queue_wait};
+            }
+        }
+
+        auto shrink_limit = nanoseconds(static_cast<nanoseconds::rep>(
+          static_cast<double>(target.count()) * policy.shrink_threshold));
+
+        // NOTE: the idle thread at the back is the one idle the longest.
+        if (!decision && n > policy.min_workers && queue_wait <= shrink_limit &&
+            !m_idle_threads.empty()) {
+            auto id = static_cast<uint32_t>(
+              m_idle_threads.back()->get_worker_id());
+            auto found = m_idle_since.find(id);
+            if (found != m_idle_since.end() &&
+                now - found->second >= policy.idle_timeout) {
+                decision =
+                  autoscale_decision {reason::IDLE, n, n - 1, queue_wait};
+            }
+        }
+
+        if (!decision) {
+            return;
+        }
+
+        m_num_workers = decision->new_num_workers;
+        m_last_resize = now;
+    }
+
+    m_autoscale_signal.emit(*decision);
+}
+
 size_t ThreadPool::get_num_tasks_handled() const {
     std::shared_lock l {m_mtx};
     return m_num_tasks_handled;
 }
 
+pool_metrics ThreadPool::get_metrics() const {
+    pool_metrics m;
+    decltype(m_threads) workers;
+
+    {
+        std::shared_lock l {m_mtx};
+        workers = m_threads;
+        m.queue_wait = m_retired_metrics.queue_wait;
+        m.exec_time = m_retired_metrics.exec_time;
+        m.num_tasks_handled = m_num_tasks_handled;
+        m.queue_length = m_taskq->get_queue_length();
+    }
+
+    // NOTE: do not call into the workers with the mutex locked.
+    for (auto &[worker_id, worker] : workers) {
+        auto w = worker->get_metrics();
+        impl::accumulate(m, w);
+        m.workers.push_back(std::move(w));
+    }
+
+    m.queue_length_hwm = m_queue_hwm.get();
+    return m;
+}
+
 
 }  // namespace tarp
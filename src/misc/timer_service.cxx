@@ -0,0 +1,224 @@
+#include <tarp/timer_service.hxx>
+
+#include <iostream>
+#include <stdexcept>
+
+namespace tarp {
+namespace threading {
+
+TimerService::~TimerService() {
+    stop();
+}
+
+void TimerService::push(timer_id id, timer &t, time_point expiry) {
+    t.seq = m_next_seq++;
+    m_heap.push(entry {expiry, t.seq, id});
+}
+
+TimerService::timer_id TimerService::schedule(time_point expiry,
+                                              callback_type cb) {
+    if (!cb) {
+        throw std::invalid_argument("Illegal null timer callback");
+    }
+
+    timer_id id;
+    {
+        std::unique_lock l {m_mtx};
+        id = m_next_id++;
+        auto &t = m_timers[id];
+        t.cb = std::move(cb);
+        push(id, t, expiry);
+    }
+
+    /* wake up the service (or spawn it, the first time), since the new
+     * timer may expire before the one it is currently sleeping until. */
+    signal();
+    return id;
+}
+
+bool TimerService::reschedule(timer_id id, time_point expiry) {
+    {
+        std::unique_lock l {m_mtx};
+        auto found = m_timers.find(id);
+        if (found == m_timers.end()) {
+            return false;
+        }
+        push(id, found->second, expiry);
+    }
+
+    signal();
+    return true;
+}
+
+bool TimerService::cancel(timer_id id) {
+    std::unique_lock l {m_mtx};
+    auto found = m_timers.find(id);
+    if (found == m_timers.end()) {
+        return false;
+    }
+
+    if (m_running == id) {
+        // Called from the callback itself: the callback must not be
+        // destroyed while running; do_work removes the timer on return.
+        if (std::this_thread::get_id() == m_service_thread) {
+            m_running_canceled = true;
+            return true;
+        }
+
+        m_callback_done.wait(l, [this, id] { return m_running != id; });
+
+        // may have been retired or canceled in the meantime.
+        found = m_timers.find(id);
+        if (found == m_timers.end()) {
+            return true;
+        }
+    }
+
+    // NOTE: the heap entry is left in place; it is skipped as stale.
+    m_timers.erase(found);
+    return true;
+}
+
+std::size_t TimerService::size() const {
+    std::unique_lock l {m_mtx};
+    return m_timers.size();
+}
+
+void TimerService::do_work() {
+    std::unique_lock l {m_mtx};
+    m_service_thread = std::this_thread::get_id();
+
+    // drop stale entries.
+    while (!m_heap.empty()) {
+        const auto &top = m_heap.top();
+        auto found = m_timers.find(top.id);
+        if (found != m_timers.end() && found->second.seq == top.seq) {
+            break;
+        }
+        m_heap.pop();
+    }
+
+    // nothing to do. Sleep until a timer is scheduled.
+    if (m_heap.empty()) {
+        set_state(threadState::PAUSED);
+        return;
+    }
+
+    auto top = m_heap.top();
+    if (top.expiry > std::chrono::steady_clock::now()) {
+        l.unlock();
+
+        // interrupted early by schedule() etc.
+        wait_until(top.expiry);
+        return;
+    }
+
+    m_heap.pop();
+
+    // NOTE: references to unordered_map elements stay valid until the
+    // element is erased, which cancel() defers while the callback runs.
+    auto &t = m_timers.at(top.id);
+    m_running = top.id;
+    m_running_canceled = false;
+
+    // a callback that throws is retired: there is no expiration time to
+    // re-arm it with, and letting the exception escape would take down the
+    // service thread and every other timer with it.
+    std::optional<time_point> next;
+    l.unlock();
+    try {
+        next = t.cb();
+    } catch (const std::exception &e) {
+        std::cerr << "exception caught in TimerService callback: " << e.what()
+                  << std::endl;
+    } catch (...) {
+        std::cerr << "unknown exception caught in TimerService callback"
+                  << std::endl;
+    }
+    l.lock();
+
+    if (next && !m_running_canceled) {
+        push(top.id, t, *next);
+    } else {
+        m_timers.erase(top.id);
+    }
+
+    m_running.reset();
+    l.unlock();
+    m_callback_done.notify_all();
+}
+
+//
+
+HostedOscillator::~HostedOscillator() {
+    stop();
+}
+
+void HostedOscillator::start() {
+    std::unique_lock l {m_mtx};
+    if (m_id) {
+        return;
+    }
+
+    // To start with, the next tick will be PERIOD from now.
+    m_prev_tick_tp = std::chrono::steady_clock::now();
+    m_id = m_service.schedule(m_prev_tick_tp + m_period,
+                              [this] { return on_expiry(); });
+}
+
+void HostedOscillator::stop() {
+    std::optional<TimerService::timer_id> id;
+    {
+        std::unique_lock l {m_mtx};
+        std::swap(id, m_id);
+    }
+
+    if (id) {
+        m_service.cancel(*id);
+    }
+}
+
+std::chrono::microseconds HostedOscillator::get_period() const {
+    std::unique_lock l {m_mtx};
+    return m_period;
+}
+
+void HostedOscillator::set_period(const std::chrono::microseconds &period) {
+    std::unique_lock l {m_mtx};
+    m_period = period;
+
+    if (m_id) {
+        m_service.reschedule(*m_id, m_prev_tick_tp + m_period);
+    }
+}
+
+std::optional<TimerService::time_point> HostedOscillator::on_expiry() {
+    std::chrono::microseconds period;
+    {
+        std::unique_lock l {m_mtx};
+        period = m_period;
+
+        auto next_tick_tp = m_prev_tick_tp + period;
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_tick_tp) {
+            return next_tick_tp;
+        }
+
+        m_prev_tick_tp = next_tick_tp;
+
+        // if the timer has fallen behind, bring it up to date with the
+        // current time: ensure the next tick is in the future!
+        if ((m_prev_tick_tp + period) <= now) {
+            m_prev_tick_tp = now;
+        }
+    }
+
+    on_tick();
+    m_tick_signal.emit();
+
+    std::unique_lock l {m_mtx};
+    return m_prev_tick_tp + m_period;
+}
+
+}  // namespace threading
+}  // namespace tarp
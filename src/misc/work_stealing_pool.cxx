@@ -0,0 +1,254 @@
+#include <tarp/futex.hxx>
+#include <tarp/work_stealing_pool.hxx>
+
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+
+namespace tarp {
+namespace threading {
+
+namespace {
+
+// Pool and worker the calling thread belongs to, if it is a pool worker.
+thread_local const WorkStealingPool *tl_pool = nullptr;
+thread_local void *tl_worker = nullptr;
+
+// Cheap per-thread PRNG (xorshift) for picking victims to steal from.
+std::size_t random_index(std::size_t n) {
+    static thread_local std::uint64_t state =
+      std::hash<std::thread::id> {}(std::this_thread::get_id()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return static_cast<std::size_t>(state % n);
+}
+
+// Number of times an idle worker looks for work before parking.
+constexpr unsigned NUM_SPINS = 64;
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(std::uint16_t num_workers) {
+    if (num_workers == 0) {
+        throw std::invalid_argument("WorkStealingPool needs >= 1 worker");
+    }
+
+    for (std::size_t i = 0; i < num_workers; ++i) {
+        m_workers.push_back(
+          std::make_unique<worker>(static_cast<std::uint32_t>(i)));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    stop();
+
+    // Discard any tasks left over.
+    for (auto &w : m_workers) {
+        while (auto *task = w->deque.pop()) {
+            delete task;
+        }
+    }
+    for (auto *task : m_injectq) {
+        delete task;
+    }
+}
+
+void WorkStealingPool::start() {
+    LOCK(m_mtx);
+    if (m_started) {
+        throw std::logic_error("WorkStealingPool already started");
+    }
+    m_started = true;
+
+    for (std::size_t i = 0; i < m_workers.size(); ++i) {
+        m_workers[i]->thread = std::thread(&WorkStealingPool::loop, this, i);
+    }
+}
+
+void WorkStealingPool::stop() {
+    m_stopping.store(true);
+    m_epoch.fetch_add(1);
+    tarp::futex::wake_all(m_epoch);
+
+    for (auto &w : m_workers) {
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+    }
+}
+
+WorkStealingPool::worker *WorkStealingPool::current_worker() const {
+    if (tl_pool != this) {
+        return nullptr;
+    }
+    return static_cast<worker *>(tl_worker);
+}
+
+void WorkStealingPool::enqueue_task(
+  std::unique_ptr<tarp::sched::interfaces::task> task) {
+    if (!task) {
+        return;
+    }
+
+    task->set_enqueue_time(std::chrono::steady_clock::now());
+
+    if (auto *self = current_worker(); self != nullptr) {
+        self->deque.push(task.release());
+        m_queue_hwm.update(self->deque.size());
+    } else {
+        LOCK(m_mtx);
+        m_injectq.push_back(task.release());
+        m_queue_hwm.update(m_injectq.size());
+    }
+
+    notify();
+}
+
+void WorkStealingPool::notify() {
+    // Pairs with the fence in loop() between incrementing m_num_sleepers
+    // and looking for work one last time: either the worker finds the task
+    // we have just enqueued, or we see the worker and wake it up.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_num_sleepers.load(std::memory_order_relaxed) > 0) {
+        m_epoch.fetch_add(1);
+        tarp::futex::wake(m_epoch, 1);
+    }
+}
+
+WorkStealingPool::task_t *WorkStealingPool::steal(worker *self) {
+    auto n = m_workers.size();
+    auto start = random_index(n);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        auto *victim = m_workers[(start + i) % n].get();
+        if (victim == self) {
+            continue;
+        }
+
+        if (auto *task = victim->deque.steal()) {
+            if (self) {
+                self->recorder.record_steal();
+            }
+            return task;
+        }
+    }
+
+    return nullptr;
+}
+
+WorkStealingPool::task_t *WorkStealingPool::find_task(worker *self) {
+    if (self) {
+        if (auto *task = self->deque.pop()) {
+            return task;
+        }
+    }
+
+    {
+        LOCK(m_mtx);
+        if (!m_injectq.empty()) {
+            auto *task = m_injectq.front();
+            m_injectq.pop_front();
+            return task;
+        }
+    }
+
+    return steal(self);
+}
+
+void WorkStealingPool::run_task(worker *self, task_t *task) {
+    std::unique_ptr<task_t> owned {task};
+    if (self) {
+        self->recorder.run(*owned);
+    } else {
+        owned->execute();
+    }
+    m_num_tasks_handled.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool WorkStealingPool::try_run_one() {
+    auto *self = current_worker();
+    auto *task = find_task(self);
+    if (!task) {
+        return false;
+    }
+
+    run_task(self, task);
+    return true;
+}
+
+void WorkStealingPool::loop(std::size_t idx) {
+    tl_pool = this;
+    tl_worker = m_workers[idx].get();
+    auto *self = m_workers[idx].get();
+
+    unsigned misses = 0;
+
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        if (auto *task = find_task(self)) {
+            misses = 0;
+            run_task(self, task);
+            continue;
+        }
+
+        if (++misses < NUM_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Park. Announce ourselves as a sleeper *before* checking for work
+        // one last time so that a concurrent enqueue_task cannot be missed.
+        misses = 0;
+        auto epoch = m_epoch.load();
+        m_num_sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        auto *task = find_task(self);
+        if (!task && !m_stopping.load()) {
+            tarp::futex::wait(m_epoch, epoch);
+        }
+        m_num_sleepers.fetch_sub(1);
+
+        if (task) {
+            run_task(self, task);
+        }
+    }
+
+    tl_pool = nullptr;
+    tl_worker = nullptr;
+}
+
+std::size_t WorkStealingPool::get_queue_length() const {
+    std::size_t n = 0;
+    for (const auto &w : m_workers) {
+        n += w->deque.size();
+    }
+
+    LOCK(m_mtx);
+    return n + m_injectq.size();
+}
+
+std::size_t WorkStealingPool::get_num_tasks_handled() const {
+    return m_num_tasks_handled.load(std::memory_order_relaxed);
+}
+
+std::size_t WorkStealingPool::get_num_threads() const {
+    return m_workers.size();
+}
+
+pool_metrics WorkStealingPool::get_metrics() const {
+    pool_metrics m;
+    for (const auto &w : m_workers) {
+        auto wm = w->recorder.snapshot();
+        impl::accumulate(m, wm);
+        m.workers.push_back(std::move(wm));
+    }
+
+    m.num_tasks_handled = get_num_tasks_handled();
+    m.queue_length = get_queue_length();
+    m.queue_length_hwm = m_queue_hwm.get();
+    return m;
+}
+
+}  // namespace threading
+}  // namespace tarp
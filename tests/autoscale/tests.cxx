@@ -0,0 +1,161 @@
+#include <tarp/threading.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace tarp::threading;
+using steady = std::chrono::steady_clock;
+
+namespace {
+
+template<typename F>
+bool wait_for_condition(F &&f, std::chrono::milliseconds timeout = 10s) {
+    auto deadline = steady::now() + timeout;
+    while (!f()) {
+        if (steady::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+autoscale_policy test_policy() {
+    autoscale_policy p;
+    p.min_workers = 1;
+    p.max_workers = 4;
+    p.target_queue_wait = 1ms;
+    p.idle_timeout = 50ms;
+    p.interval = 5ms;
+    p.cooldown = 10ms;
+    return p;
+}
+
+}  // namespace
+
+TEST_CASE("Invalid autoscale policies are rejected") {
+    ThreadPool pool(1);
+
+    auto p = test_policy();
+    p.min_workers = 0;
+    REQUIRE_THROWS_AS(pool.set_autoscale_policy(p), std::invalid_argument);
+
+    p = test_policy();
+    p.max_workers = 0;
+    REQUIRE_THROWS_AS(pool.set_autoscale_policy(p), std::invalid_argument);
+
+    p = test_policy();
+    p.percentile = 0;
+    REQUIRE_THROWS_AS(pool.set_autoscale_policy(p), std::invalid_argument);
+
+    p = test_policy();
+    p.grow_step = 0;
+    REQUIRE_THROWS_AS(pool.set_autoscale_policy(p), std::invalid_argument);
+
+    // the size is clamped to the allowed range.
+    p = test_policy();
+    p.min_workers = 2;
+    pool.set_autoscale_policy(p);
+    REQUIRE(pool.get_num_threads() == 2);
+    pool.set_autoscale_policy(std::nullopt);
+}
+
+TEST_CASE("The pool grows under load and shrinks when idle") {
+    ThreadPool pool(1);
+
+    std::mutex mtx;
+    std::vector<autoscale_decision> decisions;
+    auto conn = pool.get_autoscale_signal().connect(
+      [&](const autoscale_decision &d) {
+          std::unique_lock l {mtx};
+          decisions.push_back(d);
+      });
+
+    pool.set_autoscale_policy(test_policy());
+    pool.start();
+
+    constexpr std::size_t N = 300;
+    for (std::size_t i = 0; i < N; ++i) {
+        pool.post([] { std::this_thread::sleep_for(2ms); });
+    }
+
+    REQUIRE(wait_for_condition([&] { return pool.get_num_threads() == 4; }));
+    REQUIRE(wait_for_condition(
+      [&] { return pool.get_num_tasks_handled() == N; }));
+
+    // back down to the minimum once idle.
+    REQUIRE(wait_for_condition([&] { return pool.get_num_threads() == 1; }));
+    REQUIRE(wait_for_condition(
+      [&] { return pool.get_metrics().workers.size() == 1; }));
+
+    conn->disconnect();
+
+    std::unique_lock l {mtx};
+    REQUIRE(decisions.size() >= 6);
+    std::size_t n = 1;
+    for (const auto &d : decisions) {
+        REQUIRE(d.old_num_workers == n);
+        if (d.why == autoscale_decision::reason::IDLE) {
+            REQUIRE(d.new_num_workers == n - 1);
+        } else {
+            REQUIRE(d.new_num_workers == n + 1);
+        }
+        n = d.new_num_workers;
+    }
+    REQUIRE(decisions.front().why != autoscale_decision::reason::IDLE);
+    REQUIRE(decisions.back().why == autoscale_decision::reason::IDLE);
+}
+
+TEST_CASE("Long-running tasks saturating the pool make it grow") {
+    ThreadPool pool(1);
+    auto p = test_policy();
+    p.max_workers = 2;
+    pool.set_autoscale_policy(p);
+    pool.start();
+
+    // The first task ties up the only worker, so no queue wait is recorded
+    // for the second one until it starts.
+    std::atomic<bool> release {false};
+    std::atomic<unsigned> done {0};
+    pool.post([&] {
+        while (!release) {
+            std::this_thread::sleep_for(1ms);
+        }
+        done++;
+    });
+    pool.post([&] { done++; });
+
+    REQUIRE(wait_for_condition([&] { return done == 1; }));
+    REQUIRE(pool.get_num_threads() == 2);
+
+    release = true;
+    REQUIRE(wait_for_condition([&] { return done == 2; }));
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
@@ -0,0 +1,280 @@
+#include <tarp/dsp.hxx>
+#include <tarp/pipeline.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+using namespace tarp;
+
+namespace {
+
+template<typename T>
+std::vector<T> make_signal(std::size_t n) {
+    std::vector<T> v;
+    for (std::size_t i = 0; i < n; ++i) {
+        v.push_back(static_cast<T>(std::sin(0.1 * i) + 0.01 * ((i * 37) % 11)));
+    }
+    return v;
+}
+
+// Straightforward reference implementation.
+template<typename T>
+std::vector<T> reference_fir(const std::vector<T> &in, const std::vector<T> &taps) {
+    std::vector<T> out;
+    for (std::size_t i = 0; i + taps.size() <= in.size(); ++i) {
+        double acc = 0;
+        for (std::size_t j = 0; j < taps.size(); ++j) {
+            acc += static_cast<double>(taps[j]) * in[i + j];
+        }
+        out.push_back(static_cast<T>(acc));
+    }
+    return out;
+}
+
+// Feed the inputs to the stage in batches of varying sizes.
+template<typename stage_t, typename T>
+std::vector<T> run_batches(stage_t &stage, const std::vector<T> &inputs) {
+    std::vector<T> outputs;
+    stage.output_batch.connect_detached([&](const T *values, std::size_t n) {
+        outputs.insert(outputs.end(), values, values + n);
+    });
+
+    std::size_t pos = 0;
+    std::size_t batch_size = 1;
+    while (pos < inputs.size()) {
+        auto n = std::min(batch_size, inputs.size() - pos);
+        stage.process_batch(inputs.data() + pos, n);
+        pos += n;
+        batch_size = (batch_size * 5) % 23;
+    }
+    return outputs;
+}
+
+template<typename stage_t, typename T>
+std::vector<T> run_single(stage_t &stage, const std::vector<T> &inputs) {
+    std::vector<T> outputs;
+    stage.output.connect_detached([&](T value) { outputs.push_back(value); });
+    for (auto v : inputs) {
+        stage.process(v);
+    }
+    return outputs;
+}
+
+template<typename T>
+void check_fir_kernels() {
+    auto in = make_signal<T>(1000);
+
+    for (std::size_t ntaps : {1, 3, 8, 17, 64}) {
+        std::vector<T> taps;
+        for (std::size_t j = 0; j < ntaps; ++j) {
+            taps.push_back(static_cast<T>(1.0 / (j + 2)));
+        }
+
+        auto expected = reference_fir(in, taps);
+
+        std::vector<T> scalar(in.size());
+        dsp::fir(in.data(),
+                 in.size(),
+                 taps.data(),
+                 ntaps,
+                 scalar.data(),
+                 dsp::isa::SCALAR);
+
+        for (auto use : {dsp::isa::SCALAR, dsp::isa::SSE2, dsp::isa::AVX2}) {
+            std::vector<T> out(in.size());
+            auto n =
+              dsp::fir(in.data(), in.size(), taps.data(), ntaps, out.data(), use);
+            REQUIRE(n == expected.size());
+            for (std::size_t i = 0; i < n; ++i) {
+                REQUIRE(std::fabs(out[i] - expected[i]) < 1e-4);
+
+                // the kernels must agree exactly (see dsp::fir).
+                REQUIRE(out[i] == scalar[i]);
+            }
+        }
+
+        // too few inputs for a single output.
+        std::vector<T> out(ntaps);
+        REQUIRE(dsp::fir(in.data(), ntaps - 1, taps.data(), ntaps, out.data()) ==
+                0);
+    }
+
+    std::vector<T> out(1);
+    REQUIRE_THROWS_AS(
+      dsp::fir(in.data(), in.size(), in.data(), 0, out.data()),
+      std::invalid_argument);
+}
+
+}  // namespace
+
+TEST_CASE("Every FIR kernel matches the reference") {
+    check_fir_kernels<float>();
+    check_fir_kernels<double>();
+}
+
+TEST_CASE("Generic FIR for other types") {
+    std::vector<int> in {1, 2, 3, 4, 5};
+    std::vector<int> taps {1, 10};
+    std::vector<int> out(4);
+    REQUIRE(dsp::fir(in.data(), in.size(), taps.data(), taps.size(), out.data()) ==
+            4);
+    REQUIRE(out == std::vector<int> {21, 32, 43, 54});
+}
+
+TEST_CASE("EMA and biquad") {
+    std::vector<double> in {1, 1, 1, 1};
+    std::vector<double> out(4);
+    auto state = dsp::ema(in.data(), in.size(), 0.5, 0.0, out.data());
+    REQUIRE(out == std::vector<double> {0.5, 0.75, 0.875, 0.9375});
+    REQUIRE(state == 0.9375);
+
+    // y[i] = x[i] + 0.5 * y[i-1]: impulse response 1, 0.5, 0.25, ...
+    dsp::biquad_coeffs<double> c;
+    c.a1 = -0.5;
+    dsp::biquad_state<double> s;
+    std::vector<double> impulse {1, 0, 0, 0};
+    dsp::biquad(impulse.data(), impulse.size(), c, s, out.data());
+    REQUIRE(out == std::vector<double> {1, 0.5, 0.25, 0.125});
+
+    // FIR-only: y[i] = x[i] + x[i-1] + x[i-2]
+    dsp::biquad_coeffs<double> c2 {1, 1, 1, 0, 0};
+    dsp::biquad_state<double> s2;
+    std::vector<double> ramp {1, 2, 3, 4};
+    dsp::biquad(ramp.data(), 2, c2, s2, out.data());
+    dsp::biquad(ramp.data() + 2, 2, c2, s2, out.data() + 2);
+    REQUIRE(out == std::vector<double> {1, 3, 6, 9});
+}
+
+TEST_CASE("Running min, max and median") {
+    std::vector<int> in {5, 1, 4, 2, 8, 7, 3, 9, 6, 0};
+    std::vector<int> out(in.size());
+
+    auto n = dsp::running_min(in.data(), in.size(), 3, out.data());
+    REQUIRE(n == 8);
+    out.resize(n);
+    REQUIRE(out == std::vector<int> {1, 1, 2, 2, 3, 3, 3, 0});
+
+    out.resize(in.size());
+    n = dsp::running_max(in.data(), in.size(), 3, out.data());
+    out.resize(n);
+    REQUIRE(out == std::vector<int> {5, 4, 8, 8, 8, 9, 9, 9});
+
+    out.resize(in.size());
+    n = dsp::median(in.data(), in.size(), 3, out.data());
+    out.resize(n);
+    REQUIRE(out == std::vector<int> {4, 2, 4, 7, 7, 7, 6, 6});
+
+    // brute force, over a longer signal with duplicates.
+    std::vector<int> sig;
+    for (int i = 0; i < 500; ++i) {
+        sig.push_back((i * 7919) % 31);
+    }
+    for (std::size_t w : {1, 5, 17}) {
+        std::vector<int> mins(sig.size()), maxs(sig.size()), meds(sig.size());
+        REQUIRE(dsp::running_min(sig.data(), sig.size(), w, mins.data()) ==
+                sig.size() - w + 1);
+        dsp::running_max(sig.data(), sig.size(), w, maxs.data());
+        dsp::median(sig.data(), sig.size(), w, meds.data());
+
+        for (std::size_t i = 0; i + w <= sig.size(); ++i) {
+            std::vector<int> win(sig.begin() + i, sig.begin() + i + w);
+            std::sort(win.begin(), win.end());
+            REQUIRE(mins[i] == win.front());
+            REQUIRE(maxs[i] == win.back());
+            REQUIRE(meds[i] == win[w / 2]);
+        }
+    }
+
+    REQUIRE_THROWS_AS(dsp::median(in.data(), in.size(), 4, out.data()),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(dsp::running_min(in.data(), in.size(), 0, out.data()),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Filter stages give the same outputs in batch and single mode") {
+    auto in = make_signal<float>(700);
+
+    SUBCASE("ema") {
+        tarp::ema<float> a(0.2f), b(0.2f);
+        auto expected = run_single(a, in);
+        auto actual = run_batches(b, in);
+        REQUIRE(expected.size() == in.size());
+        REQUIRE(expected.front() == in.front());
+        REQUIRE(actual == expected);
+    }
+
+    SUBCASE("fir") {
+        std::vector<float> taps {0.1f, 0.2f, 0.4f, 0.2f, 0.1f};
+        tarp::fir_filter<float> a(taps), b(taps);
+        auto expected = reference_fir(in, taps);
+        auto single = run_single(a, in);
+        auto batched = run_batches(b, in);
+        REQUIRE(single.size() == expected.size());
+        REQUIRE(batched.size() == expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            REQUIRE(std::fabs(single[i] - expected[i]) < 1e-5);
+            REQUIRE(batched[i] == single[i]);
+        }
+    }
+
+    SUBCASE("biquad") {
+        dsp::biquad_coeffs<float> c {0.2f, 0.4f, 0.2f, -0.3f, 0.1f};
+        tarp::biquad_filter<float> a(c), b(c);
+        auto expected = run_single(a, in);
+        auto actual = run_batches(b, in);
+        REQUIRE(actual == expected);
+    }
+
+    SUBCASE("min/max/median") {
+        tarp::running_min<float> mn1(9), mn2(9);
+        tarp::running_max<float> mx1(9), mx2(9);
+        tarp::median_filter<float> md1(9), md2(9);
+        REQUIRE(run_single(mn1, in) == run_batches(mn2, in));
+        REQUIRE(run_single(mx1, in) == run_batches(mx2, in));
+
+        auto medians = run_single(md1, in);
+        REQUIRE(medians.size() == in.size() - 8);
+        REQUIRE(medians == run_batches(md2, in));
+    }
+}
+
+TEST_CASE("Filter stages compose in a fused pipeline") {
+    auto in = make_signal<float>(200);
+
+    tarp::median_filter<float> md(3);
+    tarp::fir_filter<float> fir({0.5f, 0.5f});
+    tarp::ema<float> ema(0.5f);
+
+    std::vector<float> out;
+    auto p = tarp::make_pipeline(md, fir, ema, [&](float v) { out.push_back(v); });
+    p.process_batch(in.data(), in.size());
+
+    // 2 samples lost to the median window and 1 to the FIR window.
+    REQUIRE(out.size() == in.size() - 3);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
@@ -116,3 +116,33 @@ bool test_event_aggregator(
   return test_passed;
 }
 
+
+// Channels can be removed; the remaining ones are still read from.
+bool test_event_aggregator_remove() {
+    E::event_aggregator<unsigned, unsigned> a;
+    auto c1 = a.channel(1);
+    auto c2 = a.channel(2);
+    auto c3 = a.channel(3);
+
+    c1->try_push(1);
+    c2->try_push(2);
+    c3->try_push(3);
+
+    a.remove(2);
+    a.remove(2); // NOP
+    a.remove(4); // NOP
+
+    auto events = a.get_all();
+    if (events.size() != 2 || events[0] + events[1] != 4) {
+        return false;
+    }
+
+    // a new channel with the same key is a different channel.
+    if (a.channel(2) == c2) {
+        return false;
+    }
+
+    c3->try_push(5);
+    auto ev = a.try_get();
+    return ev.has_value() && *ev == 5 && !a.try_get().has_value();
+}
@@ -10,3 +10,5 @@ bool test_event_aggregator(
         std::chrono::seconds max_wait,
         std::chrono::microseconds producer_period
         );
+
+bool test_event_aggregator_remove();
@@ -7,6 +7,7 @@
 #include "event_broadcaster_test.hxx"
 #include "event_aggregator_test.hxx"
 #include "event_stream_test.hxx"
+#include "stats_test.hxx"
 
 using namespace std;
 using namespace std::chrono_literals;
@@ -72,6 +73,7 @@ int main(int, const char **) {
   // event being lost whatsoever -- just for the purpose of the test, so
   // it does not fail because of fast senders outpacing the sole receiver.
   run_test(test_event_aggregator, 1000, 500, 1000, 10s, 100us);
+  run_test(test_event_aggregator_remove);
 
   //=======================================
   // ===== Test classes `event_{r,w}stream`
@@ -85,6 +87,15 @@ int main(int, const char **) {
 
   run_test(test_event_rstream, 10 * 1000, 100us, 1 * 100, 10);
 
+  //=====================================
+  // ===== Channel statistics
+  //=====================================
+  run_test(test_channel_stats);
+  run_test(test_trunk_stats);
+  run_test(test_broadcaster_stats);
+  run_test(test_aggregator_stats);
+  run_test(test_stats_registry);
+
   cerr << endl;
   cerr << "Passed: " << num_passed << "/" << num_total << "." << endl;
 
@@ -0,0 +1,210 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <tarp/evchan.hxx>
+
+#include "stats_test.hxx"
+
+using namespace std;
+using namespace std::chrono_literals;
+namespace E = tarp::evchan::ts;
+
+#define CHECK_OR_FAIL(cond)                                             \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      cerr << "check failed (" << __LINE__ << "): " << #cond << endl;   \
+      return false;                                                     \
+    }                                                                   \
+  } while (0)
+
+// Verify the counters and watermark of buffered event channels, with and
+// without ring-buffer semantics.
+bool test_channel_stats() {
+  E::event_channel<unsigned> chan(4, false);
+
+  // off by default.
+  CHECK_OR_FAIL(!chan.stats().has_value());
+
+  chan.enable_stats();
+  for (unsigned i = 0; i < 6; ++i) {
+    chan.try_push(i);
+  }
+  chan.try_get();
+  chan.try_get();
+
+  auto s = chan.stats().value();
+  cerr << s << endl;
+  CHECK_OR_FAIL(s.pushed == 4);
+  CHECK_OR_FAIL(s.dropped == 2);
+  CHECK_OR_FAIL(s.got == 2);
+  CHECK_OR_FAIL(s.depth == 2);
+  CHECK_OR_FAIL(s.high_watermark == 4);
+  CHECK_OR_FAIL(s.overwritten == 0);
+
+  CHECK_OR_FAIL(chan.get_all().size() == 2);
+  chan.try_push(1u);
+  chan.clear();
+  s = chan.stats().value();
+  CHECK_OR_FAIL(s.got == 4);
+  CHECK_OR_FAIL(s.dropped == 3);
+  CHECK_OR_FAIL(s.depth == 0);
+
+  chan.reset_stats();
+  s = chan.stats().value();
+  CHECK_OR_FAIL(s.pushed == 0 && s.got == 0 && s.dropped == 0);
+  CHECK_OR_FAIL(s.high_watermark == 0);
+
+  // circular: overwrites count as drops.
+  E::event_channel<unsigned> ring(4, true);
+  ring.enable_stats();
+  for (unsigned i = 0; i < 10; ++i) {
+    ring.try_push(i);
+  }
+  s = ring.stats().value();
+  CHECK_OR_FAIL(s.pushed == 10);
+  CHECK_OR_FAIL(s.overwritten == 6);
+  CHECK_OR_FAIL(s.dropped == 6);
+  CHECK_OR_FAIL(s.depth == 4);
+  CHECK_OR_FAIL(s.high_watermark == 4);
+
+  return true;
+}
+
+// Verify the trunk counters and that the time spent blocked by senders
+// and receivers gets recorded.
+bool test_trunk_stats() {
+  E::trunk<unsigned> trunk;
+  trunk.enable_stats();
+
+  // no receiver.
+  CHECK_OR_FAIL(!trunk.try_push(1u).first);
+
+  static constexpr unsigned NUM_MSGS = 10;
+  std::thread producer([&trunk] {
+    for (unsigned i = 0; i < NUM_MSGS; ++i) {
+      trunk.push(i);
+    }
+  });
+
+  // the producer is kept blocked for a while before each get.
+  for (unsigned i = 0; i < NUM_MSGS; ++i) {
+    std::this_thread::sleep_for(2ms);
+    CHECK_OR_FAIL(trunk.get().has_value());
+  }
+  producer.join();
+
+  // nothing to get; times out.
+  CHECK_OR_FAIL(!trunk.try_get_for(5ms).has_value());
+
+  auto s = trunk.stats().value();
+  cerr << s << endl;
+  CHECK_OR_FAIL(s.pushed == NUM_MSGS);
+  CHECK_OR_FAIL(s.got == NUM_MSGS);
+  CHECK_OR_FAIL(s.dropped == 1);
+  CHECK_OR_FAIL(s.depth == 0);
+  CHECK_OR_FAIL(s.high_watermark == 1);
+  CHECK_OR_FAIL(s.producer_block.count() == NUM_MSGS);
+  CHECK_OR_FAIL(s.producer_block.max() >= 1000 * 1000);
+  CHECK_OR_FAIL(s.consumer_wait.count() >= 1);
+  CHECK_OR_FAIL(s.consumer_wait.max() >= 5 * 1000 * 1000);
+
+  return true;
+}
+
+// Verify successful and failed deliveries are counted.
+bool test_broadcaster_stats() {
+  E::event_broadcaster<unsigned> br(false);
+  br.enable_stats();
+
+  auto a = std::make_shared<E::event_channel<unsigned>>(10, false);
+  auto b = std::make_shared<E::event_channel<unsigned>>(2, false);
+  br.connect(a);
+  br.connect(b);
+
+  for (unsigned i = 0; i < 5; ++i) {
+    br.push(i);
+  }
+
+  auto s = br.stats().value();
+  CHECK_OR_FAIL(s.pushed == 5);
+  CHECK_OR_FAIL(s.depth == 5);
+
+  br.dispatch();
+  s = br.stats().value();
+  cerr << s << endl;
+  CHECK_OR_FAIL(s.depth == 0);
+  CHECK_OR_FAIL(s.got == 7);
+  CHECK_OR_FAIL(s.dropped == 3);
+
+  return true;
+}
+
+// Verify aggregate and per-channel stats, including for channels created
+// after stats were enabled.
+bool test_aggregator_stats() {
+  E::event_aggregator<unsigned, unsigned> agg;
+  auto c1 = agg.channel(1, 2);
+
+  CHECK_OR_FAIL(!agg.stats().has_value());
+  agg.enable_stats();
+
+  auto c2 = agg.channel(2, 2);
+  for (unsigned i = 0; i < 3; ++i) {
+    c1->try_push(i);
+    c2->try_push(i);
+  }
+  CHECK_OR_FAIL(agg.try_get().has_value());
+
+  auto s = agg.stats().value();
+  cerr << s << endl;
+  CHECK_OR_FAIL(s.pushed == 6);
+  CHECK_OR_FAIL(s.overwritten == 2);
+  CHECK_OR_FAIL(s.got == 1);
+  CHECK_OR_FAIL(s.depth == 3);
+
+  auto per_channel = agg.stats_by_channel().value();
+  CHECK_OR_FAIL(per_channel.size() == 2);
+  for (auto &[k, stats] : per_channel) {
+    CHECK_OR_FAIL(stats.pushed == 3);
+    CHECK_OR_FAIL(stats.high_watermark == 2);
+  }
+
+  return true;
+}
+
+// Verify the registry aggregates channels of different types and forgets
+// channels that have been destroyed.
+bool test_stats_registry() {
+  tarp::evchan::stats_registry registry;
+
+  auto chan = std::make_shared<E::event_channel<unsigned>>(10, false);
+  auto trunk = std::make_shared<E::trunk<unsigned>>();
+  auto disabled = std::make_shared<E::event_channel<unsigned>>(10, false);
+  chan->enable_stats();
+  trunk->enable_stats();
+
+  registry.add("chan", chan);
+  registry.add("trunk", trunk);
+  registry.add("disabled", disabled);
+
+  chan->try_push(1u);
+  chan->try_push(2u);
+  trunk->try_push(3u);
+
+  auto snapshot = registry.snapshot();
+  CHECK_OR_FAIL(snapshot.size() == 2);
+  CHECK_OR_FAIL(snapshot[0].first == "chan");
+  CHECK_OR_FAIL(snapshot[1].first == "trunk");
+
+  auto total = registry.total();
+  CHECK_OR_FAIL(total.pushed == 2);
+  CHECK_OR_FAIL(total.dropped == 1);
+  CHECK_OR_FAIL(total.depth == 2);
+
+  chan.reset();
+  CHECK_OR_FAIL(registry.snapshot().size() == 1);
+
+  return true;
+}
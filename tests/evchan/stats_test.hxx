@@ -0,0 +1,7 @@
+#pragma once
+
+bool test_channel_stats();
+bool test_trunk_stats();
+bool test_broadcaster_stats();
+bool test_aggregator_stats();
+bool test_stats_registry();
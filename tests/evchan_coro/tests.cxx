@@ -0,0 +1,288 @@
+#include <tarp/evchan_coro.hxx>
+#include <tarp/executor.hxx>
+#include <tarp/threading.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+namespace E = tarp::evchan::ts;
+namespace co = tarp::evchan::coro;
+
+// Run the jobs posted to exec until pred is satisfied or a generous timeout
+// expires. Return pred().
+template<typename F>
+bool drive(tarp::exec::queue_executor &exec, F &&pred) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!pred() && std::chrono::steady_clock::now() < deadline) {
+        exec.run_one_for(10ms);
+    }
+    return pred();
+}
+
+TEST_CASE("Awaiting an event channel") {
+    tarp::exec::queue_executor exec;
+    E::event_channel<int> chan(10, false);
+    auto &rchan = chan.as_rchan();
+
+    std::vector<int> received;
+    bool done = false;
+
+    auto consumer = [&]() -> co::detached_task {
+        while (auto ev = co_await co::get(rchan, exec)) {
+            received.push_back(*ev);
+        }
+        done = true;
+    };
+    consumer();
+
+    // nothing there yet: suspended.
+    REQUIRE(received.empty());
+    REQUIRE_FALSE(done);
+
+    std::thread producer([&chan] {
+        for (int i = 0; i < 100; ++i) {
+            while (!chan.try_push(i).first) {
+                std::this_thread::sleep_for(100us);
+            }
+        }
+    });
+
+    REQUIRE(drive(exec, [&] { return received.size() == 100; }));
+    producer.join();
+
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(received[i] == i);
+    }
+
+    chan.close();
+    REQUIRE(drive(exec, [&] { return done; }));
+}
+
+TEST_CASE("Awaiting a push applies backpressure") {
+    tarp::exec::queue_executor exec;
+    E::event_channel<int> chan(2, false);
+    auto &wchan = chan.as_wchan();
+
+    int num_pushed = 0;
+    bool done = false;
+
+    auto producer = [&]() -> co::detached_task {
+        for (int i = 0; i < 10; ++i) {
+            auto [ok, rejected] = co_await co::push(wchan, exec, i);
+            if (!ok) {
+                break;
+            }
+            ++num_pushed;
+        }
+        done = true;
+    };
+    producer();
+
+    // filled the channel, then suspended.
+    REQUIRE(num_pushed == 2);
+
+    int expected = 0;
+    while (expected < 10) {
+        auto ev = chan.try_get();
+        if (ev.has_value()) {
+            REQUIRE(*ev == expected++);
+        }
+        exec.run_pending();
+    }
+
+    REQUIRE(done);
+    REQUIRE(num_pushed == 10);
+}
+
+TEST_CASE("Closing a channel fails a pending push") {
+    tarp::exec::queue_executor exec;
+    E::event_channel<int> chan(1, false);
+    auto &wchan = chan.as_wchan();
+    REQUIRE(chan.try_push(1).first);
+
+    std::optional<int> returned;
+    bool done = false;
+
+    auto producer = [&]() -> co::detached_task {
+        auto [ok, data] = co_await co::push(wchan, exec, 2);
+        REQUIRE_FALSE(ok);
+        returned = data;
+        done = true;
+    };
+    producer();
+    REQUIRE_FALSE(done);
+
+    chan.close();
+    REQUIRE(drive(exec, [&] { return done; }));
+    REQUIRE(returned == 2);
+}
+
+TEST_CASE("Selecting over multiple channels") {
+    tarp::exec::queue_executor exec;
+    E::event_channel<int> a(10, false);
+    E::event_channel<int> b(10, false);
+
+    std::vector<std::pair<std::size_t, int>> received;
+    bool done = false;
+
+    auto consumer = [&]() -> co::detached_task {
+        for (;;) {
+            auto [idx, ev] =
+              co_await co::select(exec, a.as_rchan(), b.as_rchan());
+            if (!ev) {
+                REQUIRE(idx == 2);
+                break;
+            }
+            received.emplace_back(idx, *ev);
+        }
+        done = true;
+    };
+    consumer();
+
+    REQUIRE(b.try_push(20).first);
+    REQUIRE(drive(exec, [&] { return received.size() == 1; }));
+    REQUIRE(received[0] == std::make_pair<std::size_t, int>(1, 20));
+
+    REQUIRE(a.try_push(10).first);
+    REQUIRE(drive(exec, [&] { return received.size() == 2; }));
+    REQUIRE(received[1] == std::make_pair<std::size_t, int>(0, 10));
+
+    a.close();
+    exec.run_pending();
+    REQUIRE_FALSE(done);
+
+    b.close();
+    REQUIRE(drive(exec, [&] { return done; }));
+}
+
+TEST_CASE("Awaiting an event aggregator") {
+    tarp::exec::queue_executor exec;
+    E::event_aggregator<unsigned, int> agg;
+    auto c1 = agg.channel(1);
+    auto c2 = agg.channel(2);
+
+    int sum = 0;
+    bool done = false;
+
+    auto consumer = [&]() -> co::detached_task {
+        while (auto ev = co_await co::get(agg, exec)) {
+            sum += *ev;
+        }
+        done = true;
+    };
+    consumer();
+
+    REQUIRE(c1->try_push(1).first);
+    REQUIRE(c2->try_push(2).first);
+    REQUIRE(c1->try_push(3).first);
+    REQUIRE(drive(exec, [&] { return sum == 6; }));
+
+    agg.close();
+    REQUIRE(drive(exec, [&] { return done; }));
+}
+
+TEST_CASE("Awaiting a trunk") {
+    tarp::exec::queue_executor exec;
+    E::trunk<int> trunk;
+
+    std::vector<int> received;
+
+    auto consumer = [&]() -> co::detached_task {
+        for (int i = 0; i < 10; ++i) {
+            auto ev = co_await co::get(trunk.as_rtrunk(), exec);
+            if (!ev) {
+                break;
+            }
+            received.push_back(*ev);
+        }
+    };
+    consumer();
+
+    // the producer uses the blocking API; the trunk becomes readable whenever
+    // it is blocked in push().
+    std::thread producer([&trunk] {
+        for (int i = 0; i < 10; ++i) {
+            trunk.push(i);
+        }
+    });
+
+    REQUIRE(drive(exec, [&] { return received.size() == 10; }));
+    producer.join();
+
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(received[i] == i);
+    }
+}
+
+TEST_CASE("Many coroutines sharing a thread pool") {
+    static constexpr unsigned NUM_CONSUMERS = 1000;
+
+    tarp::threading::ThreadPool pool(4);
+    pool.start();
+    tarp::exec::threadpool_executor exec(pool);
+
+    E::event_channel<unsigned> chan(64, false);
+    auto &rchan = chan.as_rchan();
+
+    std::atomic<unsigned> num_received {0};
+    std::atomic<unsigned> num_done {0};
+
+    auto consumer = [&]() -> co::detached_task {
+        while (co_await co::get(rchan, exec)) {
+            ++num_received;
+        }
+        ++num_done;
+    };
+
+    for (unsigned i = 0; i < NUM_CONSUMERS; ++i) {
+        consumer();
+    }
+
+    static constexpr unsigned NUM_MSGS = 10000;
+    for (unsigned i = 0; i < NUM_MSGS; ++i) {
+        while (!chan.try_push(i).first) {
+            std::this_thread::yield();
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (num_received < NUM_MSGS &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(num_received == NUM_MSGS);
+
+    chan.close();
+    while (num_done < NUM_CONSUMERS &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(num_done == NUM_CONSUMERS);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
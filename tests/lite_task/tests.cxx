@@ -0,0 +1,275 @@
+#include <tarp/lite_task.hxx>
+#include <tarp/threading.hxx>
+#include <tarp/work_stealing_pool.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+using namespace tarp::sched;
+
+// Count heap allocations made by the current thread.
+// NOTE: noinline, otherwise gcc flags the (matching) malloc/free pairs.
+namespace {
+thread_local std::size_t num_allocs = 0;
+}
+
+__attribute__((noinline)) void *operator new(std::size_t n) {
+    ++num_allocs;
+    if (void *p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p,
+                                                std::size_t) noexcept {
+    std::free(p);
+}
+
+TEST_CASE("inline_task runs and destroys its callable") {
+    auto counter = std::make_shared<int>(0);
+
+    {
+        auto t = make_inline_task([counter] { ++*counter; });
+        t->execute();
+        t->execute();
+        REQUIRE(*counter == 2);
+        REQUIRE(counter.use_count() == 2);
+    }
+    REQUIRE(counter.use_count() == 1);
+
+    // too big to be stored inline.
+    std::array<char, 256> big {};
+    big[0] = 'x';
+    char seen = 0;
+    auto t = make_inline_task([big, &seen] { seen = big[0]; });
+    t->execute();
+    REQUIRE(seen == 'x');
+}
+
+TEST_CASE("inline_task does not allocate after warm-up") {
+    int counter = 0;
+
+    // warm up the freelist.
+    make_inline_task([&counter] { ++counter; })->execute();
+
+    auto before = num_allocs;
+    for (int i = 0; i < 1000; ++i) {
+        auto t = make_inline_task([&counter] { ++counter; });
+        t->execute();
+    }
+    REQUIRE(num_allocs == before);
+    REQUIRE(counter == 1001);
+}
+
+TEST_CASE("lite_task does not allocate after warm-up") {
+    {
+        auto [t, f] = make_lite_task([] { return 1; });
+        t->execute();
+        REQUIRE(f.get() == 1);
+    }
+
+    auto before = num_allocs;
+    for (int i = 0; i < 1000; ++i) {
+        auto [t, f] = make_lite_task([i] { return i; });
+        t->execute();
+        REQUIRE(f.get() == i);
+    }
+    REQUIRE(num_allocs == before);
+}
+
+TEST_CASE("lite_future: values, void, exceptions, broken promises") {
+    lite_promise<std::string> p;
+    auto f = p.get_future();
+    REQUIRE(f.valid());
+    REQUIRE(!f.is_ready());
+    REQUIRE_THROWS_AS(p.get_future(), std::future_error);
+
+    p.set_value("hello");
+    REQUIRE(f.is_ready());
+    REQUIRE(f.get() == "hello");
+    REQUIRE(!f.valid());
+    REQUIRE_THROWS_AS(p.set_value("again"), std::future_error);
+
+    lite_promise<void> pv;
+    auto fv = pv.get_future();
+    pv.set_value();
+    fv.get();
+
+    auto [t, fe] = make_lite_task([]() -> int { throw std::runtime_error("x"); });
+    t->execute();
+    REQUIRE_THROWS_AS(fe.get(), std::runtime_error);
+
+    lite_future<int> fb;
+    {
+        lite_promise<int> pb;
+        fb = pb.get_future();
+    }
+    REQUIRE_THROWS_AS(fb.get(), std::future_error);
+}
+
+TEST_CASE("lite_future: blocking get across threads") {
+    lite_promise<int> p;
+    auto f = p.get_future();
+
+    std::thread t([&p] {
+        std::this_thread::sleep_for(20ms);
+        p.set_value(42);
+    });
+
+    REQUIRE(f.get() == 42);
+    t.join();
+}
+
+TEST_CASE("lite_future: continuations") {
+    // chained before the value is set.
+    lite_promise<int> p;
+    auto f = p.get_future()
+               .then([](int i) { return i * 2; })
+               .then([](int i) { return std::to_string(i); });
+    REQUIRE(!f.is_ready());
+    p.set_value(21);
+    REQUIRE(f.is_ready());
+    REQUIRE(f.get() == "42");
+
+    // chained after the value is set: runs immediately.
+    lite_promise<void> pv;
+    auto fv = pv.get_future();
+    pv.set_value();
+    bool ran = false;
+    auto f2 = std::move(fv).then([&ran] { ran = true; });
+    REQUIRE(ran);
+    f2.get();
+
+    // exceptions skip the continuation and propagate.
+    lite_promise<int> pe;
+    bool called = false;
+    auto fe = pe.get_future().then([&called](int) {
+        called = true;
+        return 0;
+    });
+    pe.set_exception(std::make_exception_ptr(std::runtime_error("x")));
+    REQUIRE_THROWS_AS(fe.get(), std::runtime_error);
+    REQUIRE(!called);
+
+    // exception thrown by the continuation itself.
+    lite_promise<int> pt;
+    auto ft = pt.get_future().then([](int) -> int {
+        throw std::logic_error("y");
+    });
+    pt.set_value(1);
+    REQUIRE_THROWS_AS(ft.get(), std::logic_error);
+}
+
+// Tasks are allocated on the posting thread but destroyed on the workers;
+// their memory must find its way back to the poster's freelist.
+TEST_CASE("ThreadPool::post does not allocate tasks in the steady state") {
+    constexpr unsigned BATCH = 256;
+    constexpr unsigned NUM_BATCHES = 40;
+
+    tarp::threading::ThreadPool pool(4);
+    pool.start();
+
+    std::atomic<unsigned> counter {0};
+    auto post_batch = [&] {
+        auto target = counter.load() + BATCH;
+        for (unsigned i = 0; i < BATCH; ++i) {
+            pool.post([&counter] { counter++; });
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + 10s;
+        while (counter < target && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(100us);
+        }
+        REQUIRE(counter == target);
+    };
+
+    // warm-up: the first batch populates the freelist.
+    post_batch();
+
+    auto before = num_allocs;
+    for (unsigned i = 1; i < NUM_BATCHES; ++i) {
+        post_batch();
+    }
+
+    // NOTE: the pool's task queue (a std::deque) still allocates a chunk
+    // every so often; the tasks themselves should not allocate at all.
+    auto num_posted = BATCH * (NUM_BATCHES - 1);
+    REQUIRE(num_allocs - before < num_posted / 16);
+}
+
+TEST_CASE("Fire-and-forget submission to the thread pools") {
+    constexpr unsigned N = 10000;
+
+    SUBCASE("ThreadPool") {
+        tarp::threading::ThreadPool pool(4);
+        pool.start();
+
+        std::atomic<unsigned> counter {0};
+        for (unsigned i = 0; i < N; ++i) {
+            pool.post([&counter] { counter++; });
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + 10s;
+        while (counter < N && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        REQUIRE(counter == N);
+    }
+
+    SUBCASE("WorkStealingPool") {
+        tarp::threading::WorkStealingPool pool(4);
+        pool.start();
+
+        std::atomic<unsigned> counter {0};
+        for (unsigned i = 0; i < N; ++i) {
+            pool.post([&counter] { counter++; });
+        }
+
+        auto [t, f] = make_lite_task([] { return 7; });
+        pool.enqueue_task(std::move(t));
+        REQUIRE(f.get() == 7);
+
+        auto deadline = std::chrono::steady_clock::now() + 10s;
+        while (counter < N && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        REQUIRE(counter == N);
+    }
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
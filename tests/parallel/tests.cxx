@@ -0,0 +1,222 @@
+#include <tarp/parallel.hxx>
+#include <tarp/seqtools.hxx>
+#include <tarp/threading.hxx>
+#include <tarp/work_stealing_pool.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using tarp::threading::ThreadPool;
+using tarp::threading::WorkStealingPool;
+
+namespace {
+
+std::vector<std::uint64_t> make_input(std::size_t n) {
+    std::mt19937_64 rng(n);
+    std::vector<std::uint64_t> v(n);
+    for (auto &i : v) {
+        i = rng() % 100000;
+    }
+    return v;
+}
+
+template<typename Pool>
+void check_algorithms(Pool &pool) {
+    for (std::size_t n : {0, 1, 7, 1000, 100003}) {
+        for (std::size_t grain : {0, 1, 64}) {
+            auto input = make_input(n);
+
+            // for_each
+            auto v = input;
+            tarp::parallel::for_each(
+              pool, v.begin(), v.end(), [](auto &i) { i *= 2; }, grain);
+            for (std::size_t i = 0; i < n; ++i) {
+                REQUIRE(v[i] == input[i] * 2);
+            }
+
+            // parallel_for: every index visited exactly once.
+            std::vector<std::atomic<int>> visits(n);
+            tarp::parallel::parallel_for(
+              pool,
+              0,
+              n,
+              [&](std::size_t lo, std::size_t hi) {
+                  for (auto i = lo; i < hi; ++i) {
+                      visits[i]++;
+                  }
+              },
+              grain);
+            for (auto &c : visits) {
+                REQUIRE(c == 1);
+            }
+
+            // transform_reduce; non-commutative reduction (concatenation).
+            auto sum = tarp::parallel::transform_reduce(
+              pool,
+              input.begin(),
+              input.end(),
+              std::uint64_t {5},
+              std::plus<> {},
+              [](auto i) { return i * i; },
+              grain);
+            std::uint64_t expected = 5;
+            for (auto i : input) {
+                expected += i * i;
+            }
+            REQUIRE(sum == expected);
+
+            if (n < 2000) {
+                auto s = tarp::parallel::transform_reduce(
+                  pool,
+                  input.begin(),
+                  input.end(),
+                  std::string {},
+                  std::plus<> {},
+                  [](auto i) { return std::to_string(i) + ","; },
+                  grain);
+                std::string expected_s;
+                for (auto i : input) {
+                    expected_s += std::to_string(i) + ",";
+                }
+                REQUIRE(s == expected_s);
+            }
+
+            // sort
+            v = input;
+            tarp::parallel::sort(
+              pool, v.begin(), v.end(), std::greater<> {}, grain);
+            auto sorted = input;
+            std::sort(sorted.begin(), sorted.end(), std::greater<> {});
+            REQUIRE(v == sorted);
+
+            // scan, out of place and in place.
+            std::vector<std::uint64_t> out(n);
+            std::vector<std::uint64_t> expected_scan(n);
+            std::partial_sum(
+              input.begin(), input.end(), expected_scan.begin());
+            auto end = tarp::parallel::scan(pool,
+                                            input.begin(),
+                                            input.end(),
+                                            out.begin(),
+                                            std::plus<> {},
+                                            grain);
+            REQUIRE(end == out.end());
+            REQUIRE(out == expected_scan);
+
+            v = input;
+            tarp::parallel::scan(
+              pool, v.begin(), v.end(), v.begin(), std::plus<> {}, grain);
+            REQUIRE(v == expected_scan);
+        }
+    }
+}
+
+}  // namespace
+
+TEST_CASE("chunk_range") {
+    std::vector<std::pair<int, int>> chunks;
+    auto n = tarp::chunk_range(
+      3, 13, 4, [&](int lo, int hi) { chunks.emplace_back(lo, hi); });
+    REQUIRE(n == 3);
+    REQUIRE(chunks ==
+            std::vector<std::pair<int, int>> {{3, 7}, {7, 11}, {11, 13}});
+
+    std::vector<char> v(5);
+    std::size_t total = 0;
+    n = tarp::chunk_range(v.begin(), v.end(), 5, [&](auto lo, auto hi) {
+        total += static_cast<std::size_t>(hi - lo);
+    });
+    REQUIRE(n == 1);
+    REQUIRE(total == 5);
+
+    REQUIRE(tarp::chunk_range(0, 0, 4, [](int, int) {}) == 0);
+}
+
+TEST_CASE("Algorithms on a ThreadPool") {
+    ThreadPool pool(4);
+    pool.start();
+    check_algorithms(pool);
+}
+
+TEST_CASE("Algorithms on a WorkStealingPool") {
+    WorkStealingPool pool(4);
+    pool.start();
+    check_algorithms(pool);
+}
+
+TEST_CASE("Nested parallel calls from within a task") {
+    WorkStealingPool pool(2);
+    pool.start();
+
+    // Each outer chunk runs a parallel algorithm on the same pool; the
+    // waiting callers help out so this cannot deadlock.
+    std::vector<std::vector<std::uint64_t>> inputs(8, make_input(10000));
+    tarp::parallel::for_each(
+      pool,
+      inputs.begin(),
+      inputs.end(),
+      [&pool](auto &v) { tarp::parallel::sort(pool, v.begin(), v.end()); },
+      1);
+
+    for (auto &v : inputs) {
+        REQUIRE(std::is_sorted(v.begin(), v.end()));
+    }
+}
+
+TEST_CASE("Exceptions are propagated to the caller") {
+    WorkStealingPool pool(4);
+    pool.start();
+
+    std::atomic<unsigned> count {0};
+    bool caught = false;
+    try {
+        tarp::parallel::parallel_for(
+          pool,
+          0,
+          100,
+          [&](std::size_t lo, std::size_t) {
+              count++;
+              if (lo == 50) {
+                  throw std::runtime_error("chunk failed");
+              }
+          },
+          10);
+    } catch (const std::runtime_error &) {
+        caught = true;
+    }
+
+    REQUIRE(caught);
+
+    // all the chunks still ran to completion.
+    REQUIRE(count == 10);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
@@ -1,5 +1,11 @@
+#include <atomic>
+#include <chrono>
 #include <initializer_list>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <tarp/cohort.h>
 #include <tarp/floats.h>
@@ -77,6 +83,389 @@ OUT test_ma(enum transformType transform,
     return TEST_PASS;
 }
 
+/*
+ * Feed the same inputs to two identical stages: one value at a time to the
+ * first and in batches of varying sizes to the second. The outputs must
+ * match: to the given tolerance or, if it is 0, exactly.
+ */
+template<typename IN, typename OUT>
+int test_batch_equivalence(std::shared_ptr<tarp::PipelineStage<IN, OUT>> single,
+                           std::shared_ptr<tarp::PipelineStage<IN, OUT>> batched,
+                           const std::vector<IN> &inputs,
+                           double tolerance) {
+    vector<OUT> expected;
+    vector<OUT> actual;
+    single->output.connect_detached([&](OUT val) { expected.push_back(val); });
+    batched->output_batch.connect_detached([&](const OUT *vals, size_t n) {
+        actual.insert(actual.end(), vals, vals + n);
+    });
+
+    for (auto &i : inputs) {
+        single->process(i);
+    }
+
+    size_t pos = 0;
+    size_t batch_size = 1;
+    while (pos < inputs.size()) {
+        size_t n = std::min(batch_size, inputs.size() - pos);
+        batched->process_batch(inputs.data() + pos, n);
+        pos += n;
+        batch_size = (batch_size * 3) % 17;
+    }
+
+    if (actual.size() != expected.size()) {
+        error("number of batch outputs (%zu) != number of outputs (%zu)",
+              actual.size(),
+              expected.size());
+        return TEST_FAIL;
+    }
+
+    for (size_t i = 0; i < actual.size(); ++i) {
+        bool match = tolerance > 0 ? !dbcmp(actual[i], expected[i], tolerance)
+                                   : actual[i] == expected[i];
+        if (!match) {
+            error("FAIL: output %zu: batch(%f) != single(%f)",
+                  i,
+                  static_cast<double>(actual[i]),
+                  static_cast<double>(expected[i]));
+            return TEST_FAIL;
+        }
+    }
+
+    return TEST_PASS;
+}
+
+std::vector<float> make_inputs(size_t n) {
+    std::vector<float> inputs;
+    for (size_t i = 0; i < n; ++i) {
+        inputs.push_back(static_cast<float>((i * 7919) % 1000) / 10.f);
+    }
+    return inputs;
+}
+
+/*
+ * The counter outputs 1 on every wraparound, whether fed one value at a
+ * time or in batches; stages joined in batch mode and in single mode can
+ * be mixed.
+ */
+int test_counter_and_mixed_joins() {
+    tarp::counter<size_t> c1(4);
+    tarp::counter<size_t> c2(4);
+    size_t singles = 0;
+    size_t batched = 0;
+    c1.output.connect_detached([&](size_t) { ++singles; });
+    c2.output_batch.connect_detached([&](const size_t *, size_t n) {
+        batched += n;
+    });
+
+    std::vector<size_t> inputs(11, 0);
+    for (auto i : inputs) {
+        c1.process(i);
+    }
+    c2.process_batch(inputs.data(), 3);
+    c2.process_batch(inputs.data(), 8);
+
+    if (singles != 2 || batched != 2) {
+        error("counter: singles=%zu batched=%zu", singles, batched);
+        return TEST_FAIL;
+    }
+
+    // bandpass -> (batch) sma -> (single) sink; the sma is only given
+    // batches, but still emits on the single-value output.
+    tarp::memoryless_bandpass_filter<float> bp(10, 80, false);
+    tarp::sma<float, float> ma(2);
+    ma.join_batch(bp);
+
+    std::vector<float> outputs;
+    ma.output.connect_detached([&](float v) { outputs.push_back(v); });
+
+    std::vector<float> values {5, 10, 20, 90, 30, 81, 40};
+    bp.process_batch(values);
+
+    std::vector<float> expected {15, 25, 35};
+    if (outputs.size() != expected.size()) {
+        return TEST_FAIL;
+    }
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (dbcmp(outputs[i], expected[i], 0.01)) {
+            return TEST_FAIL;
+        }
+    }
+
+    return TEST_PASS;
+}
+
+/*
+ * A fused pipeline produces the same outputs as the same stages joined
+ * through their signals.
+ */
+int test_fused_pipeline() {
+    auto inputs = make_inputs(500);
+
+    tarp::sma<float, float> ma1(4);
+    tarp::memoryless_bandpass_filter<float> bp1(40, 60, false);
+    tarp::wma<float, float> wma1(3, {0.5, 0.3, 0.2});
+    bp1.join(ma1);
+    wma1.join(bp1);
+
+    std::vector<float> expected;
+    wma1.output.connect_detached([&](float v) { expected.push_back(v); });
+    for (auto i : inputs) {
+        ma1.process(i);
+    }
+
+    tarp::sma<float, float> ma2(4);
+    tarp::memoryless_bandpass_filter<float> bp2(40, 60, false);
+    tarp::wma<float, float> wma2(3, {0.5, 0.3, 0.2});
+
+    std::vector<float> actual;
+    auto p =
+      tarp::make_pipeline(ma2, bp2, wma2, [&](float v) { actual.push_back(v); });
+
+    static_assert(std::is_same_v<decltype(p)::input_type, float>);
+    static_assert(std::is_same_v<decltype(p)::output_type, float>);
+
+    for (size_t i = 0; i < 100; ++i) {
+        p(inputs[i]);
+    }
+    p.process_batch(inputs.data() + 100, inputs.size() - 100);
+
+    if (expected.empty() || actual.size() != expected.size()) {
+        error("fused outputs (%zu) != joined outputs (%zu)",
+              actual.size(),
+              expected.size());
+        return TEST_FAIL;
+    }
+
+    for (size_t i = 0; i < actual.size(); ++i) {
+        if (dbcmp(actual[i], expected[i], 0.0001)) {
+            return TEST_FAIL;
+        }
+    }
+
+    // the output signals of the stages are bypassed.
+    size_t emitted = 0;
+    ma2.output.connect_detached([&](float) { ++emitted; });
+    p(1.0);
+    if (emitted != 0) {
+        return TEST_FAIL;
+    }
+
+    // single stage.
+    tarp::counter<size_t> c(3);
+    size_t wraparounds = 0;
+    auto p2 = tarp::make_pipeline(c, [&](size_t) { ++wraparounds; });
+    for (size_t i = 0; i < 7; ++i) {
+        p2(i);
+    }
+    if (wraparounds != 2) {
+        return TEST_FAIL;
+    }
+
+    return TEST_PASS;
+}
+
+/*
+ * Stages downstream of an async_boundary run on another thread, receive
+ * all the values in order, and hold up the producer only once the
+ * boundary buffer is full.
+ */
+int test_async_boundary() {
+    using namespace std::chrono_literals;
+
+    auto inputs = make_inputs(2000);
+
+    tarp::sma<float, float> ma(4);
+    tarp::async_boundary<float> b(64);
+    tarp::memoryless_bandpass_filter<float> bp(0, 1000, false);
+    b.join(ma);
+    bp.join_batch(b);
+
+    std::vector<float> expected;
+    {
+        tarp::sma<float, float> ref(4);
+        auto p = tarp::make_pipeline(ref, [&](float v) {
+            expected.push_back(v);
+        });
+        p.process_batch(inputs.data(), inputs.size());
+    }
+
+    const auto producer = std::this_thread::get_id();
+    std::atomic<bool> wrong_thread {false};
+    std::atomic<size_t> max_buffered {0};
+    std::vector<float> actual;
+    bp.output.connect_detached([&](float v) {
+        if (std::this_thread::get_id() == producer) {
+            wrong_thread = true;
+        }
+        max_buffered = std::max<size_t>(max_buffered, b.size());
+        actual.push_back(v);
+        if (actual.size() % 100 == 0) {
+            std::this_thread::sleep_for(1ms);
+        }
+    });
+
+    for (size_t i = 0; i < 1000; ++i) {
+        ma.process(inputs[i]);
+    }
+    ma.process_batch(inputs.data() + 1000, inputs.size() - 1000);
+    b.flush();
+
+    if (wrong_thread || max_buffered > b.capacity() ||
+        b.num_batches() >= actual.size()) {
+        error("wrong_thread=%d max_buffered=%zu batches=%zu",
+              wrong_thread.load(),
+              max_buffered.load(),
+              b.num_batches());
+        return TEST_FAIL;
+    }
+
+    if (actual.size() != expected.size()) {
+        error("async outputs (%zu) != expected (%zu)",
+              actual.size(),
+              expected.size());
+        return TEST_FAIL;
+    }
+
+    for (size_t i = 0; i < actual.size(); ++i) {
+        if (dbcmp(actual[i], expected[i], 0.01)) {
+            return TEST_FAIL;
+        }
+    }
+
+    return TEST_PASS;
+}
+
+/*
+ * Parallel paths behind their own boundaries run concurrently.
+ */
+int test_async_fanout() {
+    using namespace std::chrono_literals;
+
+    tarp::sma<float, float> ma(1);
+    tarp::async_boundary<float> b1(16);
+    tarp::async_boundary<float> b2(16);
+    b1.join(ma);
+    b2.join(ma);
+
+    std::atomic<unsigned> n1 {0};
+    std::atomic<unsigned> n2 {0};
+    auto slow = [](std::atomic<unsigned> &n) {
+        return [&n](float) {
+            std::this_thread::sleep_for(2ms);
+            n++;
+        };
+    };
+    b1.output.connect_detached(slow(n1));
+    b2.output.connect_detached(slow(n2));
+
+    // each path takes >= 100ms; in sequence, both would take >= 200ms.
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 50; ++i) {
+        ma.process(static_cast<float>(i));
+    }
+    b1.flush();
+    b2.flush();
+    auto elapsed = std::chrono::steady_clock::now() - t0;
+
+    if (n1 != 50 || n2 != 50 || elapsed >= 190ms) {
+        return TEST_FAIL;
+    }
+
+    return TEST_PASS;
+}
+
+/* Pass-through stage that spins for a while on each input. */
+class slow_stage : public tarp::PipelineStage<float, float> {
+protected:
+    void process_input(float input, std::optional<float> &result) override {
+        auto until = std::chrono::steady_clock::now() +
+                     std::chrono::microseconds(20);
+        while (std::chrono::steady_clock::now() < until) {
+        }
+        result = input;
+    }
+};
+
+/*
+ * The profiler attributes counts and time to the right stages and
+ * reconstructs the topology of the pipeline.
+ */
+int test_profiler() {
+    auto inputs = make_inputs(1000);
+
+    tarp::sma<float, float> ma(4);
+    tarp::memoryless_bandpass_filter<float> bp(0, 50, false);
+    slow_stage slow;
+    tarp::sma<float, float> unprofiled(2);
+    bp.join(ma);
+    slow.join_batch(ma);
+    unprofiled.join(ma);
+
+    tarp::pipeline_profiler prof;
+    prof.add(ma, "ma");
+    prof.add(slow, "slow");
+
+    for (size_t i = 0; i < 500; ++i) {
+        ma.process(inputs[i]);
+    }
+    ma.process_batch(inputs.data() + 500, inputs.size() - 500);
+
+    // added after the stage has been joined and fed.
+    prof.add(bp, "bandpass");
+    for (size_t i = 0; i < 10; ++i) {
+        ma.process(1000);
+    }
+
+    auto m = prof.snapshot();
+    if (m.size() != 3 || m[0].name != "ma" || m[0].upstream.has_value() ||
+        m[1].upstream != 0 || m[2].upstream != 0) {
+        error("wrong topology");
+        return TEST_FAIL;
+    }
+
+    // sma(4) drops its first 3 inputs.
+    if (m[0].num_inputs != 1010 || m[0].num_outputs != 1007 ||
+        m[0].process_time.count() != 1010 || m[0].drop_ratio() <= 0) {
+        error("ma: inputs=%lu outputs=%lu",
+              static_cast<unsigned long>(m[0].num_inputs),
+              static_cast<unsigned long>(m[0].num_outputs));
+        return TEST_FAIL;
+    }
+
+    // the last 10 inputs are out of band.
+    if (m[1].num_inputs != 1007 || m[1].num_outputs != 1007 ||
+        m[2].num_inputs != 10 || m[2].num_outputs != 0 ||
+        m[2].drop_ratio() != 1) {
+        error("slow/bandpass: wrong counts");
+        return TEST_FAIL;
+    }
+
+    // the time of the downstream stages is not charged to ma.
+    if (m[1].busy_time < std::chrono::milliseconds(15) ||
+        m[0].busy_time >= m[1].busy_time) {
+        error("wrong busy times");
+        return TEST_FAIL;
+    }
+
+    std::ostringstream ss;
+    prof.dump(ss);
+    auto dump = ss.str();
+    if (dump.find("\nma ") == std::string::npos ||
+        dump.find("  `-slow ") == std::string::npos ||
+        dump.find("  `-bandpass ") == std::string::npos) {
+        error("unexpected dump:\n%s", dump.c_str());
+        return TEST_FAIL;
+    }
+
+    prof.reset();
+    if (prof.snapshot()[1].num_inputs != 0) {
+        return TEST_FAIL;
+    }
+
+    return TEST_PASS;
+}
+
 int main(int argc, char **argv) {
     UNUSED(argc);
     UNUSED(argv);
@@ -137,5 +526,77 @@ int main(int argc, char **argv) {
                  outputs);
     update_test_counter(passed, test_wma);
 
+    /*==========================
+     * Test 4:
+     * Batch processing produces the same outputs as processing one value
+     * at a time.
+     */
+    auto batch_inputs = make_inputs(1000);
+
+    printf("Validating batch tarp::sma\n");
+    passed = run(test_batch_equivalence<float, float>,
+                 TEST_PASS,
+                 make_shared<tarp::sma<float, float>>(8),
+                 make_shared<tarp::sma<float, float>>(8),
+                 batch_inputs,
+                 0.0);
+    update_test_counter(passed, test_batch_equivalence);
+
+    printf("Validating batch tarp::wma\n");
+    passed = run(
+      test_batch_equivalence<float, float>,
+      TEST_PASS,
+      make_shared<tarp::wma<float, float>>(5, initializer_list<float> {0.3, 0.4}),
+      make_shared<tarp::wma<float, float>>(5, initializer_list<float> {0.3, 0.4}),
+      batch_inputs,
+      0.0);
+    update_test_counter(passed, test_batch_equivalence);
+
+    printf("Validating batch tarp::memoryless_bandpass_filter\n");
+    passed =
+      run(test_batch_equivalence<float, float>,
+          TEST_PASS,
+          make_shared<tarp::memoryless_bandpass_filter<float>>(50, 20, true),
+          make_shared<tarp::memoryless_bandpass_filter<float>>(50, 20, true),
+          batch_inputs,
+          0.0);
+    update_test_counter(passed, test_batch_equivalence);
+
+    /*==========================
+     * Test 5:
+     * Counter, and stages joined in batch mode.
+     */
+    printf("Validating tarp::counter and batch joins\n");
+    passed = run(test_counter_and_mixed_joins, TEST_PASS);
+    update_test_counter(passed, test_counter_and_mixed_joins);
+
+    /*==========================
+     * Test 6:
+     * Statically fused pipelines.
+     */
+    printf("Validating tarp::make_pipeline\n");
+    passed = run(test_fused_pipeline, TEST_PASS);
+    update_test_counter(passed, test_fused_pipeline);
+
+    /*==========================
+     * Test 7:
+     * Asynchronous stage boundaries.
+     */
+    printf("Validating tarp::async_boundary\n");
+    passed = run(test_async_boundary, TEST_PASS);
+    update_test_counter(passed, test_async_boundary);
+
+    printf("Validating concurrent parallel paths\n");
+    passed = run(test_async_fanout, TEST_PASS);
+    update_test_counter(passed, test_async_fanout);
+
+    /*==========================
+     * Test 8:
+     * Stage profiling.
+     */
+    printf("Validating tarp::pipeline_profiler\n");
+    passed = run(test_profiler, TEST_PASS);
+    update_test_counter(passed, test_profiler);
+
     report_test_summary();
 }
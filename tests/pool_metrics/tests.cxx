@@ -0,0 +1,193 @@
+#include <tarp/pool_metrics.hxx>
+#include <tarp/threading.hxx>
+#include <tarp/work_stealing_pool.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace std::chrono_literals;
+using namespace tarp::threading;
+
+namespace {
+
+template<typename pool_t>
+void wait_handled(const pool_t &pool, std::size_t n) {
+    auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (pool.get_num_tasks_handled() < n &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+}
+
+// With legacy=true, tasks are run the way ActiveObject subclasses
+// traditionally do, i.e. with get_next_task()->execute().
+template<bool legacy>
+class active_counter : public ActiveObject {
+public:
+    active_counter() { run(); }
+
+    ~active_counter() override { stop(); }
+
+    void bump() {
+        post([this] {
+            std::this_thread::sleep_for(1ms);
+            m_count++;
+        });
+    }
+
+    unsigned count() const { return m_count; }
+
+private:
+    void do_work() override {
+        if constexpr (legacy) {
+            if (!has_pending_tasks()) {
+                wait_for_next_task();
+                return;
+            }
+            if (auto task = get_next_task()) {
+                task->execute();
+            }
+        } else {
+            if (!run_next_task()) {
+                wait_for_next_task();
+            }
+        }
+    }
+
+    std::atomic<unsigned> m_count {0};
+};
+
+}  // namespace
+
+TEST_CASE("ThreadPool metrics") {
+    constexpr std::size_t N = 50;
+    ThreadPool pool(2);
+
+    pool.start();
+    for (std::size_t i = 0; i < N; ++i) {
+        pool.post([] { std::this_thread::sleep_for(1ms); });
+    }
+    wait_handled(pool, N);
+
+    auto m = pool.get_metrics();
+    REQUIRE(m.num_tasks_handled == N);
+    REQUIRE(m.queue_length == 0);
+    REQUIRE(m.queue_length_hwm > 1);
+    REQUIRE(m.queue_length_hwm <= N);
+    REQUIRE(m.exec_time.count() == N);
+    REQUIRE(m.queue_wait.count() == N);
+    REQUIRE(m.exec_time.min() >= 1'000'000);
+    REQUIRE(m.queue_wait.max() >= m.exec_time.min());
+
+    REQUIRE(m.workers.size() == 2);
+    std::uint64_t total = 0;
+    for (const auto &w : m.workers) {
+        total += w.num_tasks;
+        REQUIRE(w.busy_time <= w.uptime);
+        REQUIRE(w.busy_ratio() >= 0);
+        REQUIRE(w.busy_ratio() <= 1);
+        REQUIRE(w.num_steals == 0);
+    }
+    REQUIRE(total == N);
+
+    // metrics of removed workers are kept in the totals.
+    pool.set_num_threads(1);
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (pool.get_metrics().workers.size() != 1 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    m = pool.get_metrics();
+    REQUIRE(m.workers.size() == 1);
+    REQUIRE(m.exec_time.count() == N);
+}
+
+namespace {
+
+template<bool legacy>
+void check_active_object_metrics() {
+    active_counter<legacy> ao;
+    for (int i = 0; i < 20; ++i) {
+        ao.bump();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (ao.count() < 20 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(ao.count() == 20);
+
+    auto m = ao.get_metrics();
+    REQUIRE(m.num_tasks_handled == 20);
+    REQUIRE(m.workers.size() == 1);
+    REQUIRE(m.exec_time.count() == 20);
+    REQUIRE(m.queue_wait.count() == 20);
+    REQUIRE(m.queue_length_hwm >= 1);
+    REQUIRE(m.workers[0].busy_time.count() >= 20'000'000);
+}
+
+}  // namespace
+
+TEST_CASE("ActiveObject metrics") {
+    check_active_object_metrics<false>();
+}
+
+TEST_CASE("ActiveObject metrics with get_next_task") {
+    check_active_object_metrics<true>();
+}
+
+TEST_CASE("WorkStealingPool metrics") {
+    constexpr std::size_t N = 64;
+    WorkStealingPool pool(4);
+    pool.start();
+
+    // Tasks spawned from inside the pool go to the spawning worker's own
+    // deque, so the other workers can only get at them by stealing.
+    std::promise<void> spawned;
+    pool.post([&pool, &spawned] {
+        for (std::size_t i = 0; i < N; ++i) {
+            pool.post([] { std::this_thread::sleep_for(1ms); });
+        }
+        spawned.set_value();
+    });
+    spawned.get_future().wait();
+    wait_handled(pool, N + 1);
+
+    auto m = pool.get_metrics();
+    REQUIRE(m.num_tasks_handled == N + 1);
+    REQUIRE(m.exec_time.count() == N + 1);
+    REQUIRE(m.queue_length_hwm >= 1);
+    REQUIRE(m.workers.size() == 4);
+
+    std::uint64_t steals = 0;
+    for (const auto &w : m.workers) {
+        steals += w.num_steals;
+    }
+    REQUIRE(steals > 0);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
@@ -0,0 +1,397 @@
+#include <tarp/sched.hxx>
+#include <tarp/threading.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace tarp::sched;
+using steady = std::chrono::steady_clock;
+
+namespace {
+
+struct item {
+    item(steady::time_point d, int i) : deadline(d), id(i) {}
+
+    bool expired() const { return steady::now() >= deadline; }
+
+    steady::time_point get_expiration_time() const { return deadline; }
+
+    steady::time_point deadline;
+    int id;
+};
+
+// Scheduler that holds back all tasks until a given point in time, in order
+// to check that the thread pool sleeps until then.
+class held_back_fifo final : public Scheduler<interfaces::task> {
+public:
+    explicit held_back_fifo(steady::time_point release)
+        : Scheduler<interfaces::task>(0), m_release(release) {}
+
+    std::size_t get_queue_length() const override { return m_q.size(); }
+
+    void clear() override { m_q.clear(); }
+
+    std::optional<steady::time_point> get_first_deadline() const override {
+        if (m_q.empty()) {
+            return std::nullopt;
+        }
+        return m_release;
+    }
+
+private:
+    void do_enqueue(std::unique_ptr<interfaces::task> item) override {
+        m_q.push_back(std::move(item));
+    }
+
+    std::unique_ptr<interfaces::task> do_dequeue() override {
+        if (m_q.empty() || steady::now() < m_release) {
+            return nullptr;
+        }
+        auto t = std::move(m_q.front());
+        m_q.pop_front();
+        return t;
+    }
+
+    steady::time_point m_release;
+    std::deque<std::unique_ptr<interfaces::task>> m_q;
+};
+
+struct job {
+    job(int c, int s) : cls(c), seq(s) {}
+
+    int cls;
+    int seq;
+};
+
+std::shared_ptr<filters::Filter<job>> match_class(uint32_t filter_id, int cls) {
+    return std::make_shared<filters::MatchIf<job>>(
+      filter_id, [cls](const job &j) { return j.cls == cls; });
+}
+
+}  // namespace
+
+TEST_CASE("Deadline scheduler dequeues in deadline order") {
+    SchedulerDeadline<item> sched;
+    REQUIRE(!sched.get_first_deadline().has_value());
+    REQUIRE(sched.dequeue() == nullptr);
+
+    // all in the past, so immediately dequeueable.
+    auto base = steady::now() - 1h;
+    std::vector<int> offsets(10000);
+    std::mt19937 rng(1);
+    for (std::size_t i = 0; i < offsets.size(); ++i) {
+        offsets[i] = static_cast<int>(rng() % 500);
+        sched.enqueue(std::make_unique<item>(
+          base + std::chrono::seconds(offsets[i]), static_cast<int>(i)));
+    }
+    REQUIRE(sched.get_queue_length() == offsets.size());
+
+    std::vector<std::unique_ptr<item>> out;
+    while (auto i = sched.dequeue()) {
+        out.push_back(std::move(i));
+    }
+    REQUIRE(out.size() == offsets.size());
+    REQUIRE(sched.empty());
+
+    for (std::size_t i = 1; i < out.size(); ++i) {
+        REQUIRE(out[i - 1]->deadline <= out[i]->deadline);
+
+        // FIFO among items with equal deadlines.
+        if (out[i - 1]->deadline == out[i]->deadline) {
+            REQUIRE(out[i - 1]->id < out[i]->id);
+        }
+    }
+}
+
+TEST_CASE("Deadline scheduler holds back unexpired items") {
+    SchedulerDeadline<item> sched;
+    auto now = steady::now();
+
+    sched.enqueue(std::make_unique<item>(now + 1h, 1));
+    sched.enqueue(std::make_unique<item>(now - 1s, 2));
+    sched.enqueue(std::make_unique<item>(now + 2h, 3));
+    REQUIRE(sched.get_first_deadline() == now - 1s);
+
+    auto i = sched.dequeue();
+    REQUIRE(i);
+    REQUIRE(i->id == 2);
+
+    REQUIRE(sched.get_first_deadline() == now + 1h);
+    REQUIRE(sched.dequeue() == nullptr);
+    REQUIRE(sched.get_queue_length() == 2);
+
+    sched.clear();
+    REQUIRE(sched.empty());
+    REQUIRE(!sched.get_first_deadline().has_value());
+}
+
+TEST_CASE("Deadline tasks use the steady clock") {
+    SchedulerDeadline<interfaces::deadline_task> sched;
+
+    auto [late, late_future] =
+      make_deadline_task_as<interfaces::deadline_task>(30ms, [] { return 2; });
+    auto [early, early_future] =
+      make_deadline_task_as<interfaces::deadline_task>(10ms, [] { return 1; });
+    sched.enqueue(std::move(late));
+    sched.enqueue(std::move(early));
+
+    auto deadline = sched.get_first_deadline();
+    REQUIRE(deadline.has_value());
+    REQUIRE(*deadline > steady::now());
+
+    std::this_thread::sleep_until(*deadline);
+    auto t = sched.dequeue();
+    REQUIRE(t);
+    t->execute();
+    REQUIRE(early_future.get() == 1);
+    REQUIRE(sched.dequeue() == nullptr);
+}
+
+TEST_CASE("Thread pool sleeps until the scheduler's first deadline") {
+    auto release = steady::now() + 100ms;
+    tarp::threading::ThreadPool pool(2,
+                                     std::make_unique<held_back_fifo>(release));
+    pool.start();
+
+    auto [task, future] =
+      make_task_as<interfaces::task>([] { return steady::now(); });
+    pool.enqueue_task(std::move(task));
+
+    REQUIRE(future.wait_for(2s) == std::future_status::ready);
+    auto ran_at = future.get();
+    REQUIRE(ran_at >= release);
+    REQUIRE(ran_at < release + 500ms);
+}
+
+TEST_CASE("Priority scheduler") {
+    SchedulerPrio<job> root(1);
+    SchedulerFifo<job> hi(2), lo(3);
+
+    REQUIRE(lo.attach_parent(1, root));
+    REQUIRE(hi.attach_parent(1, root));
+    root.set_priority(2, 10);
+    root.attach_filter(1, match_class(1, 0), 2);
+    root.set_default_child(3);
+
+    for (int i = 0; i < 100; ++i) {
+        root.enqueue(std::make_unique<job>(i % 2, i));
+    }
+    REQUIRE(root.get_queue_length() == 100);
+    REQUIRE(hi.get_queue_length() == 50);
+
+    for (int i = 0; i < 100; ++i) {
+        auto j = root.dequeue();
+        REQUIRE(j);
+        REQUIRE(j->cls == (i < 50 ? 0 : 1));
+    }
+    REQUIRE(root.dequeue() == nullptr);
+    REQUIRE(root.empty());
+
+    // swap priorities.
+    root.set_priority(3, 20);
+    root.enqueue(std::make_unique<job>(0, 0));
+    root.enqueue(std::make_unique<job>(1, 1));
+    REQUIRE(root.dequeue()->cls == 1);
+    REQUIRE(root.dequeue()->cls == 0);
+
+    REQUIRE_THROWS_AS(root.set_priority(4, 1), std::invalid_argument);
+}
+
+TEST_CASE("DRR scheduler shares dequeues in proportion to weights") {
+    SchedulerDrr<job> root(1);
+    SchedulerFifo<job> a(2), b(3), c(4);
+
+    REQUIRE(a.attach_parent(1, root));
+    REQUIRE(b.attach_parent(1, root));
+    REQUIRE(c.attach_parent(1, root));
+    root.set_weight(2, 3);
+    root.attach_filter(1, match_class(1, 0), 2);
+    root.attach_filter(2, match_class(2, 1), 3);
+    root.set_default_child(4);
+    REQUIRE_THROWS_AS(root.set_weight(2, 0), std::invalid_argument);
+
+    // c stays empty: its share goes to the others.
+    for (int i = 0; i < 400; ++i) {
+        root.enqueue(std::make_unique<job>(0, i));
+        root.enqueue(std::make_unique<job>(1, i));
+    }
+
+    int counts[2] = {0, 0};
+    for (int i = 0; i < 400; ++i) {
+        auto j = root.dequeue();
+        REQUIRE(j);
+        counts[j->cls]++;
+    }
+    REQUIRE(counts[0] == 300);
+    REQUIRE(counts[1] == 100);
+
+    // a is backlogged for another 100 dequeues, then b gets everything.
+    for (int i = 0; i < 400; ++i) {
+        auto j = root.dequeue();
+        REQUIRE(j);
+        counts[j->cls]++;
+    }
+    REQUIRE(counts[0] == 400);
+    REQUIRE(counts[1] == 400);
+    REQUIRE(root.dequeue() == nullptr);
+
+    // each class keeps FIFO order.
+    int last = -1;
+    for (int i = 0; i < 10; ++i) {
+        root.enqueue(std::make_unique<job>(0, i));
+        root.enqueue(std::make_unique<job>(1, i));
+    }
+    while (auto j = root.dequeue()) {
+        if (j->cls == 0) {
+            REQUIRE(j->seq > last);
+            last = j->seq;
+        }
+    }
+}
+
+TEST_CASE("Scheduler hierarchies") {
+    SchedulerPrio<job> root(1);
+    SchedulerFifo<job> urgent(2);
+    SchedulerDrr<job> bulk(3);
+    SchedulerFifo<job> a(4), b(5);
+
+    // non-classful parent, wrong id.
+    REQUIRE(!a.attach_parent(2, urgent));
+    REQUIRE(!a.attach_parent(3, root));
+
+    REQUIRE(urgent.attach_parent(1, root));
+    REQUIRE(bulk.attach_parent(1, root));
+    REQUIRE(a.attach_parent(3, bulk));
+    REQUIRE(b.attach_parent(3, bulk));
+    root.set_priority(2, 1);
+
+    // already has a parent; cycles.
+    REQUIRE(!a.attach_parent(1, root));
+    REQUIRE(!root.attach_parent(3, bulk));
+
+    // unknown child.
+    REQUIRE_THROWS_AS(root.attach_filter(1, match_class(1, 0), 4),
+                      std::invalid_argument);
+
+    root.attach_filter(1, match_class(1, 0), 2);
+    root.set_default_child(3);
+    bulk.attach_filter(1, match_class(1, 1), 4);
+    bulk.set_default_child(5);
+
+    root.enqueue(std::make_unique<job>(1, 0));
+    root.enqueue(std::make_unique<job>(2, 1));
+    root.enqueue(std::make_unique<job>(0, 2));
+    REQUIRE(root.get_queue_length() == 3);
+    REQUIRE(a.get_queue_length() == 1);
+    REQUIRE(b.get_queue_length() == 1);
+
+    REQUIRE(root.dequeue()->cls == 0);
+    REQUIRE(root.dequeue()->cls == 1);
+    REQUIRE(root.dequeue()->cls == 2);
+
+    // detaching a child removes the filters pointing to it.
+    REQUIRE(urgent.detach_parent(1));
+    root.enqueue(std::make_unique<job>(0, 0));
+    REQUIRE(urgent.empty());
+    REQUIRE(b.get_queue_length() == 1);
+    root.clear();
+    REQUIRE(root.empty());
+
+    // a destroyed child detaches itself.
+    {
+        SchedulerFifo<job> tmp(6);
+        REQUIRE(tmp.attach_parent(1, root));
+        root.attach_filter(2, match_class(2, 7), 6);
+        root.enqueue(std::make_unique<job>(7, 0));
+        REQUIRE(root.get_queue_length() == 1);
+    }
+    REQUIRE(root.empty());
+    root.enqueue(std::make_unique<job>(7, 0));
+    REQUIRE(b.get_queue_length() == 1);
+
+    SchedulerDrr<job> nodefault(7);
+    REQUIRE_THROWS_AS(nodefault.enqueue(std::make_unique<job>(0, 0)),
+                      std::logic_error);
+}
+
+TEST_CASE("Thread pool with a priority scheduler") {
+    using task_t = interfaces::task;
+
+    // The children must outlive the pool, which owns the root.
+    SchedulerFifo<task_t> urgent(2), bulk(3);
+    auto root = std::make_unique<SchedulerPrio<task_t>>(1);
+    REQUIRE(urgent.attach_parent(1, *root));
+    REQUIRE(bulk.attach_parent(1, *root));
+    root->set_priority(2, 1);
+    root->set_default_child(3);
+    root->attach_filter(
+      1,
+      std::make_shared<filters::MatchIf<task_t>>(
+        1, [](const task_t &t) { return t.get_name() == "urgent"; }),
+      2);
+
+    tarp::threading::ThreadPool pool(1, std::move(root));
+
+    // Block the only worker so that the tasks below all get queued up.
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    pool.post([gate_future] { gate_future.wait(); });
+    std::this_thread::sleep_for(20ms);
+
+    std::mutex mtx;
+    std::vector<std::string> order;
+    for (int i = 0; i < 10; ++i) {
+        for (std::string name : {"bulk", "urgent"}) {
+            auto f = [&mtx, &order, name] {
+                std::unique_lock l(mtx);
+                order.push_back(name);
+            };
+            pool.enqueue_task(
+              std::make_unique<task<void, decltype(f)>>(f, name));
+        }
+    }
+
+    gate.set_value();
+    auto deadline = steady::now() + 5s;
+    while (pool.get_num_tasks_handled() < 21 && steady::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    std::unique_lock l(mtx);
+    REQUIRE(order.size() == 20);
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        REQUIRE(order[i] == (i < 10 ? "urgent" : "bulk"));
+    }
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
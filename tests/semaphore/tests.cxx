@@ -0,0 +1,144 @@
+#include <tarp/semaphore.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Counting and max count") {
+    tarp::semaphore sem(3);
+    REQUIRE_FALSE(sem.try_acquire());
+
+    for (int i = 0; i < 5; ++i) {
+        sem.release();
+    }
+
+    // capped at max_count.
+    REQUIRE(sem.try_acquire());
+    REQUIRE(sem.try_acquire());
+    REQUIRE(sem.try_acquire());
+    REQUIRE_FALSE(sem.try_acquire());
+
+    tarp::semaphore initial(10, 2);
+    initial.acquire();
+    initial.acquire();
+    REQUIRE_FALSE(initial.try_acquire());
+    initial.reset();
+    REQUIRE(initial.try_acquire());
+}
+
+TEST_CASE("Binary semaphore") {
+    tarp::binary_semaphore sem;
+    REQUIRE_FALSE(sem.try_acquire());
+    sem.release();
+    sem.release();
+    REQUIRE(sem.try_acquire());
+    REQUIRE_FALSE(sem.try_acquire());
+
+    tarp::binary_semaphore unlocked(1);
+    REQUIRE(unlocked.try_acquire());
+}
+
+TEST_CASE("Timed acquire") {
+    tarp::semaphore sem;
+
+    auto t0 = std::chrono::steady_clock::now();
+    REQUIRE_FALSE(sem.try_acquire_for(20ms));
+    REQUIRE(std::chrono::steady_clock::now() - t0 >= 20ms);
+
+    // a deadline in the past still takes an available count.
+    sem.release();
+    REQUIRE(sem.try_acquire_until(t0));
+
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(10ms);
+        sem.release();
+    });
+    REQUIRE(sem.try_acquire_for(10s));
+    releaser.join();
+
+    REQUIRE_FALSE(
+      sem.try_acquire_until(std::chrono::system_clock::now() + 5ms));
+}
+
+TEST_CASE("Blocked acquirers are woken by release") {
+    tarp::semaphore sem;
+    std::atomic<unsigned> acquired {0};
+
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 4; ++i) {
+        waiters.emplace_back([&] {
+            sem.acquire();
+            acquired++;
+        });
+    }
+
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(acquired == 0);
+
+    for (int i = 0; i < 4; ++i) {
+        sem.release();
+    }
+
+    for (auto &t : waiters) {
+        t.join();
+    }
+    REQUIRE(acquired == 4);
+    REQUIRE_FALSE(sem.try_acquire());
+}
+
+// Producer/consumer handoff through a pair of semaphores: no item is lost
+// or duplicated.
+TEST_CASE("Producer/consumer handoff") {
+    constexpr std::uint64_t NUM_ITEMS = 200000;
+    constexpr std::size_t NUM_SLOTS = 8;
+
+    tarp::semaphore free_slots(NUM_SLOTS, NUM_SLOTS);
+    tarp::semaphore used_slots(NUM_SLOTS, 0);
+    std::vector<std::uint64_t> ring(NUM_SLOTS);
+
+    std::uint64_t sum = 0;
+    std::thread consumer([&] {
+        for (std::uint64_t i = 0; i < NUM_ITEMS; ++i) {
+            used_slots.acquire();
+            sum += ring[i % NUM_SLOTS];
+            free_slots.release();
+        }
+    });
+
+    for (std::uint64_t i = 0; i < NUM_ITEMS; ++i) {
+        free_slots.acquire();
+        ring[i % NUM_SLOTS] = i;
+        used_slots.release();
+    }
+
+    consumer.join();
+    REQUIRE(sum == NUM_ITEMS * (NUM_ITEMS - 1) / 2);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
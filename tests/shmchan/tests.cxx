@@ -0,0 +1,198 @@
+#include <tarp/shmchan.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+extern "C" {
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+using namespace std::chrono_literals;
+using tarp::evchan::shm_channel;
+
+struct sample {
+    std::uint32_t seq;
+    double value;
+};
+
+TEST_CASE("Buffered shm_channel") {
+    auto chan = shm_channel<int>::create(3);
+    REQUIRE(chan->capacity() == 3);
+    REQUIRE(chan->empty());
+
+    REQUIRE(chan->try_push(1).first);
+    REQUIRE(chan->try_push(2).first);
+    REQUIRE(chan->try_push(3).first);
+
+    auto [ok, rejected] = chan->try_push(4);
+    REQUIRE_FALSE(ok);
+    REQUIRE(rejected.has_value());
+    REQUIRE(*rejected == 4);
+    REQUIRE(chan->size() == 3);
+
+    REQUIRE(chan->try_get() == 1);
+    REQUIRE(chan->try_push(4).first);
+
+    auto all = chan->get_all();
+    REQUIRE(all.size() == 3);
+    REQUIRE(all[0] == 2);
+    REQUIRE(all[1] == 3);
+    REQUIRE(all[2] == 4);
+    REQUIRE(chan->empty());
+    REQUIRE_FALSE(chan->try_get().has_value());
+}
+
+TEST_CASE("Circular shm_channel") {
+    auto chan = shm_channel<int>::create(2, true);
+
+    REQUIRE(chan->try_push(1).first);
+    REQUIRE(chan->try_push(2).first);
+
+    auto [ok, evicted] = chan->try_push(3);
+    REQUIRE(ok);
+    REQUIRE(evicted.has_value());
+    REQUIRE(*evicted == 1);
+
+    REQUIRE(chan->try_get() == 2);
+    REQUIRE(chan->try_get() == 3);
+}
+
+TEST_CASE("Closing an shm_channel unblocks readers and writers") {
+    auto chan = shm_channel<int>::create(1);
+
+    REQUIRE_FALSE(chan->try_get_for(10ms).has_value());
+    REQUIRE(chan->try_push_for(1, 10ms));
+    REQUIRE_FALSE(chan->try_push_for(2, 10ms));
+
+    std::thread writer([&chan] { REQUIRE_FALSE(chan->push(2)); });
+    std::this_thread::sleep_for(20ms);
+    chan->close();
+    writer.join();
+
+    // buffered data can still be drained after close.
+    REQUIRE(chan->get() == 1);
+    REQUIRE_FALSE(chan->get().has_value());
+    REQUIRE_FALSE(chan->try_push(3).first);
+}
+
+TEST_CASE("Attaching with the wrong payload type fails") {
+    auto chan = shm_channel<std::uint8_t>::create(4);
+    REQUIRE_THROWS_AS(shm_channel<sample>::attach(dup(chan->fd())),
+                      std::runtime_error);
+}
+
+TEST_CASE("Attaching to a segment with a corrupt header fails") {
+    using tarp::evchan::impl::shm_header;
+
+    auto chan = shm_channel<std::uint32_t>::create(4);
+    void *base = mmap(nullptr,
+                      sizeof(shm_header),
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      chan->fd(),
+                      0);
+    REQUIRE(base != MAP_FAILED);
+    auto *hdr = static_cast<shm_header *>(base);
+
+    auto check_attach_fails = [&] {
+        REQUIRE_THROWS_AS(shm_channel<std::uint32_t>::attach(dup(chan->fd())),
+                          std::runtime_error);
+    };
+
+    // elem_size * capacity wraps around to 0.
+    hdr->capacity = std::uint64_t {1} << 62;
+    check_attach_fails();
+    hdr->capacity = 5;
+    check_attach_fails();
+    hdr->capacity = 4;
+
+    hdr->head = 4;
+    check_attach_fails();
+    hdr->head = 0;
+
+    hdr->count = 5;
+    check_attach_fails();
+    hdr->count = 4;
+
+    // intact again.
+    REQUIRE(shm_channel<std::uint32_t>::attach(dup(chan->fd()))->size() == 4);
+    munmap(base, sizeof(shm_header));
+}
+
+TEST_CASE("Cross-process shm_channel with fd passing") {
+    static constexpr std::uint32_t NUM_MSGS = 10000;
+
+    int sv[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+    pid_t pid = fork();
+    REQUIRE(pid >= 0);
+
+    if (pid == 0) {
+        close(sv[0]);
+        int rc = 0;
+        try {
+            auto chan = shm_channel<sample>::receive(sv[1]);
+            for (std::uint32_t i = 0; i < NUM_MSGS; ++i) {
+                if (!chan->push(sample {i, i * 0.5})) {
+                    rc = 1;
+                    break;
+                }
+            }
+            chan->close();
+        } catch (...) {
+            rc = 2;
+        }
+        _exit(rc);
+    }
+
+    close(sv[1]);
+
+    // small capacity so the producer has to block frequently.
+    auto chan = shm_channel<sample>::create(16);
+    chan->send(sv[0]);
+
+    std::uint32_t expected = 0;
+    while (auto s = chan->get()) {
+        REQUIRE(s->seq == expected);
+        REQUIRE(s->value == doctest::Approx(expected * 0.5));
+        ++expected;
+    }
+
+    REQUIRE(expected == NUM_MSGS);
+    REQUIRE(chan->closed());
+
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+    close(sv[0]);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
@@ -4,15 +4,45 @@
 #include <stdexcept>
 #include <tarp/cohort.h>
 #include <tarp/common.h>
+#include <tarp/executor.hxx>
 #include <tarp/log.h>
+#include <tarp/lite_signal.hxx>
 #include <tarp/signal.hxx>
 #include <tarp/type_traits.hxx>
 
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace tarp;
 
+// Count heap allocations, to check the lite_signal never allocates.
+// NOTE: noinline, otherwise gcc flags the (matching) malloc/free pairs.
+static std::atomic<std::size_t> g_num_allocs {0};
+
+__attribute__((noinline)) void *operator new(std::size_t n) {
+    g_num_allocs++;
+    if (void *p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p,
+                                                std::size_t) noexcept {
+    std::free(p);
+}
+
 template<typename ts_policy, typename callback_signature>
 using S =
   std::conditional_t<std::is_same_v<ts_policy, tarp::type_traits::thread_safe>,
@@ -218,6 +248,492 @@ enum testStatus test_disconnection() {
 
 }  // namespace monosignal
 
+template<typename ts_policy,
+         typename callback_signature,
+         typename signal_output =
+           tarp::type_traits::signature_decomp_return_t<callback_signature>,
+         template<typename output, typename input> typename reducer =
+           tarp::reduce::last>
+using M = std::conditional_t<
+  std::is_same_v<ts_policy, tarp::type_traits::thread_safe>,
+  tarp::ts::signal<callback_signature, signal_output, reducer>,
+  tarp::tu::signal<callback_signature, signal_output, reducer>>;
+
+namespace multisignal {
+
+template<typename ts_policy>
+enum testStatus test_garbage_collection() {
+    M<ts_policy, int(int), int, tarp::reduce::sum> sig;
+
+    sig.connect_detached([](int x) { return x; });
+    auto conn1 = sig.connect([](int x) { return 10 * x; });
+    auto conn2 = sig.connect([](int x) { return 100 * x; });
+
+    if (sig.count() != 3 || sig.emit(1) != 111) {
+        return TEST_FAIL;
+    }
+
+    // disconnected observers are no longer invoked, and are weeded out
+    // lazily, on the next emission.
+    conn1->disconnect();
+    if (sig.emit(1) != 101 || sig.count() != 2) {
+        return TEST_FAIL;
+    }
+
+    conn2->disconnect();
+    if (sig.emit(2) != 2 || sig.count() != 1) {
+        return TEST_FAIL;
+    }
+
+    return testStatus::TEST_PASS;
+}
+
+template<typename ts_policy>
+enum testStatus test_connect_from_handler() {
+    M<ts_policy, void()> sig;
+
+    unsigned outer = 0;
+    unsigned inner = 0;
+    sig.connect_detached([&]() {
+        if (outer++ == 0) {
+            sig.connect_detached([&]() { ++inner; });
+        }
+    });
+
+    // the new handler only takes effect on the next emission.
+    sig.emit();
+    if (outer != 1 || inner != 0 || sig.count() != 2) {
+        return TEST_FAIL;
+    }
+
+    sig.emit();
+    if (outer != 2 || inner != 1) {
+        return TEST_FAIL;
+    }
+
+    // emission from inside a handler.
+    M<ts_policy, void(int)> rec;
+    unsigned depth = 0;
+    rec.connect_detached([&](int n) {
+        ++depth;
+        if (n > 0) {
+            rec.emit(n - 1);
+        }
+    });
+    rec.emit(5);
+    if (depth != 6) {
+        return TEST_FAIL;
+    }
+
+    return testStatus::TEST_PASS;
+}
+
+// Emitters, connections and disconnections all racing each other.
+enum testStatus test_concurrent_emission() {
+    tarp::ts::signal<void(int)> sig;
+
+    std::atomic<unsigned> num_calls {0};
+    sig.connect_detached([&](int) { num_calls++; });
+
+    std::atomic<bool> stop {false};
+    std::atomic<bool> violation {false};
+
+    std::vector<std::thread> emitters;
+    for (int i = 0; i < 4; ++i) {
+        emitters.emplace_back([&] {
+            while (!stop) {
+                sig.emit(1);
+            }
+        });
+    }
+
+    // once disconnect() returns, the handler must never be invoked again.
+    for (int i = 0; i < 2000; ++i) {
+        auto disconnected = std::make_shared<std::atomic<bool>>(false);
+        auto conn = sig.connect([&violation, disconnected](int) {
+            if (*disconnected) {
+                violation = true;
+            }
+        });
+        std::this_thread::yield();
+        conn->disconnect();
+        *disconnected = true;
+    }
+
+    stop = true;
+    for (auto &t : emitters) {
+        t.join();
+    }
+
+    if (violation || num_calls == 0) {
+        return TEST_FAIL;
+    }
+
+    sig.emit(1);
+    if (sig.count() != 1) {
+        return TEST_FAIL;
+    }
+
+    return testStatus::TEST_PASS;
+}
+
+// A handler re-emitting its signal while a disconnect() of that same
+// handler is pending on another thread must not deadlock.
+enum testStatus test_recursive_emission_with_pending_disconnect() {
+    tarp::ts::signal<void(int)> sig;
+
+    std::atomic<bool> started {false};
+    std::atomic<bool> disconnecting {false};
+    std::atomic<unsigned> num_calls {0};
+
+    auto conn = sig.connect([&](int n) {
+        num_calls++;
+        if (n == 0) {
+            return;
+        }
+
+        started = true;
+        while (!disconnecting) {
+            std::this_thread::yield();
+        }
+
+        // let disconnect() get to waiting for the token lock.
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        sig.emit(0);
+    });
+
+    std::thread disconnector([&] {
+        while (!started) {
+            std::this_thread::yield();
+        }
+        disconnecting = true;
+        conn->disconnect();
+    });
+
+    sig.emit(1);
+    disconnector.join();
+
+    // the inner emission ran before disconnect() returned.
+    if (num_calls != 2) {
+        return TEST_FAIL;
+    }
+
+    sig.emit(1);
+    if (num_calls != 2) {
+        return TEST_FAIL;
+    }
+
+    return testStatus::TEST_PASS;
+}
+
+template<typename ts_policy>
+enum testStatus test_queued_connection() {
+    M<ts_policy, void(const std::string &, int)> sig;
+    tarp::exec::queue_executor target;
+
+    std::vector<std::string> received;
+    auto conn = sig.connect_queued(target,
+                                   [&](const std::string &s, int n) {
+                                       received.push_back(s + std::to_string(n));
+                                   });
+
+    // the arguments are copied: the originals may change or go away.
+    std::string s = "a";
+    sig.emit(s, 1);
+    s = "b";
+    sig.emit(s, 2);
+    if (!received.empty() || target.size() != 2) {
+        return TEST_FAIL;
+    }
+
+    target.run_pending();
+    if (received != std::vector<std::string> {"a1", "b2"}) {
+        return TEST_FAIL;
+    }
+
+    // deliveries still queued on disconnection are dropped.
+    sig.emit("c", 3);
+    conn->disconnect();
+    target.run_pending();
+    if (received.size() != 2) {
+        return TEST_FAIL;
+    }
+
+    return testStatus::TEST_PASS;
+}
+
+// Emissions from several signals to the same target cost it one wakeup.
+enum testStatus test_batched_delivery() {
+    tarp::ts::signal<void(int)> sig1;
+    tarp::ts::signal<void(int)> sig2;
+    tarp::exec::queue_executor target;
+    tarp::exec::batching_executor batch(target);
+
+    std::vector<int> received;
+    auto conn1 = sig1.connect_queued(batch, [&](int n) {
+        received.push_back(n);
+    });
+    auto conn2 = sig2.connect_queued(batch, [&](int n) {
+        received.push_back(-n);
+    });
+
+    for (int i = 1; i <= 3; ++i) {
+        sig1.emit(i);
+        sig2.emit(i);
+    }
+
+    if (target.size() != 1 || batch.size() != 6 || batch.num_batches() != 1) {
+        return TEST_FAIL;
+    }
+
+    if (target.run_pending() != 1 ||
+        received != std::vector<int> {1, -1, 2, -2, 3, -3}) {
+        return TEST_FAIL;
+    }
+
+    // the next emission starts a new batch.
+    sig1.emit(4);
+    if (target.size() != 1 || batch.num_batches() != 2) {
+        return TEST_FAIL;
+    }
+    target.run_pending();
+    if (received.back() != 4) {
+        return TEST_FAIL;
+    }
+
+    conn1->disconnect();
+    conn2->disconnect();
+    return testStatus::TEST_PASS;
+}
+
+// An observer that throws loses only its own delivery, not the rest of the
+// batch it was part of.
+enum testStatus test_batched_delivery_with_throwing_observer() {
+    tarp::ts::signal<void(int)> sig;
+    tarp::exec::queue_executor target;
+    tarp::exec::batching_executor batch(target);
+
+    std::vector<int> received;
+    auto conn = sig.connect_queued(batch, [&](int n) {
+        if (n == 2) {
+            throw std::runtime_error("observer");
+        }
+        received.push_back(n);
+    });
+
+    for (int i = 1; i <= 4; ++i) {
+        sig.emit(i);
+    }
+
+    bool thrown = false;
+    try {
+        target.run_pending();
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+
+    // the exception reaches the target; the deliveries behind the one that
+    // threw are put in a new batch.
+    if (!thrown || received != std::vector<int> {1} || batch.size() != 2 ||
+        target.size() != 1) {
+        return TEST_FAIL;
+    }
+
+    target.run_pending();
+    if (received != std::vector<int> {1, 3, 4} || batch.num_batches() != 2) {
+        return TEST_FAIL;
+    }
+
+    conn->disconnect();
+    return testStatus::TEST_PASS;
+}
+
+// The emitter does not wait for a slow observer running on another thread.
+enum testStatus test_queued_cross_thread() {
+    tarp::ts::signal<void(int)> sig;
+    tarp::exec::queue_executor target;
+
+    std::atomic<int> sum {0};
+    auto conn = sig.connect_queued(target, [&](int n) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        sum += n;
+    });
+
+    std::atomic<bool> stop {false};
+    std::thread consumer([&] {
+        while (!stop) {
+            target.run_one_for(std::chrono::milliseconds(1));
+        }
+        target.run_pending();
+    });
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; ++i) {
+        sig.emit(1);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - t0;
+
+    // 100 deliveries take at least 100ms.
+    if (elapsed >= std::chrono::milliseconds(50)) {
+        stop = true;
+        consumer.join();
+        conn->disconnect();
+        return TEST_FAIL;
+    }
+
+    while (sum < 10) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // no delivery runs after disconnect() returns.
+    conn->disconnect();
+    int seen = sum;
+    stop = true;
+    consumer.join();
+
+    if (sum != seen || sum == 100) {
+        return TEST_FAIL;
+    }
+
+    return testStatus::TEST_PASS;
+}
+
+}  // namespace multisignal
+
+template<typename ts_policy,
+         typename callback_signature,
+         std::size_t max_observers = 0,
+         template<typename output, typename input> typename reducer =
+           tarp::reduce::last>
+using L = std::conditional_t<
+  std::is_same_v<ts_policy, tarp::type_traits::thread_safe>,
+  tarp::ts::lite_signal<callback_signature, max_observers, reducer>,
+  tarp::tu::lite_signal<callback_signature, max_observers, reducer>>;
+
+namespace litesignal {
+
+template<typename ts_policy>
+enum testStatus test_lite_signal() {
+    L<ts_policy, int(int), 3, tarp::reduce::sum> sig;
+    tarp::lite_slot<int(int)> s1, s2, s3, s4;
+
+    int base = 1000;
+    auto before = g_num_allocs.load();
+
+    if (sig.emit(1) != 0) {
+        return TEST_FAIL;
+    }
+
+    sig.connect(s1, [](int x) { return x; });
+    sig.connect(s2, [](int x) { return 10 * x; });
+    sig.connect(s3, [&base](int x) { return base * x; });
+
+    // full.
+    if (sig.connect(s4, [](int x) { return x; }) || s4.connected()) {
+        return TEST_FAIL;
+    }
+
+    if (sig.count() != 3 || sig.emit(1) != 1011) {
+        return TEST_FAIL;
+    }
+
+    s2.disconnect();
+    s2.disconnect();
+    if (s2.connected() || sig.count() != 2 || sig.emit(2) != 2002) {
+        return TEST_FAIL;
+    }
+
+    // room again; also, rebinding a connected slot.
+    if (!sig.connect(s4, [](int x) { return 100 * x; })) {
+        return TEST_FAIL;
+    }
+    sig.connect(s1, [](int x) { return -x; });
+    if (sig.count() != 3 || sig.emit(1) != 1099) {
+        return TEST_FAIL;
+    }
+
+    // destroying a slot disconnects it.
+    {
+        tarp::lite_slot<int(int)> tmp;
+        s4.disconnect();
+        sig.connect(tmp, [](int x) { return x; });
+        if (sig.emit(1) != 1000) {
+            return TEST_FAIL;
+        }
+    }
+    if (sig.count() != 2) {
+        return TEST_FAIL;
+    }
+
+    if (g_num_allocs != before) {
+        return TEST_FAIL;
+    }
+
+    // destroying the signal disconnects the remaining slots.
+    tarp::lite_slot<void(const std::string &)> survivor;
+    {
+        L<ts_policy, void(const std::string &)> sig2;
+        std::string last;
+        sig2.connect(survivor, [&last](const std::string &s) { last = s; });
+        sig2.emit("hello");
+        if (last != "hello" || !survivor.connected()) {
+            return TEST_FAIL;
+        }
+    }
+    if (survivor.connected()) {
+        return TEST_FAIL;
+    }
+
+    return testStatus::TEST_PASS;
+}
+
+// Slots are connected and disconnected while emissions run in parallel.
+enum testStatus test_lite_signal_concurrency() {
+    tarp::ts::lite_signal<void(int)> sig;
+
+    std::atomic<bool> stop {false};
+    std::atomic<bool> violation {false};
+    std::atomic<unsigned> num_calls {0};
+
+    std::vector<std::thread> emitters;
+    for (int i = 0; i < 2; ++i) {
+        emitters.emplace_back([&] {
+            while (!stop) {
+                sig.emit(1);
+            }
+        });
+    }
+
+    auto before = g_num_allocs.load();
+    for (int i = 0; i < 2000; ++i) {
+        bool disconnected = false;
+        tarp::lite_slot<void(int)> slot;
+        sig.connect(slot, [&](int) {
+            if (disconnected) {
+                violation = true;
+            }
+            num_calls++;
+        });
+        std::this_thread::yield();
+        slot.disconnect();
+        disconnected = true;
+    }
+    auto after = g_num_allocs.load();
+
+    stop = true;
+    for (auto &t : emitters) {
+        t.join();
+    }
+
+    if (violation || after != before || sig.count() != 0) {
+        return TEST_FAIL;
+    }
+
+    return testStatus::TEST_PASS;
+}
+
+}  // namespace litesignal
+
 int main(int argc, char **argv) {
     UNUSED(argc);
     UNUSED(argv);
@@ -260,6 +776,66 @@ int main(int argc, char **argv) {
     passed = run(monosignal::test_move_only_arg<TU>, TEST_PASS);
     update_test_counter(passed, test_move_only_arg);
 
+    printf("TEST: [ts] signal garbage collection.\n");
+    passed = run(multisignal::test_garbage_collection<TS>, TEST_PASS);
+    update_test_counter(passed, test_garbage_collection);
+
+    printf("TEST: [tu] signal garbage collection.\n");
+    passed = run(multisignal::test_garbage_collection<TU>, TEST_PASS);
+    update_test_counter(passed, test_garbage_collection);
+
+    printf("TEST: [ts] connection and emission from signal handler.\n");
+    passed = run(multisignal::test_connect_from_handler<TS>, TEST_PASS);
+    update_test_counter(passed, test_connect_from_handler);
+
+    printf("TEST: [tu] connection and emission from signal handler.\n");
+    passed = run(multisignal::test_connect_from_handler<TU>, TEST_PASS);
+    update_test_counter(passed, test_connect_from_handler);
+
+    printf("TEST: [ts] concurrent emission and (dis)connection.\n");
+    passed = run(multisignal::test_concurrent_emission, TEST_PASS);
+    update_test_counter(passed, test_concurrent_emission);
+
+    printf("TEST: [ts] recursive emission with a pending disconnection.\n");
+    passed =
+      run(multisignal::test_recursive_emission_with_pending_disconnect,
+          TEST_PASS);
+    update_test_counter(passed,
+                        test_recursive_emission_with_pending_disconnect);
+
+    printf("TEST: [ts] queued connection.\n");
+    passed = run(multisignal::test_queued_connection<TS>, TEST_PASS);
+    update_test_counter(passed, test_queued_connection);
+
+    printf("TEST: [tu] queued connection.\n");
+    passed = run(multisignal::test_queued_connection<TU>, TEST_PASS);
+    update_test_counter(passed, test_queued_connection);
+
+    printf("TEST: [ts] batched delivery of queued emissions.\n");
+    passed = run(multisignal::test_batched_delivery, TEST_PASS);
+    update_test_counter(passed, test_batched_delivery);
+
+    printf("TEST: [ts] batched delivery with a throwing observer.\n");
+    passed = run(multisignal::test_batched_delivery_with_throwing_observer,
+                 TEST_PASS);
+    update_test_counter(passed, test_batched_delivery_with_throwing_observer);
+
+    printf("TEST: [ts] queued connection across threads.\n");
+    passed = run(multisignal::test_queued_cross_thread, TEST_PASS);
+    update_test_counter(passed, test_queued_cross_thread);
+
+    printf("TEST: [ts] lite signal.\n");
+    passed = run(litesignal::test_lite_signal<TS>, TEST_PASS);
+    update_test_counter(passed, test_lite_signal);
+
+    printf("TEST: [tu] lite signal.\n");
+    passed = run(litesignal::test_lite_signal<TU>, TEST_PASS);
+    update_test_counter(passed, test_lite_signal);
+
+    printf("TEST: [ts] lite signal concurrent (dis)connection.\n");
+    passed = run(litesignal::test_lite_signal_concurrency, TEST_PASS);
+    update_test_counter(passed, test_lite_signal_concurrency);
+
     report_test_summary();
 #endif
 }
@@ -0,0 +1,196 @@
+#include <tarp/histogram.hxx>
+#include <tarp/pipeline.hxx>
+#include <tarp/sketches.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace tarp;
+
+namespace {
+
+// Exponentially distributed values, i.e. skewed like latencies are.
+std::vector<double> make_values(std::size_t n, unsigned seed) {
+    std::mt19937_64 rng(seed);
+    std::exponential_distribution<double> dist(1.0 / 1000);
+    std::vector<double> v(n);
+    for (auto &x : v) {
+        x = dist(rng);
+    }
+    return v;
+}
+
+double exact_quantile(const std::vector<double> &sorted, double q) {
+    auto n = static_cast<double>(sorted.size() - 1);
+    return sorted[static_cast<std::size_t>(q * n)];
+}
+
+// The fraction of values <= x.
+double exact_rank(const std::vector<double> &sorted, double x) {
+    auto it = std::upper_bound(sorted.begin(), sorted.end(), x);
+    return static_cast<double>(it - sorted.begin()) /
+           static_cast<double>(sorted.size());
+}
+
+}  // namespace
+
+TEST_CASE("Welford matches the two-pass computation") {
+    auto values = make_values(10000, 1);
+
+    double sum = 0;
+    for (auto x : values) sum += x;
+    const double mean = sum / static_cast<double>(values.size());
+
+    double ss = 0;
+    for (auto x : values) ss += (x - mean) * (x - mean);
+    const double var = ss / static_cast<double>(values.size());
+
+    welford<> w;
+    REQUIRE(w.count() == 0);
+    REQUIRE(w.variance() == 0);
+    for (auto x : values) w.add(x);
+
+    REQUIRE(w.count() == values.size());
+    REQUIRE(std::fabs(w.mean() - mean) < 1e-9 * mean);
+    REQUIRE(std::fabs(w.variance() - var) < 1e-9 * var);
+    REQUIRE(w.min() == *std::min_element(values.begin(), values.end()));
+    REQUIRE(w.max() == *std::max_element(values.begin(), values.end()));
+
+    // merging partial accumulators gives the same result.
+    welford<> a, b, empty;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        (i < 3000 ? a : b).add(values[i]);
+    }
+    a.merge(b);
+    a.merge(empty);
+    REQUIRE(a.count() == w.count());
+    REQUIRE(std::fabs(a.mean() - w.mean()) < 1e-9 * mean);
+    REQUIRE(std::fabs(a.variance() - w.variance()) < 1e-9 * var);
+    REQUIRE(a.min() == w.min());
+    REQUIRE(a.max() == w.max());
+}
+
+TEST_CASE("t-digest quantile estimates") {
+    tdigest empty;
+    REQUIRE(empty.quantile(0.5) == 0);
+    REQUIRE(empty.count() == 0);
+    REQUIRE_THROWS_AS(empty.quantile(1.5), std::invalid_argument);
+    REQUIRE_THROWS_AS(tdigest(1), std::invalid_argument);
+
+    tdigest single;
+    single.add(42);
+    REQUIRE(single.quantile(0) == 42);
+    REQUIRE(single.quantile(0.99) == 42);
+
+    auto values = make_values(200000, 2);
+    tdigest d;
+    for (auto x : values) d.add(x);
+
+    REQUIRE(d.count() == values.size());
+    REQUIRE(d.size() <= 100);
+    REQUIRE(d.quantile(0) == *std::min_element(values.begin(), values.end()));
+    REQUIRE(d.quantile(1) == *std::max_element(values.begin(), values.end()));
+
+    std::sort(values.begin(), values.end());
+    for (double q : {0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 0.999}) {
+        double exact = exact_quantile(values, q);
+        double est = d.quantile(q);
+        INFO("q=", q, " exact=", exact, " est=", est);
+        REQUIRE(std::fabs(exact_rank(values, est) - q) < 0.001);
+        REQUIRE(std::fabs(d.cdf(exact) - q) < 0.001);
+    }
+
+    // in the bulk of the distribution, the values themselves are close too.
+    for (double q : {0.1, 0.5, 0.9}) {
+        double exact = exact_quantile(values, q);
+        REQUIRE(std::fabs(d.quantile(q) - exact) / exact < 0.01);
+    }
+}
+
+TEST_CASE("Per-thread t-digests merge into one") {
+    constexpr std::size_t NUM_THREADS = 4;
+    auto values = make_values(400000, 3);
+
+    std::vector<tdigest> digests(NUM_THREADS);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < NUM_THREADS; ++t) {
+        threads.emplace_back([&, t] {
+            for (std::size_t i = t; i < values.size(); i += NUM_THREADS) {
+                digests[t].add(values[i]);
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+
+    tdigest merged;
+    for (const auto &d : digests) merged.merge(d);
+    REQUIRE_THROWS_AS(merged.merge(merged), std::invalid_argument);
+
+    REQUIRE(merged.count() == values.size());
+    std::sort(values.begin(), values.end());
+    for (double q : {0.5, 0.9, 0.99, 0.999}) {
+        double est = merged.quantile(q);
+        REQUIRE(std::fabs(exact_rank(values, est) - q) < 0.001);
+    }
+}
+
+TEST_CASE("Accumulator stages pass their inputs through") {
+    auto values = make_values(10000, 4);
+
+    welford_stage<double> ws;
+    tdigest_stage<double> ts(200);
+    histogram_stage<double> hs;
+    std::vector<double> out;
+
+    auto p = make_pipeline(ws, ts, hs, [&](double v) { out.push_back(v); });
+    p.process_batch(values.data(), values.size() / 2);
+    for (std::size_t i = values.size() / 2; i < values.size(); ++i) {
+        p.process(values[i]);
+    }
+
+    REQUIRE(out == values);
+    REQUIRE(ws.accumulator().count() == values.size());
+    REQUIRE(ts.accumulator().count() == values.size());
+    REQUIRE(ts.accumulator().compression() == 200);
+    REQUIRE(hs.accumulator().count() == values.size());
+
+    std::sort(values.begin(), values.end());
+    double exact = exact_quantile(values, 0.99);
+    auto hist_p99 = static_cast<double>(hs.accumulator().percentile(99));
+    REQUIRE(std::fabs(hist_p99 - exact) / exact < 0.07);
+    double est = ts.accumulator().quantile(0.99);
+    REQUIRE(std::fabs(exact_rank(values, est) - 0.99) < 0.001);
+
+    // negative values are recorded as 0 by the histogram.
+    hs.process(-5);
+    REQUIRE(hs.accumulator().min() == 0);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
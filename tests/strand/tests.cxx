@@ -0,0 +1,388 @@
+#include <tarp/executor.hxx>
+#include <tarp/strand.hxx>
+#include <tarp/threading.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace tarp::exec;
+using namespace tarp::threading;
+
+namespace {
+
+// Port of a typical ActiveObject: all state is only touched from tasks.
+class Account final : public LiteActiveObject {
+public:
+    explicit Account(interfaces::executor &ex) : LiteActiveObject(ex) {}
+
+    ~Account() override { stop(); }
+
+    std::future<long> deposit(long amount) {
+        return schedule_task([this, amount] {
+            if (m_busy.exchange(true)) {
+                m_overlapped = true;
+            }
+            m_balance += amount;
+            m_busy = false;
+            return m_balance;
+        });
+    }
+
+    void deposit_async(long amount) {
+        post([this, amount] { m_balance += amount; });
+    }
+
+    std::future<long> get_balance() {
+        return schedule_task([this] { return m_balance; });
+    }
+
+    std::future<bool> check_context() {
+        return schedule_task([this] { return in_task_context(); });
+    }
+
+    bool outside_context() const { return in_task_context(); }
+    bool overlapped() const { return m_overlapped; }
+
+private:
+    long m_balance {0};
+    std::atomic<bool> m_busy {false};
+    std::atomic<bool> m_overlapped {false};
+};
+
+}  // namespace
+
+TEST_CASE("Strand jobs run in order and one at a time") {
+    ThreadPool pool(4);
+    pool.start();
+    threadpool_executor ex(pool);
+
+    constexpr std::size_t NUM_STRANDS = 200;
+    constexpr std::size_t NUM_JOBS = 200;
+
+    struct record {
+        std::vector<std::size_t> order;
+        std::atomic<bool> busy {false};
+        std::atomic<bool> overlapped {false};
+    };
+
+    std::vector<std::unique_ptr<strand>> strands;
+    std::vector<record> records(NUM_STRANDS);
+    for (std::size_t i = 0; i < NUM_STRANDS; ++i) {
+        strands.push_back(std::make_unique<strand>(ex));
+    }
+
+    std::promise<void> done;
+    std::atomic<std::size_t> remaining {NUM_STRANDS * NUM_JOBS};
+
+    // post from several threads at once; per-strand FIFO order only holds
+    // for jobs posted from the same thread, so each strand gets all its
+    // jobs from one poster.
+    std::vector<std::thread> posters;
+    for (std::size_t t = 0; t < 4; ++t) {
+        posters.emplace_back([&, t] {
+            for (std::size_t j = 0; j < NUM_JOBS; ++j) {
+                for (std::size_t i = t; i < NUM_STRANDS; i += 4) {
+                    auto &r = records[i];
+                    strands[i]->post([&r, &remaining, &done, j] {
+                        if (r.busy.exchange(true)) {
+                            r.overlapped = true;
+                        }
+                        r.order.push_back(j);
+                        r.busy = false;
+                        if (--remaining == 0) {
+                            done.set_value();
+                        }
+                    });
+                }
+            }
+        });
+    }
+
+    for (auto &t : posters) {
+        t.join();
+    }
+
+    REQUIRE(done.get_future().wait_for(30s) == std::future_status::ready);
+    for (auto &r : records) {
+        REQUIRE(!r.overlapped);
+        REQUIRE(r.order.size() == NUM_JOBS);
+        for (std::size_t j = 0; j < NUM_JOBS; ++j) {
+            REQUIRE(r.order[j] == j);
+        }
+    }
+}
+
+TEST_CASE("Strand batches and close") {
+    queue_executor ex;
+
+    strand s(ex);
+    REQUIRE(!s.running_in_this_thread());
+
+    std::size_t n = 0;
+    bool in_strand = false;
+    for (int i = 0; i < 40; ++i) {
+        s.post([&] {
+            ++n;
+            in_strand = s.running_in_this_thread();
+        });
+    }
+
+    // a single drain job is posted, however many jobs there are.
+    REQUIRE(ex.size() == 1);
+    REQUIRE(s.size() == 40);
+
+    // it yields after a batch and reposts itself.
+    REQUIRE(ex.run_pending() == 1);
+    REQUIRE(in_strand);
+    REQUIRE(n > 0);
+    REQUIRE(n < 40);
+    REQUIRE(ex.size() == 1);
+
+    ex.run_pending();
+    REQUIRE(n == 40);
+    REQUIRE(ex.size() == 0);
+    REQUIRE(s.size() == 0);
+
+    // closing discards pending and future jobs.
+    s.post([&] { ++n; });
+    s.close();
+    REQUIRE(s.size() == 0);
+    s.post([&] { ++n; });
+    ex.run_pending();
+    REQUIRE(n == 40);
+    REQUIRE(ex.size() == 0);
+}
+
+TEST_CASE("Close waits for the running job") {
+    ThreadPool pool(2);
+    pool.start();
+    threadpool_executor ex(pool);
+
+    auto s = std::make_unique<strand>(ex);
+
+    std::promise<void> started;
+    std::atomic<bool> finished {false};
+    s->post([&] {
+        started.set_value();
+        std::this_thread::sleep_for(50ms);
+        finished = true;
+    });
+
+    started.get_future().wait();
+    s.reset();
+    REQUIRE(finished);
+}
+
+namespace {
+
+// Holds all tasks back until released, like a deadline scheduler before
+// the first deadline.
+class holding_scheduler final
+    : public tarp::sched::Scheduler<tarp::sched::interfaces::task> {
+public:
+    holding_scheduler() : Scheduler(0) {}
+
+    std::size_t get_queue_length() const override { return m_q.size(); }
+
+    void clear() override { m_q.clear(); }
+
+    std::optional<std::chrono::steady_clock::time_point>
+    get_first_deadline() const override {
+        if (m_q.empty() || released) {
+            return std::nullopt;
+        }
+        return std::chrono::steady_clock::now() + 1h;
+    }
+
+    std::atomic<bool> released {false};
+    std::atomic<unsigned> num_dequeues {0};
+
+private:
+    void do_enqueue(
+      std::unique_ptr<tarp::sched::interfaces::task> task) override {
+        m_q.push_back(std::move(task));
+    }
+
+    std::unique_ptr<tarp::sched::interfaces::task> do_dequeue() override {
+        num_dequeues++;
+        if (m_q.empty() || !released) {
+            return nullptr;
+        }
+        auto task = std::move(m_q.front());
+        m_q.pop_front();
+        return task;
+    }
+
+    std::deque<std::unique_ptr<tarp::sched::interfaces::task>> m_q;
+};
+
+}  // namespace
+
+TEST_CASE("Tasks held back by the scheduler do not spin the strand") {
+    queue_executor ex;
+    auto sched = std::make_unique<holding_scheduler>();
+    auto &held = *sched;
+    strand s(ex, std::move(sched));
+
+    int n = 0;
+    s.post([&] { ++n; });
+    s.post([&] { ++n; });
+
+    // the drain job finds the tasks held back and does not post itself
+    // again.
+    REQUIRE(ex.run_pending() == 1);
+    REQUIRE(ex.size() == 0);
+    REQUIRE(held.num_dequeues == 1);
+    REQUIRE(n == 0);
+    REQUIRE(s.size() == 2);
+
+    // the next enqueue after the deadline gets things going again.
+    held.released = true;
+    s.post([&] { ++n; });
+    REQUIRE(ex.run_pending() == 1);
+    REQUIRE(n == 3);
+    REQUIRE(s.size() == 0);
+    REQUIRE(ex.size() == 0);
+}
+
+TEST_CASE("Throwing jobs") {
+    SUBCASE("posted jobs do not take down the pool or the strand") {
+        ThreadPool pool(2);
+        pool.start();
+        threadpool_executor ex(pool);
+
+        strand s(ex);
+        std::promise<void> done;
+        s.post([] { throw std::runtime_error("posted job"); });
+        s.post([] { throw 1; });
+        s.post([&] { done.set_value(); });
+        REQUIRE(done.get_future().wait_for(5s) == std::future_status::ready);
+
+        std::promise<void> pool_done;
+        ex.post([] { throw std::runtime_error("pool job"); });
+        ex.post([&] { pool_done.set_value(); });
+        REQUIRE(pool_done.get_future().wait_for(5s) ==
+                std::future_status::ready);
+        s.close();
+    }
+
+    SUBCASE("an enqueued task that throws does not wedge the strand") {
+        queue_executor ex;
+        strand s(ex);
+
+        int n = 0;
+        auto [t, f] = tarp::sched::make_task_as<tarp::sched::interfaces::task>(
+          [] { throw std::runtime_error("enqueued task"); });
+        s.enqueue(std::move(t));
+        s.post([&] { ++n; });
+
+        bool thrown = false;
+        try {
+            ex.run_pending();
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        REQUIRE(thrown);
+        REQUIRE(!s.running_in_this_thread());
+
+        // the rest runs on the next drain job.
+        ex.run_pending();
+        REQUIRE(n == 1);
+        s.close();
+    }
+
+    SUBCASE("a throwing job does not lose the rest of its batch") {
+        queue_executor ex;
+        batching_executor batch(ex);
+
+        int n = 0;
+        batch.post([&] { ++n; });
+        batch.post([] { throw std::runtime_error("batched job"); });
+        batch.post([&] { ++n; });
+
+        bool thrown = false;
+        try {
+            ex.run_pending();
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        REQUIRE(thrown);
+        REQUIRE(n == 1);
+        REQUIRE(batch.size() == 1);
+
+        ex.run_pending();
+        REQUIRE(n == 2);
+        REQUIRE(batch.num_batches() == 2);
+    }
+}
+
+TEST_CASE("Many lite active objects on a few threads") {
+    ThreadPool pool(4);
+    pool.start();
+    threadpool_executor ex(pool);
+
+    constexpr std::size_t NUM_OBJECTS = 10000;
+    std::vector<std::unique_ptr<Account>> accounts;
+    for (std::size_t i = 0; i < NUM_OBJECTS; ++i) {
+        accounts.push_back(std::make_unique<Account>(ex));
+    }
+
+    std::vector<std::thread> clients;
+    for (int t = 0; t < 4; ++t) {
+        clients.emplace_back([&] {
+            for (auto &a : accounts) {
+                a->deposit(1);
+                a->deposit_async(10);
+            }
+        });
+    }
+    for (auto &t : clients) {
+        t.join();
+    }
+
+    for (auto &a : accounts) {
+        REQUIRE(a->get_balance().get() == 44);
+        REQUIRE(!a->overlapped());
+    }
+
+    REQUIRE(accounts[0]->check_context().get());
+    REQUIRE(!accounts[0]->outside_context());
+
+    // destroyed with tasks still pending.
+    for (auto &a : accounts) {
+        a->deposit(1);
+    }
+    accounts.clear();
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
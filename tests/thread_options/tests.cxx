@@ -0,0 +1,230 @@
+#include <tarp/thread_options.hxx>
+#include <tarp/threading.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace tarp::threading;
+
+namespace {
+
+std::string current_thread_name() {
+    char buff[16] = {0};
+    pthread_getname_np(pthread_self(), buff, sizeof(buff));
+    return buff;
+}
+
+// Records the cpu and name of its thread on the first pass.
+class Probe final : public ThreadEntity {
+public:
+    ~Probe() override { stop(); }
+
+    std::promise<std::pair<int, std::string>> result;
+
+private:
+    void do_work() override {
+        if (!m_done) {
+            result.set_value({sched_getcpu(), current_thread_name()});
+            m_done = true;
+        }
+        wait_for(10ms);
+    }
+
+    bool m_done {false};
+};
+
+// Write a fake sysfs cpu hierarchy: 2 packages x 2 cores x 2 threads,
+// numbered the way Linux usually numbers them (all the first SMT threads,
+// then all the second ones).
+std::string make_fake_sysfs() {
+    namespace fs = std::filesystem;
+    auto root = fs::temp_directory_path() /
+                ("tarp_sysfs_" + std::to_string(getpid()));
+    fs::create_directories(root);
+    std::ofstream(root / "online") << "0-7\n";
+
+    for (unsigned cpu = 0; cpu < 8; ++cpu) {
+        auto dir = root / ("cpu" + std::to_string(cpu)) / "topology";
+        fs::create_directories(dir);
+        std::ofstream(dir / "core_id") << (cpu % 2) << "\n";
+        std::ofstream(dir / "physical_package_id") << ((cpu / 2) % 2) << "\n";
+    }
+
+    return root.string();
+}
+
+}  // namespace
+
+TEST_CASE("Topology and placement") {
+    auto root = make_fake_sysfs();
+    auto topology = read_cpu_topology(root);
+    std::filesystem::remove_all(root);
+
+    REQUIRE(topology.size() == 8);
+    REQUIRE(topology[5].cpu == 5);
+    REQUIRE(topology[5].core == 1);
+    REQUIRE(topology[5].package == 0);
+    REQUIRE(topology[6].package == 1);
+
+    // siblings: {0,4} {1,5} on package 0, {2,6} {3,7} on package 1.
+    auto compact = plan_placement(topology, placement::COMPACT);
+    REQUIRE(compact == std::vector<unsigned> {0, 4, 1, 5, 2, 6, 3, 7});
+
+    auto scatter = plan_placement(topology, placement::SCATTER);
+    REQUIRE(scatter == std::vector<unsigned> {0, 2, 1, 3, 4, 6, 5, 7});
+
+    REQUIRE(plan_placement(topology, placement::NONE).empty());
+
+    // the real thing: only sanity checks since it depends on the host.
+    auto host = read_cpu_topology();
+    REQUIRE(!host.empty());
+    REQUIRE(plan_placement(host, placement::SCATTER).size() == host.size());
+
+    // missing topology files: every cpu is a core of its own.
+    auto bogus = read_cpu_topology("/nonexistent");
+    REQUIRE(bogus.size() == get_allowed_cpus().size());
+}
+
+TEST_CASE("Invalid options are rejected") {
+    thread_options opts;
+    opts.priority = 10;
+    REQUIRE_THROWS_AS(apply_thread_options(opts), std::invalid_argument);
+
+    opts.policy = sched_policy::FIFO;
+    opts.priority = 1000;
+    REQUIRE_THROWS_AS(apply_thread_options(opts), std::invalid_argument);
+
+    thread_options bad_cpu;
+    bad_cpu.cpus = {CPU_SETSIZE};
+    REQUIRE_THROWS_AS(apply_thread_options(bad_cpu), std::invalid_argument);
+
+    // no privileges is fine, but it must be reported.
+    thread_options rt;
+    rt.policy = sched_policy::RR;
+    rt.priority = 1;
+    std::thread t([&] {
+        try {
+            apply_thread_options(rt);
+            struct sched_param param;
+            int policy = 0;
+            pthread_getschedparam(pthread_self(), &policy, &param);
+            CHECK(policy == SCHED_RR);
+            CHECK(param.sched_priority == 1);
+        } catch (const std::runtime_error &) {
+        }
+    });
+    t.join();
+}
+
+TEST_CASE("Thread entity options") {
+    auto cpus = get_allowed_cpus();
+    REQUIRE(!cpus.empty());
+
+    thread_options opts;
+    opts.name = "probe-thread-with-a-long-name";
+    opts.cpus = {cpus.back()};
+    opts.prefault_stack = 256 * 1024;
+
+    Probe probe;
+    probe.set_thread_options(opts);
+    auto fut = probe.result.get_future();
+    probe.run();
+
+    auto [cpu, name] = fut.get();
+    REQUIRE(cpu == static_cast<int>(cpus.back()));
+    REQUIRE(name == "probe-thread-wi");
+
+    // applied immediately to a running thread.
+    opts.cpus.clear();
+    opts.name = "renamed";
+    REQUIRE_NOTHROW(probe.set_thread_options(opts));
+    probe.stop();
+}
+
+TEST_CASE("Prefaulting more than the whole stack") {
+    // clamped to the stack that is left rather than overflowing it.
+    REQUIRE_NOTHROW(prefault_stack(std::size_t {1} << 40));
+
+    std::thread t([] { REQUIRE_NOTHROW(prefault_stack(SIZE_MAX)); });
+    t.join();
+}
+
+TEST_CASE("Thread pool worker options") {
+    auto cpus = get_allowed_cpus();
+
+    ThreadPool pool(3);
+
+    thread_options opts;
+    opts.name = "worker";
+    pool.set_worker_options(opts, placement::SCATTER);
+    pool.start();
+
+    std::vector<std::future<std::pair<int, std::string>>> results;
+    for (int i = 0; i < 20; ++i) {
+        auto [task, fut] = tarp::sched::make_task_as<tarp::sched::interfaces::task>(
+          [] { return std::make_pair(sched_getcpu(), current_thread_name()); });
+        pool.enqueue_task(std::move(task));
+        results.push_back(std::move(fut));
+    }
+
+    for (auto &r : results) {
+        auto [cpu, name] = r.get();
+        REQUIRE(name.rfind("worker/", 0) == 0);
+        REQUIRE(std::find(cpus.begin(), cpus.end(), static_cast<unsigned>(cpu)) !=
+                cpus.end());
+    }
+
+    // existing workers are updated in place.
+    opts.name = "renamed";
+    pool.set_worker_options(opts);
+    auto [task, fut] = tarp::sched::make_task_as<tarp::sched::interfaces::task>(
+      [] { return current_thread_name(); });
+    pool.enqueue_task(std::move(task));
+    REQUIRE(fut.get().rfind("renamed/", 0) == 0);
+}
+
+TEST_CASE("Process memory locking") {
+    // typically needs privileges or a large enough RLIMIT_MEMLOCK.
+    try {
+        lock_process_memory(false);
+        unlock_process_memory();
+    } catch (const std::runtime_error &e) {
+        MESSAGE("mlockall unavailable: " << e.what());
+    }
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
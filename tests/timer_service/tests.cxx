@@ -0,0 +1,269 @@
+#include <tarp/timer_service.hxx>
+#include <tarp/watchdog.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace tarp::threading;
+using steady = std::chrono::steady_clock;
+
+namespace {
+
+template<typename F>
+bool wait_for_condition(F &&f, std::chrono::milliseconds timeout = 5s) {
+    auto deadline = steady::now() + timeout;
+    while (!f()) {
+        if (steady::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+}  // namespace
+
+TEST_CASE("Timers fire in expiry order") {
+    TimerService svc;
+
+    std::mutex mtx;
+    std::vector<int> fired;
+    auto base = steady::now() + 20ms;
+    for (int i = 99; i >= 0; --i) {
+        svc.schedule(base + std::chrono::microseconds(i * 100), [&, i] {
+            std::unique_lock l {mtx};
+            fired.push_back(i);
+            return std::nullopt;
+        });
+    }
+    REQUIRE(svc.size() == 100);
+
+    REQUIRE(wait_for_condition([&] { return svc.size() == 0; }));
+    std::unique_lock l {mtx};
+    REQUIRE(fired.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(fired[static_cast<std::size_t>(i)] == i);
+    }
+}
+
+TEST_CASE("Periodic timers, rescheduling and cancellation") {
+    TimerService svc;
+
+    // re-armed by its callback until canceled.
+    std::atomic<unsigned> ticks {0};
+    auto periodic = svc.schedule(steady::now(), [&] {
+        ticks++;
+        return steady::now() + 2ms;
+    });
+    REQUIRE(wait_for_condition([&] { return ticks >= 5; }));
+    REQUIRE(svc.cancel(periodic));
+    auto n = ticks.load();
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(ticks == n);
+    REQUIRE(!svc.cancel(periodic));
+
+    // moved much earlier.
+    std::atomic<bool> fired {false};
+    auto id = svc.schedule(steady::now() + 1h, [&] {
+        fired = true;
+        return std::nullopt;
+    });
+    REQUIRE(svc.reschedule(id, steady::now() + 5ms));
+    REQUIRE(wait_for_condition([&] { return fired.load(); }));
+    REQUIRE(!svc.reschedule(id, steady::now()));
+
+    // canceled from inside its own callback.
+    std::atomic<unsigned> calls {0};
+    TimerService::timer_id self = 0;
+    std::mutex mtx;
+    {
+        std::unique_lock l {mtx};
+        self = svc.schedule(steady::now(), [&] {
+            std::unique_lock l2 {mtx};
+            calls++;
+            svc.cancel(self);
+            return steady::now();
+        });
+    }
+    REQUIRE(wait_for_condition([&] { return svc.size() == 0; }));
+    std::this_thread::sleep_for(10ms);
+    REQUIRE(calls == 1);
+}
+
+TEST_CASE("Cancel waits for a running callback") {
+    TimerService svc;
+
+    std::atomic<bool> started {false};
+    std::atomic<bool> finished {false};
+    auto id = svc.schedule(steady::now(), [&] {
+        started = true;
+        std::this_thread::sleep_for(50ms);
+        finished = true;
+        return steady::now();
+    });
+
+    REQUIRE(wait_for_condition([&] { return started.load(); }));
+    REQUIRE(svc.cancel(id));
+    REQUIRE(finished);
+}
+
+TEST_CASE("A throwing callback retires its timer only") {
+    TimerService svc;
+
+    std::atomic<unsigned> ticks {0};
+    auto periodic = svc.schedule(steady::now(), [&] {
+        ticks++;
+        return steady::now() + 2ms;
+    });
+
+    std::atomic<bool> started {false};
+    auto thrower = svc.schedule(
+      steady::now(), [&]() -> std::optional<steady::time_point> {
+        started = true;
+        std::this_thread::sleep_for(20ms);
+        throw std::runtime_error("timer callback");
+    });
+
+    // cancel() must not wait forever for the callback that threw.
+    REQUIRE(wait_for_condition([&] { return started.load(); }));
+    svc.cancel(thrower);
+    REQUIRE(!svc.cancel(thrower));
+
+    // the service thread survives and the other timers keep firing.
+    auto n = ticks.load();
+    REQUIRE(wait_for_condition([&] { return ticks > n + 3; }));
+    REQUIRE(svc.cancel(periodic));
+    REQUIRE(svc.size() == 0);
+}
+
+TEST_CASE("Hosted timer and oscillator") {
+    TimerService svc;
+
+    auto guard = std::make_unique<tarp::TimeGuard<std::chrono::milliseconds>>(
+      5ms, true, 5);
+    HostedTimer<std::chrono::milliseconds> timer(svc, std::move(guard));
+    std::atomic<unsigned> timeouts {0};
+    auto tconn = timer.get_timeout_signal().connect([&] { timeouts++; });
+    timer.start();
+
+    HostedOscillator osc(svc);
+    osc.set_period(2ms);
+    REQUIRE(osc.get_period() == 2ms);
+    std::atomic<unsigned> ticks {0};
+    auto oconn = osc.get_tick_signal().connect([&] { ticks++; });
+    osc.start();
+
+    // the guard disables itself after 5 intervals, retiring the timer.
+    REQUIRE(wait_for_condition([&] { return timeouts >= 5; }));
+    REQUIRE(wait_for_condition([&] { return svc.size() == 1; }));
+    auto n = timeouts.load();
+
+    REQUIRE(wait_for_condition([&] { return ticks >= 10; }));
+    osc.stop();
+    auto t = ticks.load();
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(ticks == t);
+    REQUIRE(timeouts == n);
+    REQUIRE(svc.size() == 0);
+
+    tconn->disconnect();
+    oconn->disconnect();
+}
+
+TEST_CASE("Many hosted watchdogs on one thread") {
+    TimerService svc;
+
+    constexpr std::size_t N = 200;
+    std::atomic<unsigned> bitten {0};
+    std::vector<std::unique_ptr<tarp::HostedWatchdog<std::chrono::milliseconds>>>
+      dogs;
+    for (std::size_t i = 0; i < N; ++i) {
+        dogs.push_back(
+          std::make_unique<tarp::HostedWatchdog<std::chrono::milliseconds>>(
+            svc, 20ms, [&] { bitten++; }));
+        dogs.back()->kick();
+    }
+    REQUIRE(svc.size() == N);
+
+    // keep the odd ones at bay; the even ones bite.
+    auto until = steady::now() + 100ms;
+    while (steady::now() < until) {
+        for (std::size_t i = 1; i < N; i += 2) {
+            dogs[i]->reset();
+        }
+        std::this_thread::sleep_for(2ms);
+    }
+
+    REQUIRE(bitten == N / 2);
+    for (std::size_t i = 0; i < N; ++i) {
+        REQUIRE(dogs[i]->armed() == (i % 2 == 1));
+    }
+
+    // stopped watchdogs never bite.
+    for (std::size_t i = 1; i < N; i += 2) {
+        dogs[i]->stop();
+    }
+    REQUIRE(svc.size() == 0);
+
+    // bitten watchdogs can be re-armed.
+    dogs[0]->kick();
+    REQUIRE(dogs[0]->armed());
+    REQUIRE(wait_for_condition([&] { return bitten == N / 2 + 1; }));
+
+    // guarded mode: the guard keeps the watchdog at bay.
+    std::atomic<bool> healthy {true};
+    std::atomic<unsigned> guarded_bites {0};
+    tarp::HostedWatchdog<std::chrono::milliseconds> guarded(
+      svc, 5ms, [&] { guarded_bites++; }, [&] { return healthy.load(); });
+    guarded.kick();
+    std::this_thread::sleep_for(30ms);
+    REQUIRE(guarded_bites == 0);
+    healthy = false;
+    REQUIRE(wait_for_condition([&] { return guarded_bites == 1; }));
+}
+
+TEST_CASE("Thread-based watchdog reset") {
+    std::atomic<unsigned> bitten {0};
+    tarp::Watchdog<std::chrono::milliseconds> wd(20ms, [&] { bitten++; });
+    wd.run();
+
+    auto until = steady::now() + 100ms;
+    while (steady::now() < until) {
+        wd.reset();
+        std::this_thread::sleep_for(2ms);
+    }
+    REQUIRE(bitten == 0);
+    REQUIRE(wait_for_condition([&] { return bitten == 1; }));
+    wd.stop();
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
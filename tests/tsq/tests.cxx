@@ -0,0 +1,194 @@
+#include <tarp/tsq.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Move-only elements") {
+    tarp::tsq<std::unique_ptr<int>> q;
+
+    q.push_back(std::make_unique<int>(1));
+    q.push_front(std::make_unique<int>(0));
+    q.emplace_back(new int(2));
+    REQUIRE(q.size() == 3);
+
+    REQUIRE(*q.pop_front() == 0);
+    REQUIRE(*q.pop_back() == 2);
+
+    std::deque<std::unique_ptr<int>> out;
+    q.pop_front_many(out);
+    REQUIRE(out.size() == 1);
+    REQUIRE(*out.front() == 1);
+    REQUIRE(q.empty());
+    REQUIRE_FALSE(q.try_pop().has_value());
+}
+
+namespace {
+// Counts the number of times it has been copied.
+struct counter {
+    counter() = default;
+    counter(const counter &) { ++copies; }
+    counter(counter &&) noexcept = default;
+    counter &operator=(const counter &) = default;
+    counter &operator=(counter &&) noexcept = default;
+    static inline unsigned copies = 0;
+};
+}  // namespace
+
+TEST_CASE("Pushed elements are not copied") {
+    tarp::tsq<counter> q;
+    q.push_back(counter {});
+    q.push_front(counter {});
+    q.pop_front();
+    q.try_pop();
+    REQUIRE(counter::copies == 0);
+}
+
+TEST_CASE("Blocking pops") {
+    tarp::tsq<int> q;
+
+    SUBCASE("wait_pop_for times out") {
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE_FALSE(q.wait_pop_for(20ms).has_value());
+        REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+    }
+
+    SUBCASE("wait_pop is woken by a producer") {
+        std::thread producer([&q] {
+            std::this_thread::sleep_for(20ms);
+            q.push_back(5);
+        });
+        REQUIRE(q.wait_pop() == 5);
+        producer.join();
+    }
+
+    SUBCASE("wait_pop_for returns available elements immediately") {
+        q.push_back(1);
+        REQUIRE(q.wait_pop_for(1h) == 1);
+    }
+}
+
+TEST_CASE("swap_drain takes all elements") {
+    tarp::tsq<int> q;
+    for (int i = 0; i < 10; ++i) {
+        q.push_back(i);
+    }
+
+    std::deque<int> items {100};
+    q.swap_drain(items);
+    REQUIRE(q.empty());
+    REQUIRE(items.size() == 10);
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(items[i] == i);
+    }
+}
+
+TEST_CASE("Multiple producers and consumers") {
+    static constexpr int NUM_THREADS = 4;
+    static constexpr int NUM_ITEMS = 10000;
+
+    tarp::tsq<int> q;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<int>> received(NUM_THREADS);
+
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        threads.emplace_back([&q, &items = received[i]] {
+            // -1 is the sentinel used to stop the consumers.
+            for (int v; (v = q.wait_pop()) != -1;) {
+                items.push_back(v);
+            }
+        });
+    }
+
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        threads.emplace_back([&q, i] {
+            for (int j = 0; j < NUM_ITEMS; ++j) {
+                q.push_back(i * NUM_ITEMS + j);
+            }
+        });
+    }
+
+    for (int i = NUM_THREADS; i < 2 * NUM_THREADS; ++i) {
+        threads[i].join();
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        q.push_back(-1);
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        threads[i].join();
+    }
+
+    std::set<int> all;
+    for (auto &items : received) {
+        all.insert(items.begin(), items.end());
+    }
+    REQUIRE(all.size() == NUM_THREADS * NUM_ITEMS);
+}
+
+TEST_CASE("Sharded queue") {
+    static constexpr int NUM_PRODUCERS = 8;
+    static constexpr int NUM_ITEMS = 10000;
+
+    tarp::sharded_tsq<std::unique_ptr<int>> q(4);
+    REQUIRE(q.num_shards() == 4);
+    REQUIRE(q.empty());
+    REQUIRE_FALSE(q.wait_pop_for(10ms).has_value());
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < NUM_PRODUCERS; ++i) {
+        producers.emplace_back([&q, i] {
+            for (int j = 0; j < NUM_ITEMS; ++j) {
+                q.push(std::make_unique<int>(i * NUM_ITEMS + j));
+            }
+        });
+    }
+
+    // items pushed by the same producer are popped in order.
+    std::vector<int> last(NUM_PRODUCERS, -1);
+    unsigned num_received = 0;
+    while (num_received < NUM_PRODUCERS * NUM_ITEMS / 2) {
+        auto v = *q.wait_pop();
+        auto producer = v / NUM_ITEMS;
+        REQUIRE(v > last[producer]);
+        last[producer] = v;
+        ++num_received;
+    }
+
+    for (auto &t : producers) {
+        t.join();
+    }
+
+    std::deque<std::unique_ptr<int>> rest;
+    q.drain(rest);
+    REQUIRE(q.empty());
+    REQUIRE(num_received + rest.size() == NUM_PRODUCERS * NUM_ITEMS);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}
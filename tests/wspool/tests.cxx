@@ -0,0 +1,254 @@
+#include <tarp/sched.hxx>
+#include <tarp/work_stealing_pool.hxx>
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using tarp::threading::WorkStealingPool;
+
+namespace {
+
+template<typename F>
+auto submit(WorkStealingPool &pool, F f) {
+    auto [task, future] =
+      tarp::sched::make_task_as<tarp::sched::interfaces::task>(std::move(f));
+    pool.enqueue_task(std::move(task));
+    return std::move(future);
+}
+
+// Wait on the future, running other tasks meanwhile.
+template<typename T>
+T help_while_waiting(WorkStealingPool &pool, std::future<T> &f) {
+    while (f.wait_for(0s) != std::future_status::ready) {
+        if (!pool.try_run_one()) {
+            std::this_thread::yield();
+        }
+    }
+    return f.get();
+}
+
+// The counter is only bumped after the task's future has been made ready.
+bool wait_handled(WorkStealingPool &pool, std::size_t n) {
+    auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (pool.get_num_tasks_handled() < n) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return pool.get_num_tasks_handled() == n;
+}
+
+unsigned fib(WorkStealingPool &pool, unsigned n) {
+    if (n < 2) {
+        return n;
+    }
+
+    auto f = submit(pool, [&pool, n] { return fib(pool, n - 1); });
+    auto b = fib(pool, n - 2);
+    return help_while_waiting(pool, f) + b;
+}
+
+}  // namespace
+
+TEST_CASE("Chase-Lev deque: owner pops LIFO, thieves steal FIFO") {
+    tarp::threading::impl::ws_deque<int> dq(2);
+    int items[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+    REQUIRE(dq.pop() == nullptr);
+    REQUIRE(dq.steal() == nullptr);
+
+    // grows past the initial capacity.
+    for (auto &i : items) {
+        dq.push(&i);
+    }
+    REQUIRE(dq.size() == 8);
+
+    REQUIRE(*dq.pop() == 7);
+    REQUIRE(*dq.steal() == 0);
+    REQUIRE(*dq.steal() == 1);
+    REQUIRE(*dq.pop() == 6);
+    REQUIRE(dq.size() == 4);
+}
+
+TEST_CASE("Chase-Lev deque: every item is taken exactly once") {
+    constexpr int NUM_ITEMS = 200000;
+    constexpr int NUM_THIEVES = 3;
+
+    tarp::threading::impl::ws_deque<int> dq;
+    std::vector<int> items(NUM_ITEMS);
+    std::vector<std::atomic<int>> taken(NUM_ITEMS);
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        items[i] = i;
+    }
+
+    std::atomic<bool> done {false};
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < NUM_THIEVES; ++i) {
+        thieves.emplace_back([&] {
+            while (!done.load()) {
+                if (auto *p = dq.steal()) {
+                    taken[*p]++;
+                }
+            }
+        });
+    }
+
+    // Owner interleaves pushes and pops.
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        dq.push(&items[i]);
+        if (i % 3 == 0) {
+            if (auto *p = dq.pop()) {
+                taken[*p]++;
+            }
+        }
+    }
+    while (auto *p = dq.pop()) {
+        taken[*p]++;
+    }
+
+    done = true;
+    for (auto &t : thieves) {
+        t.join();
+    }
+
+    // Stragglers left after the owner lost a race on the last item.
+    while (auto *p = dq.steal()) {
+        taken[*p]++;
+    }
+
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        REQUIRE(taken[i] == 1);
+    }
+}
+
+TEST_CASE("External submissions are all executed") {
+    WorkStealingPool pool(4);
+    REQUIRE(pool.get_num_threads() == 4);
+
+    // buffered until start().
+    std::atomic<unsigned> count {0};
+    std::vector<std::future<void>> futures;
+    for (unsigned i = 0; i < 10; ++i) {
+        futures.push_back(submit(pool, [&count] { count++; }));
+    }
+    REQUIRE(pool.get_queue_length() == 10);
+
+    pool.start();
+    for (unsigned i = 0; i < 990; ++i) {
+        futures.push_back(submit(pool, [&count] { count++; }));
+    }
+
+    for (auto &f : futures) {
+        f.get();
+    }
+
+    REQUIRE(count == 1000);
+    REQUIRE(wait_handled(pool, 1000));
+    REQUIRE(pool.get_queue_length() == 0);
+}
+
+TEST_CASE("Tasks submitted from within tasks are spread across workers") {
+    WorkStealingPool pool(4);
+    pool.start();
+
+    std::mutex mtx;
+    std::set<std::thread::id> threads;
+
+    auto f = submit(pool, [&] {
+        std::vector<std::future<void>> children;
+        for (unsigned i = 0; i < 64; ++i) {
+            children.push_back(submit(pool, [&] {
+                std::this_thread::sleep_for(1ms);
+                std::unique_lock l {mtx};
+                threads.insert(std::this_thread::get_id());
+            }));
+        }
+        for (auto &c : children) {
+            help_while_waiting(pool, c);
+        }
+    });
+
+    f.get();
+    REQUIRE(wait_handled(pool, 65));
+
+    // The children were pushed onto the deque of a single worker so the
+    // others must have stolen some of them.
+    REQUIRE(threads.size() > 1);
+}
+
+TEST_CASE("Recursive fork-join does not deadlock") {
+    WorkStealingPool pool(2);
+    pool.start();
+
+    auto f = submit(pool, [&pool] { return fib(pool, 18); });
+    REQUIRE(f.get() == 2584);
+}
+
+TEST_CASE("Idle workers park and are woken by new work") {
+    WorkStealingPool pool(3);
+    pool.start();
+
+    for (unsigned round = 0; round < 5; ++round) {
+        // give the workers time to park.
+        std::this_thread::sleep_for(20ms);
+        auto f = submit(pool, [] { return 7; });
+        REQUIRE(f.wait_for(1s) == std::future_status::ready);
+        REQUIRE(f.get() == 7);
+    }
+}
+
+TEST_CASE("Stopping discards pending tasks") {
+    std::atomic<unsigned> count {0};
+    {
+        WorkStealingPool pool(1);
+        pool.start();
+
+        std::promise<void> gate;
+        auto gate_future = gate.get_future().share();
+        submit(pool, [gate_future] { gate_future.wait(); });
+        for (unsigned i = 0; i < 10; ++i) {
+            submit(pool, [&count] { count++; });
+        }
+
+        std::thread t([&] {
+            std::this_thread::sleep_for(20ms);
+            gate.set_value();
+        });
+        pool.stop();
+        t.join();
+    }
+
+    // the worker may have squeezed in a few before noticing the stop
+    // request, but not all.
+    REQUIRE(count < 10);
+}
+
+int main(int argc, char **argv) {
+    doctest::Context ctx;
+
+    ctx.setOption("abort-after",
+                  1);  // default - stop after 5 failed asserts
+
+    ctx.applyCommandLine(argc, argv);  // apply command line - argc / argv
+
+    ctx.setOption("no-breaks",
+                  true);  // override - don't break in the debugger
+
+    int res = ctx.run();  // run test cases unless with --no-run
+
+    if (ctx.shouldExit())  // query flags (and --exit) rely on this
+    {
+        return res;  // propagate the result of the tests
+    }
+
+    return 0;
+}